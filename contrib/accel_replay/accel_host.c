@@ -0,0 +1,115 @@
+/*
+ * accel_host.c
+ *
+ * Stand-ins for the display, menu, message bus and buzzer services that
+ * modules/accelerometer.c uses, see accel_host.h. The display only keeps
+ * the number _sprintf() formatted last and where it went, which is how
+ * the module shows the acceleration.
+ */
+
+#include <stdbool.h>
+
+#include "openchronos.h"
+#include "menu.h"
+#include "messagebus.h"
+#include "drivers/display.h"
+#include "drivers/buzzer.h"
+
+#include "accel_host.h"
+
+struct menu accel_host_menu;
+uint16_t accel_host_shown;
+uint8_t accel_host_up;
+unsigned long accel_host_updates;
+unsigned long accel_host_beeps;
+
+static void (*listener)(enum sys_message);
+static enum sys_message listens;
+static uint16_t printed;
+
+void accel_host_send(enum sys_message msg)
+{
+    if (listener && (msg & listens))
+        listener(msg);
+}
+
+char *_sprintf(const char *fmt, int16_t n)
+{
+    static char str[] = "0000";
+
+    printed = (uint16_t)n;
+    return str;
+}
+
+void display_chars(uint8_t scr_nr, enum display_segment_array segments,
+        char const *str, enum display_segstate state)
+{
+    if (scr_nr == 1 && segments == LCD_SEG_L1_2_0) {
+        accel_host_shown = printed;
+        accel_host_updates++;
+    }
+}
+
+void display_char(uint8_t scr_nr, enum display_segment segment,
+        char chr, enum display_segstate state)
+{
+}
+
+void display_symbol(uint8_t scr_nr, enum display_segment symbol,
+        enum display_segstate state)
+{
+    if (scr_nr == 1 && symbol == LCD_SYMB_ARROW_UP)
+        accel_host_up = state == SEG_ON;
+}
+
+void display_clear(uint8_t scr_nr, uint8_t line)
+{
+}
+
+void lcd_screens_create(uint8_t nr)
+{
+}
+
+void lcd_screens_destroy(void)
+{
+}
+
+void lcd_screen_activate(uint8_t scr_nr)
+{
+}
+
+void buzzer_play(const note *notes, enum buzzer_priority priority)
+{
+    accel_host_beeps++;
+}
+
+struct menu *menu_add_entry(char const *name,
+        void (*up_btn_fn)(void), void (*down_btn_fn)(void),
+        void (*num_btn_fn)(void), void (*lstar_btn_fn)(void),
+        void (*lnum_btn_fn)(void), void (*updown_btn_fn)(void),
+        void (*activate_fn)(void), void (*deactivate_fn)(void))
+{
+    accel_host_menu.name = name;
+    accel_host_menu.up_btn_fn = up_btn_fn;
+    accel_host_menu.down_btn_fn = down_btn_fn;
+    accel_host_menu.num_btn_fn = num_btn_fn;
+    accel_host_menu.lstar_btn_fn = lstar_btn_fn;
+    accel_host_menu.lnum_btn_fn = lnum_btn_fn;
+    accel_host_menu.updown_btn_fn = updown_btn_fn;
+    accel_host_menu.activate_fn = activate_fn;
+    accel_host_menu.deactivate_fn = deactivate_fn;
+    return &accel_host_menu;
+}
+
+void sys_messagebus_register(void (*callback)(enum sys_message),
+        enum sys_message msgs)
+{
+    listener = callback;
+    listens = msgs;
+}
+
+void sys_messagebus_unregister_all(void (*callback)(enum sys_message))
+{
+    if (listener == callback)
+        listener = NULL;
+}
@@ -0,0 +1,30 @@
+/*
+ * accel_host.h
+ *
+ * What accel_host.c offers the replay of modules/accelerometer.c: the menu
+ * entry it registered, the message bus callback it listens with, and the
+ * value it last put on line 1 of its data screen.
+ */
+
+#ifndef __ACCEL_HOST_H__
+#define __ACCEL_HOST_H__
+
+#include <stdint.h>
+#include "menu.h"
+#include "messagebus.h"
+
+/* The entry of mod_accelerometer_init(), to press buttons and switch to it */
+extern struct menu accel_host_menu;
+
+/* Sends msg to the registered callback if it listens for it */
+void accel_host_send(enum sys_message msg);
+
+/* The number on screen 1, line 1 and its arrow, 1 up, 0 down */
+extern uint16_t accel_host_shown;
+extern uint8_t accel_host_up;
+
+/* Screen updates and buzzer_play() calls */
+extern unsigned long accel_host_updates;
+extern unsigned long accel_host_beeps;
+
+#endif /* __ACCEL_HOST_H__ */
@@ -0,0 +1,315 @@
+/*
+ * accel_replay.c
+ *
+ * Replay a recorded X/Y/Z trace through the accelerometer algorithms on the
+ * host, so changes can be compared offline against real captures from
+ * contrib/read_acceleration.py or contrib/plot_accel.py.
+ *
+ * Input is one sample per line. Any three integers on a line are taken as
+ * X, Y, Z (so the "x: 12 y: 250 z: 60" output of read_acceleration.py works
+ * as is), four integers as a time stamp in ms followed by X, Y, Z. Values
+ * are raw sensor counts, either 0..255 or -128..127. Time stamped traces are
+ * resampled to the replay rate by holding the last sample, untimed traces
+ * are taken to be at that rate already.
+ *
+ * The samples come out of the CMA3000 model in cma3000.c at the replay
+ * rate and go through drivers/vti_as.c as on the watch: the data ready
+ * interrupt, the USCI interrupt reading X/Y/Z into the ring, and a wake up
+ * of the main loop per batch, which feeds the ring to the step counter.
+ * With -a the batches go to modules/accelerometer.c instead, built in with
+ * the display, menu and message bus of accel_host.c. It is switched to its
+ * screen and to measurement mode with the up button, as by hand, at the
+ * replay rate: the 10 Hz it asks for is only a motion detection rate of the
+ * sensor.
+ *
+ * The report lists every detected step, or every value the accelerometer
+ * screen shows, with its time, the totals, and the per-sample cost:
+ * interrupts and SPI frames, host time of the algorithm
+ * and the number of Q15 multiplies done through dsp.c, which dominate on
+ * the MSP430 without a hardware multiplier. The multiplies are counted by
+ * wrapping the dsp.c entry points the algorithms call, calls inside dsp.c
+ * itself are not seen by the linker, hence the per-filter weights below.
+ * A sample that takes more than STEPCOUNT_MULTS fails the replay.
+ *
+ * walk.txt is a synthetic trace in the output format of read_acceleration.py,
+ * 2 s standing and 10 s walking at 1.8 steps per second, sampled at 100 Hz.
+ *
+ * Build from the top of the tree, -fcommon lets vti_as.h define
+ * as_last_interrupt in every file as on the target:
+ *
+ *   cc -O2 -Wall -fcommon -DCONFIG_MOD_PEDOMETER -DCONFIG_MOD_ACCELEROMETER \
+ *      -Icontrib/accel_replay -Idrivers -I. -o accel_replay \
+ *      contrib/accel_replay/accel_replay.c contrib/accel_replay/accel_host.c \
+ *      contrib/accel_replay/cma3000.c drivers/vti_as.c drivers/stepcount.c \
+ *      drivers/dsp.c -Wl,--wrap=mult_scale15 -Wl,--wrap=mult_scale16 \
+ *      -Wl,--wrap=iir1_filter -Wl,--wrap=biquad_filter
+ *
+ * Usage: accel_replay [-r 40|100] [-b batch] [-a] [-q] trace.csv
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "openchronos.h"
+#include "vti_as.h"
+#include "stepcount.h"
+#include "cma3000.h"
+#include "accel_host.h"
+
+#include "modules/accelerometer.c"
+
+/* Same batch as modules/pedometer.c, half of AS_RING_SIZE */
+#define REPLAY_BATCH    16
+#define REPLAY_RATE     100
+#define REPLAY_MAX      (1L << 24)
+
+static unsigned long mults;
+
+extern int16_t __real_mult_scale15(int16_t a, int16_t b);
+extern int16_t __real_mult_scale16(int16_t a, int16_t b);
+extern int16_t __real_iir1_filter(struct iir1 *f, int16_t x);
+extern int16_t __real_biquad_filter(struct biquad *f, int16_t x);
+
+int16_t __wrap_mult_scale15(int16_t a, int16_t b)
+{
+    mults++;
+    return __real_mult_scale15(a, b);
+}
+
+int16_t __wrap_mult_scale16(int16_t a, int16_t b)
+{
+    mults++;
+    return __real_mult_scale16(a, b);
+}
+
+/* one mult_scale15() inside */
+int16_t __wrap_iir1_filter(struct iir1 *f, int16_t x)
+{
+    mults++;
+    return __real_iir1_filter(f, x);
+}
+
+/* five mult_scale15() inside */
+int16_t __wrap_biquad_filter(struct biquad *f, int16_t x)
+{
+    mults += 5;
+    return __real_biquad_filter(f, x);
+}
+
+/* Pull up to max integers out of a line, skipping anything else */
+static int parse_line(const char *line, long *v, int max)
+{
+    int n = 0;
+    char *end;
+
+    while (*line && n < max) {
+        if ((*line == '-' && line[1] >= '0' && line[1] <= '9')
+            || (*line >= '0' && *line <= '9')) {
+            v[n++] = strtol(line, &end, 10);
+            line = end;
+        } else {
+            line++;
+        }
+    }
+    return n;
+}
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "usage: %s [-r 40|100] [-b batch] [-a] [-q] trace.csv\n",
+            name);
+    exit(2);
+}
+
+/* Open the accelerometer screen and press up twice, ACTI to FALL to MEAS */
+static void accel_start(unsigned rate)
+{
+    mod_accelerometer_init();
+    accel_host_menu.activate_fn();
+    sAccel.as.range = rate == 40 ? 8 : 2;
+    sAccel.as.sampling = rate == 40 ? SAMPLING_40_HZ : SAMPLING_100_HZ;
+    accel_host_menu.up_btn_fn();
+    accel_host_menu.up_btn_fn();
+}
+
+int main(int argc, char **argv)
+{
+    struct stepcount sc;
+    uint8_t (*trace)[3];
+    long count = 0, i, v[4];
+    long t0 = -1, next = 0;
+    unsigned rate = REPLAY_RATE, batch = REPLAY_BATCH, wakes = 0;
+    unsigned long frames, worst = 0, m;
+    unsigned long long end;
+    int quiet = 0, module = 0, opt, n;
+    uint8_t xyz[3], awake;
+    char line[256];
+    double start, elapsed;
+    FILE *in;
+
+    while ((opt = getopt(argc, argv, "r:b:aq")) != -1) {
+        switch (opt) {
+        case 'r':
+            rate = atoi(optarg);
+            break;
+        case 'b':
+            batch = atoi(optarg);
+            break;
+        case 'a':
+            module = 1;
+            batch = ACCEL_STREAM_BATCH;
+            break;
+        case 'q':
+            quiet = 1;
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+    if (optind != argc - 1 || (rate != 40 && rate != 100) || batch == 0
+            || batch >= AS_RING_SIZE)
+        usage(argv[0]);
+
+    in = strcmp(argv[optind], "-") ? fopen(argv[optind], "r") : stdin;
+    if (!in) {
+        perror(argv[optind]);
+        return 1;
+    }
+
+    trace = malloc(REPLAY_MAX * sizeof(*trace));
+    if (!trace)
+        return 1;
+
+    /* Load and resample first, so the timed part is the algorithm only */
+    while (fgets(line, sizeof(line), in) && count < REPLAY_MAX) {
+        n = parse_line(line, v, 4);
+        if (n < 3)
+            continue;
+        if (n == 4) {
+            if (t0 < 0)
+                t0 = v[0];
+            /* hold the previous sample over any gap */
+            while (count && next * 1000 < (v[0] - t0) * (long)rate
+                   && count < REPLAY_MAX) {
+                memcpy(trace[count], trace[count - 1], 3);
+                count++;
+                next++;
+            }
+            if (next * 1000 > (v[0] - t0) * (long)rate)
+                continue;
+            next++;
+            memmove(v, v + 1, 3 * sizeof(*v));
+        }
+        trace[count][0] = (uint8_t)v[0];
+        trace[count][1] = (uint8_t)v[1];
+        trace[count][2] = (uint8_t)v[2];
+        count++;
+    }
+    if (in != stdin)
+        fclose(in);
+
+    stepcount_init(&sc, rate);
+    mults = 0;
+    elapsed = 0;
+
+    /* What modules/pedometer.c does, 40 Hz needs the 8 g range */
+    cma3000_init();
+    cma3000.trace = (const uint8_t (*)[3])trace;
+    cma3000.trace_len = count;
+    as_init();
+    if (module) {
+        accel_start(rate);
+    } else {
+        as_config.range = rate == 40 ? 8 : 2;
+        as_config.sampling = rate == 40 ? SAMPLING_40_HZ : SAMPLING_100_HZ;
+        as_start(MEASUREMENT_MODE);
+        as_stream_start(batch);
+    }
+    frames = cma3000.frames;
+
+    /* The main loop, woken once a batch */
+    i = 0;
+    end = cma3000.cycles + (count + 2) * CMA3000_MHZ * 1000000ull / rate;
+    do {
+        awake = cma3000_sleep_until(end);
+        if (awake)
+            wakes++;
+        if (!as_last_interrupt && awake)
+            continue;
+        as_last_interrupt = 0;
+
+        start = now();
+        if (module) {
+            unsigned long updates = accel_host_updates;
+
+            /* the module drains the ring itself */
+            accel_host_send(SYS_MSG_AS_INT);
+            i = cma3000.samples;
+            if (accel_host_updates != updates && !quiet)
+                printf("%9.2f s  %u.%02u g %s\n", (double)i / rate,
+                       accel_host_shown / 100, accel_host_shown % 100,
+                       accel_host_up ? "up" : "down");
+        }
+        while (!module && as_stream_read(xyz)) {
+            uint8_t added;
+
+            m = mults;
+            added = stepcount_feed(&sc, xyz);
+            if (mults - m > worst)
+                worst = mults - m;
+
+            if (added && !quiet)
+                printf("%9.2f s  step %lu%s\n", (double)i / rate,
+                       (unsigned long)sc.steps,
+                       added > 1 ? "  (run confirmed)" : "");
+            i++;
+        }
+        elapsed += now() - start;
+    } while (awake);
+
+    frames = cma3000.frames - frames;
+    if (module) {
+        accel_host_menu.deactivate_fn();
+    } else {
+        as_stream_stop();
+        as_stop();
+    }
+
+    printf("samples    %ld (%.1f s at %u Hz), %ld through the ring\n", count,
+           (double)count / rate, rate, i);
+    printf("wake ups   %u (batch %u)\n", wakes, batch);
+    if (module)
+        printf("shown      %lu values, the last %u.%02u g\n",
+               accel_host_updates, accel_host_shown / 100,
+               accel_host_shown % 100);
+    else
+        printf("steps      %lu\n", (unsigned long)sc.steps);
+    if (count) {
+        printf("interrupts %.2f port, %.2f USCI per sample\n",
+               (double)cma3000.port_irqs / count,
+               (double)cma3000.usci_irqs / count);
+        printf("SPI        %.2f frames per sample, %lu errors\n",
+               (double)frames / count, cma3000.errors);
+        if (module)
+            printf("multiplies %.2f per sample\n", (double)mults / count);
+        else
+            printf("multiplies %.2f per sample, %lu at most, budget %u\n",
+                   (double)mults / count, worst, STEPCOUNT_MULTS);
+        printf("host time  %.1f ns per sample\n", elapsed * 1e9 / count);
+    }
+
+    free(trace);
+    return i == count && !cma3000.overruns && !cma3000.errors
+        && worst <= STEPCOUNT_MULTS && as_owner() == AS_CLIENTS ? 0 : 1;
+}
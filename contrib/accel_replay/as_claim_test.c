@@ -0,0 +1,197 @@
+/*
+ * as_claim_test.c
+ *
+ * Runs the sharing of the sensor by as_claim() and as_release() in
+ * drivers/vti_as.c against the CMA3000 model in cma3000.c, the way the
+ * accelerometer, sleep and pedometer modules use it:
+ *
+ *   pedometer  streams at 100 Hz into the ring, alone
+ *   preempted  the accelerometer screen claims motion detection, the
+ *              stream stops and the pedometer keeps its claim
+ *   queued     a claim below the owner is kept but does not touch the sensor
+ *   restored   the accelerometer releases, the pedometer stream comes back
+ *              as it asked, batch wake ups and all
+ *   sleep      the sleep tracker counts motion events over the pedometer
+ *   off        the sensor powers down once every claim is released
+ *
+ * Build from the top of the tree, -fcommon lets vti_as.h define
+ * as_last_interrupt in every file as on the target:
+ *
+ *   cc -O2 -Wall -fcommon -DCONFIG_MOD_PEDOMETER -DCONFIG_MOD_SLEEP \
+ *      -Icontrib/accel_replay -Idrivers -o as_claim_test \
+ *      contrib/accel_replay/as_claim_test.c contrib/accel_replay/cma3000.c \
+ *      drivers/vti_as.c
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "openchronos.h"
+#include "vti_as.h"
+#include "cma3000.h"
+
+#define TRACE_LEN   20000
+
+/* MODE bits of CTRL */
+#define CTRL_MODE           (0x0e)
+#define CTRL_MEAS_100_HZ    (0x02)
+#define CTRL_MOTION_DET     (0x08)
+
+static uint8_t trace[TRACE_LEN][3];
+
+static int failures;
+
+static void check(int cond, const char *what)
+{
+    printf("%-48s %s\n", what, cond ? "ok" : "FAIL");
+    if (!cond)
+        failures++;
+}
+
+/* Index of the trace sample, -1 if the bytes are not from one sample */
+static long sample_index(const uint8_t *xyz)
+{
+    long i = xyz[0] | (xyz[1] << 8);
+
+    return i < TRACE_LEN && !memcmp(xyz, trace[i], 3) ? i : -1;
+}
+
+/* Sleep until woken, the samples taken since, 0 if not by the sensor */
+static unsigned long wake(void)
+{
+    unsigned long n = cma3000.samples;
+
+    cma3000_sleep_until(CMA3000_NEVER);
+    if (!as_last_interrupt)
+        return 0;
+    as_last_interrupt = 0;
+    return cma3000.samples - n;
+}
+
+/* Take the ring out, 1 if it held count samples in a row */
+static int take(unsigned count)
+{
+    uint8_t xyz[3];
+    unsigned n = 0;
+    long first = -1;
+    int ok = 1;
+
+    while (as_stream_read(xyz)) {
+        if (!n)
+            first = sample_index(xyz);
+        if (first < 0 || sample_index(xyz) != first + n)
+            ok = 0;
+        n++;
+    }
+    return ok && n == count;
+}
+
+/* count batches in a row woken every batch samples and taken out whole */
+static int stream_runs(uint8_t batch, uint8_t count)
+{
+    int ok = 1;
+
+    while (count--)
+        if (wake() != batch || !take(batch))
+            ok = 0;
+    return ok;
+}
+
+int main(void)
+{
+    struct As_Param pedometer_as, accel_as, sleep_as;
+    unsigned long frames;
+    uint8_t xyz[3];
+    long i;
+
+    for (i = 0; i < TRACE_LEN; i++) {
+        trace[i][0] = i;
+        trace[i][1] = i >> 8;
+        trace[i][2] = i * 7;
+    }
+
+    cma3000_init();
+    cma3000.trace = (const uint8_t (*)[3])trace;
+    cma3000.trace_len = TRACE_LEN;
+    as_init();
+
+    /* As modules/pedometer.c, modules/accelerometer.c and modules/sleep.c */
+    memset(&pedometer_as, 0, sizeof(pedometer_as));
+    pedometer_as.range = 2;
+    pedometer_as.sampling = SAMPLING_100_HZ;
+    pedometer_as.mode = MEASUREMENT_MODE;
+
+    memset(&accel_as, 0, sizeof(accel_as));
+    accel_as.range = 2;
+    accel_as.sampling = SAMPLING_10_HZ;
+    accel_as.mode = ACTIVITY_MODE;
+    accel_as.MDTHR = 2;
+    accel_as.MDFFTMR = 1;
+
+    sleep_as = accel_as;
+
+    check(as_owner() == AS_CLIENTS && !(PJOUT & AS_PWR_PIN),
+          "sensor off without a claim");
+
+    check(as_claim(AS_CLIENT_PEDOMETER, &pedometer_as, 8),
+          "pedometer claims, owns the sensor");
+    check(cma3000.reg[ADDR_CTRL] == 0x82, "  CTRL is 2 g, 100 Hz measurement");
+    check(stream_runs(8, 20), "  woken every 8 samples");
+
+    /* the accelerometer screen opens */
+    check(as_claim(AS_CLIENT_ACCEL, &accel_as, AS_READ_IRQ),
+          "accelerometer claims over it");
+    check(as_owner() == AS_CLIENT_ACCEL
+          && (cma3000.reg[ADDR_CTRL] & CTRL_MODE) == CTRL_MOTION_DET,
+          "  sensor in motion detection");
+    take(0);
+    frames = cma3000.frames;
+    as_last_interrupt = 0;
+    cma3000_run(CMA3000_MHZ * 100000ul);
+    check(cma3000.frames == frames && !as_stream_read(xyz),
+          "  no stream into the ring");
+
+    check(!as_claim(AS_CLIENT_PEDOMETER, &pedometer_as, 4),
+          "pedometer changes its claim, queued");
+    check(as_owner() == AS_CLIENT_ACCEL
+          && (cma3000.reg[ADDR_CTRL] & CTRL_MODE) == CTRL_MOTION_DET,
+          "  sensor left to the accelerometer");
+
+    /* measurement mode on the screen, streamed as the module does */
+    accel_as.sampling = SAMPLING_100_HZ;
+    accel_as.mode = MEASUREMENT_MODE;
+    check(as_claim(AS_CLIENT_ACCEL, &accel_as, 16)
+          && (cma3000.reg[ADDR_CTRL] & CTRL_MODE) == CTRL_MEAS_100_HZ
+          && stream_runs(16, 5), "accelerometer changes its own mode");
+
+    /* the screen closes */
+    as_release(AS_CLIENT_ACCEL);
+    check(as_owner() == AS_CLIENT_PEDOMETER, "accelerometer releases");
+    check(cma3000.reg[ADDR_CTRL] == 0x82 && stream_runs(4, 20),
+          "  pedometer stream back, batch of 4");
+
+    /* a night of sleep tracking */
+    check(as_claim(AS_CLIENT_SLEEP, &sleep_as, AS_READ_MOTION),
+          "sleep tracker claims over the pedometer");
+    take(0);
+    as_motion_take();
+    cma3000.motion = 7;
+    as_last_interrupt = 0;
+    cma3000_run(CMA3000_MHZ * 2000000ul);
+    check(as_motion_take() == 7 && !as_stream_read(xyz),
+          "  motion events counted, no stream");
+
+    as_release(AS_CLIENT_SLEEP);
+    check(as_owner() == AS_CLIENT_PEDOMETER && stream_runs(4, 20),
+          "sleep tracker releases, pedometer back");
+
+    as_release(AS_CLIENT_PEDOMETER);
+    as_release(AS_CLIENT_PEDOMETER);
+    check(as_owner() == AS_CLIENTS && !(PJOUT & AS_PWR_PIN),
+          "every claim released, sensor off");
+
+    check(!cma3000.errors && !cma3000.overruns, "no protocol errors, no overrun");
+
+    printf("%s\n", failures ? "FAIL" : "PASS");
+    return failures ? 1 : 0;
+}
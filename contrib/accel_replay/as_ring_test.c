@@ -0,0 +1,220 @@
+/*
+ * as_ring_test.c
+ *
+ * Runs the sample ring of drivers/vti_as.c against the CMA3000 model in
+ * cma3000.c, with the main loop asleep between the wake ups of
+ * as_usci_isr(). Every sample of the trace carries its own index, so the
+ * samples taken out with as_stream_read() show what was kept, in which
+ * order, and what was dropped:
+ *
+ *   batch      one wake up per batch samples, and none in between
+ *   wrap       the ring wraps many times, also with a main loop that takes
+ *              the samples out only every other wake up
+ *   overflow   a main loop that does not take them out for longer than
+ *              the ring holds loses the newest samples, not the oldest,
+ *              and the sensor is still read every sample
+ *   waiting    as_stream_start() with a sample already waiting on INT
+ *   stop       as_stream_stop() goes back to only setting as_last_interrupt
+ *
+ * and prints the main loop wake ups per second at 40, 100 and 400 Hz.
+ *
+ * Build from the top of the tree, -fcommon lets vti_as.h define
+ * as_last_interrupt in every file as on the target:
+ *
+ *   cc -O2 -Wall -fcommon -DCONFIG_MOD_PEDOMETER -Icontrib/accel_replay \
+ *      -Idrivers -o as_ring_test contrib/accel_replay/as_ring_test.c \
+ *      contrib/accel_replay/cma3000.c drivers/vti_as.c
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "openchronos.h"
+#include "vti_as.h"
+#include "cma3000.h"
+
+#define TRACE_LEN   20000
+
+static uint8_t trace[TRACE_LEN][3];
+
+static int failures;
+
+static void check(int cond, const char *what)
+{
+    printf("%-48s %s\n", what, cond ? "ok" : "FAIL");
+    if (!cond)
+        failures++;
+}
+
+/* Index of the trace sample, -1 if the bytes are not from one sample */
+static long sample_index(const uint8_t *xyz)
+{
+    long i = xyz[0] | (xyz[1] << 8);
+
+    return i < TRACE_LEN && !memcmp(xyz, trace[i], 3) ? i : -1;
+}
+
+/* Take the ring out, 1 if it held the count samples from first on */
+static int take(long first, unsigned count)
+{
+    uint8_t xyz[3];
+    unsigned n = 0;
+    int ok = 1;
+
+    while (as_stream_read(xyz)) {
+        if (sample_index(xyz) != first + n)
+            ok = 0;
+        n++;
+    }
+    return ok && n == count;
+}
+
+static void start(uint8_t sampling)
+{
+    cma3000_init();
+    cma3000.trace = (const uint8_t (*)[3])trace;
+    cma3000.trace_len = TRACE_LEN;
+    as_init();
+    as_config.range = sampling == SAMPLING_40_HZ ? 8 : 2;
+    as_config.sampling = sampling;
+    as_start(MEASUREMENT_MODE);
+}
+
+/* Sleep until woken, the sample count and as_last_interrupt it was for */
+static unsigned long wake(void)
+{
+    unsigned long n = cma3000.samples;
+
+    cma3000_sleep_until(CMA3000_NEVER);
+    if (!as_last_interrupt)
+        return 0;
+    as_last_interrupt = 0;
+    return cma3000.samples - n;
+}
+
+static void test_batch(void)
+{
+    long first;
+    int ok = 1;
+    uint16_t i;
+
+    start(SAMPLING_100_HZ);
+    first = cma3000.trace_pos;
+    as_stream_start(8);
+
+    for (i = 0; i < 100; i++) {
+        if (wake() != 8 || !take(first + 8 * i, 8))
+            ok = 0;
+    }
+    check(ok, "batch of 8, woken every 8 samples, 25 wraps");
+
+    /* every other wake up, 16 samples in the ring across the wrap */
+    ok = 1;
+    for (i = 0; i < 100; i++) {
+        if (wake() != 8)
+            ok = 0;
+        if (i & 1 && !take(first + 800 + 8 * (i - 1), 16))
+            ok = 0;
+    }
+    check(ok, "  taken out every other wake up");
+    as_stop();
+    check(!cma3000.errors && !cma3000.overruns, "  every sample read in time");
+}
+
+static void test_overflow(void)
+{
+    long first;
+    uint8_t i;
+    int ok = 1;
+
+    start(SAMPLING_100_HZ);
+    first = cma3000.trace_pos;
+    as_stream_start(4);
+
+    /* 40 samples without taking any out */
+    for (i = 0; i < 10; i++)
+        if (wake() != 4)
+            ok = 0;
+    check(ok, "ring full, still woken every batch");
+    check(take(first, AS_RING_SIZE - 1), "  the oldest 31 samples are kept");
+
+    /* back to normal from the sample after the gap */
+    wake();
+    check(take(first + 40, 4), "  and the ring goes on after the gap");
+    as_stop();
+    check(!cma3000.errors && !cma3000.overruns,
+          "  every sample read from the sensor");
+}
+
+static void test_waiting(void)
+{
+    unsigned long frames;
+    uint8_t xyz[3];
+    long waiting;
+
+    start(SAMPLING_100_HZ);
+
+    /* a sample on INT that nobody read */
+    cma3000_run(CMA3000_MHZ * 15000ul);
+    waiting = cma3000.trace_pos - 1;
+    as_last_interrupt = 0;
+    check(cma3000_int(), "sample waiting on INT");
+
+    as_stream_start(4);
+    wake();
+    check(take(waiting, 4), "  read by as_stream_start()");
+
+    /* back to flagging the interrupt, nothing read for the ring */
+    as_stream_stop();
+    take(0, 0);
+    frames = cma3000.frames;
+    as_last_interrupt = 0;
+    cma3000_run(CMA3000_MHZ * 30000ul);
+    check(as_last_interrupt && cma3000.frames == frames
+          && !as_stream_read(xyz), "as_stream_stop(), only the flag is set");
+    as_stop();
+    check(!cma3000.errors, "  no protocol errors");
+}
+
+static void wake_rate(const char *what, uint8_t sampling, uint8_t batch)
+{
+    unsigned long wakes = 0, samples;
+    unsigned long long end;
+
+    start(sampling);
+    samples = cma3000.samples;
+    as_stream_start(batch);
+    end = cma3000.cycles + 10 * 1000000ull * CMA3000_MHZ;
+    while (cma3000_sleep_until(end))
+        wakes++;
+    samples = cma3000.samples - samples;
+    as_stop();
+
+    printf("%-8s batch %2u: %4lu samples/s, %5.1f wake ups/s\n", what, batch,
+           samples / 10, wakes / 10.0);
+    if (wakes != samples / batch || cma3000.errors || cma3000.overruns)
+        failures++;
+}
+
+int main(void)
+{
+    long i;
+
+    for (i = 0; i < TRACE_LEN; i++) {
+        trace[i][0] = i;
+        trace[i][1] = i >> 8;
+        trace[i][2] = i * 7;
+    }
+
+    test_batch();
+    test_overflow();
+    test_waiting();
+
+    wake_rate("40 Hz", SAMPLING_40_HZ, 16);
+    wake_rate("100 Hz", SAMPLING_100_HZ, 16);
+    wake_rate("400 Hz", SAMPLING_400_HZ, 16);
+    wake_rate("400 Hz", SAMPLING_400_HZ, AS_RING_SIZE - 1);
+
+    printf("%s\n", failures ? "FAIL" : "PASS");
+    return failures ? 1 : 0;
+}
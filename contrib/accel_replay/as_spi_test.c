@@ -0,0 +1,189 @@
+/*
+ * as_spi_test.c
+ *
+ * Runs the register access of drivers/vti_as.c against the CMA3000 model in
+ * cma3000.c: the polled reads and writes of the set up, the X/Y/Z read of
+ * as_get_data() done frame by frame by as_usci_isr() while the CPU sleeps
+ * in as_wait_burst(), and the cases where two reads meet:
+ *
+ *   a sample arriving during as_get_data(), read for the ring right after
+ *   as_read_register() and as_stop() while the ring read is on the bus
+ *
+ * Every frame is logged, the model counts any frame that is not exactly
+ * an address and a data byte inside one CSN low as a protocol error. Prints
+ * the bus time of the reads and exits non-zero on a failure.
+ *
+ * Build from the top of the tree, -fcommon lets vti_as.h define
+ * as_last_interrupt in every file as on the target:
+ *
+ *   cc -O2 -Wall -fcommon -DCONFIG_MOD_PEDOMETER -Icontrib/accel_replay \
+ *      -Idrivers -o as_spi_test contrib/accel_replay/as_spi_test.c \
+ *      contrib/accel_replay/cma3000.c drivers/vti_as.c
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "openchronos.h"
+#include "vti_as.h"
+#include "cma3000.h"
+
+#define TRACE_LEN   1000
+
+extern uint8_t as_ok;
+
+static uint8_t trace[TRACE_LEN][3];
+
+static struct {
+    uint8_t addr, write, data;
+} frame_log[64];
+static uint8_t frame_count;
+
+static int failures;
+
+static void check(int cond, const char *what)
+{
+    printf("%-48s %s\n", what, cond ? "ok" : "FAIL");
+    if (!cond)
+        failures++;
+}
+
+static void report(const char *what, unsigned long long start)
+{
+    unsigned long long cycles = cma3000.cycles - start;
+
+    printf("%-48s %llu cycles, %llu us\n", what, cycles,
+           cycles / CMA3000_MHZ);
+}
+
+static void log_frame(uint8_t addr, uint8_t write, uint8_t data)
+{
+    if (frame_count < sizeof(frame_log) / sizeof(frame_log[0])) {
+        frame_log[frame_count].addr = addr;
+        frame_log[frame_count].write = write;
+        frame_log[frame_count].data = data;
+    }
+    frame_count++;
+}
+
+/* The frames logged from first on read X, Y and Z of one sample */
+static int xyz_frames(uint8_t first, const uint8_t *sample)
+{
+    uint8_t i;
+
+    for (i = 0; i < 3; i++)
+        if (frame_log[first + i].addr != 0x06 + i || frame_log[first + i].write
+                || (sample && frame_log[first + i].data != sample[i]))
+            return 0;
+    return 1;
+}
+
+/* Sleep until the sensor has taken the next sample, at 1 us resolution */
+static void next_sample(void)
+{
+    unsigned long n = cma3000.samples;
+
+    while (cma3000.samples == n)
+        cma3000_run(CMA3000_MHZ);
+}
+
+static int from_sample(const uint8_t *data, unsigned long a, unsigned long b)
+{
+    uint8_t i;
+
+    for (i = 0; i < 3; i++)
+        if (data[i] != trace[a][i] && data[i] != trace[b][i])
+            return 0;
+    return 1;
+}
+
+int main(void)
+{
+    unsigned long long t;
+    unsigned long n;
+    uint8_t data[3];
+    uint16_t i;
+
+    for (i = 0; i < TRACE_LEN; i++) {
+        trace[i][0] = i;
+        trace[i][1] = i + 85;
+        trace[i][2] = i + 170;
+    }
+
+    cma3000_init();
+    cma3000.trace = (const uint8_t (*)[3])trace;
+    cma3000.trace_len = TRACE_LEN;
+    cma3000.frame = log_frame;
+
+    /* Polled set up */
+    as_init();
+    as_config.range = 2;
+    as_config.sampling = SAMPLING_100_HZ;
+    t = cma3000.cycles;
+    as_start(MEASUREMENT_MODE);
+    check(as_ok && cma3000.resets == 1, "as_start() resets the sensor");
+    check(cma3000.reg[ADDR_CTRL] == 0x82, "CTRL is 2 g, 100 Hz measurement");
+    check(frame_count == 4, "  in four frames");
+    report("  as_start()", t);
+
+    frame_count = 0;
+    t = cma3000.cycles;
+    write_MDTHR(5);
+    check(cma3000.reg[ADDR_MDTHR] == 5 << 2, "write_MDTHR() polled");
+    check(as_read_register(ADDR_MDTHR) == 5 << 2, "as_read_register() polled");
+    check(frame_count == 2 && frame_log[0].write && !frame_log[1].write,
+          "  one frame each");
+    report("  one write and one read", t);
+
+    /* X/Y/Z from the USCI interrupt, one frame per register */
+    next_sample();
+    frame_count = 0;
+    n = cma3000.usci_irqs;
+    t = cma3000.cycles;
+    as_get_data(data);
+    report("  as_get_data()", t);
+    check(!memcmp(data, trace[cma3000.trace_pos - 1], 3),
+          "as_get_data() reads the last sample");
+    check(frame_count == 3 && xyz_frames(0, data),
+          "  in three frames, X, Y, Z");
+    check(cma3000.usci_irqs - n == 6, "  two USCI interrupts per frame");
+    check(!cma3000_int(), "  and releases INT");
+
+    /* A sample while as_get_data() is on the bus goes to the ring after it */
+    as_stream_start(4);
+    next_sample();
+    cma3000_run(CMA3000_MHZ * 10000ul - 600);
+    frame_count = 0;
+    n = cma3000.trace_pos;
+    as_get_data(data);
+    check(cma3000.trace_pos == n + 1, "sample during as_get_data()");
+    check(from_sample(data, n - 1, n), "  as_get_data() reads whole registers");
+    check(frame_count == 6 && xyz_frames(0, NULL)
+          && xyz_frames(3, trace[n]), "  then the pending ring read");
+    check(as_stream_read(data) && !memcmp(data, trace[n - 1], 3)
+          && as_stream_read(data) && !memcmp(data, trace[n], 3)
+          && !as_stream_read(data), "  both samples in the ring");
+
+    /* A register access waits for the ring read on the bus */
+    next_sample();
+    frame_count = 0;
+    n = cma3000.trace_pos;
+    check(frame_count == 0 && cma3000_int(), "ring read on the bus");
+    check(as_read_register(ADDR_CTRL) == 0x82,
+          "as_read_register() during a ring read");
+    check(frame_count == 4 && xyz_frames(0, trace[n - 1])
+          && frame_log[3].addr == ADDR_CTRL, "  after the ring read");
+
+    next_sample();
+    frame_count = 0;
+    as_stop();
+    check(frame_count == 3 && xyz_frames(0, NULL),
+          "as_stop() lets the ring read finish");
+    check(!cma3000_int() && !(PJOUT & AS_PWR_PIN), "  then powers down");
+
+    check(cma3000.errors == 0, "no protocol errors");
+    check(cma3000.overruns == 0, "no sample missed");
+
+    printf("%s\n", failures ? "FAIL" : "PASS");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,512 @@
+/*
+ * cma3000.c
+ *
+ * Bit level SPI slave model of the VTI CMA3000-D0x, behind the USCI_A0 and
+ * port registers that drivers/vti_as.c uses. A write of TXBUF starts a byte
+ * that takes 8 bit clocks of UCA0BR0 cycles, both sides shift at once, the
+ * watch in the bit order set by UCMSB, the sensor MSB first. A frame is the
+ * bytes between a falling and a rising CSN: the address byte (address << 2,
+ * RW in bit 1), then the data byte the register is written with, or shifted
+ * out in. Frames of another length, CSN changing during a byte, TXBUF written
+ * during a byte, RXBUF overruns and frames within 5 ms of power up are
+ * counted as protocol errors.
+ *
+ * Registers: CTRL (0x02) with the sampling modes, the RSTR (0x04) reset
+ * sequence 02h 0Ah 04h, INT_STATUS (0x05), DOUTX/Y/Z (0x06 to 0x08), MDTHR,
+ * MDFFTMR and FFTHR. In measurement mode every sample raises INT, reading
+ * an output register releases it. In motion detection mode the events put
+ * into cma3000.motion are raised one per 10 Hz sample, reading INT_STATUS
+ * releases INT. Free fall is not detected.
+ *
+ * Interrupts run while the CPU sleeps, in cma3000_sleep_until() and the
+ * timer0_delay() stub, or when GIE is set again with one pending: the USCI
+ * one calls as_usci_isr(), the port one as_data_ready() like PORT2_ISR.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "openchronos.h"
+#include "vti_as.h"
+#include "battery.h"
+#include "cma3000.h"
+
+uint8_t P1OUT, P1DIR, P1SEL, P1REN;
+uint8_t P2OUT, P2DIR, P2IE, P2IES, P2IFG;
+uint8_t PJDIR;
+uint8_t UCA0CTL0, UCA0CTL1, UCA0BR0, UCA0BR1, UCA0IE;
+
+struct cma3000 cma3000;
+
+extern void as_usci_isr(void);
+
+#define REG_CTRL        0x02
+#define REG_RSTR        0x04
+#define REG_INT_STATUS  0x05
+#define REG_DOUTX       0x06
+#define REG_DOUTZ       0x08
+
+#define CTRL_G_RANGE    0x80        // 2 g when set
+#define CTRL_MDET_EXIT  0x20        // stay in motion detection after an event
+#define CTRL_INT_DIS    0x01
+
+enum {
+    MODE_OFF, MODE_100, MODE_400, MODE_40, MODE_MOTION, MODE_FALL_100,
+    MODE_FALL_400, MODE_OFF2
+};
+
+#define POWER_UP_CYCLES (5000 * CMA3000_MHZ)
+#define NO_FRAME        0xff
+
+static uint8_t pj;                  // PJOUT
+static uint8_t powered, csn;
+static unsigned long long power_at;
+static uint8_t frame_pos;           // bytes of the frame so far
+static uint8_t frame_addr, frame_write;
+static uint8_t shift_out;           // the sensor's side of the next byte
+static uint8_t tx_busy;
+static unsigned long long tx_done;
+static uint8_t txbuf, rxbuf, ifg;
+static uint8_t int_line;
+static unsigned long long sample_at;
+static uint8_t rstr_seq;
+static uint8_t motion_axis;
+static uint8_t gie;
+static uint8_t woken;
+
+static void error(const char *why)
+{
+    cma3000.errors++;
+    fprintf(stderr, "cma3000: %s at %.3f ms\n", why,
+            cma3000.cycles / (CMA3000_MHZ * 1000.0));
+}
+
+static uint8_t mode(void)
+{
+    return (cma3000.reg[REG_CTRL] >> 1) & 7;
+}
+
+/* Cycles between two samples, 0 when powered down */
+static unsigned long period(void)
+{
+    static const uint16_t hz[8] = { 0, 100, 400, 40, 10, 100, 400, 0 };
+
+    return hz[mode()] ? CMA3000_MHZ * 1000000ul / hz[mode()] : 0;
+}
+
+static void set_int(uint8_t level)
+{
+    if (cma3000.reg[REG_CTRL] & CTRL_INT_DIS)
+        level = 0;
+
+    /* P2IES clear: the flag is set on the rising edge */
+    if (level && !int_line && !(P2DIR & AS_INT_PIN) && !(P2IES & AS_INT_PIN))
+        P2IFG |= AS_INT_PIN;
+    int_line = level;
+}
+
+static void reset_regs(void)
+{
+    memset(cma3000.reg, 0, sizeof(cma3000.reg));
+    int_line = 0;
+    sample_at = CMA3000_NEVER;
+    rstr_seq = 0;
+}
+
+/* Follows power and CSN as the watch left them */
+static void pins(void)
+{
+    uint8_t on = (PJDIR & AS_PWR_PIN) && (pj & AS_PWR_PIN);
+    uint8_t cs = !(PJDIR & AS_CSN_PIN) || (pj & AS_CSN_PIN);
+
+    if (on != powered) {
+        powered = on;
+        power_at = cma3000.cycles;
+        reset_regs();
+        frame_pos = NO_FRAME;
+        csn = cs;
+        return;
+    }
+
+    if (!powered || cs == csn) {
+        csn = cs;
+        return;
+    }
+
+    csn = cs;
+    if (tx_busy)
+        error("CSN changed during a byte");
+
+    if (!cs) {
+        frame_pos = 0;
+        shift_out = 0;
+        return;
+    }
+
+    if (frame_pos == 1)
+        error("frame ended after the address byte");
+    frame_pos = NO_FRAME;
+}
+
+static void write_reg(uint8_t addr, uint8_t b)
+{
+    static const uint8_t rstr[3] = { 0x02, 0x0A, 0x04 };
+    unsigned long p;
+
+    if (addr == REG_RSTR) {
+        if (b == rstr[rstr_seq]) {
+            if (++rstr_seq == 3) {
+                reset_regs();
+                cma3000.resets++;
+            }
+        } else {
+            rstr_seq = b == rstr[0];
+        }
+        return;
+    }
+    rstr_seq = 0;
+
+    switch (addr) {
+    case REG_CTRL:
+        cma3000.reg[REG_CTRL] = b;
+        if (mode() == MODE_40 && (b & CTRL_G_RANGE))
+            error("40 Hz needs the 8 g range");
+        p = period();
+        sample_at = p ? cma3000.cycles + p : CMA3000_NEVER;
+        set_int(0);
+        break;
+    case ADDR_MDTHR:
+    case ADDR_MDFFTMR:
+    case ADDR_FFTHR:
+        cma3000.reg[addr] = b;
+        break;
+    default:
+        error("write to a read only register");
+    }
+}
+
+static void read_done(uint8_t addr)
+{
+    if (addr >= REG_DOUTX && addr <= REG_DOUTZ && mode() != MODE_MOTION)
+        set_int(0);
+
+    if (addr == REG_INT_STATUS) {
+        cma3000.reg[REG_INT_STATUS] = 0;
+        if (mode() == MODE_MOTION)
+            set_int(0);
+    }
+}
+
+/* A byte was clocked through while selected */
+static void sensor_byte(uint8_t b, uint8_t out)
+{
+    if (cma3000.cycles - power_at < POWER_UP_CYCLES)
+        error("frame less than 5 ms after power up");
+
+    switch (frame_pos++) {
+    case 0:
+        frame_addr = b >> 2;
+        frame_write = (b & BIT1) != 0;
+        if ((b & BIT0) || frame_addr >= sizeof(cma3000.reg)) {
+            error("bad address byte");
+            frame_addr &= sizeof(cma3000.reg) - 1;
+        }
+        shift_out = frame_write ? 0 : cma3000.reg[frame_addr];
+        break;
+
+    case 1:
+        if (frame_write)
+            write_reg(frame_addr, b);
+        else
+            read_done(frame_addr);
+        cma3000.frames++;
+        if (cma3000.frame)
+            cma3000.frame(frame_addr, frame_write, frame_write ? b : out);
+        break;
+
+    default:
+        error("more than two bytes in a frame");
+        frame_pos = 2;
+    }
+}
+
+static void shift(void)
+{
+    uint8_t selected = frame_pos != NO_FRAME;
+    uint8_t msb = (UCA0CTL0 & UCMSB) != 0;
+    uint8_t in = 0, rx = 0, out = shift_out, i, m;
+
+    if ((UCA0CTL0 & (UCSYNC | UCMST | UCCKPH)) != (UCSYNC | UCMST | UCCKPH))
+        error("USCI is not a SPI master capturing on the first edge");
+
+    for (i = 0; i < 8; i++) {
+        m = msb ? 7 - i : i;
+        in = (in << 1) | ((txbuf >> m) & 1);
+        if (selected)
+            rx |= ((out >> (7 - i)) & 1) << m;
+    }
+
+    tx_busy = 0;
+    if (ifg & UCRXIFG)
+        error("RXBUF overrun");
+    rxbuf = rx;
+    ifg |= UCRXIFG | UCTXIFG;
+
+    if (selected)
+        sensor_byte(in, out);
+}
+
+static void sample(void)
+{
+    unsigned long p = period();
+
+    sample_at += p;
+
+    switch (mode()) {
+    case MODE_MOTION:
+        if (!cma3000.motion || int_line)
+            break;
+        cma3000.motion--;
+        cma3000.reg[REG_INT_STATUS] = 1 + motion_axis;
+        motion_axis = (motion_axis + 1) % 3;
+        set_int(1);
+        if (!(cma3000.reg[REG_CTRL] & CTRL_MDET_EXIT)) {
+            /* on to measurement at 400 Hz */
+            cma3000.reg[REG_CTRL] = (cma3000.reg[REG_CTRL] & ~0x0E)
+                                    | (MODE_400 << 1);
+            sample_at = cma3000.cycles + period();
+        }
+        break;
+
+    case MODE_100:
+    case MODE_400:
+    case MODE_40:
+        if (cma3000.trace) {
+            if (cma3000.trace_pos >= cma3000.trace_len) {
+                sample_at = CMA3000_NEVER;
+                break;
+            }
+            memcpy(&cma3000.reg[REG_DOUTX],
+                   cma3000.trace[cma3000.trace_pos++], 3);
+        } else {
+            memcpy(&cma3000.reg[REG_DOUTX], cma3000.xyz, 3);
+        }
+        cma3000.samples++;
+        if (int_line)
+            cma3000.overruns++;
+        set_int(1);
+        break;
+    }
+}
+
+static unsigned long long next_event(void)
+{
+    if (tx_busy && tx_done < sample_at)
+        return tx_done;
+    return sample_at;
+}
+
+static void event(void)
+{
+    cma3000.cycles = next_event();
+    pins();
+    if (tx_busy && tx_done == cma3000.cycles)
+        shift();
+    else
+        sample();
+}
+
+static void dispatch(void)
+{
+    while (gie) {
+        if ((UCA0IE & UCRXIE) && (ifg & UCRXIFG)) {
+            gie = 0;
+            cma3000.usci_irqs++;
+            as_usci_isr();
+            gie = 1;
+        } else if (P2IE & P2IFG & AS_INT_PIN) {
+            gie = 0;
+            cma3000.port_irqs++;
+            /* as PORT2_ISR does it */
+            as_data_ready();
+            P2IFG &= ~AS_INT_PIN;
+            gie = 1;
+        } else {
+            break;
+        }
+    }
+}
+
+static void advance(unsigned long long until)
+{
+    while (next_event() <= until) {
+        event();
+        dispatch();
+    }
+    if (until > cma3000.cycles)
+        cma3000.cycles = until;
+}
+
+void cma3000_init(void)
+{
+    memset(&cma3000, 0, sizeof(cma3000));
+
+    P1OUT = P1DIR = P1SEL = P1REN = 0;
+    P2OUT = P2DIR = P2IE = P2IES = P2IFG = 0;
+    pj = PJDIR = 0;
+    UCA0CTL0 = UCA0BR0 = UCA0BR1 = UCA0IE = 0;
+    UCA0CTL1 = UCSWRST;
+
+    powered = 0;
+    csn = 1;
+    frame_pos = NO_FRAME;
+    tx_busy = 0;
+    ifg = UCTXIFG;
+    rxbuf = 0;
+    motion_axis = 0;
+    reset_regs();
+    gie = 1;
+    woken = 0;
+}
+
+/* Sleep with interrupts on until one wakes the CPU (1) or the deadline (0) */
+uint8_t cma3000_sleep_until(unsigned long long deadline)
+{
+    unsigned long long t;
+
+    woken = 0;
+    gie = 1;
+    pins();
+    dispatch();
+
+    while (!woken) {
+        t = next_event();
+        if (t > deadline || t == CMA3000_NEVER) {
+            if (deadline == CMA3000_NEVER) {
+                fprintf(stderr, "cma3000: sleeping with nothing to wake up\n");
+                exit(1);
+            }
+            if (deadline > cma3000.cycles)
+                cma3000.cycles = deadline;
+            return 0;
+        }
+        event();
+        dispatch();
+    }
+    return 1;
+}
+
+/* Let the given time pass with interrupts on, whatever wakes the CPU */
+void cma3000_run(unsigned long long cycles)
+{
+    unsigned long long end = cma3000.cycles + cycles;
+
+    while (cma3000_sleep_until(end))
+        ;
+}
+
+uint8_t cma3000_int(void)
+{
+    return int_line;
+}
+
+void cma3000_sleep(void)
+{
+    cma3000_sleep_until(CMA3000_NEVER);
+}
+
+void cma3000_wake(void)
+{
+    woken = 1;
+}
+
+uint16_t cma3000_sr(void)
+{
+    return gie ? GIE : 0;
+}
+
+void cma3000_gie(uint16_t sr)
+{
+    gie = (sr & GIE) != 0;
+    pins();
+    dispatch();
+}
+
+void cma3000_delay_cycles(unsigned long cycles)
+{
+    pins();
+    advance(cma3000.cycles + cycles);
+}
+
+uint8_t *cma3000_pjout(void)
+{
+    pins();
+    return &pj;
+}
+
+uint8_t *cma3000_txbuf(void)
+{
+    unsigned long br = UCA0BR0 | (UCA0BR1 << 8);
+
+    pins();
+    if (UCA0CTL1 & UCSWRST) {
+        error("TXBUF written with the USCI in reset");
+    } else if (tx_busy) {
+        error("TXBUF written during a byte");
+    } else {
+        tx_busy = 1;
+        tx_done = cma3000.cycles + 8 * (br ? br : 1);
+        ifg &= ~UCTXIFG;
+    }
+    return &txbuf;
+}
+
+uint8_t cma3000_rxbuf(void)
+{
+    pins();
+    ifg &= ~UCRXIFG;
+    return rxbuf;
+}
+
+/* Polling the flag lets the byte on the bus finish */
+uint8_t cma3000_ifg(void)
+{
+    pins();
+    if (tx_busy)
+        advance(tx_done);
+    return ifg;
+}
+
+uint8_t cma3000_iv(void)
+{
+    pins();
+    if ((ifg & UCRXIFG) && (UCA0IE & UCRXIE)) {
+        ifg &= ~UCRXIFG;
+        return 2;
+    }
+    return 0;
+}
+
+uint8_t cma3000_p2in(void)
+{
+    pins();
+    return powered && int_line && !(P2DIR & AS_INT_PIN) ? AS_INT_PIN : 0;
+}
+
+/* What the driver needs from the rest of the firmware */
+void timer0_delay(uint16_t duration, uint16_t LPM_bits)
+{
+    uint8_t sr = gie;
+
+    cma3000_run(duration * 1000ull * CMA3000_MHZ);
+    gie = sr;
+}
+
+void battery_load_start(enum battery_load load)
+{
+}
+
+void battery_load_stop(enum battery_load load)
+{
+}
@@ -0,0 +1,42 @@
+/*
+ * cma3000.h
+ *
+ * Bit level SPI slave model of the VTI CMA3000-D0x for host tests.
+ */
+
+#ifndef CMA3000_H_
+#define CMA3000_H_
+
+#include <stdint.h>
+
+/* Time is kept in cycles of the 12 MHz MCLK */
+#define CMA3000_MHZ         12ul
+#define CMA3000_NEVER       (~0ull)
+
+struct cma3000 {
+    const uint8_t (*trace)[3];  // samples served in measurement mode, NULL for xyz
+    unsigned long trace_len;
+    unsigned long trace_pos;    // next sample of the trace, sampling stops at the end
+    uint8_t xyz[3];             // sample served when there is no trace
+    unsigned long motion;       // motion events still to raise in motion detection mode
+    uint8_t reg[16];            // register map, DOUTX/Y/Z hold the last sample
+    unsigned long long cycles;  // time since cma3000_init()
+    unsigned long samples;      // samples taken in measurement mode
+    unsigned long overruns;     // samples taken while INT was still high
+    unsigned long frames;       // complete SPI frames
+    unsigned long usci_irqs;    // as_usci_isr() calls
+    unsigned long port_irqs;    // as_data_ready() calls from the port interrupt
+    unsigned long resets;       // RSTR reset sequences
+    unsigned long errors;       // protocol violations, each one is printed
+    /* called after every complete frame, may be NULL */
+    void (*frame)(uint8_t addr, uint8_t write, uint8_t data);
+};
+
+extern struct cma3000 cma3000;
+
+extern void cma3000_init(void);
+extern uint8_t cma3000_sleep_until(unsigned long long deadline);
+extern void cma3000_run(unsigned long long cycles);
+extern uint8_t cma3000_int(void);
+
+#endif /* CMA3000_H_ */
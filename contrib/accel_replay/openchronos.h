@@ -0,0 +1,85 @@
+/*
+ * openchronos.h
+ *
+ * Host stand-in for the firmware main header, so the hardware independent
+ * drivers (dsp.c, stepcount.c, sleeplog.c), drivers/vti_as.c and
+ * modules/accelerometer.c build with the native compiler. The USCI_A0 registers the driver polls or reads from
+ * its interrupt, PJOUT and P2IN go through the CMA3000 model in cma3000.c,
+ * the other port registers are plain variables. It is found before the real
+ * header through -I.
+ */
+
+#ifndef __OPENCHRONOS_H__
+#define __OPENCHRONOS_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define BIT0 (0x0001)
+#define BIT1 (0x0002)
+#define BIT2 (0x0004)
+#define BIT3 (0x0008)
+#define BIT4 (0x0010)
+#define BIT5 (0x0020)
+#define BIT6 (0x0040)
+#define BIT7 (0x0080)
+#define BIT8 (0x0100)
+#define BIT9 (0x0200)
+#define BITA (0x0400)
+#define BITB (0x0800)
+#define BITC (0x1000)
+#define BITD (0x2000)
+#define BITE (0x4000)
+#define BITF (0x8000)
+
+#define GIE         (0x0008)
+#define LPM0_bits   (0x0010)
+#define LPM3_bits   (0x00f0)
+
+/* USCI_A0 in SPI mode */
+#define UCSYNC      (0x01)
+#define UCMST       (0x08)
+#define UCMSB       (0x20)
+#define UCCKPH      (0x80)
+#define UCSWRST     (0x01)
+#define UCSSEL1     (0x80)
+#define UCRXIFG     (0x01)
+#define UCTXIFG     (0x02)
+#define UCRXIE      (0x01)
+
+extern uint8_t P1OUT, P1DIR, P1SEL, P1REN;
+extern uint8_t P2OUT, P2DIR, P2IE, P2IES, P2IFG;
+extern uint8_t PJDIR;
+extern uint8_t UCA0CTL0, UCA0CTL1, UCA0BR0, UCA0BR1, UCA0IE;
+
+/* Every access lets the model see the lines as they were left before */
+extern uint8_t *cma3000_pjout(void);
+extern uint8_t *cma3000_txbuf(void);
+extern uint8_t cma3000_rxbuf(void);
+extern uint8_t cma3000_ifg(void);
+extern uint8_t cma3000_iv(void);
+extern uint8_t cma3000_p2in(void);
+#define PJOUT       (*cma3000_pjout())
+#define UCA0TXBUF   (*cma3000_txbuf())
+#define UCA0RXBUF   (cma3000_rxbuf())
+#define UCA0IFG     (cma3000_ifg())
+#define UCA0IV      (cma3000_iv())
+#define P2IN        (cma3000_p2in())
+
+/* Sleeping runs the sensor and the interrupts until one asks for a wake up */
+extern void cma3000_sleep(void);
+extern void cma3000_wake(void);
+extern uint16_t cma3000_sr(void);
+extern void cma3000_gie(uint16_t sr);
+extern void cma3000_delay_cycles(unsigned long cycles);
+#define _BIS_SR(x)                  cma3000_sleep()
+#define _BIC_SR_IRQ(x)              cma3000_wake()
+#define __get_SR_register()         cma3000_sr()
+#define __disable_interrupt()       cma3000_gie(0)
+#define __set_interrupt_state(x)    cma3000_gie(x)
+#define __delay_cycles(x)           cma3000_delay_cycles(x)
+#define __even_in_range(x, y)       (x)
+#define interrupt(x)                used
+
+#endif /* __OPENCHRONOS_H__ */
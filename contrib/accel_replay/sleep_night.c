@@ -0,0 +1,172 @@
+/*
+ * sleep_night.c
+ *
+ * Host simulation of one 8 hour night through drivers/sleeplog.c. The
+ * motion interrupts of the sensor are generated per minute from a simple
+ * model: deep stretches with no events, lighter phases every 90 minutes
+ * with the odd twitch, single turn overs, and a few real wake ups of
+ * several busy minutes. The log must count the injected wake ups and
+ * nothing else.
+ *
+ * The events are raised by the CMA3000 model in cma3000.c in motion
+ * detection mode, claimed as modules/sleep.c does it, and counted by
+ * drivers/vti_as.c: every one costs an INT_STATUS read from the USCI
+ * interrupt without waking the main loop, which only runs once a minute to
+ * take the count and close the bucket. Both are reported, against what
+ * streaming at 100 Hz in batches of 16 would need.
+ *
+ * Build from the top of the tree, -fcommon lets vti_as.h define
+ * as_last_interrupt in every file as on the target:
+ *
+ *   cc -O2 -Wall -fcommon -DCONFIG_MOD_SLEEP -Icontrib/accel_replay \
+ *      -Idrivers -o sleep_night contrib/accel_replay/sleep_night.c \
+ *      contrib/accel_replay/cma3000.c drivers/vti_as.c drivers/sleeplog.c
+ *
+ * Usage: sleep_night [-s seed] [-v]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "openchronos.h"
+#include "vti_as.h"
+#include "sleeplog.h"
+#include "cma3000.h"
+
+#define NIGHT_MINUTES   (8 * 60)
+
+/* Motion detection set up as in modules/sleep.c */
+#define SLEEP_MDTHR     2
+#define SLEEP_MDFFTMR   1
+
+#define MINUTE_CYCLES   (60 * 1000000ull * CMA3000_MHZ)
+
+/* Wake ups put into the night: start minute and length */
+static const struct {
+    uint16_t start;
+    uint8_t length;
+} wake[] = {
+    { 95, 4 },
+    { 230, 6 },
+    { 372, 3 },
+};
+
+#define NUM_WAKE (sizeof(wake) / sizeof(wake[0]))
+
+/* Single busy minutes, rolling over without waking up */
+static const uint16_t turn[] = { 40, 61, 150, 188, 275, 300, 333, 410, 455 };
+
+#define NUM_TURN (sizeof(turn) / sizeof(turn[0]))
+
+static uint16_t events_in(uint16_t minute)
+{
+    uint8_t i;
+
+    for (i = 0; i < NUM_WAKE; i++)
+        if (minute >= wake[i].start && minute < wake[i].start + wake[i].length)
+            return 20 + rand() % 60;
+
+    for (i = 0; i < NUM_TURN; i++)
+        if (minute == turn[i])
+            return 16 + rand() % 20;
+
+    /* falling asleep */
+    if (minute < 12)
+        return rand() % 12;
+
+    /* light phase in the last 20 minutes of every 90 minute cycle */
+    if (minute % 90 >= 70)
+        return rand() % 4 == 0 ? 1 + rand() % 8 : 0;
+
+    return rand() % 20 == 0 ? 1 : 0;
+}
+
+int main(int argc, char **argv)
+{
+    static const char level_char[] = ".:+#";
+    struct sleeplog log;
+    struct As_Param sleep_as;
+    unsigned long interrupts = 0, frames, woken = 0;
+    unsigned long long end;
+    int verbose = 0, failures = 0, opt;
+    uint16_t m;
+
+    srand(1);
+    while ((opt = getopt(argc, argv, "s:v")) != -1) {
+        switch (opt) {
+        case 's':
+            srand(atoi(optarg));
+            break;
+        case 'v':
+            verbose = 1;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-s seed] [-v]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    sleeplog_init(&log);
+    memset(&sleep_as, 0, sizeof(sleep_as));
+
+    cma3000_init();
+    as_init();
+    sleep_as.range = 2;
+    sleep_as.sampling = SAMPLING_10_HZ;
+    sleep_as.mode = ACTIVITY_MODE;
+    sleep_as.MDTHR = SLEEP_MDTHR;
+    sleep_as.MDFFTMR = SLEEP_MDFFTMR;
+    as_claim(AS_CLIENT_SLEEP, &sleep_as, AS_READ_MOTION);
+    frames = cma3000.frames;
+
+    for (m = 0; m < NIGHT_MINUTES; m++) {
+        uint16_t events = events_in(m);
+        uint16_t counted;
+        uint8_t before = log.wakeups;
+
+        /* the main loop sleeps until the RTC minute */
+        cma3000.motion += events;
+        end = cma3000.cycles + MINUTE_CYCLES;
+        while (cma3000_sleep_until(end))
+            woken++;
+
+        counted = as_motion_take();
+        if (counted != events) {
+            printf("minute %u: %u events counted, %u put in\n", m, counted,
+                   events);
+            failures++;
+        }
+        interrupts += counted;
+        sleeplog_minute(&log, counted);
+
+        if (verbose && log.wakeups != before)
+            printf("wake up at %u:%02u\n", m / 60, m % 60);
+    }
+
+    frames = cma3000.frames - frames;
+    as_release(AS_CLIENT_SLEEP);
+
+    /* the log table, one hour per line */
+    for (m = 0; m < NIGHT_MINUTES; m++) {
+        putchar(level_char[sleeplog_level_at(&log, m)]);
+        if (m % 60 == 59)
+            putchar('\n');
+    }
+
+    printf("minutes    %u still %u light %u moving %u active %u\n",
+           log.minutes, log.level_minutes[SLEEPLOG_STILL],
+           log.level_minutes[SLEEPLOG_LIGHT],
+           log.level_minutes[SLEEPLOG_MOVING],
+           log.level_minutes[SLEEPLOG_ACTIVE]);
+    printf("wake ups   %u (%u put in)\n", log.wakeups, (unsigned)NUM_WAKE);
+    printf("log size   %u bytes\n", (unsigned)sizeof(log.hist));
+    printf("interrupts %lu motion, %lu status reads, %lu main loop wake ups\n",
+           interrupts, frames, log.minutes + woken);
+    printf("streaming  %lu main loop wake ups at 100 Hz / 16\n",
+           (unsigned long)NIGHT_MINUTES * 60 * 100 / 16);
+
+    return log.wakeups == NUM_WAKE && !failures && !woken
+           && !cma3000.errors ? 0 : 1;
+}
@@ -0,0 +1,209 @@
+/*
+ * adc12_test.c
+ *
+ * Runs adc12_oversample() and adc12_single_conversion() of
+ * drivers/adc12.c against a model of the ADC12_A. Every conversion
+ * returns the input plus gaussian noise, rounded and clipped to 12 bits.
+ * The input is swept over a range of fractional codes. The error of each
+ * result, taken back to 12 bit LSB, gives the effective bits gained over a
+ * single conversion.
+ *
+ * The model also counts reference warm ups and conversions per call, and
+ * the time slept through the timer0_delay() calls.
+ *
+ * Build from the top of the tree:
+ *
+ *   cc -O2 -Wall -Icontrib/adc_replay -Idrivers -o adc12_test \
+ *      contrib/adc_replay/adc12_test.c drivers/adc12.c -lm
+ *
+ * Usage: adc12_test [-s seed] [-n noise_lsb]
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "openchronos.h"
+#include "adc12.h"
+
+#define SWEEP           2000
+#define SWEEP_FROM      1800.0
+#define SWEEP_LSB       100.0
+
+/* ADC12OSC at 4.8 MHz, ADC12SHT0_8 */
+#define CONV_US         ((256 + 13) / 4.8)
+
+uint16_t REFCTL0;
+uint16_t ADC12CTL0, ADC12CTL1, ADC12IE, ADC12IV, ADC12MEM0;
+uint8_t ADC12MCTL0;
+
+extern void ADC12ISR(void);
+
+static double input;
+static double noise_lsb = 0.7;
+static unsigned long rng = 1;
+
+static uint8_t ref_was_on;
+static unsigned long warmups, conversions;
+static double now_us, conv_at_us;
+static uint8_t running;
+
+static double gauss(void)
+{
+    double u, v;
+
+    rng = rng * 1103515245ul + 12345ul;
+    u = (((rng >> 8) & 0xffffff) + 1) / 16777217.0;
+    rng = rng * 1103515245ul + 12345ul;
+    v = ((rng >> 8) & 0xffffff) / 16777216.0;
+
+    return sqrt(-2 * log(u)) * cos(2 * M_PI * v);
+}
+
+static void convert(void)
+{
+    double code = floor(input + noise_lsb * gauss() + 0.5);
+
+    if (code < 0)
+        code = 0;
+    if (code > 4095)
+        code = 4095;
+
+    conversions++;
+    ADC12MEM0 = (uint16_t)code;
+    ADC12IV = 6;
+    if (ADC12IE & 1)
+        ADC12ISR();
+}
+
+/*
+ * Sleeping is where the hardware moves on: the reference comes up, a
+ * started conversion completes, and with ADC12MSC in repeat mode the next
+ * one follows until ADC12ENC is cleared.
+ */
+void timer0_delay(uint16_t duration, uint16_t LPM_bits)
+{
+    double until = now_us + duration * 1000.0;
+
+    if ((REFCTL0 & REFON) && !ref_was_on)
+        warmups++;
+    ref_was_on = (REFCTL0 & REFON) != 0;
+
+    if (!running && (ADC12CTL0 & ADC12SC) && (ADC12CTL0 & ADC12ENC)) {
+        running = 1;
+        conv_at_us = now_us + CONV_US;
+        ADC12CTL0 &= ~ADC12SC;
+    }
+
+    while (running && conv_at_us <= until) {
+        uint8_t repeat = (ADC12CTL1 & ADC12CONSEQ_2) && (ADC12CTL0 & ADC12MSC);
+
+        convert();
+        if (!repeat || !(ADC12CTL0 & ADC12ENC))
+            running = 0;
+        conv_at_us += CONV_US;
+    }
+
+    now_us = until;
+}
+
+struct result {
+    double rms, bias, ms;
+    unsigned long warmups, conversions;
+};
+
+static void sweep(uint8_t bits, struct result *r)
+{
+    double sum2 = 0, sum = 0;
+    int i;
+
+    warmups = conversions = 0;
+    now_us = 0;
+
+    for (i = 0; i < SWEEP; i++) {
+        double got;
+
+        input = SWEEP_FROM + SWEEP_LSB * i / SWEEP;
+        ref_was_on = 0;
+
+        if (bits)
+            got = adc12_oversample(REFVSEL_0, ADC12SHT0_8, ADC12INCH_10, bits)
+                  / (double)(1 << bits);
+        else
+            got = adc12_single_conversion(REFVSEL_0, ADC12SHT0_8, ADC12INCH_10);
+
+        sum += got - input;
+        sum2 += (got - input) * (got - input);
+
+        if (REFCTL0 || ADC12CTL0 || ADC12IE)
+            fprintf(stderr, "ADC12 or REF left on\n");
+    }
+
+    r->rms = sqrt(sum2 / SWEEP);
+    r->bias = sum / SWEEP;
+    r->ms = now_us / 1000 / SWEEP;
+    r->warmups = warmups;
+    r->conversions = conversions;
+}
+
+int main(int argc, char **argv)
+{
+    static const double min_gain[] = { 0, 0.7, 1.8, 2.6, 3.4 };
+    struct result single, over;
+    int opt, failures = 0;
+    uint8_t bits;
+
+    while ((opt = getopt(argc, argv, "s:n:")) != -1) {
+        switch (opt) {
+        case 's':
+            rng = strtoul(optarg, NULL, 0) * 2 + 1;
+            break;
+        case 'n':
+            noise_lsb = atof(optarg);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-s seed] [-n noise_lsb]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    printf("noise %.2f LSB, %d inputs over %.0f LSB\n",
+           noise_lsb, SWEEP, SWEEP_LSB);
+
+    sweep(0, &single);
+    printf("single      rms %.3f LSB  bias %+.3f  %.1f conv/call  %.1f ms slept\n",
+           single.rms, single.bias, (double)single.conversions / SWEEP,
+           single.ms);
+
+    for (bits = 1; bits <= ADC12_OVERSAMPLE_MAX_BITS; bits++) {
+        double gain;
+        int ok;
+
+        sweep(bits, &over);
+        gain = log2(single.rms / over.rms);
+
+        /*
+         * Rounding the sum up on a tie leaves a bias of half an output
+         * step times the chance of a tie, 1 / 2^(2 bits + 1) LSB.
+         * The trailing conversion after ADC12ENC is cleared is not summed.
+         */
+        ok = over.warmups == SWEEP &&
+             over.conversions <= (unsigned long)SWEEP * ((1 << (2 * bits)) + 1);
+
+        /* without noise there is nothing to gain */
+        if (noise_lsb >= 0.5)
+            ok = ok && gain >= min_gain[bits] &&
+                 fabs(over.bias) < 0.02 + 1.0 / (2 << (2 * bits));
+
+        printf("%3u samples rms %.3f LSB  bias %+.3f  +%.2f bits  "
+               "%lu warm up/call  %.1f ms slept  %s\n",
+               1 << (2 * bits), over.rms, over.bias, gain,
+               over.warmups / SWEEP, over.ms, ok ? "ok" : "FAIL");
+        failures += !ok;
+    }
+
+    printf("%s\n", failures ? "FAILED" : "all passed");
+
+    return failures != 0;
+}
@@ -0,0 +1,56 @@
+/*
+ * openchronos.h
+ *
+ * Host stand-in for the firmware main header, so drivers/adc12.c builds
+ * with the native compiler. The ADC12_A and REF registers are plain
+ * variables, the conversions are run by the timer0_delay() of
+ * adc12_test.c. It is found before the real header through -I.
+ */
+
+#ifndef __OPENCHRONOS_H__
+#define __OPENCHRONOS_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define BIT0 (0x0001)
+#define BIT1 (0x0002)
+#define BIT2 (0x0004)
+#define BIT3 (0x0008)
+#define BIT4 (0x0010)
+#define BIT5 (0x0020)
+#define BIT6 (0x0040)
+#define BIT7 (0x0080)
+
+#define LPM3_bits       (0x00f0)
+
+/* REF_A */
+#define REFMSTR         (0x0080)
+#define REFVSEL_0       (0x0000)
+#define REFVSEL_1       (0x0010)
+#define REFVSEL_2       (0x0020)
+#define REFON           (0x0001)
+
+/* ADC12_A */
+#define ADC12SC         (0x0001)
+#define ADC12ENC        (0x0002)
+#define ADC12ON         (0x0010)
+#define ADC12MSC        (0x0080)
+#define ADC12SHT0_8     (0x0800)
+#define ADC12SHT0_10    (0x0a00)
+#define ADC12SHP        (0x0200)
+#define ADC12CONSEQ_2   (0x0004)
+#define ADC12SREF_1     (0x0010)
+#define ADC12INCH_10    (0x000a)
+#define ADC12INCH_11    (0x000b)
+
+extern uint16_t REFCTL0;
+extern uint16_t ADC12CTL0, ADC12CTL1, ADC12IE, ADC12IV, ADC12MEM0;
+extern uint8_t ADC12MCTL0;
+
+/* The interrupt routine is called by the model */
+#define interrupt(vector)       used
+#define __even_in_range(x, y)   (x)
+#define _BIC_SR_IRQ(x)
+
+#endif /* __OPENCHRONOS_H__ */
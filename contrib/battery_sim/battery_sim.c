@@ -0,0 +1,221 @@
+/*
+ * battery_sim.c
+ *
+ * Runs the battery_minute() scheduler of drivers/battery.c over 60 days
+ * of a simulated CR2032, one call per minute like handle_events(), and
+ * counts the ADC conversions it asks for.
+ *
+ * The cell falls from 3.00 V to 2.90 V over 50 days with a daily swing of
+ * 30 mV, sags 150 mV under a 30 s alarm every morning and 100 mV under a
+ * 2 minute radio sync once a week, recovering over a few minutes. Over the
+ * last 10 days it falls through the knee to 2.20 V. Every conversion reads
+ * the cell with 7 mV of noise.
+ *
+ * Checked: conversions per day while the cell holds, the delay of the low
+ * battery warning once the cell is below BATTERY_LOW_THRESHOLD at rest,
+ * and how far battery_info.voltage strays from the cell away from loads.
+ * The warning is reported against the cell going empty, below
+ * BATTERY_EMPTY_THRESHOLD at rest.
+ * That last one is for the unfiltered voltage of the default config, the
+ * filter adds a lag of several measurements on top.
+ *
+ * Build from the top of the tree, the define is the default config and
+ * -fcommon lets battery.h define battery_info in both files as on the
+ * target:
+ *
+ *   cc -O2 -Wall -fcommon -Icontrib/battery_sim -Idrivers \
+ *      -DCONFIG_BATTERY_DISABLE_FILTER -o battery_sim \
+ *      contrib/battery_sim/battery_sim.c drivers/battery.c -lm
+ *
+ * Usage: battery_sim [-s seed] [-v]
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "openchronos.h"
+#include "display.h"
+#include "battery.h"
+#include "rtca.h"
+
+#define DAYS            60
+#define KNEE_DAY        50
+#define MINUTES         (DAYS * 24 * 60)
+
+#define ALARM_MINUTE    (7 * 60)
+#define ALARM_SECONDS   30
+#define RADIO_MINUTES   2
+#define RECOVERY_MIN    3.0
+
+/* Minutes after a load ends that are left out of the tracking error */
+#define SETTLE_MIN      30
+
+#define LIMIT_PER_DAY   48
+#define LIMIT_WARN_MIN  30
+#define LIMIT_TRACK_CV  5
+
+static unsigned long rng = 1;
+static int verbose;
+
+static double cell;             /* cell voltage in 10 mV */
+static unsigned long conversions;
+static int warning;
+
+static double gauss(void)
+{
+    double u, v;
+
+    rng = rng * 1103515245ul + 12345ul;
+    u = (((rng >> 8) & 0xffffff) + 1) / 16777217.0;
+    rng = rng * 1103515245ul + 12345ul;
+    v = ((rng >> 8) & 0xffffff) / 16777216.0;
+
+    return sqrt(-2 * log(u)) * cos(2 * M_PI * v);
+}
+
+/* A11 is AVCC/2 against the 2.0 V reference, read back as (A11 * 4) / 41 */
+uint16_t adc12_single_conversion(uint16_t ref, uint16_t sht, uint16_t channel)
+{
+    double code = (cell + 0.7 * gauss()) * 41 / 4;
+
+    conversions++;
+
+    return code < 0 ? 0 : (uint16_t)(code + 0.5);
+}
+
+void display_symbol(uint8_t scr_nr, enum display_segment symbol,
+                    enum display_segstate state)
+{
+    if (symbol == LCD_SYMB_BATTERY && (state & BLINK_ON))
+        warning = 1;
+}
+
+/* Open circuit voltage of the cell */
+static double rest_voltage(long m)
+{
+    double day = m / 1440.0;
+    double v = 300 - 10 * fmin(day, KNEE_DAY) / KNEE_DAY;
+
+    if (day > KNEE_DAY)
+        v -= 70 * pow((day - KNEE_DAY) / (DAYS - KNEE_DAY), 3);
+
+    /* colder at night */
+    return v - 3 * cos(2 * M_PI * (m % 1440) / 1440.0);
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long per_day[DAYS] = { 0 };
+    double sag = 0, max_track = 0;
+    long m, low_at = -1, warn_at = -1, empty_at = -1;
+    long load_end = -SETTLE_MIN;
+    unsigned long holding = 0;
+    int opt, failures = 0, day;
+
+    while ((opt = getopt(argc, argv, "s:v")) != -1) {
+        switch (opt) {
+        case 's':
+            rng = strtoul(optarg, NULL, 0) * 2 + 1;
+            break;
+        case 'v':
+            verbose = 1;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-s seed] [-v]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    battery_init();
+
+    for (m = 0; m < MINUTES; m++) {
+        double rest = rest_voltage(m);
+        unsigned long before = conversions;
+        int load = 0;
+
+        day = m / 1440;
+
+        /* the alarm plays at the start of the minute, the sync runs for two */
+        if (m % 1440 == ALARM_MINUTE) {
+            load = 15;
+        } else if (m % (7 * 1440) >= 19 * 60 &&
+                   m % (7 * 1440) < 19 * 60 + RADIO_MINUTES) {
+            load = 10;
+        }
+
+        /* as the buzzer and radio drivers report their loads */
+        rtca_time.sys = m * 60;
+        if (load) {
+            sag = load;
+            load_end = m;
+            if (m % 1440 == ALARM_MINUTE) {
+                battery_load_start(BATTERY_LOAD_BUZZER);
+                rtca_time.sys += ALARM_SECONDS;
+                battery_load_stop(BATTERY_LOAD_BUZZER);
+            } else if (m % (7 * 1440) == 19 * 60) {
+                battery_load_start(BATTERY_LOAD_RADIO);
+            } else {
+                rtca_time.sys += 59;
+                battery_load_stop(BATTERY_LOAD_RADIO);
+            }
+        }
+        rtca_time.sys = m * 60 + 59;
+
+        cell = rest - sag;
+        sag *= exp(-1 / RECOVERY_MIN);
+
+        if (battery_minute() && verbose)
+            printf("%7.3f %6.1f %4u\n", m / 1440.0, cell,
+                   battery_info.voltage);
+        per_day[day] += conversions - before;
+
+        if (low_at < 0 && rest < BATTERY_LOW_THRESHOLD)
+            low_at = m;
+        if (empty_at < 0 && rest < BATTERY_EMPTY_THRESHOLD)
+            empty_at = m;
+        if (warn_at < 0 && warning)
+            warn_at = m;
+
+        if (day >= 1 && day < KNEE_DAY && m - load_end > SETTLE_MIN) {
+            double d = fabs(battery_info.voltage - cell);
+
+            if (d > max_track)
+                max_track = d;
+        }
+    }
+
+    for (day = 1; day < KNEE_DAY; day++)
+        holding += per_day[day];
+
+    printf("conversions, every minute %d per day\n", 24 * 60);
+    printf("  first day               %lu\n", per_day[0]);
+    printf("  days 1-%d, cell holds   %.1f per day        %s\n", KNEE_DAY - 1,
+           (double)holding / (KNEE_DAY - 1),
+           holding <= LIMIT_PER_DAY * (KNEE_DAY - 1) ? "ok" : "FAIL");
+    failures += holding > LIMIT_PER_DAY * (KNEE_DAY - 1);
+    for (day = KNEE_DAY; day < DAYS; day++)
+        printf("  day %d, knee            %lu\n", day, per_day[day]);
+
+    printf("tracking away from loads  max %.1f x 10 mV      %s\n", max_track,
+           max_track <= LIMIT_TRACK_CV ? "ok" : "FAIL");
+    failures += max_track > LIMIT_TRACK_CV;
+
+    if (empty_at < 0)
+        empty_at = MINUTES;
+    if (low_at < 0 || warn_at < 0) {
+        printf("low battery warning       missing             FAIL\n");
+        failures++;
+    } else {
+        /* a sag under load may well warn before the cell is low at rest */
+        printf("low battery warning       %ld min before empty  %s\n",
+               empty_at - warn_at, warn_at - low_at <= LIMIT_WARN_MIN
+               && warn_at < empty_at ? "ok" : "FAIL");
+        failures += warn_at - low_at > LIMIT_WARN_MIN || warn_at >= empty_at;
+    }
+
+    printf("%s\n", failures ? "FAILED" : "all passed");
+
+    return failures != 0;
+}
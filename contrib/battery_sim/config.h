@@ -0,0 +1 @@
+/* Host stand-in for the generated config.h */
@@ -0,0 +1,42 @@
+/*
+ * openchronos.h
+ *
+ * Host stand-in for the firmware main header, so drivers/battery.c builds
+ * with the native compiler. The ADC, the display and rtca_time are
+ * provided by the simulations. It is found before the real header
+ * through -I.
+ */
+
+#ifndef __OPENCHRONOS_H__
+#define __OPENCHRONOS_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define BIT0 (0x0001)
+#define BIT1 (0x0002)
+#define BIT2 (0x0004)
+#define BIT3 (0x0008)
+#define BIT4 (0x0010)
+#define BIT5 (0x0020)
+#define BIT6 (0x0040)
+#define BIT7 (0x0080)
+#define BIT8 (0x0100)
+#define BIT9 (0x0200)
+#define BITA (0x0400)
+#define BITB (0x0800)
+#define BITC (0x1000)
+#define BITD (0x2000)
+#define BITE (0x4000)
+#define BITF (0x8000)
+
+/* Nothing interrupts the simulation */
+#define __get_SR_register()         (0)
+#define __disable_interrupt()
+#define __set_interrupt_state(x)    ((void)(x))
+
+#define REFVSEL_1       (0x0010)
+#define ADC12SHT0_10    (0x0a00)
+#define ADC12INCH_11    (0x000b)
+
+#endif /* __OPENCHRONOS_H__ */
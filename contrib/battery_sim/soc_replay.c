@@ -0,0 +1,340 @@
+/*
+ * soc_replay.c
+ *
+ * Replays a battery voltage log through the state of charge estimate of
+ * drivers/battery.c and compares the days left it predicts with the days
+ * the cell really lasted.
+ *
+ * A log has one line per minute, or fewer, of
+ *
+ *   minute,mV,buzzer_s,radio_s,accel_s,motion_s
+ *
+ * with the cell voltage and the seconds each load was on in that minute.
+ * Between lines the voltage holds and the loads are off. Every minute
+ * goes through battery_minute() like handle_events() does, the loads
+ * through battery_load_start() and battery_load_stop() like the drivers
+ * report them, and the ADC reads the logged voltage. The cell is taken to
+ * be empty at the first reading below 2.20 V that is BATTERY_REST_MINUTES
+ * clear of the buzzer and the radio.
+ *
+ * Without a file a whole life is generated. The cell holds 225 mAh and
+ * draws 9 uA at rest, 4.5 mA for the buzzer, 16 mA for the radio, 80 uA
+ * for the acceleration sensor and 12 uA for motion detection, all a little
+ * more than battery.h assumes. Every day has a 30 s alarm and a night of
+ * motion detection, weekdays 12 hours of pedometer, and once a week a
+ * 2 minute radio sync. The pedometer is dropped after 100 days. The cell
+ * voltage follows a discharge curve that is close to, but not the same
+ * as, the one in battery.c, with a daily swing, sags under load and 7 mV
+ * of noise. -w writes it out in the log format.
+ *
+ * Build from the top of the tree, the define is the default config:
+ *
+ *   cc -O2 -Wall -fcommon -Icontrib/battery_sim -Idrivers \
+ *      -DCONFIG_BATTERY_DISABLE_FILTER -o soc_replay \
+ *      contrib/battery_sim/soc_replay.c drivers/battery.c -lm
+ *
+ * Usage: soc_replay [-s seed] [-v] [-w out.csv] [log.csv]
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "openchronos.h"
+#include "display.h"
+#include "battery.h"
+#include "rtca.h"
+
+#define LOG_MAX         (2 * 366 * 1440)
+
+/* The synthetic cell */
+#define CELL_MAH        225.0
+#define CELL_BASE_UA    9.0
+#define CELL_LOAD_UA    { 4500.0, 16000.0, 80.0, 12.0 }
+#define CELL_SAG_CV     { 15.0, 10.0, 0.0, 0.0 }
+#define PEDOMETER_DAYS  100
+
+/*
+ * Checkpoints of days really left, and how far off the prediction may be.
+ * On the plateau the voltage tells nothing and the prediction is only as
+ * good as the currents in battery.h, which the synthetic cell beats by
+ * 10 to 15 percent. That is high on the charge left and low on the daily
+ * draw, about 26 percent at 180 days. From the edge of the plateau on the
+ * discharge curve takes over. The firmware shows whole days, so every
+ * checkpoint allows one more.
+ */
+static const struct {
+    double days;
+    double off;         /* fraction of the days left */
+} checkpoints[] = {
+    { 180, 0.30 },
+    { 90, 0.25 },
+    { 30, 0.30 },
+    { 10, 0.30 },
+    { 3, 0.50 },
+};
+#define CHECKPOINTS (sizeof(checkpoints) / sizeof(checkpoints[0]))
+
+struct record {
+    uint32_t minute;
+    uint16_t mv;
+    uint8_t secs[BATTERY_LOADS];
+};
+
+static unsigned long rng = 1;
+static int verbose;
+static uint16_t adc_mv;
+
+static double gauss(void)
+{
+    double u, v;
+
+    rng = rng * 1103515245ul + 12345ul;
+    u = (((rng >> 8) & 0xffffff) + 1) / 16777217.0;
+    rng = rng * 1103515245ul + 12345ul;
+    v = ((rng >> 8) & 0xffffff) / 16777216.0;
+
+    return sqrt(-2 * log(u)) * cos(2 * M_PI * v);
+}
+
+/* A11 is AVCC/2 against the 2.0 V reference, read back as (A11 * 4) / 41 */
+uint16_t adc12_single_conversion(uint16_t ref, uint16_t sht, uint16_t channel)
+{
+    return (uint16_t)(adc_mv * 41 / 40.0 + 0.5);
+}
+
+void display_symbol(uint8_t scr_nr, enum display_segment symbol,
+                    enum display_segstate state)
+{
+}
+
+/* Cell voltage at rest in 10 mV by the fraction of charge left */
+static double cell_curve(double left)
+{
+    static const double frac[] = { 1.0, 0.20, 0.12, 0.08, 0.05, 0.03, 0.015, 0.0 };
+    static const double cv[] = { 304, 292, 283, 272, 260, 248, 235, 220 };
+    int i;
+
+    if (left >= 1)
+        return cv[0];
+    for (i = 1; frac[i] > left && i < 7; i++)
+        ;
+    if (left <= frac[i])
+        return cv[i] - (frac[i] - left) * 2000;
+
+    return cv[i] + (left - frac[i]) * (cv[i - 1] - cv[i]) / (frac[i - 1] - frac[i]);
+}
+
+static long synth(struct record *log)
+{
+    static const double load_ua[] = CELL_LOAD_UA;
+    static const double sag_cv[] = CELL_SAG_CV;
+    double used = 0, sag = 0;
+    long m, n = 0;
+
+    for (m = 0; n < LOG_MAX; m++) {
+        struct record *r = &log[n++];
+        long day = m / 1440, mod = m % 1440;
+        double uas = CELL_BASE_UA * 60, left, v;
+        int i;
+
+        memset(r, 0, sizeof(*r));
+        r->minute = m;
+
+        if (mod == 7 * 60)
+            r->secs[BATTERY_LOAD_BUZZER] = 30;
+        if (m % (7 * 1440) >= 19 * 60 && m % (7 * 1440) < 19 * 60 + 2)
+            r->secs[BATTERY_LOAD_RADIO] = 60;
+        if (day < PEDOMETER_DAYS && day % 7 < 5 && mod >= 8 * 60 && mod < 20 * 60)
+            r->secs[BATTERY_LOAD_ACCEL] = 60;
+        if (mod >= 23 * 60 || mod < 7 * 60)
+            r->secs[BATTERY_LOAD_MOTION] = 60;
+
+        for (i = 0; i < BATTERY_LOADS; i++) {
+            uas += r->secs[i] * load_ua[i];
+            if (r->secs[i] && sag_cv[i] > sag)
+                sag = sag_cv[i];
+        }
+        used += uas / 3600e3;
+        left = 1 - used / CELL_MAH;
+
+        /* the sag grows with the internal resistance near the end */
+        v = cell_curve(left) - 2 * cos(2 * M_PI * mod / 1440.0)
+            - sag * (left < 0.1 ? 2 : 1) + 0.7 * gauss();
+        sag *= exp(-1 / 3.0);
+
+        r->mv = v < 0 ? 0 : (uint16_t)(v * 10 + 0.5);
+        if (cell_curve(left) < BATTERY_EMPTY_THRESHOLD - 5)
+            break;
+    }
+
+    return n;
+}
+
+static long load(FILE *f, struct record *log)
+{
+    char line[128];
+    long n = 0;
+
+    while (n < LOG_MAX && fgets(line, sizeof(line), f)) {
+        unsigned long minute;
+        unsigned mv, s[BATTERY_LOADS] = { 0 };
+        int i;
+
+        if (sscanf(line, "%lu,%u,%u,%u,%u,%u", &minute, &mv,
+                   &s[0], &s[1], &s[2], &s[3]) < 2)
+            continue;
+
+        log[n].minute = minute;
+        log[n].mv = mv;
+        for (i = 0; i < BATTERY_LOADS; i++)
+            log[n].secs[i] = s[i] > 60 ? 60 : s[i];
+        n++;
+    }
+
+    return n;
+}
+
+static int loaded(const struct record *r)
+{
+    return r->secs[BATTERY_LOAD_BUZZER] || r->secs[BATTERY_LOAD_RADIO];
+}
+
+int main(int argc, char **argv)
+{
+    struct record *log;
+    const char *out = NULL;
+    long n, i, end = -1;
+    uint32_t m, last;
+    unsigned c = 0, measured = 0;
+    int opt, failures = 0;
+    uint8_t soc_before = 100, soc_up = 0;
+
+    while ((opt = getopt(argc, argv, "s:vw:")) != -1) {
+        switch (opt) {
+        case 's':
+            rng = strtoul(optarg, NULL, 0) * 2 + 1;
+            break;
+        case 'v':
+            verbose = 1;
+            break;
+        case 'w':
+            out = optarg;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-s seed] [-v] [-w out.csv] [log.csv]\n",
+                    argv[0]);
+            return 2;
+        }
+    }
+
+    log = malloc(LOG_MAX * sizeof(*log));
+    if (!log)
+        return 2;
+
+    if (optind < argc) {
+        FILE *f = fopen(argv[optind], "r");
+
+        if (!f) {
+            perror(argv[optind]);
+            return 2;
+        }
+        n = load(f, log);
+        fclose(f);
+    } else {
+        n = synth(log);
+    }
+
+    if (out) {
+        FILE *f = fopen(out, "w");
+
+        if (!f) {
+            perror(out);
+            return 2;
+        }
+        for (i = 0; i < n; i++)
+            fprintf(f, "%u,%u,%u,%u,%u,%u\n", log[i].minute, log[i].mv,
+                    log[i].secs[0], log[i].secs[1], log[i].secs[2],
+                    log[i].secs[3]);
+        fclose(f);
+    }
+
+    for (i = 0, last = 0; i < n; i++) {
+        if (loaded(&log[i]))
+            last = log[i].minute;
+        else if (log[i].minute - last >= BATTERY_REST_MINUTES &&
+                 log[i].mv < BATTERY_EMPTY_THRESHOLD * 10) {
+            end = log[i].minute;
+            break;
+        }
+    }
+    if (end < 0) {
+        fprintf(stderr, "the cell never went below %u0 mV\n",
+                BATTERY_EMPTY_THRESHOLD);
+        return 2;
+    }
+
+    printf("cell lasted               %.1f days\n", end / 1440.0);
+
+    battery_init();
+    last = log[0].minute;
+    adc_mv = log[0].mv;
+
+    for (i = 0, m = last; m < (uint32_t)end; m++) {
+        const struct record *r = NULL;
+        double left_days = (end - m) / 1440.0;
+        int k;
+
+        if (i < n && log[i].minute == m)
+            r = &log[i++];
+
+        rtca_time.sys = m * 60;
+        if (r) {
+            adc_mv = r->mv;
+            for (k = 0; k < BATTERY_LOADS; k++) {
+                if (!r->secs[k])
+                    continue;
+                rtca_time.sys = m * 60;
+                battery_load_start(k);
+                rtca_time.sys += r->secs[k];
+                battery_load_stop(k);
+            }
+        }
+        rtca_time.sys = m * 60 + 60;
+
+        if (!battery_minute())
+            continue;
+        measured++;
+
+        if (battery_info.soc > soc_before)
+            soc_up = 1;
+        soc_before = battery_info.soc;
+
+        if (verbose)
+            printf("%8.3f %4u %3u %5u %8.1f\n", m / 1440.0,
+                   battery_info.voltage, battery_info.soc,
+                   battery_info.days, left_days);
+
+        if (c < CHECKPOINTS && left_days <= checkpoints[c].days) {
+            double off = fabs(battery_info.days - left_days);
+            int ok = off <= checkpoints[c].off * left_days + 1;
+
+            printf("%5.0f days left: predicted %4u, %3u%%          %s\n",
+                   left_days, battery_info.days, battery_info.soc,
+                   ok ? "ok" : "FAIL");
+            failures += !ok;
+            c++;
+        }
+    }
+
+    printf("state of charge never rises  %s\n", soc_up ? "FAIL" : "ok");
+    failures += soc_up;
+
+    printf("measurements              %.1f per day\n",
+           measured * 1440.0 / end);
+    printf("%s\n", failures ? "FAILED" : "all passed");
+
+    return failures != 0;
+}
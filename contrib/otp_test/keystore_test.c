@@ -0,0 +1,391 @@
+/*
+ * keystore_test.c
+ *
+ * Round trips of the OTP keystore through a fake infomem, built with
+ * CONFIG_MOD_OTP_INFOMEM. The fake keeps the application's words in an
+ * array and follows the return codes and the growing and bounds rules of
+ * drivers/infomem.c for infomem_app_amount(), _read(), _replace(),
+ * _modify() and _clear(). After every write the module is started again
+ * with mod_otp_init(), as after a reset, and each loaded key has to show
+ * the code of the key it was written from.
+ *
+ *   empty      nothing stored, the built-in key is used, also after
+ *              otp_keystore_write() of no keys over a stored keystore
+ *   full       OTP_MAX_KEYS keys of all settings and lengths from 1 to
+ *              64 bytes, one more is dropped at boot, a 65 byte key and
+ *              a keystore larger than infomem are refused
+ *   sixteen    16 keys of 10 bytes, as from a base32 secret of 16
+ *              characters, fit alone but not next to the sleep log, how
+ *              long mod_otp_init() takes to load them on the host
+ *   menu       a long '#' stores the built-in keys
+ *   corrupt    a key length past the record size, a keystore cut off
+ *              inside a key and inside settings, out of range settings
+ *
+ * Build from the top of the tree, -fcommon lets rtca.h define rtca_time
+ * in both files as on the target:
+ *
+ *   cc -O2 -Wall -fcommon -DCONFIG_MOD_OTP_INFOMEM -Icontrib/otp_test -I. \
+ *      -o keystore_test contrib/otp_test/keystore_test.c \
+ *      contrib/otp_test/otp_host.c modules/hashutils.c
+ *
+ * Usage: keystore_test [-v]
+ */
+
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "otp_host.h"
+
+#define KEY_SHA1    "12345678901234567890"
+#define KEY_LONG    "1234567890123456789012345678901234567890" \
+                    "123456789012345678901234"
+#define KEY_BASE32  "\x3d\xc6\xca\xa4\x82\x4a\x6d\x28\x87\x67"
+
+#define CONFIG_MOD_OTP_OFFSET 0
+#define CONFIG_MOD_OTP_KEYS { \
+    { "F", KEY_SHA1, 20 }, \
+}
+
+#include "modules/otp.c"
+
+/* Words the fake infomem holds, as openchronos.c sets it up over two
+   segments. The application header takes one of them. */
+#define FAKE_MAXSIZE    (2 * INFOMEM_SEGMENT_WORDS - 3)
+
+/* The sleep log of modules/sleep.c, its header, the 60 words of its
+   history and the application header */
+#define SLEEP_WORDS     (4 + 60 + 1)
+
+static uint16_t fake[FAKE_MAXSIZE];
+static int16_t fake_size = -1;      /* -1: no application data */
+static int16_t fake_other;          /* words of other applications */
+
+static int16_t fake_used(void)
+{
+    return fake_other + (fake_size < 0 ? 0 : fake_size + 1);
+}
+
+int16_t infomem_space(void)
+{
+    return FAKE_MAXSIZE - fake_used();
+}
+
+int16_t infomem_app_amount(uint8_t identifier)
+{
+    return fake_size < 0 ? 0 : fake_size;
+}
+
+int16_t infomem_app_read(uint8_t identifier, uint16_t *data, uint8_t count,
+                         uint8_t offset)
+{
+    if (fake_size < 0 || offset >= fake_size)
+        return 0;
+    if (count + offset > fake_size)
+        count = fake_size - offset;
+    memcpy(data, &fake[offset], count * 2);
+    return count;
+}
+
+int16_t infomem_app_clear(uint8_t identifier)
+{
+    if (fake_size < 0)
+        return 0;
+    fake_size = -1;
+    return 0;
+}
+
+int16_t infomem_app_replace(uint8_t identifier, uint16_t *data,
+                            uint8_t count)
+{
+    if (count == 0)
+        return infomem_app_clear(identifier);
+    if (count + 1 > FAKE_MAXSIZE - fake_other)
+        return -4;
+    memcpy(fake, data, count * 2);
+    fake_size = count;
+    return count + 1;
+}
+
+int16_t infomem_app_modify(uint8_t identifier, uint16_t *data,
+                           uint8_t count, uint8_t offset)
+{
+    if (fake_size < 0)
+        return 0;
+    if (offset > fake_size)
+        return -3;
+    if (count + offset + 1 > FAKE_MAXSIZE - fake_other)
+        return -4;
+    memcpy(&fake[offset], data, count * 2);
+    if (count + offset > fake_size)
+        fake_size = count + offset;
+    return fake_size;
+}
+
+static int verbose;
+
+/* Starts the module as after a reset and compares the loaded keys */
+static int check_loaded(const char *what, const keystore_t *keys,
+                        uint8_t count)
+{
+    int failures = 0;
+    uint8_t i;
+
+    mod_otp_init();
+
+    if (max_key_index != count) {
+        printf("%s: %u keys loaded, want %u\n", what, max_key_index, count);
+        return 1;
+    }
+
+    for (i = 0; i < count; i++) {
+        const keystore_t *k = &keys[i];
+        const struct otp_key *key = &otp_table[i];
+        uint8_t digits = k->otp_digits == 8 ? 8 : 6;
+        uint16_t period = k->otp_period ? k->otp_period : 30;
+        uint8_t algorithm = k->otp_algorithm == OTP_ALG_SHA256 ?
+            OTP_ALG_SHA256 : OTP_ALG_SHA1;
+        uint32_t shown, want;
+
+        otp_host_now = 1500000000ul + 7919ul * i;
+        current_key_index = i;
+        otp_host_menu.activate_fn();
+        shown = otp_host_code(key->digits);
+        want = otp_host_reference((const uint8_t *)k->otp_key,
+                k->otp_key_len, algorithm, digits,
+                (otp_host_now - k->otp_t0) / period);
+
+        if (verbose)
+            printf("%s: key %c alg %u digits %u period %u t0 %lu: %0*lu\n",
+                   what, key->identifier, key->algorithm, key->digits,
+                   key->period, (unsigned long)key->t0, key->digits,
+                   (unsigned long)shown);
+
+        if (key->identifier != k->otp_identifier[0]
+                || (key->algorithm == OTP_ALG_SHA256) != (algorithm == OTP_ALG_SHA256)
+                || key->digits != digits
+                || key->period != period || key->t0 != k->otp_t0
+                || shown != want) {
+            printf("%s: key %u (%c) loaded wrong, shows %0*lu want %0*lu\n",
+                   what, i, key->identifier, key->digits,
+                   (unsigned long)shown, digits, (unsigned long)want);
+            failures++;
+        }
+    }
+    return failures;
+}
+
+static int check_write(const char *what, const keystore_t *keys,
+                       uint8_t count, int16_t want)
+{
+    int16_t ret = otp_keystore_write(keys, count);
+
+    if (ret == want)
+        return 0;
+    printf("%s: otp_keystore_write() returned %d, want %d\n",
+           what, ret, want);
+    return 1;
+}
+
+static const keystore_t factory[] = CONFIG_MOD_OTP_KEYS;
+
+/* 107 words, two of the records with settings take 24 of them */
+static const keystore_t full[] = {
+    { "A", KEY_SHA1, 20 },
+    { "B", KEY_LONG, 16, OTP_ALG_SHA256, 8, 60, 1000 },
+    { "C", KEY_LONG, 1, OTP_ALG_SHA1, 6, 45, 0 },
+    { "D", KEY_LONG, 13, OTP_ALG_SHA256, 6, 30, 1400000000ul },
+    { "E", KEY_LONG, 64, OTP_ALG_SHA1, 8, 90, 12345 },
+    { "G", KEY_LONG, 3 },
+    { "H", KEY_LONG, 4, OTP_ALG_SHA1, 6, 30, 0 },
+    { "I", KEY_LONG, 2, OTP_ALG_SHA256, 6, 120, 7 },
+    { "J", KEY_LONG, 2 },
+    { "K", KEY_LONG, 2 },
+    { "L", KEY_LONG, 2, OTP_ALG_SHA1, 8, 0, 0 },
+    { "M", KEY_LONG, 2 },
+    { "N", KEY_LONG, 2 },
+    { "P", KEY_LONG, 2 },
+    { "Q", KEY_LONG, 2 },
+    { "R", KEY_LONG, 2 },
+    /* one more than the RAM table holds */
+    { "S", KEY_LONG, 5, OTP_ALG_SHA1, 6, 30, 0 },
+};
+
+static const keystore_t too_long[] = {
+    { "A", KEY_SHA1, 20 },
+    { "X", KEY_LONG "0", 65 },
+};
+
+/* Four records of 37 words do not fit into infomem, three would */
+static const keystore_t too_many[] = {
+    { "A", KEY_LONG, 64, OTP_ALG_SHA256 },
+    { "B", KEY_LONG, 64, OTP_ALG_SHA256 },
+    { "C", KEY_LONG, 64, OTP_ALG_SHA256 },
+    { "D", KEY_LONG, 64, OTP_ALG_SHA256 },
+};
+
+/* Records of 6 words, 16 take 96 of the 124 words left for the keys */
+static const keystore_t sixteen[] = {
+    { "A", KEY_BASE32, 10 }, { "B", KEY_BASE32, 10 },
+    { "C", KEY_BASE32, 10 }, { "D", KEY_BASE32, 10 },
+    { "E", KEY_BASE32, 10 }, { "F", KEY_BASE32, 10 },
+    { "G", KEY_BASE32, 10 }, { "H", KEY_BASE32, 10 },
+    { "I", KEY_BASE32, 10 }, { "J", KEY_BASE32, 10 },
+    { "K", KEY_BASE32, 10 }, { "L", KEY_BASE32, 10 },
+    { "M", KEY_BASE32, 10 }, { "N", KEY_BASE32, 10 },
+    { "O", KEY_BASE32, 10 }, { "P", KEY_BASE32, 10 },
+};
+
+/* How otp_set_key() takes settings out of range */
+static const keystore_t odd[] = {
+    { "O", KEY_SHA1, 20, 9, 7, 0, 5 },
+};
+
+static int test_empty(void)
+{
+    int failures = 0;
+
+    fake_size = -1;
+    failures += check_loaded("empty", factory, 1);
+
+    /* writing no keys drops a stored keystore at once */
+    failures += check_write("write", full, 2, 2);
+    failures += check_loaded("write", full, 2);
+    failures += check_write("write none", full, 0, 1);
+    if (max_key_index != 1 || otp_table[0].identifier != 'F') {
+        printf("write none: built-in key not back before reset\n");
+        failures++;
+    }
+    failures += check_loaded("write none", factory, 1);
+    if (fake_size >= 0) {
+        printf("write none: %d words left in infomem\n", fake_size);
+        failures++;
+    }
+    return failures;
+}
+
+static int test_full(void)
+{
+    int failures = 0;
+
+    failures += check_write("full", full, OTP_MAX_KEYS, OTP_MAX_KEYS);
+    failures += check_loaded("full", full, OTP_MAX_KEYS);
+
+    /* one more is stored, but does not fit the table */
+    failures += check_write("one more", full, OTP_MAX_KEYS + 1, OTP_MAX_KEYS);
+    failures += check_loaded("one more", full, OTP_MAX_KEYS);
+
+    /* refused writes leave the keystore of the last good one */
+    failures += check_write("65 bytes", too_long, 2, -5);
+    failures += check_write("too many", too_many, 4, -4);
+    failures += check_loaded("refused", full, OTP_MAX_KEYS);
+
+    failures += check_write("odd", odd, 1, 1);
+    failures += check_loaded("odd", odd, 1);
+    return failures;
+}
+
+static int test_sixteen(void)
+{
+    struct timespec start, end;
+    int failures = 0;
+    double us;
+    int i;
+
+    /* the sleep log is kept over a reset, written before any key */
+    fake_size = -1;
+    fake_other = SLEEP_WORDS;
+    failures += check_write("next to sleep", sixteen, 16, -4);
+    failures += check_write("next to sleep", sixteen, 9, 9);
+    failures += check_loaded("next to sleep", sixteen, 9);
+    failures += check_write("next to sleep", sixteen, 10, -4);
+    failures += check_loaded("next to sleep", sixteen, 9);
+
+    fake_size = -1;
+    fake_other = 0;
+    failures += check_write("sixteen", sixteen, 16, 16);
+    failures += check_loaded("sixteen", sixteen, 16);
+    if (infomem_space() != FAKE_MAXSIZE - 16 * 6 - 1) {
+        printf("sixteen: %d words left\n", infomem_space());
+        failures++;
+    }
+
+    /* each key takes two hash blocks, its inner and outer pad */
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < 1000; i++)
+        mod_otp_init();
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    us = ((end.tv_sec - start.tv_sec) * 1e9
+          + (end.tv_nsec - start.tv_nsec)) / 1000 / 1000;
+    printf("load of 16 keys: %d SHA-1 blocks, %.1f us on the host\n",
+           2 * max_key_index, us);
+    return failures;
+}
+
+static int test_menu(void)
+{
+    unsigned beeps = otp_host_beeps;
+    int failures = 0;
+
+    fake_size = -1;
+    mod_otp_init();
+    otp_host_menu.lnum_btn_fn();
+    if (fake_size != 11 || otp_host_beeps != beeps + 1) {
+        printf("menu: long '#' stored %d words, %u beeps\n",
+               fake_size, otp_host_beeps - beeps);
+        failures++;
+    }
+    failures += check_loaded("menu", factory, 1);
+    return failures;
+}
+
+static int test_corrupt(void)
+{
+    int failures = 0;
+
+    /* a key length past what a record can hold ends the keystore,
+       records of 11 and 13 words come before the third */
+    failures += check_write("corrupt", full, 3, 3);
+    fake[11 + 13] = 'C' | (uint16_t)(2 * OTP_KEY_WORDS + 2) << 8;
+    failures += check_loaded("key length", full, 2);
+
+    /* cut off inside the key of the third record */
+    failures += check_write("corrupt", full, 3, 3);
+    fake_size = 11 + 13 + 1 + OTP_SETTINGS_WORDS;
+    failures += check_loaded("cut in key", full, 2);
+
+    /* cut off inside the settings of the second record */
+    fake_size = 11 + 1 + OTP_SETTINGS_WORDS - 1;
+    failures += check_loaded("cut in settings", full, 1);
+
+    /* not even one key, the built-in key takes over */
+    fake_size = 1;
+    failures += check_loaded("cut short", factory, 1);
+    return failures;
+}
+
+int main(int argc, char **argv)
+{
+    int failures = 0, opt;
+
+    while ((opt = getopt(argc, argv, "v")) != -1) {
+        if (opt == 'v') {
+            verbose = 1;
+        } else {
+            fprintf(stderr, "usage: %s [-v]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    failures += test_empty();
+    failures += test_full();
+    failures += test_sixteen();
+    failures += test_menu();
+    failures += test_corrupt();
+
+    printf("%s\n", failures ? "FAIL" : "PASS");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,8 @@
+/*
+ * msp430.h
+ *
+ * Host stand-in for the toolchain header included by menu.h and
+ * messagebus.h. Everything they need comes from openchronos.h.
+ */
+
+#include "openchronos.h"
@@ -0,0 +1,133 @@
+/*
+ * otp_host.c
+ *
+ * Stand-ins for the firmware services modules/otp.c uses, see otp_host.h.
+ * The display keeps the number of each _printf() by segment, which is all
+ * the module writes its codes with, the buzzer counts what it was asked
+ * to play.
+ */
+
+#include <string.h>
+#include <stdbool.h>
+
+#include "openchronos.h"
+#include "menu.h"
+#include "messagebus.h"
+#include "drivers/display.h"
+#include "drivers/buzzer.h"
+#include "drivers/rtca.h"
+#include "modules/otp.h"
+#include "modules/hashutils.h"
+
+#include "otp_host.h"
+
+uint32_t otp_host_now;
+struct menu otp_host_menu;
+unsigned otp_host_beeps;
+
+static uint32_t printed;
+static uint32_t shown[256];
+
+uint32_t rtca_epoch(void)
+{
+    return otp_host_now;
+}
+
+char *_sprintf(const char *fmt, int16_t n)
+{
+    static char str[] = "0000";
+
+    printed = (uint16_t)n;
+    return str;
+}
+
+void display_chars(uint8_t scr_nr, enum display_segment_array segments,
+        char const *str, enum display_segstate state)
+{
+    shown[segments] = printed;
+}
+
+void display_char(uint8_t scr_nr, enum display_segment segment,
+        char chr, enum display_segstate state)
+{
+}
+
+void display_bits(uint8_t scr_nr, enum display_segment segment,
+        uint8_t bits, enum display_segstate state)
+{
+}
+
+void display_clear(uint8_t scr_nr, uint8_t line)
+{
+}
+
+struct menu *menu_add_entry(char const *name,
+        void (*up_btn_fn)(void), void (*down_btn_fn)(void),
+        void (*num_btn_fn)(void), void (*lstar_btn_fn)(void),
+        void (*lnum_btn_fn)(void), void (*updown_btn_fn)(void),
+        void (*activate_fn)(void), void (*deactivate_fn)(void))
+{
+    otp_host_menu.name = name;
+    otp_host_menu.up_btn_fn = up_btn_fn;
+    otp_host_menu.down_btn_fn = down_btn_fn;
+    otp_host_menu.num_btn_fn = num_btn_fn;
+    otp_host_menu.lstar_btn_fn = lstar_btn_fn;
+    otp_host_menu.lnum_btn_fn = lnum_btn_fn;
+    otp_host_menu.updown_btn_fn = updown_btn_fn;
+    otp_host_menu.activate_fn = activate_fn;
+    otp_host_menu.deactivate_fn = deactivate_fn;
+    return &otp_host_menu;
+}
+
+const note welcome[4] = {0x1931, 0x1934, 0x1938, 0x000F};
+
+void buzzer_play(const note *notes, enum buzzer_priority priority)
+{
+    otp_host_beeps++;
+}
+
+void sys_messagebus_register(void (*callback)(enum sys_message),
+        enum sys_message listens)
+{
+}
+
+void sys_messagebus_unregister_all(void (*callback)(enum sys_message))
+{
+}
+
+uint32_t otp_host_code(uint8_t digits)
+{
+    if (digits > 6)
+        return shown[LCD_SEG_L1_3_0] * 10000 + shown[LCD_SEG_L2_3_0];
+    return shown[LCD_SEG_L1_2_0] * 1000 + shown[LCD_SEG_L2_2_0];
+}
+
+uint32_t otp_host_reference(const uint8_t *key, uint8_t key_len,
+        uint8_t algorithm, uint8_t digits, uint32_t counter)
+{
+    uint8_t msg[8] = { 0 };
+    uint8_t mac[SHA256_DIGEST_LENGTH];
+    uint8_t len, off;
+    uint32_t val, mod = 1;
+
+    msg[4] = counter >> 24;
+    msg[5] = counter >> 16;
+    msg[6] = counter >> 8;
+    msg[7] = counter;
+
+    if (algorithm == OTP_ALG_SHA256) {
+        len = SHA256_DIGEST_LENGTH;
+        hmac_sha256(key, key_len, msg, sizeof(msg), mac, len);
+    } else {
+        len = SHA1_DIGEST_LENGTH;
+        hmac_sha1(key, key_len, msg, sizeof(msg), mac, len);
+    }
+
+    off = mac[len - 1] & 0x0f;
+    val = (uint32_t)(mac[off] & 0x7f) << 24 | (uint32_t)mac[off + 1] << 16
+        | (uint32_t)mac[off + 2] << 8 | mac[off + 3];
+
+    while (digits--)
+        mod *= 10;
+    return val % mod;
+}
@@ -0,0 +1,31 @@
+/*
+ * otp_host.h
+ *
+ * What otp_host.c offers the OTP host tests: the clock the module reads,
+ * the menu entry it registered, the code it last put on the display and
+ * the beeps it asked for.
+ */
+
+#ifndef __OTP_HOST_H__
+#define __OTP_HOST_H__
+
+#include <stdint.h>
+#include "menu.h"
+
+/* Unix time returned by rtca_epoch(), with CONFIG_MOD_OTP_OFFSET 0 */
+extern uint32_t otp_host_now;
+
+/* The entry of mod_otp_init(), to press buttons and switch to it */
+extern struct menu otp_host_menu;
+
+/* Times buzzer_play() was called */
+extern unsigned otp_host_beeps;
+
+/* The code on the display, read back from the two lines */
+uint32_t otp_host_code(uint8_t digits);
+
+/* RFC 6238 code computed from scratch with the one shot HMAC */
+uint32_t otp_host_reference(const uint8_t *key, uint8_t key_len,
+        uint8_t algorithm, uint8_t digits, uint32_t counter);
+
+#endif /* __OTP_HOST_H__ */
@@ -0,0 +1,184 @@
+/*
+ * otp_window_test.c
+ *
+ * Runs modules/otp.c second by second, as SYS_MSG_RTC_SECOND would, and
+ * checks the code on the display against one computed from scratch at
+ * every second. Three keys with different algorithms, digits, periods and
+ * T0 are cycled through with the up and down buttons, and the clock is set
+ * back and forward in the middle of windows:
+ *
+ *   back 95 s      the next window was already precomputed
+ *   back 1 hour    every precomputed code is from the future
+ *   forward 2 hours
+ *
+ * A window that starts while the clock just runs must come from otp_next[],
+ * so the precompute is really used. Any other window, after a button or a
+ * clock set, is computed on demand.
+ *
+ * Build from the top of the tree, -fcommon lets rtca.h define rtca_time
+ * in both files as on the target:
+ *
+ *   cc -O2 -Wall -fcommon -Icontrib/otp_test -I. -o otp_window_test \
+ *      contrib/otp_test/otp_window_test.c contrib/otp_test/otp_host.c \
+ *      modules/hashutils.c
+ *
+ * Usage: otp_window_test [-v]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "otp_host.h"
+
+#define KEY_SHA1    "12345678901234567890"
+#define KEY_SHA256  "12345678901234567890123456789012"
+
+#define CONFIG_MOD_OTP_OFFSET 0
+#define CONFIG_MOD_OTP_KEYS { \
+    { "A", KEY_SHA1, 20 }, \
+    { "B", KEY_SHA256, 32, OTP_ALG_SHA256, 8, 60, 1000 }, \
+    { "C", KEY_SHA1, 20, OTP_ALG_SHA1, 6, 45, 7 }, \
+}
+
+#include "modules/otp.c"
+
+#define START       1500000000ul
+
+/* What happens at a second of the run, in order */
+enum action { RUN, KEY_UP, KEY_DOWN, SET };
+
+static const struct {
+    enum action action;
+    int32_t arg;        /* seconds to run, or to move the clock */
+} script[] = {
+    { RUN, 400 },
+    { KEY_UP, 0 },      /* B */
+    { RUN, 400 },
+    { SET, -95 },
+    { RUN, 300 },
+    { KEY_UP, 0 },      /* C */
+    { RUN, 300 },
+    { SET, -3600 },
+    { RUN, 300 },
+    { SET, 7200 },
+    { RUN, 300 },
+    { KEY_UP, 0 },      /* A */
+    { SET, -13 },
+    { RUN, 200 },
+    { KEY_DOWN, 0 },    /* C */
+    { RUN, 200 },
+    { KEY_DOWN, 0 },    /* B */
+    { SET, -60 },
+    { RUN, 400 },
+};
+
+#define NUM_SCRIPT (sizeof(script) / sizeof(script[0]))
+
+static int verbose;
+
+static uint32_t reference(void)
+{
+    const keystore_t *k = &otp_keys[current_key_index];
+    uint16_t period = k->otp_period ? k->otp_period : 30;
+
+    return otp_host_reference((const uint8_t *)k->otp_key, k->otp_key_len,
+            k->otp_algorithm, k->otp_digits == 8 ? 8 : 6,
+            (otp_host_now - k->otp_t0) / period);
+}
+
+static int check(const char *when)
+{
+    const struct otp_key *key = &otp_table[current_key_index];
+    uint32_t shown = otp_host_code(key->digits);
+    uint32_t want = reference();
+
+    if (shown == want)
+        return 0;
+    printf("%lu key %c %s: shows %0*lu, want %0*lu\n",
+           (unsigned long)otp_host_now, key->identifier, when,
+           key->digits, (unsigned long)shown,
+           key->digits, (unsigned long)want);
+    return 1;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long rollovers = 0, hits = 0, on_demand = 0;
+    int failures = 0, opt;
+    uint8_t i;
+    int32_t s;
+
+    while ((opt = getopt(argc, argv, "v")) != -1) {
+        if (opt == 'v') {
+            verbose = 1;
+        } else {
+            fprintf(stderr, "usage: %s [-v]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    otp_host_now = START;
+    mod_otp_init();
+    otp_host_menu.activate_fn();
+    failures += check("activated");
+
+    for (i = 0; i < NUM_SCRIPT; i++) {
+        switch (script[i].action) {
+        case KEY_UP:
+            otp_host_menu.up_btn_fn();
+            on_demand++;
+            failures += check("up");
+            break;
+        case KEY_DOWN:
+            otp_host_menu.down_btn_fn();
+            on_demand++;
+            failures += check("down");
+            break;
+        case SET:
+            otp_host_now += script[i].arg;
+            clock_event(SYS_MSG_RTC_SECOND);
+            on_demand++;
+            failures += check("clock set");
+            break;
+        case RUN:
+            for (s = 0; s < script[i].arg; s++) {
+                const struct otp_key *key = &otp_table[current_key_index];
+                uint32_t time;
+
+                otp_host_now++;
+                time = (otp_host_now - key->t0) / key->period;
+                if (time != last_time) {
+                    rollovers++;
+                    if (otp_next[current_key_index].time == time) {
+                        hits++;
+                    } else {
+                        printf("%lu key %c: window %lu not precomputed\n",
+                               (unsigned long)otp_host_now, key->identifier,
+                               (unsigned long)time);
+                        failures++;
+                    }
+                }
+                clock_event(SYS_MSG_RTC_SECOND);
+                failures += check("running");
+            }
+            break;
+        }
+
+        if (verbose)
+            printf("step %2u: key %c at %lu shows %0*lu\n", i,
+                   otp_table[current_key_index].identifier,
+                   (unsigned long)otp_host_now,
+                   otp_table[current_key_index].digits,
+                   (unsigned long)otp_host_code(
+                       otp_table[current_key_index].digits));
+    }
+
+    printf("%lu rollovers, %lu precomputed, %lu changes computed on demand\n",
+           rollovers, hits, on_demand);
+    if (rollovers == 0 || hits != rollovers)
+        failures++;
+
+    printf("%s\n", failures ? "FAIL" : "PASS");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,126 @@
+/*
+ * totp_vectors_test.c
+ *
+ * The test vectors of RFC 6238 appendix B for HMAC-SHA1 and HMAC-SHA256
+ * through modules/otp.c, with keys set up like CONFIG_MOD_OTP_KEYS does.
+ * The RFC lists 8 digit codes with 30 second steps from T0 = 0, the other
+ * keys check the 6 digit, period and T0 settings. Their codes come from
+ * the algorithm of the RFC run with Python's hmac module.
+ *
+ * Each code is checked twice: calculate_otp() on its own, and as the
+ * module shows it on the two display lines. The SHA512 vectors are left
+ * out, the firmware has no SHA512, and so is the time past 2^32.
+ *
+ * Build from the top of the tree, -fcommon lets rtca.h define rtca_time
+ * in both files as on the target:
+ *
+ *   cc -O2 -Wall -fcommon -Icontrib/otp_test -I. -o totp_vectors_test \
+ *      contrib/otp_test/totp_vectors_test.c contrib/otp_test/otp_host.c \
+ *      modules/hashutils.c
+ *
+ * Usage: totp_vectors_test [-v]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "otp_host.h"
+
+#define KEY_SHA1    "12345678901234567890"
+#define KEY_SHA256  "12345678901234567890123456789012"
+
+#define CONFIG_MOD_OTP_OFFSET 0
+#define CONFIG_MOD_OTP_KEYS { \
+    { "1", KEY_SHA1, 20, OTP_ALG_SHA1, 8 }, \
+    { "2", KEY_SHA256, 32, OTP_ALG_SHA256, 8 }, \
+    { "3", KEY_SHA1, 20 }, \
+    { "4", KEY_SHA256, 32, OTP_ALG_SHA256, 6, 30, 0 }, \
+    { "5", KEY_SHA1, 20, OTP_ALG_SHA1, 6, 60, 1000000000 }, \
+    { "6", KEY_SHA256, 32, OTP_ALG_SHA256, 8, 45, 1234 }, \
+}
+
+#include "modules/otp.c"
+
+static const struct {
+    uint8_t key;
+    uint32_t time;
+    const char *code;
+} vector[] = {
+    /* RFC 6238 appendix B */
+    { 0, 59, "94287082" },
+    { 0, 1111111109, "07081804" },
+    { 0, 1111111111, "14050471" },
+    { 0, 1234567890, "89005924" },
+    { 0, 2000000000, "69279037" },
+    { 1, 59, "46119246" },
+    { 1, 1111111109, "68084774" },
+    { 1, 1111111111, "67062674" },
+    { 1, 1234567890, "91819424" },
+    { 1, 2000000000, "90698825" },
+    /* the same with the default and an explicit 6 digits */
+    { 2, 59, "287082" },
+    { 2, 1111111109, "081804" },
+    { 2, 1111111111, "050471" },
+    { 2, 1234567890, "005924" },
+    { 2, 2000000000, "279037" },
+    { 3, 59, "119246" },
+    { 3, 1111111109, "084774" },
+    { 3, 1111111111, "062674" },
+    { 3, 1234567890, "819424" },
+    { 3, 2000000000, "698825" },
+    /* 60 s from T0 = 1000000000 */
+    { 4, 1111111109, "457399" },
+    { 4, 1111111111, "457399" },
+    { 4, 1234567890, "136058" },
+    { 4, 2000000000, "889571" },
+    /* 45 s from T0 = 1234, 8 digits */
+    { 5, 1111111109, "47629390" },
+    { 5, 1111111111, "47629390" },
+    { 5, 1234567890, "03091365" },
+    { 5, 2000000000, "15706258" },
+};
+
+#define NUM_VECTOR (sizeof(vector) / sizeof(vector[0]))
+
+int main(int argc, char **argv)
+{
+    int failures = 0, opt, verbose = 0;
+    uint8_t i;
+
+    while ((opt = getopt(argc, argv, "v")) != -1) {
+        if (opt == 'v') {
+            verbose = 1;
+        } else {
+            fprintf(stderr, "usage: %s [-v]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    mod_otp_init();
+
+    for (i = 0; i < NUM_VECTOR; i++) {
+        const struct otp_key *key = &otp_table[vector[i].key];
+        uint32_t want = strtoul(vector[i].code, NULL, 10);
+        uint32_t calc, shown;
+
+        calc = calculate_otp((vector[i].time - key->t0) / key->period, key);
+
+        otp_host_now = vector[i].time;
+        current_key_index = vector[i].key;
+        otp_host_menu.activate_fn();
+        shown = otp_host_code(key->digits);
+
+        if (verbose || calc != want || shown != want)
+            printf("key %c at %10lu: want %s, calculated %0*lu, shown %0*lu\n",
+                   key->identifier, (unsigned long)vector[i].time,
+                   vector[i].code, key->digits, (unsigned long)calc,
+                   key->digits, (unsigned long)shown);
+        if (calc != want || shown != want)
+            failures++;
+    }
+
+    printf("%u vectors, %d failed\n", (unsigned)NUM_VECTOR, failures);
+    printf("%s\n", failures ? "FAIL" : "PASS");
+    return failures ? 1 : 0;
+}
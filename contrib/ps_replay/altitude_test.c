@@ -0,0 +1,138 @@
+/*
+ * altitude_test.c
+ *
+ * Checks the integer barometric altitude of drivers/vti_ps.c against a
+ * double precision model of the same atmosphere:
+ *
+ *   standard:    h = H0 * (1 - (p / QNH)^a)
+ *   calibrated:  QNH solved from the reference altitude and pressure
+ *   temperature: h = href + R/g * T * ln(pref / p), an isothermal column
+ *
+ * over the whole table range, several reference points and temperatures
+ * from -40 to +40 C. Prints the worst error of each sweep and exits
+ * non-zero if any is 0.5 m or more.
+ *
+ * Build from the top of the tree:
+ *
+ *   cc -O2 -Wall -Icontrib/ps_replay -Idrivers -o altitude_test \
+ *      contrib/ps_replay/altitude_test.c contrib/ps_replay/scp1000.c \
+ *      drivers/vti_ps.c -lm
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "openchronos.h"
+#include "vti_ps.h"
+
+#define H0 44330.77
+#define A 0.190263
+#define P0 101325.0
+#define R_G (A / 0.0065)
+
+#define PMIN 35840
+#define PMAX 121856
+#define LIMIT_M 0.5
+
+static int failures;
+
+static double std_altitude(double p, double qnh)
+{
+    return H0 * (1.0 - pow(p / qnh, A));
+}
+
+static double std_pressure(double h, double qnh)
+{
+    return qnh * pow(1.0 - h / H0, 1.0 / A);
+}
+
+static double sweep(int16_t href, uint32_t pref, uint16_t t_dk, double *worst_p)
+{
+    double qnh = pref / pow(1.0 - href / H0, 1.0 / A);
+    double worst = 0.0;
+    uint32_t p;
+
+    for (p = PMIN; p <= PMAX; p += 7) {
+        double want;
+        double err;
+
+        if (t_dk)
+            want = href + R_G * t_dk / 10.0 * log((double)pref / p);
+        else
+            want = std_altitude(p, qnh);
+
+        /* int16_t in 0.25 m */
+        if (want > 8191.0 || want < -8192.0)
+            continue;
+
+        err = fabs(conv_pa_to_altitude_q2(p, t_dk) / 4.0 - want);
+        if (err > worst) {
+            worst = err;
+            *worst_p = p;
+        }
+    }
+
+    return worst;
+}
+
+static void report(const char *what, double worst, double p)
+{
+    printf("%-40s max %.3f m at %6.0f Pa  %s\n", what, worst, p,
+           worst < LIMIT_M ? "ok" : "FAIL");
+    if (worst >= LIMIT_M)
+        failures++;
+}
+
+int main(void)
+{
+    static const int16_t hrefs[] = { -400, 0, 250, 1000, 2500, 4000 };
+    static const double qnhs[] = { 96000.0, 99000.0, P0, 103500.0, 105000.0 };
+    static const uint16_t temps[] = { 2332, 2632, 2882, 3132 };
+    char what[64];
+    double worst, p = 0;
+    unsigned i, j;
+    struct timespec t0, t1;
+    volatile int16_t sink;
+    uint32_t n;
+
+    init_pressure_table();
+    worst = sweep(0, (uint32_t)P0, 0, &p);
+    report("standard atmosphere", worst, p);
+
+    for (i = 0; i < sizeof(qnhs) / sizeof(qnhs[0]); i++) {
+        for (j = 0; j < sizeof(hrefs) / sizeof(hrefs[0]); j++) {
+            uint32_t pref = (uint32_t)(std_pressure(hrefs[j], qnhs[i]) + 0.5);
+
+            update_pressure_table(hrefs[j], pref, 2882);
+            worst = sweep(hrefs[j], pref, 0, &p);
+            snprintf(what, sizeof(what), "QNH %6.1f hPa, href %5d m",
+                     qnhs[i] / 100.0, hrefs[j]);
+            report(what, worst, p);
+        }
+    }
+
+    for (i = 0; i < sizeof(temps) / sizeof(temps[0]); i++) {
+        for (j = 0; j < sizeof(hrefs) / sizeof(hrefs[0]); j++) {
+            uint32_t pref = (uint32_t)(std_pressure(hrefs[j], P0) + 0.5);
+
+            update_pressure_table(hrefs[j], pref, temps[i]);
+            worst = sweep(hrefs[j], pref, temps[i], &p);
+            snprintf(what, sizeof(what), "T %5.1f C, href %5d m",
+                     temps[i] / 10.0 - 273.2, hrefs[j]);
+            report(what, worst, p);
+        }
+    }
+
+    init_pressure_table();
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (n = 0; n < 1000000; n++)
+        sink = conv_pa_to_altitude_q2(PMIN + (n % (PMAX - PMIN)), 2882);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    (void)sink;
+    printf("host time per conversion: %.1f ns\n",
+           ((t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec)) / n);
+
+    printf("%s\n", failures ? "FAILED" : "all passed");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,213 @@
+/*
+ * barolog_test.c
+ *
+ * Feeds synthetic pressure curves at one reading per 15 minutes through
+ * drivers/barolog.c, four days each so the 48 hour ring wraps twice:
+ *
+ *   steady  101325 Pa with a 12 hour tide of 40 Pa and 8 Pa of noise
+ *   front   a 4 hPa / 3 h fall for 12 hours, then a 3 hPa / 3 h rise
+ *   step    steady, then 600 Pa up at once, more than one delta can hold
+ *
+ * Every reading still in the ring must come back within 1 Pa, apart from
+ * the few after the step while the deltas catch up, and the tendency must
+ * agree with the one of the exact readings unless that change is within
+ * the rounding of the threshold.
+ *
+ * The sample the module takes, ps_start(PS_MODE_TRIGGERED), ps_get_pa()
+ * and ps_stop(), is run over the TWI against the SCP1000 model and its
+ * CPU time estimated from the bus phases and timer ticks as in vario_replay.c.
+ *
+ * Build from the top of the tree:
+ *
+ *   cc -O2 -Wall -Icontrib/ps_replay -Idrivers -o barolog_test \
+ *      contrib/ps_replay/barolog_test.c contrib/ps_replay/scp1000.c \
+ *      drivers/vti_ps.c drivers/barolog.c -lm
+ *
+ * Usage: barolog_test [-s seed] [-v]
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "openchronos.h"
+#include "vti_ps.h"
+#include "barolog.h"
+#include "scp1000.h"
+
+#define SAMPLES         (4 * 24 * 4)
+#define STEP_AT         (200)
+#define STEP_PA         (600)
+
+/* Readings after the step that may still lag */
+#define STEP_SETTLE     (3)
+
+/* MSP430 at 12 MHz, see vario_replay.c */
+#define PS_PHASE_CYCLES (PS_TWI_DELAY + 13)
+#define PS_TICK_CYCLES  50
+#define ADD_CYCLES      150
+#define CPU_MHZ         12
+#define ACTIVE_US_MAX   3000
+
+static unsigned long rng = 1;
+static int verbose;
+
+static double noise(double amp)
+{
+    rng = rng * 1103515245ul + 12345ul;
+    return amp * (((rng >> 16) & 0x7fff) / 16383.5 - 1.0);
+}
+
+static double steady(int i)
+{
+    return 101325 + 40 * sin(2 * M_PI * i / 48.0) + noise(8);
+}
+
+static double front(int i)
+{
+    /* 48 readings down, then up */
+    if (i < 48)
+        return 101800 - 400.0 / 12 * i + noise(8);
+    return 100200 + 300.0 / 12 * (i - 48) + noise(8);
+}
+
+static double step(int i)
+{
+    return 101325 + (i >= STEP_AT ? STEP_PA : 0) + noise(8);
+}
+
+static enum barolog_trend exact_trend(double d)
+{
+    if (d >= BAROLOG_STEADY_PA)
+        return BAROLOG_RISING;
+    if (d <= -BAROLOG_STEADY_PA)
+        return BAROLOG_FALLING;
+    return BAROLOG_STEADY;
+}
+
+static int run(const char *name, double (*curve)(int), int has_step)
+{
+    static const char *trend_name[] = { "----", "STDY", "RISE", "FALL" };
+    struct barolog l;
+    uint32_t pa[SAMPLES];
+    double max_err = 0;
+    int i, ago, mismatches = 0, failures = 0;
+    int counts[4] = { 0 };
+
+    barolog_init(&l);
+
+    for (i = 0; i < SAMPLES; i++) {
+        enum barolog_trend t;
+
+        pa[i] = (uint32_t)lround(curve(i));
+        barolog_add(&l, pa[i]);
+
+        t = barolog_trend(&l);
+        counts[t]++;
+
+        if (i >= BAROLOG_TREND_SLOTS) {
+            double d = (double)pa[i] - pa[i - BAROLOG_TREND_SLOTS];
+            int settled = !has_step || i < STEP_AT ||
+                          i >= STEP_AT + BAROLOG_TREND_SLOTS + STEP_SETTLE;
+
+            /* the stored readings are rounded to BAROLOG_UNIT */
+            if (t != exact_trend(d) && settled &&
+                fabs(fabs(d) - BAROLOG_STEADY_PA) > BAROLOG_UNIT)
+                mismatches++;
+        } else if (t != BAROLOG_UNKNOWN) {
+            mismatches++;
+        }
+
+        if (verbose)
+            printf("%s %4d %6u %6u %5d %s\n", name, i, pa[i],
+                   barolog_pa(&l, 0), barolog_change(&l), trend_name[t]);
+    }
+
+    for (ago = 0; ago < BAROLOG_SLOTS; ago++) {
+        int j = SAMPLES - 1 - ago;
+        double err = fabs((double)barolog_pa(&l, ago) - pa[j]);
+
+        if (has_step && j >= STEP_AT && j < STEP_AT + STEP_SETTLE)
+            continue;
+        if (err > max_err)
+            max_err = err;
+    }
+
+    printf("%-8s steady %3d rising %3d falling %3d unknown %2d\n", name,
+           counts[BAROLOG_STEADY], counts[BAROLOG_RISING],
+           counts[BAROLOG_FALLING], counts[BAROLOG_UNKNOWN]);
+
+    printf("%-8s readings held %u, oldest %u Pa        %s\n", name,
+           l.count, barolog_pa(&l, BAROLOG_SLOTS - 1),
+           l.count == BAROLOG_SLOTS && barolog_pa(&l, BAROLOG_SLOTS) == 0
+           ? "ok" : "FAIL");
+    failures += l.count != BAROLOG_SLOTS || barolog_pa(&l, BAROLOG_SLOTS) != 0;
+
+    printf("%-8s reconstruction max %.0f Pa          %s\n", name, max_err,
+           max_err <= 1 ? "ok" : "FAIL");
+    failures += max_err > 1;
+
+    printf("%-8s tendency mismatches %d              %s\n", name, mismatches,
+           mismatches == 0 ? "ok" : "FAIL");
+    failures += mismatches != 0;
+
+    return failures;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long ticks, phases;
+    unsigned long us;
+    int opt, failures = 0;
+
+    while ((opt = getopt(argc, argv, "s:v")) != -1) {
+        switch (opt) {
+        case 's':
+            rng = strtoul(optarg, NULL, 0) * 2 + 1;
+            break;
+        case 'v':
+            verbose = 1;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-s seed] [-v]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    failures += run("steady", steady, 0);
+    failures += run("front", front, 0);
+    failures += run("step", step, 1);
+
+    printf("ring size                %u bytes\n",
+           (unsigned)sizeof(struct barolog));
+
+    scp1000_init();
+    ps_init();
+    if (!ps_ok) {
+        fprintf(stderr, "pressure sensor model not found\n");
+        return 2;
+    }
+
+    /* one sample of the module, DRDY in between is not bus time */
+    scp1000.pa = 101325;
+    ticks = scp1000.ticks;
+    phases = scp1000.phases;
+    ps_start(PS_MODE_TRIGGERED);
+    if (ps_get_pa() != 101325)
+        failures++;
+    ps_stop();
+    ticks = scp1000.ticks - ticks;
+    phases = scp1000.phases - phases;
+    us = (ticks * PS_TICK_CYCLES + phases * PS_PHASE_CYCLES + ADD_CYCLES)
+         / CPU_MHZ;
+
+    printf("sample                   %lu phases, %lu ticks, %lu us CPU (est.)  %s\n",
+           phases, ticks, us, us <= ACTIVE_US_MAX && ps_mode == 0
+           ? "ok" : "FAIL");
+    failures += us > ACTIVE_US_MAX || ps_mode != 0;
+
+    printf("%s\n", failures ? "FAILED" : "all passed");
+
+    return failures != 0;
+}
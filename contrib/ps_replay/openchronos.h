@@ -0,0 +1,46 @@
+/*
+ * openchronos.h
+ *
+ * Host stand-in for the firmware main header, so drivers/vti_ps.c builds
+ * with the native compiler. The pressure sensor port and Timer0 registers
+ * are plain variables, PJIN is the wired-AND of the watch and the simulated
+ * sensor from scp1000.c. It is found before the real header through -I.
+ */
+
+#ifndef __OPENCHRONOS_H__
+#define __OPENCHRONOS_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define BIT0 (0x0001)
+#define BIT1 (0x0002)
+#define BIT2 (0x0004)
+#define BIT3 (0x0008)
+#define BIT4 (0x0010)
+#define BIT5 (0x0020)
+#define BIT6 (0x0040)
+#define BIT7 (0x0080)
+
+#define GIE         (0x0008)
+#define LPM3_bits   (0x00f0)
+#define CCIE        (0x0010)
+
+extern uint8_t PJOUT, PJDIR, PJREN;
+extern uint8_t P2IN, P2OUT, P2DIR, P2IE, P2IES, P2IFG;
+extern uint16_t TA0R, TA0CCR1, TA0CCTL1;
+
+/* Reading the port input lets the simulated sensor see the bus first */
+extern uint8_t scp1000_pjin(void);
+#define PJIN (scp1000_pjin())
+
+/* Sleeping runs the timer interrupt until it asks for a wake up */
+extern void scp1000_sleep(void);
+extern void scp1000_delay(unsigned long cycles);
+#define _BIS_SR(x)                  scp1000_sleep()
+#define __delay_cycles(x)           scp1000_delay(x)
+#define __get_SR_register()         (0)
+#define __disable_interrupt()
+#define __set_interrupt_state(x)    ((void)(x))
+
+#endif /* __OPENCHRONOS_H__ */
@@ -0,0 +1,138 @@
+/*
+ * ps_twi_test.c
+ *
+ * Runs the TWI master of drivers/vti_ps.c against the SCP1000 model in
+ * scp1000.c: sensor detection, register reads and writes through the
+ * blocking calls, a background ps_get_pa_async(), and a missing sensor.
+ * Prints the bus phases and timer interrupts of each transaction and exits
+ * non-zero on a failure. The blocking calls must not take any interrupt,
+ * the background read one per byte or bus condition.
+ *
+ * Build from the top of the tree:
+ *
+ *   cc -O2 -Wall -Icontrib/ps_replay -Idrivers -o ps_twi_test \
+ *      contrib/ps_replay/ps_twi_test.c contrib/ps_replay/scp1000.c \
+ *      drivers/vti_ps.c
+ */
+
+#include <stdio.h>
+
+#include "openchronos.h"
+#include "vti_ps.h"
+#include "scp1000.h"
+
+/* TA0 runs at 16384 Hz */
+#define TICK_US 61
+
+/* START, address, register, RESTART, address, MSB, STOP, then START,
+   address, register, RESTART, address, two bytes and STOP */
+#define PA_ASYNC_TICKS  15
+
+extern uint16_t ps_read_register(uint8_t address, uint8_t mode);
+extern uint8_t ps_write_register(uint8_t address, uint8_t data);
+
+static int failures;
+
+static volatile uint8_t pa_done;
+static uint32_t pa_value;
+
+static void check(int cond, const char *what)
+{
+    printf("%-44s %s\n", what, cond ? "ok" : "FAIL");
+    if (!cond)
+        failures++;
+}
+
+static unsigned long start_ticks, start_phases;
+
+static void start(void)
+{
+    start_ticks = scp1000.ticks;
+    start_phases = scp1000.phases;
+}
+
+/* Interrupts taken since start() */
+static unsigned long report(const char *what)
+{
+    unsigned long ticks = scp1000.ticks - start_ticks;
+
+    printf("%-44s %lu phases, %lu interrupts, %lu us\n", what,
+           scp1000.phases - start_phases, ticks, ticks * TICK_US);
+    return ticks;
+}
+
+static void pa_ready(uint32_t pa)
+{
+    pa_value = pa;
+    pa_done = 1;
+}
+
+int main(void)
+{
+
+    scp1000_init();
+
+    start();
+    ps_init();
+    check(ps_ok == 1, "ps_init() finds the sensor");
+    check(report("  reset, status and EEPROM check") == 0, "  no interrupt");
+
+    start();
+    ps_start(PS_MODE_ULTRA_LOW_POWER);
+    check(scp1000.operation == 0x0B, "ps_start() writes OPERATION");
+    report("  one register write");
+
+    start();
+    check(ps_read_register(0x07, PS_TWI_8BIT_ACCESS) == 0x20, "8 bit read of STATUS");
+    report("  one 8 bit read");
+
+    scp1000.pa = 101325;
+    start();
+    check(ps_get_pa() == 101325, "ps_get_pa() at 101325 Pa");
+    check(report("  ps_get_pa()") == 0, "  no interrupt");
+
+    scp1000.pa = 30001;
+    check(ps_get_pa() == 30001, "ps_get_pa() at 30001 Pa");
+    scp1000.pa = 119999;
+    check(ps_get_pa() == 119999, "ps_get_pa() at 119999 Pa");
+
+    scp1000.temp = 215;
+    check(ps_get_temp() == 2947, "ps_get_temp() at 21.5 C");
+    scp1000.temp = -123;
+    check(ps_get_temp() == 2609, "ps_get_temp() at -12.3 C");
+
+    /* Register address equal to an opcode value must not confuse the program */
+    check(ps_write_register(0x03, 0x00) == 1, "write of register 0x03");
+    check(scp1000.operation == 0x00, "  OPERATION is 0x00");
+
+    scp1000.pa = 95000;
+    pa_done = 0;
+    start();
+    check(ps_get_pa_async(&pa_ready) == 1, "ps_get_pa_async() starts");
+    check(ps_get_pa_async(&pa_ready) == 0, "  second start while busy is refused");
+    scp1000_run(&pa_done);
+    check(pa_done && pa_value == 95000, "  callback with 95000 Pa");
+    check(report("  ps_get_pa_async()") == PA_ASYNC_TICKS,
+          "  one interrupt per byte or condition");
+
+    /* a blocking read waits for the background one to finish first */
+    pa_done = 0;
+    ps_get_pa_async(&pa_ready);
+    check(ps_read_register(0x07, PS_TWI_8BIT_ACCESS) == 0x20 && pa_done
+          && pa_value == 95000, "blocking read behind a background one");
+
+    scp1000.present = 0;
+    check(ps_read_register(0x07, PS_TWI_8BIT_ACCESS) == 0, "read from a missing sensor gives 0");
+    check(ps_write_register(0x03, 0x0B) == 0, "write to a missing sensor fails");
+    pa_done = 0;
+    ps_get_pa_async(&pa_ready);
+    scp1000_run(&pa_done);
+    check(pa_done && pa_value == 0, "  async pressure read gives 0");
+    scp1000.present = 1;
+    check(ps_get_pa() == 95000, "bus recovers once the sensor answers");
+
+    check(scp1000_idle(), "bus idle at the end");
+    check(scp1000.errors == 0, "no SDA change on a rising SCL");
+
+    return failures != 0;
+}
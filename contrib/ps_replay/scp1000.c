@@ -0,0 +1,286 @@
+/*
+ * scp1000.c
+ *
+ * Bit level TWI slave model of the VTI SCP1000-D11, driven by the port
+ * registers that drivers/vti_ps.c writes. scp1000_bus() is called after
+ * every bus phase, every timer tick and before every read of PJIN, and
+ * follows the lines:
+ * START and STOP while SCL is high, data sampled on the rising edge of SCL,
+ * the slave's own SDA changed on the falling edge. SDA changing together
+ * with a rising SCL is counted as a protocol error.
+ *
+ * Registers: OPERATION (0x03) and RSTR (0x06) for writes, STATUS (0x07),
+ * DATARD8 (0x7F), DATARD16 (0x80) and TEMPOUT (0x81) for reads. Like the
+ * real part, the last byte of a write is not acknowledged.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "openchronos.h"
+#include "vti_ps.h"
+#include "scp1000.h"
+
+uint8_t PJOUT, PJDIR, PJREN;
+uint8_t P2IN, P2OUT, P2DIR, P2IE, P2IES, P2IFG;
+uint16_t TA0R, TA0CCR1, TA0CCTL1;
+
+struct scp1000 scp1000;
+
+enum { S_IDLE, S_RX, S_RX_ACK, S_TX, S_TX_ACK };
+
+static uint8_t state;
+static uint8_t bit;
+static uint8_t shift;
+static uint8_t first;       // next byte received is the device address
+static uint8_t reading;
+static uint8_t reg;
+static uint8_t reg_set;
+static uint8_t master_ack;
+static uint8_t tx[2];
+static uint8_t tx_len, tx_pos;
+static uint8_t slave_sda = 1;
+static uint8_t scl = 1, sda = 1;
+
+void scp1000_init(void)
+{
+    scp1000.present = 1;
+    scp1000.pa = 101325;
+    scp1000.temp = 215;
+    scp1000.operation = 0;
+    scp1000.reset = 0;
+    scp1000.errors = 0;
+    scp1000.ticks = 0;
+    scp1000.phases = 0;
+
+    state = S_IDLE;
+    slave_sda = 1;
+    PJOUT = PS_SCL_PIN | PS_SDA_PIN;
+    PJDIR = PS_SCL_PIN | PS_SDA_PIN;
+    scl = 1;
+    sda = 1;
+}
+
+/* Line levels with pull-ups, the watch drives only when the pin is an output */
+static uint8_t line(uint8_t pin)
+{
+    if (!(PJDIR & pin))
+        return 1;
+    return (PJOUT & pin) != 0;
+}
+
+static void load_tx(void)
+{
+    uint32_t raw = scp1000.pa * 4;
+    uint16_t t = (uint16_t)(scp1000.temp * 2) & 0x3fff;
+
+    tx_pos = 0;
+    tx_len = 1;
+
+    switch (reg) {
+    case 0x07:
+        tx[0] = 0x20;               // startup done, bit 0 clear
+        break;
+    case 0x7F:
+        tx[0] = scp1000.reset ? 0x01 : (raw >> 16) & 0x07;
+        break;
+    case 0x80:
+        tx[0] = raw >> 8;
+        tx[1] = raw;
+        tx_len = 2;
+        break;
+    case 0x81:
+        tx[0] = t >> 8;
+        tx[1] = t;
+        tx_len = 2;
+        break;
+    default:
+        tx[0] = 0;
+    }
+}
+
+/* A byte came in, returns 1 to acknowledge it */
+static uint8_t rx_byte(uint8_t b)
+{
+    if (first) {
+        first = 0;
+        if (!scp1000.present || (b >> 1) != 0x11)
+            return 0;
+        reading = b & 1;
+        if (reading)
+            load_tx();
+        return 1;
+    }
+
+    if (!reg_set) {
+        reg = b;
+        reg_set = 1;
+        return 1;
+    }
+
+    if (reg == 0x03) {
+        scp1000.operation = b;
+        scp1000.reset = 0;
+    } else if (reg == 0x06 && (b & 1)) {
+        scp1000.reset = 1;
+    }
+
+    return 0;
+}
+
+static uint8_t tx_bit(void)
+{
+    uint8_t b = tx_pos < tx_len ? tx[tx_pos] : 0xff;
+
+    return (b >> (7 - bit)) & 1;
+}
+
+static void scl_rise(uint8_t level)
+{
+    switch (state) {
+    case S_RX:
+        shift = (shift << 1) | level;
+        bit++;
+        break;
+    case S_TX:
+        bit++;
+        break;
+    case S_TX_ACK:
+        master_ack = !level;
+        break;
+    }
+}
+
+static void scl_fall(void)
+{
+    switch (state) {
+    case S_RX:
+        if (bit < 8)
+            break;
+        if (rx_byte(shift)) {
+            slave_sda = 0;
+            state = S_RX_ACK;
+        } else {
+            state = S_IDLE;
+        }
+        break;
+
+    case S_RX_ACK:
+        slave_sda = 1;
+        bit = 0;
+        shift = 0;
+        if (reading) {
+            state = S_TX;
+            slave_sda = tx_bit();
+        } else {
+            state = S_RX;
+        }
+        break;
+
+    case S_TX:
+        if (bit < 8) {
+            slave_sda = tx_bit();
+        } else {
+            slave_sda = 1;
+            state = S_TX_ACK;
+        }
+        break;
+
+    case S_TX_ACK:
+        if (master_ack) {
+            tx_pos++;
+            bit = 0;
+            state = S_TX;
+            slave_sda = tx_bit();
+        } else {
+            state = S_IDLE;
+        }
+        break;
+    }
+}
+
+void scp1000_bus(void)
+{
+    uint8_t new_scl = line(PS_SCL_PIN);
+    uint8_t master_sda = line(PS_SDA_PIN);
+    uint8_t new_sda;
+
+    if (new_scl != scl) {
+        scl = new_scl;
+        if (scl) {
+            if ((master_sda && slave_sda) != sda)
+                scp1000.errors++;
+            scl_rise(master_sda && slave_sda);
+        } else {
+            scl_fall();
+        }
+        sda = master_sda && slave_sda;
+        return;
+    }
+
+    new_sda = master_sda && slave_sda;
+    if (new_sda == sda)
+        return;
+    sda = new_sda;
+
+    if (!scl)
+        return;
+
+    if (!sda) {
+        // START or repeated START
+        state = S_RX;
+        bit = 0;
+        shift = 0;
+        first = 1;
+    } else {
+        // STOP
+        state = S_IDLE;
+        reg_set = 0;
+    }
+    reading = 0;
+}
+
+uint8_t scp1000_pjin(void)
+{
+    scp1000_bus();
+    return (scl ? PS_SCL_PIN : 0) | (sda ? PS_SDA_PIN : 0);
+}
+
+/* The delay between two bus phases */
+void scp1000_delay(unsigned long cycles)
+{
+    scp1000.phases++;
+    scp1000_bus();
+}
+
+uint8_t scp1000_idle(void)
+{
+    return state == S_IDLE && scl && sda;
+}
+
+/* The timer interrupt, while the CPU sleeps */
+void scp1000_sleep(void)
+{
+    for (;;) {
+        if (!(TA0CCTL1 & CCIE)) {
+            fprintf(stderr, "scp1000: sleeping with no timer running\n");
+            exit(1);
+        }
+        scp1000.ticks++;
+        if (ps_twi_tick()) {
+            scp1000_bus();
+            return;
+        }
+        scp1000_bus();
+    }
+}
+
+/* Tick until a background transaction has set *done */
+void scp1000_run(volatile uint8_t *done)
+{
+    while (!*done && (TA0CCTL1 & CCIE)) {
+        scp1000.ticks++;
+        ps_twi_tick();
+        scp1000_bus();
+    }
+}
@@ -0,0 +1,30 @@
+/*
+ * scp1000.h
+ *
+ * Bit level TWI slave model of the VTI SCP1000-D11 for host tests.
+ */
+
+#ifndef SCP1000_H_
+#define SCP1000_H_
+
+#include <stdint.h>
+
+struct scp1000 {
+    uint8_t present;        // ACK the device address
+    uint32_t pa;            // pressure in Pa
+    int16_t temp;           // temperature in 0.1 degC
+    uint8_t operation;      // last write to OPERATION (0x03)
+    uint8_t reset;          // RSTR written since the last OPERATION
+    unsigned long errors;   // protocol violations seen on the bus
+    unsigned long ticks;    // timer ticks run through scp1000_sleep() / scp1000_run()
+    unsigned long phases;   // bus phases clocked out, by the timer or at once
+};
+
+extern struct scp1000 scp1000;
+
+extern void scp1000_init(void);
+extern void scp1000_bus(void);
+extern uint8_t scp1000_idle(void);
+extern void scp1000_run(volatile uint8_t *done);
+
+#endif /* SCP1000_H_ */
@@ -0,0 +1,390 @@
+/*
+ * vario_replay.c
+ *
+ * Replay a pressure trace through the altimeter pipeline of
+ * modules/altimeter.c on the host: ps_get_pa() and ps_get_temp() over the
+ * timer driven TWI against the SCP1000 model, conv_pa_to_altitude_q2() and
+ * the vario.c Kalman filter. The same trace also goes through a double
+ * precision reference, the exact isothermal altitude and a Kalman filter
+ * that carries its covariance, and the report gives the largest difference
+ * between the two once the reference has settled.
+ *
+ * Input is one sample per line at the VARIO_RATE_HZ of the sensor's high
+ * speed mode: "pa", "t_ms,pa" or "t_ms,pa,temp_c". Pressures below 2000 are
+ * taken as hPa. Time stamped traces are resampled to the filter rate by
+ * holding the last sample. Without a file a synthetic flight is generated:
+ * one minute on the ground, then 2 m/s of climb, a glide, a 4 m/s sink and
+ * a landing, in an isothermal 15 C atmosphere with 4 Pa of sensor noise.
+ * For that one the report also has the error against the true climb rate.
+ *
+ * The per-sample cost is given in MSP430 cycles, estimated: the TWI bus
+ * phases and timer ticks are counted by the SCP1000 model and cost
+ * PS_PHASE_CYCLES and PS_TICK_CYCLES, the arithmetic of the conversion and
+ * the filter is counted as below. It is checked against REPLAY_BUDGET.
+ *
+ * Build from the top of the tree:
+ *
+ *   cc -O2 -Wall -Icontrib/ps_replay -Idrivers -o vario_replay \
+ *      contrib/ps_replay/vario_replay.c contrib/ps_replay/scp1000.c \
+ *      drivers/vti_ps.c drivers/vario.c -lm
+ *
+ * Usage: vario_replay [-s seed] [-v] [trace.csv]
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "openchronos.h"
+#include "vti_ps.h"
+#include "vario.h"
+#include "scp1000.h"
+
+#define H0      44330.77
+#define A       0.190263
+#define P0      101325.0
+#define R_G     (A / 0.0065)
+
+/* Same as drivers/vario.c */
+#define KF_SA   0.5
+#define KF_SZ   0.5
+#define KF_SV0  2.0
+
+/*
+ * MSP430 cycle estimates at 12 MHz: one bus phase of vti_ps.c with its
+ * PS_TWI_DELAY, one TA0CCR1 interrupt of ps_twi_tick() with entry and exit,
+ * a 32 by 32 bit software division, a 16 by 16 bit multiply on the MPY32
+ * and the rest of a call.
+ */
+#define PS_PHASE_CYCLES (PS_TWI_DELAY + 13)
+#define PS_TICK_CYCLES  50
+#define DIV_CYCLES      450
+#define MUL_CYCLES      12
+#define CALL_CYCLES     100
+
+/* conv_pa_to_altitude_q2(): 1 division and 7 multiplies with a temperature */
+#define CONV_CYCLES     (DIV_CYCLES + 7 * MUL_CYCLES + CALL_CYCLES)
+/* vario_update(): 3 multiplies */
+#define UPDATE_CYCLES   (3 * MUL_CYCLES + CALL_CYCLES)
+
+/* 2 ms of CPU per sample at 12 MHz, under 2% at 9 Hz */
+#define REPLAY_BUDGET   24000
+
+/*
+ * Reference filter settling time, and the limits after that. The 0.25 m
+ * steps of conv_pa_to_altitude_q2() are most of the climb rate difference.
+ */
+#define SETTLE_S        10
+#define LIMIT_H         0.30        // m
+#define LIMIT_V         15.0        // cm/s
+
+#define REPLAY_MAX      (1L << 22)
+
+struct sample {
+    double pa;
+    double temp_c;
+};
+
+struct kalman {
+    double h, v;
+    double p00, p01, p11;
+    int valid;
+};
+
+static int verbose;
+static unsigned long rng = 1;
+
+/* Exact altitude of the same isothermal column that conv_pa_to_altitude_q2() corrects for */
+static double ref_altitude(double pa, double temp_c)
+{
+    return R_G * (temp_c + 273.15) * log(P0 / pa);
+}
+
+static void kalman_update(struct kalman *k, double z)
+{
+    const double dt = 1.0 / VARIO_RATE_HZ;
+    const double q = KF_SA * KF_SA;
+    const double r = KF_SZ * KF_SZ;
+    double s, k0, k1, p00, p01, p11, e;
+
+    if (!k->valid) {
+        k->h = z;
+        k->v = 0;
+        k->p00 = r;
+        k->p01 = 0;
+        k->p11 = KF_SV0 * KF_SV0;
+        k->valid = 1;
+        return;
+    }
+
+    k->h += k->v * dt;
+    p00 = k->p00 + 2 * dt * k->p01 + dt * dt * k->p11 + q * dt * dt * dt * dt / 4;
+    p01 = k->p01 + dt * k->p11 + q * dt * dt * dt / 2;
+    p11 = k->p11 + q * dt * dt;
+
+    s = p00 + r;
+    k0 = p00 / s;
+    k1 = p01 / s;
+    e = z - k->h;
+    k->h += k0 * e;
+    k->v += k1 * e;
+
+    k->p00 = (1 - k0) * p00;
+    k->p01 = (1 - k0) * p01;
+    k->p11 = p11 - k1 * p01;
+}
+
+static double gauss(void)
+{
+    double u1, u2;
+
+    /* xorshift, Box-Muller */
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    u1 = ((rng >> 11) + 1.0) / 9007199254740993.0;
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    u2 = (rng >> 11) / 9007199254740992.0;
+
+    return sqrt(-2 * log(u1)) * cos(2 * M_PI * u2);
+}
+
+static double flight_climb(double t)
+{
+    if (t < 60)
+        return 0;
+    if (t < 180)
+        return 2.0;
+    if (t < 300)
+        return -1.0;
+    if (t < 360)
+        return -4.0;
+    return 0;
+}
+
+static long synth(struct sample *s, double *truth_v)
+{
+    const long n = 420 * VARIO_RATE_HZ;
+    double h = 1000.0;
+    long i;
+
+    for (i = 0; i < n; i++) {
+        double t = (double)i / VARIO_RATE_HZ;
+
+        truth_v[i] = flight_climb(t);
+        s[i].temp_c = 15.0;
+        s[i].pa = P0 * exp(-h / (R_G * (s[i].temp_c + 273.15))) + 4.0 * gauss();
+        h += truth_v[i] / VARIO_RATE_HZ;
+    }
+
+    return n;
+}
+
+static long load(FILE *f, struct sample *s)
+{
+    char line[256];
+    long n = 0;
+    double t_next = 0, last_t = -1;
+    struct sample last = { 0, 15.0 };
+
+    while (fgets(line, sizeof(line), f) && n < REPLAY_MAX) {
+        double v[3];
+        int k = 0;
+        char *p = line, *end;
+
+        while (k < 3) {
+            v[k] = strtod(p, &end);
+            if (end == p) {
+                if (!*p || *p == '\n')
+                    break;
+                p++;
+                continue;
+            }
+            k++;
+            p = end;
+        }
+
+        if (k == 0)
+            continue;
+
+        if (k == 1) {
+            last.pa = v[0] < 2000 ? v[0] * 100 : v[0];
+            s[n++] = last;
+            continue;
+        }
+
+        /* hold the previous sample up to this time stamp */
+        if (last_t >= 0) {
+            while (t_next < v[0] && n < REPLAY_MAX) {
+                s[n++] = last;
+                t_next += 1000.0 / VARIO_RATE_HZ;
+            }
+        } else {
+            t_next = v[0];
+        }
+        last_t = v[0];
+        last.pa = v[1] < 2000 ? v[1] * 100 : v[1];
+        if (k == 3)
+            last.temp_c = v[2];
+    }
+
+    if (last_t >= 0 && n < REPLAY_MAX)
+        s[n++] = last;
+
+    return n;
+}
+
+int main(int argc, char **argv)
+{
+    struct sample *s;
+    double *truth_v = NULL;
+    struct vario fix;
+    struct kalman ref = { 0 };
+    long n, i;
+    int opt, failures = 0;
+    double max_h = 0, max_v = 0, sum_v2 = 0, sum_t2 = 0;
+    long compared = 0;
+    unsigned long ticks, phases, twi, twi_max = 0, twi_total = 0;
+    uint16_t temp = 0;
+    double host_ns = 0;
+    struct timespec t0, t1;
+
+    while ((opt = getopt(argc, argv, "s:v")) != -1) {
+        switch (opt) {
+        case 's':
+            rng = strtoul(optarg, NULL, 0) * 2 + 1;
+            break;
+        case 'v':
+            verbose = 1;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-s seed] [-v] [trace.csv]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    s = malloc(REPLAY_MAX * sizeof(*s));
+    if (!s)
+        return 2;
+
+    if (optind < argc) {
+        FILE *f = fopen(argv[optind], "r");
+
+        if (!f) {
+            perror(argv[optind]);
+            return 2;
+        }
+        n = load(f, s);
+        fclose(f);
+    } else {
+        truth_v = malloc(REPLAY_MAX * sizeof(*truth_v));
+        if (!truth_v)
+            return 2;
+        n = synth(s, truth_v);
+    }
+
+    scp1000_init();
+    ps_init();
+    if (!ps_ok) {
+        fprintf(stderr, "pressure sensor model not found\n");
+        return 2;
+    }
+    ps_start(PS_MODE_HIGH_SPEED);
+    init_pressure_table();
+    vario_init(&fix);
+
+    for (i = 0; i < n; i++) {
+        uint32_t pa;
+        int16_t alt;
+        double t = (double)i / VARIO_RATE_HZ;
+
+        scp1000.pa = (uint32_t)(s[i].pa + 0.5);
+        scp1000.temp = (int16_t)lround(s[i].temp_c * 10);
+
+        /* the module's DRDY handler: temperature once a second, then the pressure */
+        ticks = scp1000.ticks;
+        phases = scp1000.phases;
+        if (i % VARIO_RATE_HZ == 0)
+            temp = ps_get_temp();
+        pa = ps_get_pa();
+        twi = (scp1000.ticks - ticks) * PS_TICK_CYCLES
+              + (scp1000.phases - phases) * PS_PHASE_CYCLES;
+
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        alt = conv_pa_to_altitude_q2(pa, temp);
+        vario_update(&fix, alt);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        host_ns += (t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec);
+
+        twi_total += twi;
+        if (twi > twi_max)
+            twi_max = twi;
+
+        kalman_update(&ref, ref_altitude(pa, temp / 10.0 - 273.15));
+
+        if (verbose)
+            printf("%8.3f %9u %8.2f %8.2f %6d %8.2f %6.0f\n", t, pa,
+                   alt / 4.0, ref.h, vario_altitude(&fix), ref.v * 100,
+                   (double)vario_climb(&fix));
+
+        if (t >= SETTLE_S) {
+            double dh = fabs(fix.h / 256.0 - ref.h);
+            double dv = fabs(fix.v / 2.56 - ref.v * 100);
+
+            if (dh > max_h)
+                max_h = dh;
+            if (dv > max_v)
+                max_v = dv;
+            if (truth_v) {
+                sum_v2 += pow(fix.v / 256.0 - truth_v[i], 2);
+                sum_t2 += pow(ref.v - truth_v[i], 2);
+            }
+            compared++;
+        }
+    }
+
+    printf("samples:                  %ld at %u Hz\n", n, VARIO_RATE_HZ);
+    if (!compared) {
+        printf("trace too short to compare\n");
+        return 1;
+    }
+
+    printf("altitude vs reference:    max %.3f m      %s\n", max_h,
+           max_h <= LIMIT_H ? "ok" : "FAIL");
+    failures += max_h > LIMIT_H;
+    printf("climb rate vs reference:  max %.2f cm/s   %s\n", max_v,
+           max_v <= LIMIT_V ? "ok" : "FAIL");
+    failures += max_v > LIMIT_V;
+
+    if (truth_v) {
+        double rms = 100 * sqrt(sum_v2 / compared);
+        double rms_ref = 100 * sqrt(sum_t2 / compared);
+
+        printf("climb rate vs truth:      rms %.2f cm/s, reference %.2f  %s\n",
+               rms, rms_ref, rms <= 1.05 * rms_ref ? "ok" : "FAIL");
+        failures += rms > 1.05 * rms_ref;
+    }
+
+    {
+        unsigned long avg = twi_total / n + CONV_CYCLES + UPDATE_CYCLES;
+        unsigned long worst = twi_max + CONV_CYCLES + UPDATE_CYCLES;
+
+        printf("TWI per sample (est.):    %lu cycles avg, %lu max\n",
+               twi_total / n, twi_max);
+        printf("cycles per sample (est.): %lu avg, %lu max, budget %u  %s\n",
+               avg, worst, REPLAY_BUDGET,
+               worst <= REPLAY_BUDGET ? "ok" : "FAIL");
+        failures += worst > REPLAY_BUDGET;
+    }
+
+    printf("host time per sample:     %.0f ns conversion and filter\n",
+           host_ns / n);
+    printf("%s\n", failures ? "FAILED" : "all passed");
+
+    return failures != 0;
+}
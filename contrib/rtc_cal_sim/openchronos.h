@@ -0,0 +1,29 @@
+/*
+ * openchronos.h
+ *
+ * Host stand-in for the firmware main header, so drivers/rtc_cal.c builds
+ * with the native compiler. RTCCTL2, the temperature sensor and rtca_time
+ * are provided by the simulation. It is found before the real header
+ * through -I.
+ */
+
+#ifndef __OPENCHRONOS_H__
+#define __OPENCHRONOS_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define BIT0 (0x0001)
+#define BIT1 (0x0002)
+#define BIT2 (0x0004)
+#define BIT3 (0x0008)
+#define BIT4 (0x0010)
+#define BIT5 (0x0020)
+#define BIT6 (0x0040)
+#define BIT7 (0x0080)
+
+#define RTCCALS (0x80)
+
+extern uint8_t RTCCTL2;
+
+#endif /* __OPENCHRONOS_H__ */
@@ -0,0 +1,229 @@
+/*
+ * rtc_cal_sim.c
+ *
+ * Runs the RTCCAL temperature compensation of drivers/rtc_cal.c over 30
+ * days of a simulated watch, one rtc_cal_minute() call per minute like
+ * handle_events(), and adds up how far the clock drifts with and without
+ * it.
+ *
+ * The watch is worn from 07:00 to 23:00 at 31 C and lies at 21 C at
+ * night. It spends half an hour outside every morning and evening, and
+ * four hours every weekend day. The outside temperature swings from 12 C
+ * down to -8 C in a cold spell in the third week. The watch follows with
+ * a 10 minute lag. The sensor reads it with 0.3 C of noise.
+ *
+ * Two crystals are run:
+ * - "nominal" matches the config, so the compensation should cancel
+ *   nearly all of the drift.
+ * - "spread" has the datasheet tolerances the config cannot know: the
+ *   turnover is 2 C higher, the curve is 10% steeper, and the sensor
+ *   reads 1 C high. The compensation should still remove most of the
+ *   drift.
+ *
+ * Build from the top of the tree. The defines are the default config,
+ * and -fcommon lets rtc_cal.h define rtc_cal_info in both files as on
+ * the target:
+ *
+ *   cc -O2 -Wall -fcommon -Icontrib/rtc_cal_sim -Idrivers \
+ *      -DCONFIG_RTC_CAL -DCONFIG_RTC_CAL_TURNOVER=25 \
+ *      -DCONFIG_RTC_CAL_CURVE=34 -DCONFIG_RTC_CAL_OFFSET=0 \
+ *      -o rtc_cal_sim contrib/rtc_cal_sim/rtc_cal_sim.c \
+ *      drivers/rtc_cal.c -lm
+ *
+ * Usage: rtc_cal_sim [-s seed] [-v]
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "openchronos.h"
+#include "rtca.h"
+#include "temperature.h"
+#include "rtc_cal.h"
+
+#define DAYS            30
+#define MINUTES         (DAYS * 24 * 60)
+
+#define WRIST_C         31.0
+#define ROOM_C          21.0
+#define LAG_MIN         10.0
+#define NOISE_C         0.3
+
+/* Seconds the compensated clock may drift over the month */
+#define LIMIT_NOMINAL_S 0.5
+/* Part of the uncompensated drift the spread crystal may keep */
+#define LIMIT_SPREAD    0.3
+/* How far rtc_cal_info.total may be from what was applied */
+#define LIMIT_TOTAL_MS  10
+
+struct crystal {
+    const char *name;
+    double turnover;    /* C */
+    double curve;       /* ppm / C^2 */
+    double sensor;      /* C the sensor reads high */
+};
+
+static const struct crystal crystals[] = {
+    { "nominal", CONFIG_RTC_CAL_TURNOVER, CONFIG_RTC_CAL_CURVE / 1000.0, 0.0 },
+    { "spread", CONFIG_RTC_CAL_TURNOVER + 2.0,
+      CONFIG_RTC_CAL_CURVE * 1.1 / 1000.0, 1.0 },
+};
+#define CRYSTALS (sizeof(crystals) / sizeof(crystals[0]))
+
+uint8_t RTCCTL2;
+
+static unsigned long rng = 1;
+static int verbose;
+
+static double watch;            /* temperature of the watch in C */
+static const struct crystal *xtal;
+
+static double noise(double sd)
+{
+    double u, v;
+
+    rng = rng * 1103515245ul + 12345ul;
+    u = ((rng >> 8) % 100000 + 1) / 100001.0;
+    rng = rng * 1103515245ul + 12345ul;
+    v = ((rng >> 8) % 100000) / 100000.0;
+    return sd * sqrt(-2 * log(u)) * cos(2 * M_PI * v);
+}
+
+void temperature_measurement(void)
+{
+}
+
+void temperature_get_C(int16_t *temp)
+{
+    double c = watch + xtal->sensor + noise(NOISE_C);
+
+    *temp = (int16_t)lround(c * 10);
+}
+
+static double outside(int minute)
+{
+    double day = minute / 1440.0;
+
+    /* a cold spell from day 14 to 21 */
+    if (day >= 14 && day < 21)
+        return -8.0 + 3.0 * sin(2 * M_PI * day);
+    return 12.0 - 4.0 * cos(2 * M_PI * day);
+}
+
+static double surroundings(int minute)
+{
+    int day = minute / 1440, m = minute % 1440;
+    int weekend = day % 7 >= 5;
+
+    if (m < 7 * 60 || m >= 23 * 60)
+        return ROOM_C;
+    if ((m >= 8 * 60 && m < 8 * 60 + 30) || (m >= 18 * 60 && m < 18 * 60 + 30))
+        return outside(minute);
+    if (weekend && m >= 10 * 60 && m < 14 * 60)
+        return outside(minute);
+    return WRIST_C;
+}
+
+static double crystal_ppm(double c)
+{
+    double d = c - xtal->turnover;
+
+    return CONFIG_RTC_CAL_OFFSET / 1000.0 - xtal->curve * d * d;
+}
+
+static double rtccal_ppm(void)
+{
+    uint8_t steps = RTCCTL2 & 0x3f;
+
+    if (RTCCTL2 & RTCCALS)
+        return steps * RTC_CAL_STEP_UP / 1000.0;
+    return -(steps * RTC_CAL_STEP_DOWN / 1000.0);
+}
+
+static int run(const struct crystal *c)
+{
+    double raw = 0, trimmed = 0, applied = 0;
+    int minute, failures = 0, ok;
+
+    xtal = c;
+    watch = ROOM_C;
+    RTCCTL2 = 0;
+    rtca_time.min = 0;
+    rtc_cal_init();
+
+    for (minute = 1; minute <= MINUTES; minute++) {
+        double ppm, cal = rtccal_ppm();
+
+        watch += (surroundings(minute) - watch) / LAG_MIN;
+        ppm = crystal_ppm(watch);
+
+        /* seconds lost or gained in this minute */
+        raw += ppm * 60e-6;
+        trimmed += (ppm + cal) * 60e-6;
+        applied += cal * 60e-6;
+
+        rtca_time.min = minute % 60;
+        rtc_cal_minute();
+
+        if (verbose && minute % 1440 == 0)
+            printf("  day %2d  %5.1f C  raw %+7.2f s  trimmed %+6.2f s  "
+                   "RTCCAL %+3d\n", minute / 1440, watch, raw, trimmed,
+                   rtc_cal_info.cal);
+    }
+
+    printf("%-8s uncompensated %+7.2f s, compensated %+6.2f s  ",
+           c->name, raw, trimmed);
+    if (c == &crystals[0])
+        ok = fabs(trimmed) <= LIMIT_NOMINAL_S;
+    else
+        ok = fabs(trimmed) <= LIMIT_SPREAD * fabs(raw);
+    printf("%s\n", ok ? "ok" : "FAIL");
+    failures += !ok;
+
+    /* the log is of whole hours, the last one is still running */
+    ok = fabs(applied * 1000 - rtc_cal_info.total) <=
+         LIMIT_TOTAL_MS + fabs(rtccal_ppm()) * 3.6;
+    printf("%-8s logged correction %+6ld ms, applied %+8.1f ms  %s\n",
+           c->name, (long)rtc_cal_info.total, applied * 1000,
+           ok ? "ok" : "FAIL");
+    failures += !ok;
+
+    return failures;
+}
+
+int main(int argc, char **argv)
+{
+    int opt, failures = 0;
+    unsigned i;
+
+    while ((opt = getopt(argc, argv, "s:v")) != -1) {
+        switch (opt) {
+        case 's':
+            rng = strtoul(optarg, NULL, 0);
+            break;
+        case 'v':
+            verbose = 1;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-s seed] [-v]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    /* each crystal in a fresh process, rtc_cal.c keeps static state */
+    for (i = 0; i < CRYSTALS; i++) {
+        int status;
+
+        fflush(stdout);
+        if (fork() == 0)
+            exit(run(&crystals[i]));
+        wait(&status);
+        failures += !WIFEXITED(status) || WEXITSTATUS(status);
+    }
+
+    printf(failures ? "FAILED\n" : "all passed\n");
+    return failures ? 1 : 0;
+}
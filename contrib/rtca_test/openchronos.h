@@ -0,0 +1,61 @@
+/*
+ * openchronos.h
+ *
+ * Host stand-in for the firmware main header, so drivers/rtca.c builds
+ * with the native compiler. The RTC_A registers are plain variables that
+ * rtca_epoch_test.c ticks like the calendar mode hardware. It is found
+ * before the real header through -I.
+ */
+
+#ifndef __OPENCHRONOS_H__
+#define __OPENCHRONOS_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define BIT0 (0x0001)
+#define BIT1 (0x0002)
+#define BIT2 (0x0004)
+#define BIT3 (0x0008)
+#define BIT4 (0x0010)
+#define BIT5 (0x0020)
+#define BIT6 (0x0040)
+#define BIT7 (0x0080)
+#define BIT8 (0x0100)
+#define BIT9 (0x0200)
+#define BITA (0x0400)
+#define BITB (0x0800)
+#define BITC (0x1000)
+#define BITD (0x2000)
+#define BITE (0x4000)
+#define BITF (0x8000)
+
+/* RTCCTL01 */
+#define RTCRDYIFG   (0x0001)
+#define RTCRDYIE    (0x0010)
+#define RTCAIE      (0x0020)
+#define RTCTEVIE    (0x0040)
+#define RTCRDY      (0x1000)
+#define RTCMODE     (0x2000)
+#define RTCHOLD     (0x4000)
+
+/* RTCAMIN, RTCAHOUR */
+#define RTCAE       (0x80)
+
+#define RTCIV_RTCRDYIFG (0x0002)
+#define RTCIV_RTCTEVIFG (0x0004)
+#define RTCIV_RTCAIFG   (0x0006)
+
+extern uint16_t RTCCTL01, RTCIV, RTCPS;
+extern uint8_t RTCSEC, RTCMIN, RTCHOUR, RTCDOW, RTCDAY, RTCMON;
+extern uint8_t RTCYEARL, RTCYEARH, RTCAMIN, RTCAHOUR;
+
+#define LPM3_bits   (0x00f0)
+
+#define interrupt(x)                used
+#define _BIC_SR_IRQ(x)
+#define __get_SR_register()         (0)
+#define __disable_interrupt()
+#define __set_interrupt_state(x)    ((void)(x))
+
+#endif /* __OPENCHRONOS_H__ */
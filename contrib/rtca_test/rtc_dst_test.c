@@ -0,0 +1,174 @@
+/*
+ * rtc_dst_test.c
+ *
+ * Runs the DST switch of drivers/rtc_dst.c on the RTC_A of drivers/rtca.c,
+ * for the EU zone, with the calendar registers ticked once a second like
+ * the hardware as in rtca_epoch_test.c:
+ *
+ *   spring forward  02:00 becomes 03:00, once
+ *   fall back       02:00 becomes 01:00, and the next 02:00 an hour later
+ *                   goes by without a second switch
+ *   set the time    rtca_set_time() alone past a switch picks the next one
+ *   set the date    rtca_set_date() alone onto a switch day
+ *   past the table  nothing switches after the last tabulated year
+ *
+ * The tables come from tools/make_rtc_dst.py, build from the top of the
+ * tree with:
+ *
+ *   python tools/make_rtc_dst.py drivers/rtc_dst_table.h
+ *   cc -O2 -Wall -fcommon -DCONFIG_RTC_IRQ -DCONFIG_RTC_DST \
+ *      -DCONFIG_RTC_DST_ZONE=4 -Icontrib/rtca_test -Idrivers \
+ *      -o rtc_dst_test contrib/rtca_test/rtc_dst_test.c drivers/rtca.c \
+ *      drivers/rtc_dst.c
+ */
+
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <time.h>
+
+#include "openchronos.h"
+#include "rtca.h"
+#include "rtc_dst.h"
+
+uint16_t RTCCTL01, RTCIV, RTCPS;
+uint8_t RTCSEC, RTCMIN, RTCHOUR, RTCDOW, RTCDAY, RTCMON;
+uint8_t RTCYEARL, RTCYEARH, RTCAMIN, RTCAHOUR;
+
+void RTC_A_ISR(void);
+
+static int failures;
+
+static void check(int cond, const char *what)
+{
+    printf("%-48s %s\n", what, cond ? "ok" : "FAIL");
+    if (!cond)
+        failures++;
+}
+
+static time_t registers(void)
+{
+    struct tm tm = { 0 };
+
+    tm.tm_year = (RTCYEARL | (RTCYEARH << 8)) - 1900;
+    tm.tm_mon = RTCMON - 1;
+    tm.tm_mday = RTCDAY;
+    tm.tm_hour = RTCHOUR;
+    tm.tm_min = RTCMIN;
+    tm.tm_sec = RTCSEC;
+    return timegm(&tm);
+}
+
+/* One second of the RTC, with the interrupts it raises */
+static void tick(void)
+{
+    struct tm tm;
+    time_t t;
+
+    if (RTCCTL01 & RTCHOLD)
+        return;
+
+    t = registers() + 1;
+    gmtime_r(&t, &tm);
+    RTCSEC = tm.tm_sec;
+    RTCMIN = tm.tm_min;
+    RTCHOUR = tm.tm_hour;
+    RTCDOW = tm.tm_wday;
+    RTCDAY = tm.tm_mday;
+    RTCMON = tm.tm_mon + 1;
+    RTCYEARL = (tm.tm_year + 1900) & 0xff;
+    RTCYEARH = (tm.tm_year + 1900) >> 8;
+
+    if (RTCCTL01 & RTCRDYIE) {
+        RTCIV = RTCIV_RTCRDYIFG;
+        RTC_A_ISR();
+    }
+    if (tm.tm_sec == 0 && (RTCCTL01 & RTCTEVIE)) {
+        RTCIV = RTCIV_RTCTEVIFG;
+        RTC_A_ISR();
+    }
+}
+
+/* Run for seconds, the clock jumps it saw */
+static unsigned run(unsigned long seconds)
+{
+    unsigned jumps = 0;
+    time_t t;
+
+    while (seconds--) {
+        t = registers();
+        tick();
+        if (registers() != t + 1)
+            jumps++;
+    }
+    return jumps;
+}
+
+/* The registers and the epoch counter show this time */
+static int at(uint8_t hour, uint8_t min, uint8_t sec)
+{
+    return RTCHOUR == hour && RTCMIN == min && RTCSEC == sec
+        && rtca_epoch() == (uint32_t)registers();
+}
+
+/* What modules/clock.c does when an edit is saved */
+static void set_clock(uint16_t year, uint8_t mon, uint8_t day,
+                      uint8_t hour, uint8_t min, uint8_t sec)
+{
+    rtca_stop();
+    rtca_time.year = year;
+    rtca_time.mon = mon;
+    rtca_time.day = day;
+    rtca_time.hour = hour;
+    rtca_time.min = min;
+    rtca_time.sec = sec;
+    rtca_set_time();
+    rtca_set_date();
+}
+
+int main(void)
+{
+    unsigned jumps;
+
+    rtca_init();
+
+    /* EU 2019: March 31 and October 27 */
+    set_clock(2019, 3, 31, 1, 59, 50);
+    check(rtc_dst_state == RTC_DST_STATE_ST, "winter time before March 31");
+    jumps = run(20);
+    check(jumps == 1 && at(3, 0, 10) && rtc_dst_state == RTC_DST_STATE_DST,
+          "  02:00 springs forward to 03:00");
+    check(run(7200) == 0, "  and only once");
+
+    set_clock(2019, 10, 27, 1, 59, 50);
+    check(rtc_dst_state == RTC_DST_STATE_DST, "summer time before October 27");
+    jumps = run(20);
+    check(jumps == 1 && at(1, 0, 10) && rtc_dst_state == RTC_DST_STATE_ST,
+          "  02:00 falls back to 01:00");
+    check(run(3600) == 0 && at(2, 0, 10) && rtc_dst_state == RTC_DST_STATE_ST,
+          "  the next 02:00 goes by");
+    check(rtc_dst_next_transition() > rtca_epoch() + 86400ul * 100,
+          "  next switch in March");
+
+    /* the time alone across the switch, the date already set */
+    set_clock(2020, 3, 29, 1, 0, 0);
+    rtca_stop();
+    rtca_time.hour = 5;
+    rtca_set_time();
+    check(rtc_dst_state == RTC_DST_STATE_DST && run(20) == 0,
+          "rtca_set_time() past the switch");
+
+    /* the date alone onto a switch day, before 02:00 */
+    set_clock(2020, 10, 1, 1, 59, 50);
+    rtca_stop();
+    rtca_time.day = 25;
+    rtca_set_date();
+    check(run(20) == 1 && at(1, 0, 10) && rtc_dst_state == RTC_DST_STATE_ST,
+          "rtca_set_date() onto the switch day");
+
+    set_clock(2048, 3, 29, 1, 59, 50);
+    check(rtc_dst_next_transition() == 0 && run(20) == 0 && at(2, 0, 10),
+          "no switch past the table");
+
+    printf("%s\n", failures ? "FAIL" : "PASS");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,244 @@
+/*
+ * rtca_epoch_test.c
+ *
+ * Checks the Unix epoch counter of drivers/rtca.c against timegm(). The
+ * RTC_A calendar registers are ticked once a second like the hardware in
+ * calendar mode: the read ready interrupt every second and the time event
+ * interrupt every minute go through RTC_A_ISR(), nothing is held while
+ * RTCHOLD is set. After every second rtca_epoch() has to equal timegm()
+ * of the registers, and the rtca_time cache has to agree with them.
+ *
+ * The clock is set the way modules/clock.c does, rtca_set_time() then
+ * rtca_set_date(), a few seconds before:
+ *
+ *   month ends of 30 and 31 days
+ *   February 28 and 29 in leap years, also 2000, and in 2019 and 2100
+ *   the turn of the years 2018, 2099 and 2105
+ *
+ * and the time alone and the date alone are changed, backwards too. The
+ * counter is then run a second at a time over 400 days that include a
+ * leap day and a new year.
+ *
+ * Build from the top of the tree, -fcommon lets rtca.h define rtca_time
+ * in both files as on the target:
+ *
+ *   cc -O2 -Wall -fcommon -DCONFIG_RTC_IRQ -Icontrib/rtca_test -Idrivers \
+ *      -o rtca_epoch_test contrib/rtca_test/rtca_epoch_test.c drivers/rtca.c
+ *
+ * Usage: rtca_epoch_test [-d days] [-v]
+ */
+
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "openchronos.h"
+#include "rtca.h"
+
+uint16_t RTCCTL01, RTCIV, RTCPS;
+uint8_t RTCSEC, RTCMIN, RTCHOUR, RTCDOW, RTCDAY, RTCMON;
+uint8_t RTCYEARL, RTCYEARH, RTCAMIN, RTCAHOUR;
+
+void RTC_A_ISR(void);
+
+/* Seconds to run through each boundary */
+#define AROUND      10
+
+static const struct {
+    uint16_t year;
+    uint8_t mon, day;
+} boundary[] = {
+    { 1970, 1, 1 },
+    { 2018, 1, 31 },
+    { 2018, 4, 30 },
+    { 2018, 12, 31 },
+    { 2019, 2, 28 },
+    { 2020, 2, 28 },
+    { 2020, 2, 29 },
+    { 2000, 2, 28 },
+    { 2000, 2, 29 },
+    { 2100, 2, 28 },
+    { 2099, 12, 31 },
+    { 2105, 12, 31 },
+};
+
+#define NUM_BOUNDARY (sizeof(boundary) / sizeof(boundary[0]))
+
+static int verbose;
+
+static uint16_t reg_year(void)
+{
+    return RTCYEARL | (RTCYEARH << 8);
+}
+
+static time_t registers(void)
+{
+    struct tm tm = { 0 };
+
+    tm.tm_year = reg_year() - 1900;
+    tm.tm_mon = RTCMON - 1;
+    tm.tm_mday = RTCDAY;
+    tm.tm_hour = RTCHOUR;
+    tm.tm_min = RTCMIN;
+    tm.tm_sec = RTCSEC;
+    return timegm(&tm);
+}
+
+/* One second of the RTC, with the interrupts it raises */
+static void tick(void)
+{
+    struct tm tm;
+    time_t t;
+
+    if (RTCCTL01 & RTCHOLD)
+        return;
+
+    t = registers() + 1;
+    gmtime_r(&t, &tm);
+    RTCSEC = tm.tm_sec;
+    RTCMIN = tm.tm_min;
+    RTCHOUR = tm.tm_hour;
+    RTCDOW = tm.tm_wday;
+    RTCDAY = tm.tm_mday;
+    RTCMON = tm.tm_mon + 1;
+    RTCYEARL = (tm.tm_year + 1900) & 0xff;
+    RTCYEARH = (tm.tm_year + 1900) >> 8;
+
+    if (RTCCTL01 & RTCRDYIE) {
+        RTCIV = RTCIV_RTCRDYIFG;
+        RTC_A_ISR();
+    }
+    if (tm.tm_sec == 0 && (RTCCTL01 & RTCTEVIE)) {
+        RTCIV = RTCIV_RTCTEVIFG;
+        RTC_A_ISR();
+    }
+}
+
+static int check(const char *what)
+{
+    time_t want = registers();
+    uint32_t epoch = rtca_epoch();
+    /* rtca_update_dow() only knows the years from 1984 to 2099 */
+    int dow_ok = reg_year() < 1984 || reg_year() > 2099
+        || rtca_time.dow == RTCDOW;
+
+    if (epoch == (uint32_t)want && rtca_time.year == reg_year()
+            && rtca_time.mon == RTCMON && rtca_time.day == RTCDAY
+            && dow_ok && rtca_time.hour == RTCHOUR
+            && rtca_time.min == RTCMIN && rtca_time.sec == RTCSEC)
+        return 0;
+
+    printf("%s: %04u-%02u-%02u %02u:%02u:%02u dow %u, "
+           "epoch %lu want %lu, cache %04u-%02u-%02u %02u:%02u:%02u dow %u\n",
+           what, reg_year(), RTCMON, RTCDAY, RTCHOUR, RTCMIN, RTCSEC,
+           RTCDOW, (unsigned long)epoch, (unsigned long)want,
+           rtca_time.year, rtca_time.mon, rtca_time.day, rtca_time.hour,
+           rtca_time.min, rtca_time.sec, rtca_time.dow);
+    return 1;
+}
+
+/* What modules/clock.c does when an edit is saved */
+static void set_clock(uint16_t year, uint8_t mon, uint8_t day,
+                      uint8_t hour, uint8_t min, uint8_t sec)
+{
+    rtca_stop();
+    rtca_time.year = year;
+    rtca_time.mon = mon;
+    rtca_time.day = day;
+    rtca_time.hour = hour;
+    rtca_time.min = min;
+    rtca_time.sec = sec;
+    rtca_set_time();
+    rtca_set_date();
+}
+
+static int run(const char *what, unsigned long seconds)
+{
+    int failures = 0;
+
+    while (seconds--) {
+        tick();
+        if (check(what) && ++failures > 5)
+            break;
+    }
+    return failures;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long days = 400;
+    int failures = 0, opt;
+    uint8_t i;
+
+    while ((opt = getopt(argc, argv, "d:v")) != -1) {
+        switch (opt) {
+        case 'd':
+            days = strtoul(optarg, NULL, 0);
+            break;
+        case 'v':
+            verbose = 1;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-d days] [-v]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    rtca_init();
+    failures += check("init");
+    failures += run("after init", AROUND);
+
+    for (i = 0; i < NUM_BOUNDARY; i++) {
+        char what[32];
+        uint16_t y = boundary[i].year;
+        uint8_t m = boundary[i].mon, d = boundary[i].day;
+
+        snprintf(what, sizeof(what), "%04u-%02u-%02u", y, m, d);
+        if (y == 1970)
+            set_clock(y, m, d, 0, 0, 0);
+        else
+            set_clock(y, m, d, 23, 59, 60 - AROUND / 2);
+        failures += check(what);
+        failures += run(what, AROUND);
+        if (verbose)
+            printf("%-10s epoch %lu\n", what, (unsigned long)rtca_epoch());
+    }
+
+    /* the date alone, back by 94 years */
+    rtca_stop();
+    rtca_time.year = 2012;
+    rtca_time.mon = 2;
+    rtca_time.day = 29;
+    rtca_set_date();
+    failures += check("date set");
+    failures += run("date set", 3 * 60);
+
+    /* the time alone, forward into the next day */
+    rtca_stop();
+    rtca_time.hour = 23;
+    rtca_time.min = 58;
+    rtca_time.sec = 30;
+    rtca_set_time();
+    failures += check("time set");
+    failures += run("time set", 3 * 60);
+
+    /* and back by most of a day */
+    rtca_stop();
+    rtca_time.hour = 1;
+    rtca_time.min = 2;
+    rtca_time.sec = 3;
+    rtca_set_time();
+    failures += check("time set back");
+    failures += run("time set back", 3 * 60);
+
+    set_clock(2019, 12, 1, 12, 0, 0);
+    failures += run("long run", days * 86400);
+    if (verbose)
+        printf("%lu days up to %04u-%02u-%02u, epoch %lu\n", days,
+               reg_year(), RTCMON, RTCDAY, (unsigned long)rtca_epoch());
+
+    printf("%s\n", failures ? "FAIL" : "PASS");
+    return failures ? 1 : 0;
+}
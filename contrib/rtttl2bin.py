@@ -42,7 +42,7 @@ def parse_ringtone(ringtone):
     default_duration = int(match.group(2))
     default_octave = int(match.group(3))
     bpm = int(match.group(4))
-    whole = (60 * 1000 / bpm) * 4
+    whole = (60 * 1000 // bpm) * 4
     notes = [parse_note(note, default_duration, default_octave) for note in match.group(5).split(',')]
     return {"title": match.group(1), "melody": notes, "whole": whole}
 
@@ -72,6 +72,80 @@ def generate_binary_note(note, whole_note):
     return (duration << 6) | (octave << 4) | tone
 
 
+# Stream bytes below this are dictionary indices, the ones above repeat the
+# previous note, and MELODY_END ends the melody (see drivers/melody.h).
+# MELODY_RUN itself is reserved and never written.
+MELODY_RUN = 0x80
+MELODY_END = 0xFF
+MELODY_RUN_MAX = MELODY_END - MELODY_RUN - 1
+
+
+def compile_melodies(ringtones):
+    """
+        This compiles ringtones as parsed by parse_ringtone into one note dictionary shared by all of
+        them, most used notes first, and a byte stream per ringtone. Returns (dictionary, streams).
+    """
+    melodies = [[generate_binary_note(note, ringtone["whole"]) for note in ringtone["melody"]]
+                for ringtone in ringtones]
+
+    count = dict()
+    for melody in melodies:
+        for note in melody:
+            count[note] = count.get(note, 0) + 1
+    dictionary = sorted(count, key=lambda note: (-count[note], note))
+    if len(dictionary) > MELODY_RUN:
+        raise Exception("more than %d different notes" % MELODY_RUN)
+
+    streams = list()
+    for melody in melodies:
+        stream = list()
+        previous = None
+        for note in melody:
+            if note == previous and stream[-1] >= MELODY_RUN and stream[-1] < MELODY_RUN + MELODY_RUN_MAX:
+                stream[-1] += 1
+            elif note == previous:
+                stream.append(MELODY_RUN + 1)
+            else:
+                stream.append(dictionary.index(note))
+            previous = note
+        stream.append(MELODY_END)
+        streams.append(stream)
+    return (dictionary, streams)
+
+
+def generate_melody_source(ringtones, header):
+    """
+        This generates the C source and header text for compiled ringtones. Every ringtone becomes a
+        "const struct melody tune_<title>" in flash.
+    """
+    dictionary, streams = compile_melodies(ringtones)
+    guard = re.sub('[^A-Z0-9]', '_', header.upper()) + '_'
+    notice = "/* generated by contrib/rtttl2bin.py, do not edit */\n"
+
+    h = [notice, "#ifndef %s" % guard, "#define %s" % guard, "", '#include "drivers/melody.h"', ""]
+    c = [notice, '#include "%s"' % header, ""]
+
+    c.append("static const note tunes_dictionary[%d] = {%s};" %
+             (len(dictionary), ', '.join("0x%04x" % note for note in dictionary)))
+    for ringtone, stream in zip(ringtones, streams):
+        title = ringtone["title"]
+        h.append("extern const struct melody tune_%s;" % title)
+        c.append("")
+        c.append("static const uint8_t tune_%s_stream[%d] = {%s};" %
+                 (title, len(stream), ', '.join("0x%02x" % byte for byte in stream)))
+        c.append("const struct melody tune_%s = {tunes_dictionary, tune_%s_stream};" % (title, title))
+
+    h += ["", "#endif /* %s */" % guard]
+    return ('\n'.join(c) + '\n', '\n'.join(h) + '\n')
+
+
 if __name__ == '__main__':
     import sys
-    print(generate_binary_ringtone(parse_ringtone(sys.argv[1])))
+    if len(sys.argv) > 3 and sys.argv[1] == '-o':
+        # -o <source.c> <header.h> <tune.rtttl>...: compile into flash melodies
+        ringtones = [parse_ringtone(open(name).read().strip()) for name in sys.argv[4:]]
+        source, header = generate_melody_source(ringtones, sys.argv[3].split('/')[-1])
+        open(sys.argv[2], 'w').write(source)
+        open(sys.argv[3], 'w').write(header)
+    else:
+        print(generate_binary_ringtone(parse_ringtone(sys.argv[1])))
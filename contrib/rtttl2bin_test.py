@@ -67,5 +67,29 @@ class RTTTLTests(unittest.TestCase):
             "welcome: d=16,o=4,b=150: a, c, e")),
             "static note welcome[4] = {0x1901, 0x1904, 0x1908, 0x000F};")
 
+    def test_compile_melodies(self):
+        """Testing if melodies share the dictionary and repeats are run-length coded"""
+        dictionary, streams = rtttl2bin.compile_melodies([
+            rtttl2bin.parse_ringtone("one: d=16,o=4,b=150: a, a, a, c"),
+            rtttl2bin.parse_ringtone("two: d=16,o=4,b=150: c, e")])
+        self.assertEqual(dictionary, [0x1901, 0x1904, 0x1908])
+        self.assertEqual(streams, [[0x00, 0x82, 0x01, 0xFF], [0x01, 0x02, 0xFF]])
+
+    def test_compile_melodies_long_run(self):
+        """Testing if a run longer than one stream byte holds goes on in the next"""
+        dictionary, streams = rtttl2bin.compile_melodies([
+            rtttl2bin.parse_ringtone("run: d=16,o=4,b=150: " + ', '.join(['a'] * 200))])
+        self.assertEqual(streams, [[0x00, 0xFE, 0xC9, 0xFF]])
+
+    def test_generate_melody_source(self):
+        """Testing if compiled melodies come out as const C arrays"""
+        source, header = rtttl2bin.generate_melody_source(
+            [rtttl2bin.parse_ringtone("welcome: d=16,o=4,b=150: a, c, e")], "tunes.h")
+        self.assertIn("static const note tunes_dictionary[3] = {0x1901, 0x1904, 0x1908};", source)
+        self.assertIn("static const uint8_t tune_welcome_stream[4] = {0x00, 0x01, 0x02, 0xff};", source)
+        self.assertIn("const struct melody tune_welcome = {tunes_dictionary, tune_welcome_stream};", source)
+        self.assertIn("extern const struct melody tune_welcome;", header)
+        self.assertIn("#ifndef TUNES_H_", header)
+
 if __name__ == '__main__':
     unittest.main()
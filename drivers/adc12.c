@@ -60,6 +60,10 @@
 uint16_t adc12_result;
 uint8_t  adc12_data_ready;
 
+// Burst of adc12_oversample(), summed by the ISR
+static volatile uint32_t adc12_sum;
+static volatile uint16_t adc12_samples;
+
 
 // *************************************************************************************************
 // Extern section
@@ -82,8 +86,8 @@ uint16_t adc12_single_conversion(uint16_t ref, uint16_t sht, uint16_t channel)
     ADC12MCTL0 = ADC12SREF_1 + channel;         // ADC input channel
     ADC12IE = 0x001;                            // ADC_IFG upon conv result-ADCMEMO
 
-    // Wait 2 ticks (66us) to allow internal reference to settle
-    timer0_delay(66,LPM3_bits);
+    // Allow internal reference to settle, timer0_delay() counts in ms
+    timer0_delay(1, LPM3_bits);
 
     // Start ADC12
     ADC12CTL0 |= ADC12ENC;
@@ -95,13 +99,13 @@ uint16_t adc12_single_conversion(uint16_t ref, uint16_t sht, uint16_t channel)
     ADC12CTL0 |= ADC12SC;
 
     // Wait until ADC12 has finished
-    timer0_delay(170, LPM3_bits);
+    timer0_delay(1, LPM3_bits);
 
     uint8_t loops = 0;
 
     //We were going away and the watchdog was tripping - this should reduce the instances of that.
     while (!adc12_data_ready && loops++ < 30) {
-        timer0_delay(66, LPM3_bits);
+        timer0_delay(1, LPM3_bits);
     }
 
     // Shut down ADC12
@@ -119,6 +123,65 @@ uint16_t adc12_single_conversion(uint16_t ref, uint16_t sht, uint16_t channel)
 
 
 
+// *************************************************************************************************
+// @fn          adc12_oversample
+// @brief       Init ADC12. Do 4^bits conversions in one burst and decimate. Turn off ADC12.
+//              The reference settles once for the whole burst. Oversampling only adds
+//              resolution when the input carries about 1 LSB of noise, which the internal
+//              sensors do.
+// @param       ref         REFVSEL_x
+//              sht         ADC12SHT0_x, sample time of every conversion
+//              channel     ADC12INCH_x
+//              bits        bits to add, 1 to ADC12_OVERSAMPLE_MAX_BITS
+// @return      result with 12 + bits bits
+// *************************************************************************************************
+uint16_t adc12_oversample(uint16_t ref, uint16_t sht, uint16_t channel, uint8_t bits)
+{
+    uint16_t samples = 1u << (bits << 1);
+    uint8_t loops = 0;
+
+    // Initialize the shared reference module
+    REFCTL0 |= REFMSTR + ref + REFON;
+
+    // Repeat single channel, the next sample starts as soon as a conversion is done
+    ADC12CTL0 = sht + ADC12MSC + ADC12ON;
+    ADC12CTL1 = ADC12SHP + ADC12CONSEQ_2;
+    ADC12MCTL0 = ADC12SREF_1 + channel;
+    ADC12IE = 0x001;
+
+    // Let the internal reference settle, once for all samples
+    timer0_delay(1, LPM3_bits);
+
+    adc12_sum = 0;
+    adc12_samples = samples;
+    adc12_data_ready = 0;
+
+    // Start the burst
+    ADC12CTL0 |= ADC12ENC;
+    ADC12CTL0 |= ADC12SC;
+
+    // Sleep through the burst, then poll like adc12_single_conversion()
+    timer0_delay((samples * ADC12_OVERSAMPLE_USEC) / 1000 + 1, LPM3_bits);
+
+    while (!adc12_data_ready && loops++ < 30) {
+        timer0_delay(1, LPM3_bits);
+    }
+
+    // Shut down ADC12, the ISR has already stopped the sequence
+    ADC12IE = 0;
+    adc12_samples = 0;
+    ADC12CTL0 &= ~(ADC12ENC | ADC12SC | ADC12MSC | sht);
+    ADC12CTL0 &= ~ADC12ON;
+    ADC12CTL1 = 0;
+
+    // Shut down reference voltage
+    REFCTL0 &= ~(REFMSTR + ref + REFON);
+
+    // Decimate: 4^bits samples summed, divided by 2^bits with rounding
+    return (adc12_sum + (1u << (bits - 1))) >> bits;
+}
+
+
 
 // *************************************************************************************************
 // @fn          ADC12ISR
@@ -141,7 +204,14 @@ void ADC12ISR(void)
         break;                           // Vector  4:  ADC timing overflow
 
     case  6:                            // Vector  6:  ADC12IFG0
-        adc12_result = ADC12MEM0;       // Move results, IFG is cleared
+        if (adc12_samples) {
+            adc12_sum += ADC12MEM0;     // Accumulate the burst, IFG is cleared
+            if (--adc12_samples)
+                break;
+            ADC12CTL0 &= ~ADC12ENC;     // Stop after the conversion in progress
+        } else {
+            adc12_result = ADC12MEM0;   // Move results, IFG is cleared
+        }
         adc12_data_ready = 1;
         _BIC_SR_IRQ(LPM3_bits);         // Exit active CPU
         break;
@@ -45,10 +45,17 @@
 // *************************************************************************************************
 // Prototypes section
 extern uint16_t adc12_single_conversion(uint16_t ref, uint16_t sht, uint16_t channel);
+extern uint16_t adc12_oversample(uint16_t ref, uint16_t sht, uint16_t channel, uint8_t bits);
 
 // *************************************************************************************************
 // Defines section
 
+// adc12_oversample() takes 4^bits samples, 256 at most so the sum stays in 32 bits
+#define ADC12_OVERSAMPLE_MAX_BITS                   (4u)
+
+// Time per sample with ADC12SHT0_8 on the 4.2 MHz minimum of ADC12OSC, 256 + 13 cycles
+#define ADC12_OVERSAMPLE_USEC                       (64u)
+
 //// Reference settling time
 //#define ADC12_REFERENCE_SETTLING_TIME_USEC        (4*34u)
 //
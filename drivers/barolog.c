@@ -0,0 +1,147 @@
+/**
+    drivers/barolog.c: pressure history and 3 hour tendency
+
+    http://github.com/BenjaminSoelberg/openchronos-ng-elf
+
+    This file is part of openchronos-ng.
+
+    openchronos-ng is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    openchronos-ng is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+/*
+ * Every reading is stored as a signed byte against the one before, so two
+ * days of pressure fit in 200 bytes of RAM. The delta is taken against the
+ * reconstructed previous reading, not the measured one: rounding never adds
+ * up, and a step too large for one byte is spread over the next samples.
+ * The oldest reading is kept in full and moved on as its slot is reused.
+ */
+
+// *************************************************************************************************
+// Include section
+
+// logic
+#include "barolog.h"
+
+// *************************************************************************************************
+// @fn          barolog_init
+// @brief       Empty the log
+// @param       l log to clear
+// @return      none
+// *************************************************************************************************
+void barolog_init(struct barolog *l)
+{
+    l->first = 0;
+    l->last = 0;
+    l->head = 0;
+    l->count = 0;
+}
+
+// *************************************************************************************************
+// @fn          barolog_add
+// @brief       Log one reading, drops the oldest one when the log is full
+// @param       l log
+// @param       pa pressure in Pa
+// @return      none
+// *************************************************************************************************
+void barolog_add(struct barolog *l, uint32_t pa)
+{
+    uint16_t v = (pa + BAROLOG_UNIT / 2) / BAROLOG_UNIT;
+    int16_t d;
+    uint8_t next;
+
+    if (l->count == 0) {
+        l->first = v;
+        l->last = v;
+        l->delta[l->head] = 0;
+    } else {
+        d = v - l->last;
+        if (d > 127)
+            d = 127;
+        if (d < -127)
+            d = -127;
+        l->last += d;
+
+        // Full, the slot at head holds the oldest reading
+        if (l->count == BAROLOG_SLOTS) {
+            next = l->head + 1;
+            if (next == BAROLOG_SLOTS)
+                next = 0;
+            l->first += l->delta[next];
+        }
+
+        l->delta[l->head] = d;
+    }
+
+    if (++l->head == BAROLOG_SLOTS)
+        l->head = 0;
+    if (l->count < BAROLOG_SLOTS)
+        l->count++;
+}
+
+// *************************************************************************************************
+// @fn          barolog_pa
+// @brief       Logged reading
+// @param       l log
+// @param       ago readings back from the newest one
+// @return      pressure in Pa, 0 past the start of the log
+// *************************************************************************************************
+uint32_t barolog_pa(const struct barolog *l, uint8_t ago)
+{
+    uint16_t v = l->last;
+    uint8_t i = l->head;
+
+    if (ago >= l->count)
+        return 0;
+
+    while (ago--) {
+        i = (i == 0 ? BAROLOG_SLOTS : i) - 1;
+        v -= l->delta[i];
+    }
+
+    return (uint32_t)v * BAROLOG_UNIT;
+}
+
+// *************************************************************************************************
+// @fn          barolog_change
+// @brief       Pressure change over the last 3 hours
+// @param       l log
+// @return      change in Pa, 0 before 3 hours are logged
+// *************************************************************************************************
+int16_t barolog_change(const struct barolog *l)
+{
+    if (l->count <= BAROLOG_TREND_SLOTS)
+        return 0;
+
+    return (int32_t)barolog_pa(l, 0) - (int32_t)barolog_pa(l, BAROLOG_TREND_SLOTS);
+}
+
+// *************************************************************************************************
+// @fn          barolog_trend
+// @brief       3 hour tendency
+// @param       l log
+// @return      BAROLOG_UNKNOWN before 3 hours are logged
+// *************************************************************************************************
+enum barolog_trend barolog_trend(const struct barolog *l)
+{
+    int16_t d = barolog_change(l);
+
+    if (l->count <= BAROLOG_TREND_SLOTS)
+        return BAROLOG_UNKNOWN;
+    if (d >= BAROLOG_STEADY_PA)
+        return BAROLOG_RISING;
+    if (d <= -BAROLOG_STEADY_PA)
+        return BAROLOG_FALLING;
+
+    return BAROLOG_STEADY;
+}
@@ -0,0 +1,69 @@
+/**
+    drivers/barolog.h: pressure history and 3 hour tendency
+
+    http://github.com/BenjaminSoelberg/openchronos-ng-elf
+
+    This file is part of openchronos-ng.
+
+    openchronos-ng is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    openchronos-ng is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+// *************************************************************************************************
+#ifndef BAROLOG_H_
+#define BAROLOG_H_
+
+// Include section
+#include "openchronos.h"
+
+// *************************************************************************************************
+// Defines section
+
+// Readings kept in the log, 48 hours at one every 15 minutes
+#define BAROLOG_SLOTS           (192u)
+
+// Pa per stored step, the deltas reach +-254 Pa per sample
+#define BAROLOG_UNIT            (2u)
+
+// Readings back for the tendency, 3 hours
+#define BAROLOG_TREND_SLOTS     (12u)
+
+// Change in Pa over 3 hours below which the pressure is steady
+#define BAROLOG_STEADY_PA       (100)
+
+enum barolog_trend {
+    BAROLOG_UNKNOWN = 0,
+    BAROLOG_STEADY,
+    BAROLOG_RISING,
+    BAROLOG_FALLING
+};
+
+// *************************************************************************************************
+// Global Variable section
+struct barolog {
+    int8_t delta[BAROLOG_SLOTS];    // each reading against the one before, in BAROLOG_UNIT Pa
+    uint16_t first;                 // oldest reading, in BAROLOG_UNIT Pa
+    uint16_t last;                  // newest reading, in BAROLOG_UNIT Pa
+    uint8_t head;                   // slot of the next reading
+    uint8_t count;                  // readings held, up to BAROLOG_SLOTS
+};
+
+// *************************************************************************************************
+// Prototypes section
+extern void barolog_init(struct barolog *l);
+extern void barolog_add(struct barolog *l, uint32_t pa);
+extern uint32_t barolog_pa(const struct barolog *l, uint8_t ago);
+extern int16_t barolog_change(const struct barolog *l);
+extern enum barolog_trend barolog_trend(const struct barolog *l);
+
+#endif /*BAROLOG_H_*/
@@ -63,14 +63,229 @@
 
 #include "ports.h"
 #include "adc12.h"
+#include "rtca.h"
+#include "utils.h"
+
+/* Minutes to the next measurement and the interval it was set from */
+static uint16_t battery_countdown;
+static uint16_t battery_interval = BATTERY_INTERVAL_MIN;
+
+/* Set when the buzzer or the radio releases its load */
+static volatile uint8_t battery_load_ended;
+
+/* Minutes since then, saturates */
+static uint8_t battery_rest = BATTERY_REST_MINUTES;
+
+/* Loads that are on, when they were switched on or last counted, and
+   seconds of on time not counted yet */
+static const uint16_t battery_load_ua[BATTERY_LOADS] = {
+    BATTERY_BUZZER_UA, BATTERY_RADIO_UA, BATTERY_ACCEL_UA, BATTERY_MOTION_UA
+};
+static volatile uint8_t battery_loads_on;
+static volatile uint32_t battery_load_since[BATTERY_LOADS];
+static volatile uint16_t battery_load_secs[BATTERY_LOADS];
+
+#define BATTERY_CAPACITY_UAS    (BATTERY_CAPACITY_MAH * 3600000ul)
+
+/* Charge drawn since power on, where today started, and the average
+   of a day, all in uA*s */
+static uint32_t battery_used;
+static uint32_t battery_day_start;
+static uint32_t battery_per_day = BATTERY_BASE_UA * 86400ul;
+static uint16_t battery_day_minutes;
+
+/* Readings at rest in a row with the curve below the count, and the
+   highest charge left the curve gave in them, in uA*s */
+static uint8_t battery_low_readings;
+static uint32_t battery_low_curve;
+
+/* Discharge curve of a CR2032 at a few uA, charge left in 0.1 % by
+   voltage. Above the first point the cell is on its plateau and the
+   voltage tells nothing. */
+#define BATTERY_CURVE_POINTS    7
+static const uint16_t battery_curve_v[BATTERY_CURVE_POINTS] = {
+    290, 280, 270, 260, 250, 240, 220
+};
+static const uint16_t battery_curve_left[BATTERY_CURVE_POINTS] = {
+    200, 120, 80, 50, 30, 20, 0
+};
 
 void battery_init(void)
 {
     /* Start with battery voltage estimate of full and avoid low
       battery warnings until the voltage estimate converges. */
     battery_info.voltage = BATTERY_FULL_THRESHOLD;
+    battery_info.soc = 100;
+    battery_info.days = 9999;
+}
+
+/* Drivers report their loads, on time is counted in seconds of rtca_time.
+   Calling start again while on, or stop while off, is harmless. */
+void battery_load_start(enum battery_load load)
+{
+    uint16_t int_state;
+
+    ENTER_CRITICAL_SECTION(int_state);
+    if (!(battery_loads_on & (1 << load))) {
+        battery_loads_on |= 1 << load;
+        battery_load_since[load] = rtca_time.sys;
+    }
+    EXIT_CRITICAL_SECTION(int_state);
 }
 
+void battery_load_stop(enum battery_load load)
+{
+    uint16_t int_state;
+
+    ENTER_CRITICAL_SECTION(int_state);
+    if (battery_loads_on & (1 << load)) {
+        battery_loads_on &= ~(1 << load);
+        battery_load_secs[load] += rtca_time.sys - battery_load_since[load];
+
+        /* The cell sags under the buzzer or the radio and recovers over
+           a few minutes, measure again from the next minute on. */
+        if (load == BATTERY_LOAD_BUZZER || load == BATTERY_LOAD_RADIO)
+            battery_load_ended = 1;
+    }
+    EXIT_CRITICAL_SECTION(int_state);
+}
+
+/* Add up the charge of the last minute, a multiply per load */
+static void battery_count(void)
+{
+    uint32_t uas = BATTERY_BASE_UA * 60ul;
+    uint16_t int_state;
+    uint8_t i;
+
+    ENTER_CRITICAL_SECTION(int_state);
+    for (i = 0; i < BATTERY_LOADS; i++) {
+        if (battery_loads_on & (1 << i)) {
+            battery_load_secs[i] += rtca_time.sys - battery_load_since[i];
+            battery_load_since[i] = rtca_time.sys;
+        }
+        if (battery_load_secs[i]) {
+            uas += (uint32_t)battery_load_secs[i] * battery_load_ua[i];
+            battery_load_secs[i] = 0;
+        }
+    }
+    EXIT_CRITICAL_SECTION(int_state);
+
+    battery_used += uas;
+
+    /* Average of about the last 8 days */
+    if (++battery_day_minutes == 24 * 60) {
+        battery_per_day += ((int32_t)(battery_used - battery_day_start)
+            - (int32_t)battery_per_day) / 8;
+        battery_day_start = battery_used;
+        battery_day_minutes = 0;
+    }
+}
+
+/* Charge left by the discharge curve in 0.1 %, all of it on the plateau */
+static uint16_t battery_curve(uint16_t v)
+{
+    uint8_t i;
+
+    if (v >= battery_curve_v[0])
+        return 1000;
+
+    for (i = 1; i < BATTERY_CURVE_POINTS - 1 && v < battery_curve_v[i]; i++)
+        ;
+
+    if (v <= battery_curve_v[i])
+        return battery_curve_left[i];
+
+    return battery_curve_left[i] + (v - battery_curve_v[i])
+        * (battery_curve_left[i - 1] - battery_curve_left[i])
+        / (battery_curve_v[i - 1] - battery_curve_v[i]);
+}
+
+/* Charge left from the count, pulled down to the discharge curve once
+   the cell is in its knee. Only a voltage at rest is used, and only to
+   lower the estimate, so a sag or a noisy reading cannot add charge.
+   The curve has to be lower for a few readings in a row, and then the
+   highest of them is taken, so the low end of the daily swing and of
+   the noise does not ratchet the estimate down. */
+static void battery_estimate(void)
+{
+    uint32_t left = battery_used < BATTERY_CAPACITY_UAS
+        ? BATTERY_CAPACITY_UAS - battery_used : 0;
+    uint32_t curve;
+
+    if (battery_rest >= BATTERY_REST_MINUTES && !(battery_loads_on
+        & ((1 << BATTERY_LOAD_BUZZER) | (1 << BATTERY_LOAD_RADIO)))) {
+        curve = (BATTERY_CAPACITY_UAS / 1000)
+            * battery_curve(battery_info.voltage + BATTERY_STABLE_DELTA);
+
+        if (left <= curve) {
+            battery_low_readings = 0;
+        } else if (!battery_low_readings++ || curve > battery_low_curve) {
+            battery_low_curve = curve;
+        }
+
+        if (battery_low_readings >= BATTERY_CURVE_READINGS) {
+            battery_low_readings = 0;
+            curve = battery_low_curve < left ? battery_low_curve : left;
+            /* not drawn today, keep it out of the daily average */
+            battery_day_start += left - curve;
+            left = curve;
+            battery_used = BATTERY_CAPACITY_UAS - curve;
+        }
+    }
+
+    battery_info.soc = left / (BATTERY_CAPACITY_UAS / 100);
+
+    left /= battery_per_day;
+    battery_info.days = left > 9999 ? 9999 : left;
+}
+
+/* Called every minute, counts the charge drawn and measures when the
+   interval is up. The interval doubles while the voltage holds and halves
+   when it moves, so a cell that drifts by millivolts a week is measured a
+   few times a day. Near the low threshold and right after a load it is
+   kept short. Returns 1 when a new voltage and estimate are available. */
+uint8_t battery_minute(void)
+{
+    uint16_t last = battery_info.voltage;
+    uint16_t delta;
+
+    battery_count();
+
+    if (battery_load_ended) {
+        battery_load_ended = 0;
+        battery_rest = 0;
+        battery_interval = BATTERY_INTERVAL_MIN;
+        battery_countdown = 0;
+    } else if (battery_rest < 0xff) {
+        battery_rest++;
+    }
+
+    if (battery_countdown > 1) {
+        battery_countdown--;
+        return 0;
+    }
+
+    battery_measurement();
+    battery_estimate();
+
+    delta = battery_info.voltage > last ? battery_info.voltage - last
+        : last - battery_info.voltage;
+
+    if (delta <= BATTERY_STABLE_DELTA) {
+        if (battery_interval < BATTERY_INTERVAL_MAX)
+            battery_interval <<= 1;
+    } else if (battery_interval > BATTERY_INTERVAL_MIN) {
+        battery_interval >>= 1;
+    }
+
+    if (battery_info.voltage < BATTERY_LOW_THRESHOLD + BATTERY_LOW_MARGIN
+        && battery_interval > BATTERY_INTERVAL_LOW)
+        battery_interval = BATTERY_INTERVAL_LOW;
+
+    battery_countdown = battery_interval;
+
+    return 1;
+}
 
 void battery_measurement(void)
 {
@@ -64,6 +64,7 @@
 
 void battery_init(void);
 void battery_measurement(void);
+uint8_t battery_minute(void);
 
 /* Battery high voltage threshold */
 #define BATTERY_HIGH_THRESHOLD          (360u)
@@ -78,12 +79,58 @@ void battery_measurement(void);
 /* Where we consider the battery empty */
 #define BATTERY_EMPTY_THRESHOLD         (220u)
 
+/* Minutes between measurements, doubled while the voltage holds */
+#define BATTERY_INTERVAL_MIN            (1u)
+#define BATTERY_INTERVAL_MAX            (128u)
+
+/* Change between two measurements that still counts as holding */
+#define BATTERY_STABLE_DELTA            (2u)
+
+/* Longest interval this close above BATTERY_LOW_THRESHOLD */
+#define BATTERY_LOW_MARGIN              (20u)
+#define BATTERY_INTERVAL_LOW            (16u)
+
+/* Readings at rest in a row the discharge curve has to be below the
+   charge counted before it overrides it */
+#define BATTERY_CURVE_READINGS          (2u)
+
+/* CR2032 capacity down to BATTERY_EMPTY_THRESHOLD */
+#define BATTERY_CAPACITY_MAH            (220ul)
+
+/* Current draw in uA: sleeping with the display on, and each load */
+#define BATTERY_BASE_UA                 (8u)
+#define BATTERY_BUZZER_UA               (4000u)
+#define BATTERY_RADIO_UA                (15000u)
+#define BATTERY_ACCEL_UA                (70u)
+#define BATTERY_MOTION_UA               (10u)
+
+/* Minutes after the buzzer or radio before the voltage is back at rest */
+#define BATTERY_REST_MINUTES            (10u)
+
+/* Loads reported by the drivers, see battery_load_start() */
+enum battery_load {
+    BATTERY_LOAD_BUZZER = 0,
+    BATTERY_LOAD_RADIO,
+    BATTERY_LOAD_ACCEL,     /* acceleration sensor measuring */
+    BATTERY_LOAD_MOTION,    /* acceleration sensor in motion detection */
+    BATTERY_LOADS
+};
+
+void battery_load_start(enum battery_load load);
+void battery_load_stop(enum battery_load load);
+
 struct {
     /* Battery voltage */
     uint16_t voltage;
 
     /* Battery voltage offset */
     int16_t offset;
+
+    /* State of charge in percent */
+    uint8_t soc;
+
+    /* Days left at the average use of the last week or so */
+    uint16_t days;
 } battery_info;
 
 #endif /* __BATTERY_H__ */
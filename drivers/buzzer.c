@@ -23,16 +23,24 @@
 **/
 
 #include "buzzer.h"
-#include "timer.h"
+#include "melody.h"
+#include "battery.h"
+#include "utils.h"
 
 #define DURATION(note) (note >> 6)
 #define OCTAVE(note) ((note >> 4) & 0x0003)
 #define PITCH(note) (note & 0x000F)
 
-note welcome[4] = {0x1931, 0x1934, 0x1938, 0x000F};
+/* TA1 runs from SMCLK, which boot.c sets to 12MHz */
+#define BUZZER_TICKS_PER_MS 12000ul
+
+/* Requests waiting behind the one playing */
+#define BUZZER_QUEUE 4
+
+const note welcome[4] = {0x1931, 0x1934, 0x1938, 0x000F};
 
 // The following note table is calculated using "clock frequency in hz / sound frequency in hz"
-uint16_t base_notes[13] = {
+static const uint16_t base_notes[13] = {
         0,     /* 0: P  */
         27273, /* 1: A  */
         25742, /* 2: A# */
@@ -48,71 +56,311 @@ uint16_t base_notes[13] = {
         14447  /* C: G# */
 };
 
-volatile static note *notes = NULL;
+enum buzzer_source {
+    BUZZER_NOTES,
+    BUZZER_MELODY,
+    BUZZER_PATTERN
+};
+
+struct buzzer_request {
+    const void *src;
+    uint8_t source;     /* enum buzzer_source */
+    uint8_t priority;   /* enum buzzer_priority */
+};
+
+static volatile bool buzzer_playing;
+static struct buzzer_request buzzer_now;
+
+/* Highest priority first, in order of arrival within one priority */
+static struct buzzer_request buzzer_queue[BUZZER_QUEUE];
+static uint8_t buzzer_queued;
+
+/* Read position in whatever buzzer_now.src is */
+static const note *notes;
+static uint8_t pattern_beeps;
+static bool pattern_gap;
+static uint16_t notes_loops;
+static bool notes_since_loop;
+
+static uint8_t buzzer_volume = BUZZER_VOLUME_MAX;
+static uint8_t note_volume;
+
+/* SMCLK ticks left of the current note, counted down a period at a time */
+static int32_t note_left;
 
 inline bool is_buzzer_playing() {
-    return notes != NULL;
+    return buzzer_playing;
 }
 
 inline void buzzer_init(void) {
-    /* Reset TA1R, TA1 runs from 32768Hz ACLK */
+    /* Reset TA1R, TA1 runs from 12MHz SMCLK */
     TA1CTL = TACLR | TASSEL__SMCLK | MC__STOP;
 
-    /* Enable IRQ, set output mode "toggle" */
-    TA1CCTL0 = OUTMOD_4;
+    /* TA1CCR0 sets the period, TA1CCR1 drives P2.7 */
+    TA1CCTL0 = 0;
+    TA1CCTL1 = OUTMOD_0;
 
     /* Play "welcome" chord: A major */
-    buzzer_play(welcome);
+    buzzer_play(welcome, BUZZER_PRIO_FEEDBACK);
 }
 
-inline static void buzzer_stop(void) {
+void buzzer_set_volume(uint8_t volume) {
+    if (volume > BUZZER_VOLUME_MAX)
+        volume = BUZZER_VOLUME_MAX;
+
+    /* takes effect with the next note */
+    buzzer_volume = volume;
+}
+
+static void buzzer_off(void) {
     /* Stop PWM timer */
     TA1CTL &= ~MC_3; // Clear any MC bits, effectively a MC_STOP
 
     /* Disable buzzer PWM output */
+    TA1CCTL1 = OUTMOD_0;
     P2OUT &= ~BIT7;
     P2SEL &= ~BIT7;
 
     /* Clear PWM timer interrupt */
     TA1CCTL0 &= ~CCIE;
+
+    buzzer_playing = false;
+
+    /* Let the battery driver count the load and see the cell recover */
+    battery_load_stop(BATTERY_LOAD_BUZZER);
+}
+
+void buzzer_stop(void) {
+    uint16_t int_state;
+
+    ENTER_CRITICAL_SECTION(int_state);
+    buzzer_queued = 0;
+    if (buzzer_playing)
+        buzzer_off();
+    EXIT_CRITICAL_SECTION(int_state);
+}
+
+/* Make the request the one playing, from its start */
+static void buzzer_load(const struct buzzer_request *request) {
+    buzzer_now = *request;
+
+    notes = buzzer_now.src;
+    if (buzzer_now.source == BUZZER_MELODY)
+        melody_start(buzzer_now.src);
+    pattern_beeps = 0;
+    pattern_gap = false;
+    notes_loops = 0;
+    notes_since_loop = false;
+    note_volume = buzzer_volume;
+}
+
+static bool buzzer_dequeue(void) {
+    uint8_t i;
+
+    if (!buzzer_queued)
+        return false;
+
+    buzzer_load(&buzzer_queue[0]);
+    buzzer_queued--;
+    for (i = 0; i < buzzer_queued; i++)
+        buzzer_queue[i] = buzzer_queue[i + 1];
+    return true;
+}
+
+/* Synthesizes the beeps of a pattern, nothing of it is stored */
+static note pattern_read(const struct buzzer_pattern *pattern) {
+    uint8_t step;
+
+    if (pattern_gap) {
+        pattern_gap = false;
+        return pattern->gap << 6;
+    }
+
+    if (pattern->repeat && pattern_beeps == pattern->repeat)
+        return 0x000F;
+
+    if (pattern->crescendo) {
+        step = pattern_beeps / pattern->crescendo;
+        note_volume = step < BUZZER_VOLUME_MAX ? step : BUZZER_VOLUME_MAX;
+    }
+
+    /* a pattern without a repeat count goes on at the volume reached */
+    if (pattern_beeps < 0xFF)
+        pattern_beeps++;
+
+    pattern_gap = pattern->gap != 0;
+    return pattern->tone;
+}
+
+/* Hands out the notes one by one, whatever the source */
+static note buzzer_read(void) {
+    if (buzzer_now.source == BUZZER_NOTES)
+        return *notes++;
+
+    if (buzzer_now.source == BUZZER_PATTERN)
+        return pattern_read(buzzer_now.src);
+
+    return melody_read();
 }
 
-static void buzzer_play_callback() {
-    /* 0x000F is the "stop bit" */
-    if (PITCH(*notes) != 0x000F) {
-        if (PITCH(*notes) == 0) {
-            /* Stop the timer! We are playing a rest */
-            TA1CTL &= ~MC_3;
+static void buzzer_rewind(void) {
+    notes = buzzer_now.src;
+    if (buzzer_now.source == BUZZER_MELODY)
+        melody_start(buzzer_now.src);
+}
+
+/*
+  Loads the next note into TA1. A tone runs in up mode with TA1CCR0 as the
+  period and TA1CCR1 in reset/set mode as the duty cycle, a rest keeps the
+  output low and ticks every millisecond. Either way TA1CCR0 interrupts
+  once per period and the ISR counts the note length down in SMCLK ticks.
+  At the end of a request the next one in the queue follows right away.
+*/
+static void buzzer_next(void) {
+    note n;
+    uint16_t period;
+
+    for (;;) {
+        n = buzzer_read();
+
+        if (PITCH(n) == 0x000F) {
+            if (buzzer_dequeue())
+                continue;
+            buzzer_off();
+            return;
+        }
+
+        if (PITCH(n) != 0x000E)
+            break;
+
+        /* loop note */
+        if (DURATION(n) == 0) {
+            notes_loops = 1;
+        } else if (notes_loops == 0) {
+            notes_loops = DURATION(n);
         } else {
-            /* Set PWM frequency */
-            TA1CCR0 = base_notes[PITCH(*notes)] >> OCTAVE(*notes);
+            notes_loops--;
+        }
 
-            /* Start the timer */
-            TA1CTL |= MC__UP;
+        if (notes_loops) {
+            /* there has to be something to repeat */
+            if (!notes_since_loop) {
+                if (buzzer_dequeue())
+                    continue;
+                buzzer_off();
+                return;
+            }
+            buzzer_rewind();
+            notes_since_loop = false;
         }
+    }
 
-        /* Calculate duration delay in ms */
-        uint16_t delay = DURATION(*notes);
+    notes_since_loop = true;
 
-        /* Advance to the next note */
-        notes++;
+    if (PITCH(n) == 0 || PITCH(n) > 12) {
+        /* A rest, stop driving the buzzer */
+        TA1CCTL1 = OUTMOD_0;
+        TA1CCR0 = BUZZER_TICKS_PER_MS - 1;
+    } else {
+        /* One full period is twice the half period in the table */
+        period = (base_notes[PITCH(n)] >> OCTAVE(n)) << 1;
+
+        /* 50% duty is the loudest, every step down halves it */
+        TA1CCR0 = period - 1;
+        TA1CCR1 = period >> (BUZZER_VOLUME_MAX + 1 - note_volume);
+        TA1CCTL1 = OUTMOD_7;
+    }
+
+    note_left = DURATION(n) * BUZZER_TICKS_PER_MS;
+}
+
+static bool buzzer_pending(const void *src) {
+    uint8_t i;
+
+    if (buzzer_playing && buzzer_now.src == src)
+        return true;
+
+    for (i = 0; i < buzzer_queued; i++) {
+        if (buzzer_queue[i].src == src)
+            return true;
+    }
+    return false;
+}
 
-        /* Delay for DURATION(*notes) milliseconds */
-        timer0_delay_callback(delay, &buzzer_play_callback);
+static void buzzer_enqueue(const struct buzzer_request *request) {
+    uint8_t i, j;
+
+    /* behind everything of the same or a higher priority */
+    for (i = 0; i < buzzer_queued; i++) {
+        if (buzzer_queue[i].priority < request->priority)
+            break;
+    }
+
+    /* a full queue loses its lowest request, which may be this one */
+    if (i == BUZZER_QUEUE)
+        return;
+    if (buzzer_queued < BUZZER_QUEUE)
+        buzzer_queued++;
+
+    for (j = buzzer_queued - 1; j > i; j--)
+        buzzer_queue[j] = buzzer_queue[j - 1];
+    buzzer_queue[i] = *request;
+}
+
+static void buzzer_request(const void *src, uint8_t source,
+                           enum buzzer_priority priority) {
+    struct buzzer_request request = { src, source, priority };
+    uint16_t int_state;
+
+    ENTER_CRITICAL_SECTION(int_state);
+
+    if (buzzer_pending(src)) {
+        /* already on its way */
+    } else if (!buzzer_playing) {
+        buzzer_load(&request);
+        buzzer_playing = true;
+
+        buzzer_next();
+        if (buzzer_playing) {
+            /* Allow buzzer PWM output on P2.7 */
+            P2SEL |= BIT7;
+
+            battery_load_start(BATTERY_LOAD_BUZZER);
+
+            /* From here on only the TA1CCR0 interrupt walks the notes */
+            TA1CTL = TACLR | TASSEL__SMCLK | MC__UP;
+            TA1CCTL0 = CCIE;
+        }
+    } else if (priority > buzzer_now.priority) {
+        /* the request playing is dropped, TA1 goes on with this one */
+        buzzer_load(&request);
+        buzzer_next();
     } else {
-        /* Stop buzzer */
-        buzzer_stop();
-        notes = NULL;
+        buzzer_enqueue(&request);
     }
+
+    EXIT_CRITICAL_SECTION(int_state);
 }
 
-void buzzer_play(note *async_notes) {
-    if (notes) return; // Ignore if we are currently playing.
+void buzzer_play(const note *notes, enum buzzer_priority priority) {
+    buzzer_request(notes, BUZZER_NOTES, priority);
+}
 
-    notes = async_notes;
+void buzzer_play_melody(const struct melody *melody,
+                        enum buzzer_priority priority) {
+    buzzer_request(melody, BUZZER_MELODY, priority);
+}
+
+void buzzer_play_pattern(const struct buzzer_pattern *pattern,
+                         enum buzzer_priority priority) {
+    buzzer_request(pattern, BUZZER_PATTERN, priority);
+}
 
-    /* Allow buzzer PWM output on P2.7 */
-    P2SEL |= BIT7;
+__attribute__((interrupt(TIMER1_A0_VECTOR)))
+void timer1_A0_ISR(void) {
+    /* One period of the tone, or a millisecond of a rest, has passed */
+    note_left -= TA1CCR0 + 1;
 
-    buzzer_play_callback();
-}
\ No newline at end of file
+    if (note_left <= 0)
+        buzzer_next();
+}
@@ -29,7 +29,9 @@
  * The buzzer can play a number of different tones, represented as a
  * note array.
  * The buzzer output frequency can be calculated using:
- * \f[ \frac{T_{\mathrm{ACLK}}}{2*\mathrm{TA1CCR0}} \f]
+ * \f[ \frac{T_{\mathrm{SMCLK}}}{\mathrm{TA1CCR0}+1} \f]
+ * The melody is walked by the TA1CCR0 interrupt alone, neither Timer0
+ * nor the main loop are involved once it is started.
  */
 #ifndef BUZZER_H_
 #define BUZZER_H_
@@ -45,8 +47,12 @@ bool is_buzzer_playing();
  * - The next 2 bits represent the octave
  * - The following 10 bits are the duration in ms of the note.
  *
- * There are two "meta" notes:
+ * There are three "meta" notes:
  * - The note xxx0 represents no tone (a rest).
+ * - The note xxxE is the "loop note", it plays the sequence again \
+ *   from the start as often as the duration bits say, or until \
+ *   buzzer_stop() when they are zero. Notes after it play once the \
+ *   loops are done.
  * - The note xxxF represents the "stop note" marking the \
  *   end of a note sequence.
  *
@@ -60,10 +66,69 @@ typedef uint16_t note;
  */
 void buzzer_init(void);
 
+/*!
+ * \brief Who gets the buzzer.
+ * \details A request of a higher priority than the one playing cuts it \
+ * off, the one playing is dropped. Anything else waits in a short queue \
+ * behind the requests of the same or a higher priority. A request that \
+ * is already playing or waiting is not queued twice.
+ */
+enum buzzer_priority {
+    BUZZER_PRIO_FEEDBACK = 0,   /*!< key presses, sensor cues */
+    BUZZER_PRIO_CHIME,          /*!< hourly chime */
+    BUZZER_PRIO_MUSIC,          /*!< tunes played on request */
+    BUZZER_PRIO_ALARM           /*!< alarm clock */
+};
+
 /*!
  * \brief Play a sequence of notes using the buzzer.
- * \param notes An array of notes to play.
+ * \param notes An array of notes to play, it is read while playing.
+ * \param priority See #buzzer_priority.
+ */
+void buzzer_play(const note *notes, enum buzzer_priority priority);
+
+/* see melody.h */
+struct melody;
+
+/*!
+ * \brief Play a compressed melody using the buzzer.
+ * \details The stream is decoded a note at a time from the buzzer \
+ * interrupt, the melody never gets expanded into RAM.
+ */
+void buzzer_play_melody(const struct melody *melody,
+                        enum buzzer_priority priority);
+
+/*!
+ * \brief Beeps synthesized while playing.
+ * \details \b tone beeps, each followed by \b gap ms of silence. With \
+ * \b crescendo set, the first beeps play at the lowest volume and the \
+ * volume goes up a step every \b crescendo beeps.
+ */
+struct buzzer_pattern {
+    note tone;          /*!< pitch, octave and length of a beep */
+    uint16_t gap;       /*!< ms of silence after each beep, up to 1023 */
+    uint8_t repeat;     /*!< number of beeps, 0 beeps until buzzer_stop() */
+    uint8_t crescendo;  /*!< beeps per volume step, 0 for the set volume */
+};
+
+/*!
+ * \brief Play a pattern of beeps using the buzzer.
+ */
+void buzzer_play_pattern(const struct buzzer_pattern *pattern,
+                         enum buzzer_priority priority);
+
+/*!
+ * \brief Stop the sequence that is playing, if any, and drop the queue.
+ */
+void buzzer_stop(void);
+
+#define BUZZER_VOLUME_MAX 3
+
+/*!
+ * \brief Set the buzzer volume for the notes to come.
+ * \param volume 0 to #BUZZER_VOLUME_MAX, each step doubles the \
+ * PWM duty cycle up to 50%.
  */
-void buzzer_play(note *notes);
-extern note welcome[4];
+void buzzer_set_volume(uint8_t volume);
+extern const note welcome[4];
 #endif /*BUZZER_H_*/
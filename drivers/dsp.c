@@ -1,48 +1,154 @@
-/*
- * dsp.c
- *
- * Some basic DSP routines that make efficient use of the MSP430 hardware multiplier.
- * For some reason inline combination of this code tends to be messed up by the
- * msp430-gcc compiler, so we stick with the call overhead.
- *
- *  Created on: Aug 5, 2010
- *      Author: Niek Lambert
- */
-
-// *************************************************************************************************
-// Include section
-
-// logic
-#include "dsp.h"
-
-// *************************************************************************************************
-// @fn          mult_scale16
-// @brief       Multiply and scale rounded by 16 bits
-// @param       a multiply operand 1
-// @param       b multiply operand 2
-// @return      (int16_t)((int32_t)a*b + 0x8000) >> 16
-// *************************************************************************************************
-int16_t mult_scale16(int16_t a, int16_t b)
-{
-#define HALF ((int32_t)0x8000)
-    return (int16_t)(((int32_t)a * b + HALF) >> 16);
-}
-
-// *************************************************************************************************
-// @fn          mult_scale15
-// @brief       Multiply and scale rounded by 15 bits
-// @param       a multiply operand 1
-// @param       b multiply operand 2
-// @return      (int16_t)(((int32_t)a*b << 1) + 0x8000) >> 16
-// *************************************************************************************************
-int16_t mult_scale15(int16_t a, int16_t b)
-{
-#define HALF ((int32_t)0x8000)
-    int32_t ff;
-    ff = ((int32_t)a * b);
-    // Note 1: The sequence of a separate << 1 and >>16 operation produces
-    //         far more efficient compiled code than >> 15.
-    // Note 2: Combining the shift(s) with previous statement is not accepted by the compiler.
-    ff <<= 1;
-    return (int16_t)((ff + HALF) >> 16);
-}
+/*
+ * dsp.c
+ *
+ * Some basic DSP routines that make efficient use of the MSP430 hardware multiplier.
+ * For some reason inline combination of this code tends to be messed up by the
+ * msp430-gcc compiler, so we stick with the call overhead.
+ *
+ *  Created on: Aug 5, 2010
+ *      Author: Niek Lambert
+ */
+
+// *************************************************************************************************
+// Include section
+
+// logic
+#include "dsp.h"
+
+// *************************************************************************************************
+// @fn          mult_scale16
+// @brief       Multiply and scale rounded by 16 bits
+// @param       a multiply operand 1
+// @param       b multiply operand 2
+// @return      (int16_t)((int32_t)a*b + 0x8000) >> 16
+// *************************************************************************************************
+int16_t mult_scale16(int16_t a, int16_t b)
+{
+#define HALF ((int32_t)0x8000)
+    return (int16_t)(((int32_t)a * b + HALF) >> 16);
+}
+
+// *************************************************************************************************
+// @fn          mult_scale15
+// @brief       Multiply and scale rounded by 15 bits
+// @param       a multiply operand 1
+// @param       b multiply operand 2
+// @return      (int16_t)(((int32_t)a*b << 1) + 0x8000) >> 16
+// *************************************************************************************************
+int16_t mult_scale15(int16_t a, int16_t b)
+{
+#define HALF ((int32_t)0x8000)
+    int32_t ff;
+    ff = ((int32_t)a * b);
+    // Note 1: The sequence of a separate << 1 and >>16 operation produces
+    //         far more efficient compiled code than >> 15.
+    // Note 2: Combining the shift(s) with previous statement is not accepted by the compiler.
+    ff <<= 1;
+    return (int16_t)((ff + HALF) >> 16);
+}
+
+// *************************************************************************************************
+// @fn          iir1_init
+// @brief       Set up a first order IIR low pass
+// @param       f filter state
+// @param       a smoothing factor (Q15), the weight of a new sample
+// @param       y initial output
+// @return      none
+// *************************************************************************************************
+void iir1_init(struct iir1 *f, int16_t a, int16_t y)
+{
+    f->a = a;
+    f->y = y;
+}
+
+// *************************************************************************************************
+// @fn          iir1_filter
+// @brief       Feed one sample to a first order IIR low pass
+// @param       f filter state
+// @param       x new sample
+// @return      filtered value
+// *************************************************************************************************
+int16_t iir1_filter(struct iir1 *f, int16_t x)
+{
+    f->y += mult_scale15(f->a, x - f->y);
+    return f->y;
+}
+
+// *************************************************************************************************
+// @fn          movavg_init
+// @brief       Set up a moving average with all taps at x
+// @param       f filter state
+// @param       buf storage for 2^len_log2 samples
+// @param       len_log2 log2 of the window length
+// @param       x initial value
+// @return      none
+// *************************************************************************************************
+void movavg_init(struct movavg *f, int16_t *buf, uint8_t len_log2, int16_t x)
+{
+    uint8_t i;
+
+    f->buf = buf;
+    f->len_log2 = len_log2;
+    f->pos = 0;
+    for (i = 0; i < (1 << len_log2); i++)
+        buf[i] = x;
+    f->sum = (int32_t)x << len_log2;
+}
+
+// *************************************************************************************************
+// @fn          movavg_filter
+// @brief       Feed one sample to a moving average
+// @param       f filter state
+// @param       x new sample
+// @return      average of the last 2^len_log2 samples
+// *************************************************************************************************
+int16_t movavg_filter(struct movavg *f, int16_t x)
+{
+    f->sum += x - f->buf[f->pos];
+    f->buf[f->pos] = x;
+    f->pos = (f->pos + 1) & ((1 << f->len_log2) - 1);
+    return (int16_t)(f->sum >> f->len_log2);
+}
+
+// *************************************************************************************************
+// @fn          biquad_init
+// @brief       Reset the history of a biquad to the steady state of a constant input
+// @param       f filter state, coefficients already set
+// @param       x initial value
+// @return      none
+// *************************************************************************************************
+void biquad_init(struct biquad *f, int16_t x)
+{
+    f->x1 = f->x2 = x;
+    f->y1 = f->y2 = x;
+}
+
+// *************************************************************************************************
+// @fn          biquad_filter
+// @brief       Feed one sample to a biquad
+// @param       f filter state
+// @param       x new sample
+// @return      y = b0*x + b1*x1 + b2*x2 - a1*y1 - a2*y2
+// *************************************************************************************************
+int16_t biquad_filter(struct biquad *f, int16_t x)
+{
+    int32_t acc;
+    int16_t y;
+
+    // the five products can add up past 16 bits
+    acc = (int32_t)mult_scale15(f->b0, x) + mult_scale15(f->b1, f->x1)
+        + mult_scale15(f->b2, f->x2)
+        - mult_scale15(f->a1, f->y1) - mult_scale15(f->a2, f->y2);
+    if (acc > INT16_MAX / 2)
+        acc = INT16_MAX / 2;
+    else if (acc < INT16_MIN / 2)
+        acc = INT16_MIN / 2;
+    // coefficients are halved
+    y = (int16_t)acc << 1;
+
+    f->x2 = f->x1;
+    f->x1 = x;
+    f->y2 = f->y1;
+    f->y1 = y;
+    return y;
+}
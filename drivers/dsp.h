@@ -17,4 +17,36 @@
 extern int16_t mult_scale16(int16_t a, int16_t b); // returns (int16_t)((int32_t)a*b + 0x8000) >> 16
 extern int16_t mult_scale15(int16_t a, int16_t b); // returns (int16_t)(((int32_t)a*b << 1) + 0x8000) >> 16
 
+// *************************************************************************************************
+// Fixed point filters. Coefficients are Q15 (32768 = 1.0), inputs should stay within +-16384
+// so that differences of two samples do not overflow.
+
+// First order IIR low pass: y += a * (x - y)
+struct iir1 {
+    int16_t a;      // smoothing factor, Q15
+    int16_t y;      // last output
+};
+
+// Moving average over 2^len_log2 samples
+struct movavg {
+    int16_t *buf;   // 2^len_log2 samples, provided by the caller
+    int32_t sum;
+    uint8_t len_log2;
+    uint8_t pos;
+};
+
+// Biquad in direct form I. All coefficients are stored halved (Q15 of c/2) so
+// that the usual |a1| < 2 of a stable filter fits, a0 is normalized to 1.
+struct biquad {
+    int16_t b0, b1, b2, a1, a2;
+    int16_t x1, x2, y1, y2;
+};
+
+extern void iir1_init(struct iir1 *f, int16_t a, int16_t y);
+extern int16_t iir1_filter(struct iir1 *f, int16_t x);
+extern void movavg_init(struct movavg *f, int16_t *buf, uint8_t len_log2, int16_t x);
+extern int16_t movavg_filter(struct movavg *f, int16_t x);
+extern void biquad_init(struct biquad *f, int16_t x);
+extern int16_t biquad_filter(struct biquad *f, int16_t x);
+
 #endif /*DSP_H_*/
@@ -4,7 +4,7 @@
  * use as desired but do not remove this notice
  */
 
-#include "project.h"
+#include "openchronos.h"
 
 #ifndef INFOMEM_H_
 #define INFOMEM_H_
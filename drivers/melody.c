@@ -0,0 +1,57 @@
+/**
+    drivers/melody.c: compressed melodies kept in flash
+
+    http://github.com/BenjaminSoelberg/openchronos-ng-elf
+
+    This file is part of openchronos-ng.
+
+    openchronos-ng is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    openchronos-ng is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#include "melody.h"
+
+/* Read position in the melody playing, called from the buzzer interrupt */
+static const struct melody *melody_now;
+static const uint8_t *melody_pos;
+static note melody_last;
+static uint8_t melody_run;
+
+void melody_start(const struct melody *melody) {
+    melody_now = melody;
+    melody_pos = melody->stream;
+    melody_run = 0;
+}
+
+note melody_read(void) {
+    uint8_t byte;
+
+    if (melody_run) {
+        melody_run--;
+        return melody_last;
+    }
+
+    byte = *melody_pos++;
+    if (byte == MELODY_END)
+        return 0x000F;
+
+    if (byte >= MELODY_RUN) {
+        /* this one is the first of the repeats, the reserved
+           MELODY_RUN itself is taken as a run of one */
+        melody_run = byte > MELODY_RUN ? byte - MELODY_RUN - 1 : 0;
+        return melody_last;
+    }
+
+    melody_last = melody_now->dictionary[byte];
+    return melody_last;
+}
@@ -0,0 +1,64 @@
+/**
+    drivers/melody.h: compressed melodies kept in flash
+
+    http://github.com/BenjaminSoelberg/openchronos-ng-elf
+
+    This file is part of openchronos-ng.
+
+    openchronos-ng is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    openchronos-ng is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+/*!
+ * \file melody.h
+ * \brief Compressed melody format and its stream decoder.
+ * \details Melodies are compiled from the .rtttl files in modules/tunes \
+ * by contrib/rtttl2bin.py at build time and played with \
+ * buzzer_play_melody().
+ */
+#ifndef MELODY_H_
+#define MELODY_H_
+
+#include "openchronos.h"
+#include "buzzer.h"
+
+/*!
+ * \brief Compressed melody, kept in flash.
+ * \details All melodies share one note dictionary. Each stream byte is \
+ * one of:
+ * - below #MELODY_RUN: the dictionary index of the next note.
+ * - #MELODY_RUN + n, n from 1: the previous note n more times.
+ * - #MELODY_END: the end of the melody.
+ * #MELODY_RUN itself is reserved, the compiler never writes it.
+ */
+struct melody {
+    const note *dictionary;
+    const uint8_t *stream;
+};
+
+#define MELODY_RUN 0x80
+#define MELODY_END 0xFF
+
+/*!
+ * \brief Start decoding a melody from its first note.
+ */
+void melody_start(const struct melody *melody);
+
+/*!
+ * \brief The next note of the melody started last.
+ * \details Decodes one note at a time, the melody never gets expanded \
+ * into RAM. Returns the stop note at the end of the melody.
+ */
+note melody_read(void);
+
+#endif /* MELODY_H_ */
@@ -28,11 +28,11 @@
 /* drivers */
 #include "ports.h"
 #include "timer.h"
+#include "rtca.h"
 #include "utils.h"
 
-#ifdef CONFIG_MOD_ACCELEROMETER
 #include "vti_as.h"
-#endif
+#include "vti_ps.h"
 
 #define ALL_BUTTONS 0x1F
 
@@ -42,6 +42,9 @@ volatile enum ports_buttons ports_down_btns;
 /* contains confirmed button presses (long and short) */
 volatile enum ports_buttons ports_pressed_btns;
 
+/* rtca_ticks() of the last button edge */
+volatile uint32_t ports_pressed_ticks;
+
 volatile static uint8_t timer_20Hz_started = 0;
 static uint16_t last_press;
 
@@ -164,6 +167,9 @@ void PORT2_ISR(void)
 {
     /* If the interrupt is a button press */
     if (P2IFG & ALL_BUTTONS) {
+        /* the press is only confirmed later, remember when it happened */
+        ports_pressed_ticks = rtca_ticks();
+
         /* turn on 20 Hz callback*/
         if (!timer_20Hz_started) {
             last_press = timer0_20hz_counter;
@@ -173,12 +179,19 @@ void PORT2_ISR(void)
     }
 
     /* Handle accelerometer */
-    #ifdef CONFIG_MOD_ACCELEROMETER
+    #ifdef AS_ENABLED
     /* Check if accelerometer interrupt flag */
     if ((P2IFG & AS_INT_PIN) == AS_INT_PIN)
-        as_last_interrupt = 1;
+        as_data_ready();
     #endif
 
+    /* Handle pressure sensor, DRDY is only enabled while it samples */
+    if ((P2IFG & P2IE & PS_INT_PIN) == PS_INT_PIN) {
+        P2IFG &= ~PS_INT_PIN;
+        ps_last_interrupt = 1;
+        _BIC_SR_IRQ(LPM3_bits);
+    }
+
     /* A write to the interrupt vector, automatically clears the
      latest interrupt */
     P2IV = 0x00;
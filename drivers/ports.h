@@ -60,6 +60,7 @@
 #define __PORTS_H__
 
 #include <stdbool.h>
+#include <stdint.h>
 #include "config.h"
 
 /* Button ports */
@@ -87,6 +88,10 @@ enum ports_buttons {
     PORTS_BTN_LUP       = BIT9,
 };
 
+/* rtca_ticks() at the edge of the last button press, for modules that
+   need the moment of a press rather than when it reached them */
+extern volatile uint32_t ports_pressed_ticks;
+
 /* Global keypress peek, should normally NOT use be used, unless a global hook is needed */
 uint8_t ports_button_pressed_peek(uint8_t btn, uint8_t with_longpress);
 bool is_ports_button_pressed();
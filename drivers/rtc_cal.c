@@ -0,0 +1,140 @@
+/**
+    drivers/rtc_cal.c: temperature compensation of the RTC crystal
+
+    http://github.com/BenjaminSoelberg/openchronos-ng-elf
+
+    This file is part of openchronos-ng.
+
+    openchronos-ng is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    openchronos-ng is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#include "openchronos.h"
+
+#ifdef CONFIG_RTC_CAL
+
+#include "rtca.h"
+#include "temperature.h"
+
+#include "rtc_cal.h"
+
+/* crystal error in ppb summed over the readings of this hour */
+static int32_t rtc_cal_sum;
+static int32_t rtc_cal_temp_sum;
+static uint8_t rtc_cal_samples;
+
+/* ppb hours the RTCCAL steps missed so far, made up in the hours after */
+static int32_t rtc_cal_residual;
+
+/* ppb hours applied since power on */
+static int32_t rtc_cal_applied;
+
+// *************************************************************************************************
+// @fn          rtc_cal_ppb
+// @brief       Crystal frequency error at a temperature
+// @param       int16_t temp    Temperature in 0.1 degree C
+// @return      int32_t         Error in ppb, negative when the clock runs slow
+// *************************************************************************************************
+static int32_t rtc_cal_ppb(int16_t temp)
+{
+    int32_t d = temp - RTC_CAL_TURNOVER;
+
+    /* (d / 10)^2 degrees squared, the division is last to keep 0.1 C */
+    return RTC_CAL_OFFSET - (d * d * RTC_CAL_CURVE) / 100;
+}
+
+static void rtc_cal_sample(void)
+{
+    int16_t temp;
+
+    temperature_measurement();
+    temperature_get_C(&temp);
+
+    /* the curve is not linear, so average the error, not the temperature */
+    rtc_cal_sum += rtc_cal_ppb(temp);
+    rtc_cal_temp_sum += temp;
+    rtc_cal_samples++;
+}
+
+// *************************************************************************************************
+// @fn          rtc_cal_apply
+// @brief       Set RTCCAL for the next hour from the error of the last one
+// @param       none
+// @return      none
+// *************************************************************************************************
+static void rtc_cal_apply(void)
+{
+    int32_t want, error;
+    int8_t steps;
+
+    if (!rtc_cal_samples)
+        return;
+
+    error = rtc_cal_sum / rtc_cal_samples;
+    rtc_cal_info.temp = rtc_cal_temp_sum / rtc_cal_samples;
+    rtc_cal_info.ppm = error / 10;
+    rtc_cal_sum = 0;
+    rtc_cal_temp_sum = 0;
+    rtc_cal_samples = 0;
+
+    /* The steps are coarse, 4 ppm up and 2 ppm down. Whatever one hour
+       misses is carried into the next, so the mean comes out right. */
+    want = rtc_cal_residual - error;
+
+    if (want >= 0) {
+        steps = (want + RTC_CAL_STEP_UP / 2) / RTC_CAL_STEP_UP;
+        if (steps > RTC_CAL_STEPS_MAX)
+            steps = RTC_CAL_STEPS_MAX;
+        rtc_cal_residual = want - (int32_t)steps * RTC_CAL_STEP_UP;
+        rtc_cal_applied += (int32_t)steps * RTC_CAL_STEP_UP;
+        RTCCTL2 = RTCCALS | steps;
+        rtc_cal_info.cal = steps;
+    } else {
+        steps = (-want + RTC_CAL_STEP_DOWN / 2) / RTC_CAL_STEP_DOWN;
+        if (steps > RTC_CAL_STEPS_MAX)
+            steps = RTC_CAL_STEPS_MAX;
+        rtc_cal_residual = want + (int32_t)steps * RTC_CAL_STEP_DOWN;
+        rtc_cal_applied -= (int32_t)steps * RTC_CAL_STEP_DOWN;
+        RTCCTL2 = steps;
+        rtc_cal_info.cal = -steps;
+    }
+
+    /* a ppm for an hour is 3.6 ms */
+    rtc_cal_info.total = rtc_cal_applied / 1000 * 36 / 10;
+}
+
+void rtc_cal_init(void)
+{
+    rtc_cal_sample();
+    rtc_cal_apply();
+}
+
+// *************************************************************************************************
+// @fn          rtc_cal_minute
+// @brief       Called by the main loop every minute. Reads the temperature every
+//              RTC_CAL_SAMPLE_MINUTES and sets RTCCAL on the hour.
+// @param       none
+// @return      none
+// *************************************************************************************************
+void rtc_cal_minute(void)
+{
+    if (rtca_time.min % RTC_CAL_SAMPLE_MINUTES)
+        return;
+
+    rtc_cal_sample();
+
+    if (rtca_time.min == 0)
+        rtc_cal_apply();
+}
+
+#endif /* CONFIG_RTC_CAL */
@@ -0,0 +1,51 @@
+/**
+    drivers/rtc_cal.h: temperature compensation of the RTC crystal
+
+    http://github.com/BenjaminSoelberg/openchronos-ng-elf
+
+    This file is part of openchronos-ng.
+
+    openchronos-ng is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    openchronos-ng is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#ifndef RTC_CAL_H_
+#define RTC_CAL_H_
+
+#include "openchronos.h"
+
+/* A 32 kHz tuning fork crystal slows down on both sides of its turnover
+   temperature by CONFIG_RTC_CAL_CURVE ppb per degree squared. */
+#define RTC_CAL_TURNOVER        (CONFIG_RTC_CAL_TURNOVER * 10)
+#define RTC_CAL_CURVE           (CONFIG_RTC_CAL_CURVE)
+#define RTC_CAL_OFFSET          (CONFIG_RTC_CAL_OFFSET)
+
+/* Minutes between two temperature readings, RTCCAL is set every hour */
+#define RTC_CAL_SAMPLE_MINUTES  (10u)
+
+/* RTCCAL steps in ppb, up (RTCCALS set) and down */
+#define RTC_CAL_STEP_UP         (4069)
+#define RTC_CAL_STEP_DOWN       (2035)
+#define RTC_CAL_STEPS_MAX       (63)
+
+void rtc_cal_init(void);
+void rtc_cal_minute(void);
+
+struct {
+    int16_t temp;       /* mean of the last hour in 0.1 degree C */
+    int16_t ppm;        /* crystal error of the last hour in 0.01 ppm */
+    int8_t cal;         /* RTCCAL steps set, negative for down */
+    int32_t total;      /* correction applied since power on in ms */
+} rtc_cal_info;
+
+#endif /* RTC_CAL_H_ */
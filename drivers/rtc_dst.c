@@ -26,195 +26,106 @@
 
 #ifdef CONFIG_RTC_DST
 
-/* "private" defines */
-#define N_SUN_OF_MON(n,mon,year) (((n)*7)-rtc_dst_day_of_week((year),(mon),((n)*7)))
-#define LAST_SUN_OF_MON(mon,days,year) ((days)-rtc_dst_day_of_week((year),(mon),(days)))
-#define DSTNUM(x,y,z) (((uint16_t)(x)*1000)+(uint16_t)(y*10)+(uint16_t)(z))
-
 #include "rtca.h"
+#include "utils.h"
 
 #include "rtc_dst.h"
+#include "rtc_dst_table.h"
 
-/* "private" functions */
-uint8_t rtc_dst_isDateInDST(uint8_t month, uint8_t day, uint8_t hour);
+#define RTC_DST_TRANSITIONS (sizeof(rtc_dst_table) / sizeof(rtc_dst_table[0]))
 
-struct rtc_dst_date_struct rtc_dst_dates[2];
 uint8_t rtc_dst_state;
+uint32_t rtc_dst_next_epoch;
 
-uint8_t rtc_dst_day_of_week(uint16_t year, uint8_t month, uint8_t day);
+/* index of the next switch in rtc_dst_table */
+static uint8_t rtc_dst_next;
 
+static void rtc_dst_set_next(uint8_t next)
+{
+    rtc_dst_next = next;
+
+    /* into DST at every other entry, starting with the first or second */
+    if ((next & 1) == RTC_DST_TABLE_STARTS_DST)
+        rtc_dst_state = RTC_DST_STATE_DST;
+    else
+        rtc_dst_state = RTC_DST_STATE_ST;
+
+    /* time changes always occur at 2AM */
+    if (next < RTC_DST_TRANSITIONS)
+        rtc_dst_next_epoch = RTC_DST_TABLE_EPOCH
+            + rtc_dst_table[next] * 86400ul + 2 * 3600ul;
+    else
+        rtc_dst_next_epoch = 0;
+}
 
 /****************************************************************************/
 /* DST initialize function. This is called by the module config setup       */
 /****************************************************************************/
 void rtc_dst_init(void)
 {
-    /* Calculate when to switch dates */
-    rtc_dst_calculate_dates(rtca_time.year, rtca_time.mon, rtca_time.day, rtca_time.hour);
+    rtc_dst_sync();
 }
 
 /******************************************************************************/
-/* This function is called on hour changes by the rtca interrupt handler.     */
-/* It implements the time changes on the appropriate days.                    */
+/* Looks up the next switch in the table. It should be called whenever the    */
+/* date/time is changed.                                                      */
+/* This may be wrong if you set your watch in the hour after falling back.    */
 /******************************************************************************/
-void rtc_dst_hourly_update(void)
+void rtc_dst_sync(void)
 {
-    if (rtca_time.hour == 2) {
-        /* time changes always occur at 2AM */
-        if (rtc_dst_state == RTC_DST_STATE_ST) {
-            if (rtca_time.mon == rtc_dst_dates[0].month && rtca_time.day == rtc_dst_dates[0].day) {
-                /* spring forward */
-                rtc_dst_state = RTC_DST_STATE_DST;
-                rtca_time.hour++;
-                rtca_set_time();
-            }
-        } else {
-            /* rtc_dst_state == RTC_DST_STATE_DST */
-            if (rtca_time.mon == rtc_dst_dates[1].month && rtca_time.day == rtc_dst_dates[1].day) {
-                /* fall back */
-                rtc_dst_state = RTC_DST_STATE_ST;
-                rtca_time.hour--;
-                rtca_set_time();
-            }
-        }
+    uint32_t now = rtca_epoch();
+    uint16_t int_state;
+    uint16_t day;
+    uint8_t i = 0;
+
+    if (now >= RTC_DST_TABLE_EPOCH + 2 * 3600ul) {
+        /* the hours before 2AM are still on the day before */
+        day = (now - RTC_DST_TABLE_EPOCH - 2 * 3600ul) / 86400ul;
+        for (; i < RTC_DST_TRANSITIONS && rtc_dst_table[i] <= day; i++);
     }
-}
 
-/********************************************************************************/
-/* This function calculates the new date for DST switching. It should be called */
-/* once a year, or whenever the date/time is changed                            */
-/* @param uint8_t month The current month.                                      */
-/* @param uint8_t day   The current day.                                        */
-/* @param uint8_t hour  The current hour (to get the DST right if time is changed on day of DST switch). */
-/********************************************************************************/
+    /* the RTC interrupt compares rtc_dst_next_epoch every second */
+    ENTER_CRITICAL_SECTION(int_state);
+    rtc_dst_set_next(i);
+    EXIT_CRITICAL_SECTION(int_state);
+}
 
-void rtc_dst_calculate_dates(uint16_t year, uint8_t month, uint8_t day, uint8_t hour)
+/******************************************************************************/
+/* Called by the rtca interrupt handler at the second of the switch. It       */
+/* moves the clock and makes the one after the next switch.                   */
+/******************************************************************************/
+void rtc_dst_switch(void)
 {
+    uint8_t next = rtc_dst_next + 1;
 
-#if (CONFIG_RTC_DST_ZONE == DST_US)
-    // DST in US/Canada: 2nd Sun in Mar to 1st Sun in Nov.
-    rtc_dst_dates[0].month = 3;
-    rtc_dst_dates[0].day = N_SUN_OF_MON(2, 3, year);
-    rtc_dst_dates[1].month = 11;
-    rtc_dst_dates[1].day = N_SUN_OF_MON(1, 11, year);
-#endif
-#if (CONFIG_RTC_DST_ZONE == DST_MEX)
-    // DST in Mexico: first Sun in Apr to last Sun in Oct.
-    rtc_dst_dates[0].month = 4;
-    rtc_dst_dates[0].day = N_SUN_OF_MON(1, 4, year);
-    rtc_dst_dates[1].month = 10;
-    rtc_dst_dates[1].day = LAST_SUN_OF_MON(10, 31, year);
-#endif
-#if (CONFIG_RTC_DST_ZONE == DST_BRZ)
-    // DST in Brazil: third Sun in Oct to third Sun in Feb.
-    rtc_dst_dates[0].month = 10;
-    rtc_dst_dates[0].day = N_SUN_OF_MON(3, 10, year);
-    rtc_dst_dates[1].month = 2;
-    rtc_dst_dates[1].day = N_SUN_OF_MON(3, 2, year);
-#endif
-#if (CONFIG_RTC_DST_ZONE == DST_EU)
-    // DST in EU/UK: last Sun in Mar to last Sun in Oct.
-    rtc_dst_dates[0].month = 3;
-    rtc_dst_dates[0].day = LAST_SUN_OF_MON(3, 31, year);
-    rtc_dst_dates[1].month = 10;
-    rtc_dst_dates[1].day = LAST_SUN_OF_MON(10, 31, year);
-#endif
-#if (CONFIG_RTC_DST_ZONE == DST_AUS)
-    // DST in Australia: first Sun in Oct to first Sun in Apr.
-    rtc_dst_dates[0].month = 10;
-    rtc_dst_dates[0].day = N_SUN_OF_MON(1, 10, year);
-    rtc_dst_dates[1].month = 4;
-    rtc_dst_dates[1].day = N_SUN_OF_MON(1, 4, year);
-#endif
-#if (CONFIG_RTC_DST_ZONE == DST_NZ)
-    // DST in New Zealand: last Sun in Sep to first Sun in Apr.
-    rtc_dst_dates[0].month = 9;
-    rtc_dst_dates[0].day = LAST_SUN_OF_MON(9, 30, year);
-    rtc_dst_dates[1].month = 4;
-    rtc_dst_dates[1].day = N_SUN_OF_MON(1, 4, year);
-#endif
-
-    // This test may be wrong if you set your watch
-    // on the time-change day.
-    rtc_dst_state = (rtc_dst_isDateInDST(month, day, hour)) ? RTC_DST_STATE_DST : RTC_DST_STATE_ST;
-}
+    rtc_dst_set_next(next);
 
-/* Figure out if the specified hour on the specified day is within the DST range */
-uint8_t rtc_dst_isDateInDST(uint8_t month, uint8_t day, uint8_t hour)
-{
-    /* clip hour to a single digit since we only care which side of 2AM it is */
-    /* and we're going to do comparisons via a MMDDH integer in 16 bits */
-    if (hour > 9) hour = 9;
-
-    if (rtc_dst_dates[0].month < rtc_dst_dates[1].month) {
-        /* Northern hemisphere */
-        return
-            ((DSTNUM(month, day, hour) >= DSTNUM(rtc_dst_dates[0].month, rtc_dst_dates[0].day, 2)) &&
-             (DSTNUM(month, day, hour) < DSTNUM(rtc_dst_dates[1].month, rtc_dst_dates[1].day, 2)));
+    if (rtc_dst_state == RTC_DST_STATE_DST) {
+        /* spring forward */
+        rtca_time.hour = 3;
     } else {
-        /* Southern hemisphere */
-        return (!(
-                ((DSTNUM(month, day, hour) >= DSTNUM(rtc_dst_dates[1].month, rtc_dst_dates[1].day,2)) &&
-                 (DSTNUM(month, day, hour) < DSTNUM(rtc_dst_dates[0].month, rtc_dst_dates[0].day,2)))));
+        /* fall back */
+        rtca_time.hour = 1;
     }
+    rtca_time.min = 0;
+    rtca_time.sec = 0;
+    rtca_set_time();
+
+    /* in the hour after falling back rtc_dst_sync() from rtca_set_time()
+       finds this switch again */
+    rtc_dst_set_next(next);
 }
 
-uint8_t rtc_dst_day_of_week(uint16_t year, uint8_t month, uint8_t day)
+uint32_t rtc_dst_next_transition(void)
 {
-    /* Calculate days since 2000-01-01 */
-    uint32_t tmp = (year % 200) * 365;
-    tmp += (((year % 200) + 3) / 4); // leap days
-
-    switch (month) { // using lots of drop-through!
-    case 12:
-        tmp += 30; /* for nov */
-
-    case 11:
-        tmp += 31; /* for oct */
-
-    case 10:
-        tmp += 30; /* for sep */
+    uint16_t int_state;
+    uint32_t epoch;
 
-    case 9:
-        tmp += 31; /* for aug */
+    ENTER_CRITICAL_SECTION(int_state);
+    epoch = rtc_dst_next_epoch;
+    EXIT_CRITICAL_SECTION(int_state);
 
-    case 8:
-        tmp += 31; /* for jul */
-
-    case 7:
-        tmp += 30; /* for jun */
-
-    case 6:
-        tmp += 31; /* for may */
-
-    case 5:
-        tmp += 30; /* for apr */
-
-    case 4:
-        tmp += 31; /* for mar */
-
-    case 3:
-        tmp += 28; /* for feb */
-
-        if ((year % 4) == 0) {
-            tmp++;
-        }
-
-    case 2:
-        tmp += 31; /* for jan */
-
-    case 1:
-    default:
-        /* do nothing */
-        break;
-    }
-
-    tmp += day;
-    tmp--; /* because day-of-month is 1-based (2000-01-01 is the ZERO day). */
-
-    /* day zero (2000-01-01) was a Saturday. */
-    return (uint8_t)((tmp + 6) % 7);
+    return epoch;
 }
 
 #endif /* CONFIG_RTC_DST */
-
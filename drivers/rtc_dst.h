@@ -35,16 +35,22 @@
 #define DST_AUS 5
 #define DST_NZ 6
 
-struct rtc_dst_date_struct {
-    uint8_t month;
-    uint8_t day;
-};
-
-extern struct rtc_dst_date_struct dst_dates[];
 extern uint8_t rtc_dst_state;
 
+/* local time epoch of the next switch, for the RTC interrupt to compare
+   every second against. 0 past the end of the table. */
+extern uint32_t rtc_dst_next_epoch;
+
 void rtc_dst_init(void);
-void rtc_dst_calculate_dates(uint16_t year, uint8_t month, uint8_t day, uint8_t hour);
-void rtc_dst_hourly_update(void);
+
+/* find the next switch again after the date or time was set */
+void rtc_dst_sync(void);
+
+/* switch now, the RTC interrupt calls this at rtc_dst_next_epoch */
+void rtc_dst_switch(void);
+
+/* local time epoch (see rtca_epoch()) of the next switch, or 0 when it
+   is past the tabulated years */
+uint32_t rtc_dst_next_transition(void);
 
 #endif
@@ -24,6 +24,7 @@
 
 #include "rtca.h"
 #include "rtca_now.h"
+#include "utils.h"
 
 #ifdef CONFIG_RTC_DST
 #include "rtc_dst.h"
@@ -44,6 +45,90 @@ uint8_t display_am_pm = 1;
 uint8_t display_am_pm = 0;
 #endif
 
+/* seconds since 1970-01-01 00:00:00, ticked by the ISR and only
+   recomputed from the calendar when the time or date is set */
+static volatile uint32_t rtca_epoch_sec;
+
+/* days before the first of each month in a non leap year */
+static const uint16_t rtca_days_before_month[12] = {
+    0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334
+};
+
+static void rtca_update_epoch(void)
+{
+    uint16_t y = rtca_time.year - 1;
+    uint32_t days;
+
+    /* leap days before this year, minus the 477 before 1970 */
+    days = (uint32_t)(rtca_time.year - 1970) * 365
+        + (y / 4 - y / 100 + y / 400) - 477;
+
+    days += rtca_days_before_month[rtca_time.mon - 1] + rtca_time.day - 1;
+    if (rtca_time.mon > 2 && IS_LEAP_YEAR(rtca_time.year))
+        days++;
+
+    rtca_epoch_sec = ((days * 24 + rtca_time.hour) * 60
+        + rtca_time.min) * 60 + rtca_time.sec;
+}
+
+uint32_t rtca_epoch(void)
+{
+    uint16_t int_state;
+    uint32_t epoch;
+
+    /* a 32bit read is two instructions, keep the ISR out */
+    ENTER_CRITICAL_SECTION(int_state);
+    epoch = rtca_epoch_sec;
+    EXIT_CRITICAL_SECTION(int_state);
+
+    return epoch;
+}
+
+/*
+  In calendar mode RT0PS counts ACLK and RT1PS its 128 Hz overflow, the
+  low 15 bits of RTCPS are the 1/32768 s since the last second. The
+  counters run from ACLK, so a read is only trusted while RTCRDY is up
+  and RTCPS reads the same twice. This may spin a little, so it is done
+  with interrupts on.
+*/
+static uint16_t rtca_prescaler(void)
+{
+    uint16_t ps;
+
+    do {
+        ps = RTCPS;
+    } while (!(RTCCTL01 & (RTCRDY | RTCHOLD)) || ps != RTCPS);
+
+    return ps & 0x7FFF;
+}
+
+/*
+  Only the second needs the ISR kept out: a second already ticked by the
+  RTC but not yet by the ISR still has its RTCRDYIFG pending. Should a
+  second go by between reading the prescaler and the second, the
+  prescaler has wrapped since and it is read again.
+*/
+uint32_t rtca_ticks(void)
+{
+    uint16_t int_state;
+    uint16_t ctl, ps;
+    uint32_t sec;
+
+    do {
+        ps = rtca_prescaler();
+
+        ENTER_CRITICAL_SECTION(int_state);
+        ctl = RTCCTL01;
+        sec = rtca_time.sys;
+        EXIT_CRITICAL_SECTION(int_state);
+    } while (rtca_prescaler() < ps);
+
+    if (ctl & RTCRDYIFG)
+        sec++;
+
+    return (sec << RTCA_TICKS_SHIFT) | (ps >> (15 - RTCA_TICKS_SHIFT));
+}
+
 void rtca_init(void)
 {
     rtca_time.year = COMPILE_YEAR;
@@ -53,6 +138,7 @@ void rtca_init(void)
     rtca_time.hour = COMPILE_HOUR;
     rtca_time.min = COMPILE_MIN;
     rtca_time.sec = 59; // So we can see the watch is working after reset
+    rtca_update_epoch();
 
 #ifdef CONFIG_RTC_IRQ
     /* Enable calendar mode (date/time registers are automatically reset)
@@ -123,8 +209,15 @@ void rtca_set_time()
     RTCMIN = rtca_time.min;
     RTCHOUR = rtca_time.hour;
 
+    rtca_update_epoch();
+
     /* Resume RTC time keeping */
     rtca_start();
+
+#ifdef CONFIG_RTC_DST
+    /* look up the next DST switch */
+    rtc_dst_sync();
+#endif
 }
 
 void rtca_get_alarm(uint8_t *hour, uint8_t *min)
@@ -226,12 +319,14 @@ void rtca_set_date()
     RTCYEARL = rtca_time.year & 0xff;
     RTCYEARH = rtca_time.year >> 8;
 
+    rtca_update_epoch();
+
     /* Resume RTC time keeping */
     rtca_start();
 
 #ifdef CONFIG_RTC_DST
-    /* calculate new DST switch dates */
-    rtc_dst_calculate_dates(rtca_time.year, rtca_time.mon, rtca_time.day, rtca_time.hour);
+    /* look up the next DST switch */
+    rtc_dst_sync();
 #endif
 }
 __attribute__((interrupt(RTC_A_VECTOR)))
@@ -243,13 +338,18 @@ void RTC_A_ISR(void)
     /* copy register values */
     rtca_time.sec = RTCSEC;
 
-    /* count system time */
-    rtca_time.sys++;
-
     enum rtca_tevent ev = 0;
 
     /* second event (from the read ready interrupt flag) */
     if (iv == RTCIV_RTCRDYIFG) {    /* Did second changed */
+        /* count system time, the other events are no new second */
+        rtca_time.sys++;
+        rtca_epoch_sec++;
+#ifdef CONFIG_RTC_DST
+        /* >= so a switch is not missed by a second, 0 is none left */
+        if (rtc_dst_next_epoch && rtca_epoch_sec >= rtc_dst_next_epoch)
+            rtc_dst_switch();
+#endif
         ev = RTCA_EV_SECOND;
         goto finish;
     }
@@ -270,10 +370,6 @@ void RTC_A_ISR(void)
         ev |= RTCA_EV_HOUR;
         rtca_time.hour = RTCHOUR;
 
-#ifdef CONFIG_RTC_DST
-        rtc_dst_hourly_update();
-#endif
-
         if (rtca_time.hour != 0)    /* Day changed */
             goto finish;
 
@@ -292,10 +388,6 @@ void RTC_A_ISR(void)
 
         ev |= RTCA_EV_YEAR;
         rtca_time.year = RTCYEARL | (RTCYEARH << 8);
-#ifdef CONFIG_RTC_DST
-        /* calculate new DST switch dates */
-        rtc_dst_calculate_dates(rtca_time.year, rtca_time.mon, rtca_time.day, rtca_time.hour);
-#endif
     }
 
 finish:
@@ -69,6 +69,16 @@ void rtca_init(void);
 uint8_t rtca_get_max_days(uint8_t month, uint16_t year);
 
 void rtca_update_dow(struct DATETIME *datetime);
+
+/* seconds since 1970-01-01 00:00:00 of the RTC (local) time */
+uint32_t rtca_epoch(void);
+
+/* monotonic timestamp: 1/RTCA_TICKS_HZ seconds since power on, from the
+   system seconds and the RTC prescalers. It wraps after about 48 days,
+   so only compare differences. The ticks pause while the RTC is held. */
+#define RTCA_TICKS_SHIFT 10
+#define RTCA_TICKS_HZ (1u << RTCA_TICKS_SHIFT)
+uint32_t rtca_ticks(void);
 void rtca_set_time();
 void rtca_set_date();
 
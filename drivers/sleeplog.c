@@ -0,0 +1,121 @@
+/**
+    drivers/sleeplog.c: night log from accelerometer motion counts
+
+    http://github.com/BenjaminSoelberg/openchronos-ng-elf
+
+    This file is part of openchronos-ng.
+
+    openchronos-ng is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    openchronos-ng is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+/*
+ * The sensor counts motion in ACTIVITY_MODE on its own, the CPU only sees
+ * the number of events per minute. Each minute is reduced to one of four
+ * levels and packed at 2 bits into a fixed table, with a running total per
+ * level. A wake up is a run of active minutes after the wearer has been
+ * still for a while, so turning over in bed does not count.
+ */
+
+// *************************************************************************************************
+// Include section
+
+// logic
+#include "sleeplog.h"
+
+// *************************************************************************************************
+// @fn          sleeplog_init
+// @brief       Start a new night
+// @param       l log to clear
+// @return      none
+// *************************************************************************************************
+void sleeplog_init(struct sleeplog *l)
+{
+    uint8_t i;
+
+    for (i = 0; i < sizeof(l->hist); i++)
+        l->hist[i] = 0;
+
+    for (i = 0; i < 4; i++)
+        l->level_minutes[i] = 0;
+
+    l->minutes = 0;
+    l->wakeups = 0;
+    l->quiet = 0;
+    l->active = 0;
+    l->asleep = 0;
+}
+
+// *************************************************************************************************
+// @fn          sleeplog_minute
+// @brief       Log one minute
+// @param       l log
+// @param       events motion events in the minute
+// @return      level the minute was logged at
+// *************************************************************************************************
+enum sleeplog_level sleeplog_minute(struct sleeplog *l, uint16_t events)
+{
+    enum sleeplog_level level;
+
+    if (events >= SLEEPLOG_ACTIVE_EVENTS)
+        level = SLEEPLOG_ACTIVE;
+    else if (events >= SLEEPLOG_MOVING_EVENTS)
+        level = SLEEPLOG_MOVING;
+    else if (events >= SLEEPLOG_LIGHT_EVENTS)
+        level = SLEEPLOG_LIGHT;
+    else
+        level = SLEEPLOG_STILL;
+
+    if (l->minutes < SLEEPLOG_MINUTES)
+        l->hist[l->minutes >> 2] |= level << ((l->minutes & 3) << 1);
+
+    if (l->minutes < 0xffff)
+        l->minutes++;
+    l->level_minutes[level]++;
+
+    if (level == SLEEPLOG_ACTIVE) {
+        l->quiet = 0;
+        if (l->active < 0xff)
+            l->active++;
+    } else {
+        l->active = 0;
+        if (level <= SLEEPLOG_LIGHT && l->quiet < 0xff)
+            l->quiet++;
+    }
+
+    if (l->quiet >= SLEEPLOG_ASLEEP_MINUTES)
+        l->asleep = 1;
+
+    if (l->asleep && l->active >= SLEEPLOG_WAKE_MINUTES) {
+        l->asleep = 0;
+        if (l->wakeups < 0xff)
+            l->wakeups++;
+    }
+
+    return level;
+}
+
+// *************************************************************************************************
+// @fn          sleeplog_level_at
+// @brief       Level of a logged minute
+// @param       l log
+// @param       minute minutes since the start of the night
+// @return      level, SLEEPLOG_STILL past the end of the log
+// *************************************************************************************************
+enum sleeplog_level sleeplog_level_at(const struct sleeplog *l, uint16_t minute)
+{
+    if (minute >= SLEEPLOG_MINUTES || minute >= l->minutes)
+        return SLEEPLOG_STILL;
+
+    return (l->hist[minute >> 2] >> ((minute & 3) << 1)) & 3;
+}
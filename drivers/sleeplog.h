@@ -0,0 +1,71 @@
+/**
+    drivers/sleeplog.h: night log from accelerometer motion counts
+
+    http://github.com/BenjaminSoelberg/openchronos-ng-elf
+
+    This file is part of openchronos-ng.
+
+    openchronos-ng is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    openchronos-ng is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+// *************************************************************************************************
+#ifndef SLEEPLOG_H_
+#define SLEEPLOG_H_
+
+// Include section
+#include "openchronos.h"
+
+// *************************************************************************************************
+// Defines section
+
+// Minutes kept in the log, 8 hours at 2 bits per minute is 120 bytes
+#define SLEEPLOG_MINUTES        (480u)
+
+// Motion events per minute that start each level above SLEEPLOG_STILL
+#define SLEEPLOG_LIGHT_EVENTS   (1u)
+#define SLEEPLOG_MOVING_EVENTS  (4u)
+#define SLEEPLOG_ACTIVE_EVENTS  (16u)
+
+// Still or light minutes, since the last active one, before the wearer is taken to be asleep
+#define SLEEPLOG_ASLEEP_MINUTES (15u)
+
+// Active minutes in a row that count as waking up
+#define SLEEPLOG_WAKE_MINUTES   (2u)
+
+enum sleeplog_level {
+    SLEEPLOG_STILL = 0,
+    SLEEPLOG_LIGHT,
+    SLEEPLOG_MOVING,
+    SLEEPLOG_ACTIVE
+};
+
+// *************************************************************************************************
+// Global Variable section
+struct sleeplog {
+    uint8_t hist[SLEEPLOG_MINUTES / 4];  // one level per minute, first minute in the low bits
+    uint16_t minutes;                   // minutes logged, keeps counting past SLEEPLOG_MINUTES
+    uint16_t level_minutes[4];          // minutes spent at each level
+    uint8_t wakeups;
+    uint8_t quiet;                      // still or light minutes since the last active one
+    uint8_t active;                     // active minutes in a row, saturates
+    uint8_t asleep;
+};
+
+// *************************************************************************************************
+// Prototypes section
+extern void sleeplog_init(struct sleeplog *l);
+extern enum sleeplog_level sleeplog_minute(struct sleeplog *l, uint16_t events);
+extern enum sleeplog_level sleeplog_level_at(const struct sleeplog *l, uint16_t minute);
+
+#endif /*SLEEPLOG_H_*/
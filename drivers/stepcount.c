@@ -0,0 +1,148 @@
+/**
+    drivers/stepcount.c: step detection on accelerometer samples
+
+    http://github.com/BenjaminSoelberg/openchronos-ng-elf
+
+    This file is part of openchronos-ng.
+
+    openchronos-ng is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    openchronos-ng is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+/*
+ * Step detection on 2g range CMA3000 samples. Every sample takes the same
+ * path: a magnitude estimate, a band pass of two first order IIRs (0.5 Hz
+ * high pass against gravity, 4 Hz low pass against jitter), a threshold
+ * halfway between a decaying peak and trough envelope, and a check that
+ * steps come at a walking or running cadence. That is two software
+ * multiplies and no loops per sample.
+ */
+
+// *************************************************************************************************
+// Include section
+
+// logic
+#include "stepcount.h"
+
+// *************************************************************************************************
+// @fn          stepcount_coef
+// @brief       Smoothing factor of a first order IIR low pass
+// @param       fc10 cut-off frequency in 0.1 Hz
+// @param       rate sample rate in Hz
+// @return      a = 1 - exp(-w) in Q15, approximated by w / (1 + w/2), w = 2 pi fc / rate
+// *************************************************************************************************
+static int16_t stepcount_coef(uint16_t fc10, uint8_t rate)
+{
+    // 205887 = 2 pi * 32768, 355 / 113 = pi
+    return (int16_t)((205887uL * fc10) / (10u * rate + (fc10 * 355u) / 113u));
+}
+
+static int16_t abs16(int16_t v)
+{
+    return v < 0 ? -v : v;
+}
+
+// *************************************************************************************************
+// @fn          stepcount_init
+// @brief       Reset the step detector
+// @param       s detector state
+// @param       rate sample rate in Hz, 40 to 100
+// @return      none
+// *************************************************************************************************
+void stepcount_init(struct stepcount *s, uint8_t rate)
+{
+    iir1_init(&s->gravity, stepcount_coef(5, rate), 0);
+    iir1_init(&s->smooth, stepcount_coef(40, rate), 0);
+    s->peak = 0;
+    s->trough = 0;
+    s->decay = rate > 64 ? 6 : 5;
+    s->above = 0;
+    s->since_step = 0xff;
+    // 4 steps per second at most, one step per two seconds at least
+    s->min_interval = rate / 4;
+    s->max_interval = rate < 127 ? 2 * rate : 0xfe;
+    s->run = 0;
+    s->steps = 0;
+}
+
+// *************************************************************************************************
+// @fn          stepcount_feed
+// @brief       Feed one X/Y/Z sample
+// @param       s detector state
+// @param       xyz raw 2's complement sample from the sensor
+// @return      number of steps added to s->steps
+// *************************************************************************************************
+uint8_t stepcount_feed(struct stepcount *s, const uint8_t *xyz)
+{
+    int16_t a = abs16((int8_t)xyz[0]);
+    int16_t b = abs16((int8_t)xyz[1]);
+    int16_t c = abs16((int8_t)xyz[2]);
+    int16_t t, mag, v, swing, hyst;
+
+    // |xyz| ~ max + 3/8 * (mid + min), within 7%
+    if (a < b) { t = a; a = b; b = t; }
+    if (a < c) { t = a; a = c; c = t; }
+    mag = (a << 6) + (((b + c) * 3) << 3);
+
+    // The first sample sets the gravity estimate, there is nothing to settle
+    if (s->gravity.y == 0)
+        s->gravity.y = mag;
+
+    v = iir1_filter(&s->smooth, mag - iir1_filter(&s->gravity, mag));
+
+    // Envelope follows the signal at once and decays back towards it
+    if (v > s->peak)
+        s->peak = v;
+    else
+        s->peak -= (s->peak - v) >> s->decay;
+
+    if (v < s->trough)
+        s->trough = v;
+    else
+        s->trough += (v - s->trough) >> s->decay;
+
+    if (s->since_step < 0xff)
+        s->since_step++;
+
+    swing = s->peak - s->trough;
+    hyst = swing >> 3;
+    t = s->trough + (swing >> 1);
+
+    if (s->above) {
+        if (v < t - hyst)
+            s->above = 0;
+        return 0;
+    }
+
+    if (v <= t + hyst || swing < STEPCOUNT_MIN_SWING)
+        return 0;
+
+    // Rising through the threshold, a step unless it is a bounce of the last one
+    s->above = 1;
+    if (s->since_step < s->min_interval)
+        return 0;
+
+    if (s->since_step > s->max_interval)
+        s->run = 0;
+    s->since_step = 0;
+
+    if (s->run < STEPCOUNT_RUN) {
+        if (++s->run < STEPCOUNT_RUN)
+            return 0;
+        s->steps += STEPCOUNT_RUN;
+        return STEPCOUNT_RUN;
+    }
+
+    s->steps++;
+    return 1;
+}
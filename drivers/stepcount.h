@@ -0,0 +1,65 @@
+/**
+    drivers/stepcount.h: step detection on accelerometer samples, integer only
+
+    http://github.com/BenjaminSoelberg/openchronos-ng-elf
+
+    This file is part of openchronos-ng.
+
+    openchronos-ng is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    openchronos-ng is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+// *************************************************************************************************
+#ifndef STEPCOUNT_H_
+#define STEPCOUNT_H_
+
+// Include section
+#include "openchronos.h"
+#include "dsp.h"
+
+// *************************************************************************************************
+// Defines section
+
+// Candidate steps needed in a row at a plausible cadence before they are counted
+#define STEPCOUNT_RUN           (4u)
+
+// Smallest peak to peak swing of the filtered magnitude that is taken as a step,
+// about 0.15 g with 1 g = 56 counts << 6
+#define STEPCOUNT_MIN_SWING     (540)
+
+// Multiplies stepcount_feed() may take for one sample, the budget contrib/accel_replay
+// checks on every sample of a trace. The rest of the path is shifts and compares.
+#define STEPCOUNT_MULTS         (2u)
+
+// *************************************************************************************************
+// Global Variable section
+struct stepcount {
+    struct iir1 gravity;    // slow low pass, the static 1 g to subtract
+    struct iir1 smooth;     // fast low pass, the band pass output
+    int16_t peak;           // envelope of the band pass output
+    int16_t trough;
+    uint8_t decay;          // envelope decay shift, about one second
+    uint8_t above;          // output is above the threshold
+    uint8_t since_step;     // samples since the last step, saturates
+    uint8_t min_interval;   // cadence window in samples
+    uint8_t max_interval;
+    uint8_t run;            // steps in the current run, up to STEPCOUNT_RUN
+    uint32_t steps;
+};
+
+// *************************************************************************************************
+// Prototypes section
+extern void stepcount_init(struct stepcount *s, uint8_t rate);
+extern uint8_t stepcount_feed(struct stepcount *s, const uint8_t *xyz);
+
+#endif /*STEPCOUNT_H_*/
@@ -62,37 +62,24 @@
 #include "adc12.h"
 #include "timer.h"
 
-/* The code below is optimized to this value, DO NOT CHANGE */
-#define TEMPORAL_FILTER_WINDOW 4
-
-static uint8_t adcresult[TEMPORAL_FILTER_WINDOW];
-static uint8_t adcresult_idx = 0;
+/* One burst of 64 conversions, a 15 bit result */
+static uint16_t temperature_sample(void)
+{
+    return adc12_oversample(REFVSEL_0, ADC12SHT0_8, ADC12INCH_10,
+                            TEMPERATURE_OVERSAMPLE_BITS);
+}
 
 void temperature_init(void)
 {
-    temperature.value = adc12_single_conversion(REFVSEL_0,
-                        ADC12SHT0_8, ADC12INCH_10);
+    temperature.value = temperature_sample();
     temperature.offset = CONFIG_TEMPERATURE_OFFSET;
-
-    adcresult[0] = temperature.value;
-    adcresult[1] = temperature.value;
-    adcresult[2] = temperature.value;
-    adcresult[3] = temperature.value;
 }
 
 
 void temperature_measurement(void)
 {
     /* Convert internal temperature diode voltage */
-    adcresult[adcresult_idx++] = adc12_single_conversion(REFVSEL_0,
-                        ADC12SHT0_8, ADC12INCH_10);
-    if (adcresult_idx == TEMPORAL_FILTER_WINDOW)
-        adcresult_idx = 0;
-
-    /* Calculate temporal mean value */
-    temperature.value = (temperature.value & 0xff00)
-        | (((uint16_t)adcresult[0] + (uint16_t)adcresult[1]
-        + (uint16_t)adcresult[2] + (uint16_t)adcresult[3]) >> 2);
+    temperature.value = temperature_sample();
 }
 
 
@@ -102,8 +89,9 @@ void temperature_get_C(int16_t *temp)
     ((A10/4096*1500mV) - 680mV)*(1/2.25mV)
        = (A10/4096*667) - 302
        = (A10 - 1855) * (667 / 4096) */
-    *temp = (((int32_t)temperature.value + temperature.offset - 1855)
-        * 667 * 10) / 4096;
+    *temp = (((int32_t)temperature.value
+        + (int32_t)(temperature.offset - 1855) * (1 << TEMPERATURE_OVERSAMPLE_BITS))
+        * 667 * 10) / (4096L << TEMPERATURE_OVERSAMPLE_BITS);
 }
 
 void temperature_get_F(int16_t *temp)
@@ -118,7 +106,8 @@ void temperature_get_F(int16_t *temp)
     ((A10/4096*1500mV) - 640mV)*(1/1.25mV) =
       = (A10/4096*1200) - 512
       = (A10 - 1748) * (1200 / 4096) */
-    *temp = (((int32_t)temperature.value + temperature.offset - 1748)
-        * 1200 * 10) / 4096;
+    *temp = (((int32_t)temperature.value
+        + (int32_t)(temperature.offset - 1748) * (1 << TEMPERATURE_OVERSAMPLE_BITS))
+        * 1200 * 10) / (4096L << TEMPERATURE_OVERSAMPLE_BITS);
 }
 
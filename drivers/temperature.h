@@ -27,14 +27,17 @@
 
 #include "openchronos.h"
 
+/* ADC bits added by oversampling, temperature.value has 12 + these */
+#define TEMPERATURE_OVERSAMPLE_BITS 3
+
 void temperature_init(void);
 void temperature_measurement(void);
 void temperature_get_C(int16_t *temp);
 void temperature_get_F(int16_t *temp);
 
 struct {
-    uint16_t value;
-    int16_t offset;
+    uint16_t value;     /* A10 in 1/8 LSB */
+    int16_t offset;     /* calibration in A10 LSB */
 } temperature;
 
 #endif /* __TEMPERATURE_H__ */
@@ -55,13 +55,14 @@
 */
 
 #include "timer.h"
+#include "vti_ps.h"
 #include "wdt.h"
 #include "utils.h"
 #include "lpm.h"
 
 /* HARDWARE TIMER ASSIGNMENT:
      TA0CCR0: 20Hz timer used by the button driver
-     TA0CCR1: Unused
+     TA0CCR1: pressure sensor TWI bus clock, see drivers/vti_ps.c
      TA0CCR2: delay timer with callback
      TA0CCR3: programmable timer via messagebus
      TA0CCR4: timer0_delay, will enter LPMx to save power
@@ -243,6 +244,14 @@ void timer0_A1_ISR(void) {
     /* reading TA0IV automatically resets the interrupt flag */
     uint8_t flag = (uint8_t) TA0IV; // ISR reason. Only look at the lower 8 bits
 
+    /* pressure sensor TWI, one bus phase per tick */
+    if (flag == TA0IV_TA0CCR1) {
+        if (ps_twi_tick())
+            goto exit_lpm3;
+
+        return;
+    }
+
     /* programable timer */
     if (flag == TA0IV_TA0CCR3) {
         /* setup timer for next time */
@@ -0,0 +1,139 @@
+/**
+    drivers/vario.c: altitude and climb rate from barometric altitude
+
+    http://github.com/BenjaminSoelberg/openchronos-ng-elf
+
+    This file is part of openchronos-ng.
+
+    openchronos-ng is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    openchronos-ng is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+/*
+ * Two state Kalman filter, altitude and climb rate, on barometric altitude
+ * samples. The model is a constant climb rate driven by white vertical
+ * acceleration noise, the measurement is the altitude alone:
+ *
+ *     x = [h, v],  F = [1 dt; 0 1],  H = [1 0]
+ *     Q = sa^2 * [dt^4/4 dt^3/2; dt^3/2 dt^2],  R = sz^2
+ *
+ * with sa = 0.5 m/s^2, sz = 0.5 m and dt = 1 / VARIO_RATE_HZ. The filter
+ * starts from the first sample with P0 = diag(sz^2, (2 m/s)^2).
+ *
+ * Q and R are constant, so the covariance and the gain do not depend on the
+ * samples. The gains of the first VARIO_GAINS updates are worked out ahead
+ * of time and the last one is kept after that, it is the steady state gain
+ * within 0.1%. An update is then one 16 bit multiply for the prediction and
+ * two for the correction, no divisions and no covariance arithmetic.
+ * contrib/ps_replay/vario_replay.c checks this against the full filter.
+ */
+
+// *************************************************************************************************
+// Include section
+
+// logic
+#include "vario.h"
+
+// *************************************************************************************************
+// Global Variable section
+
+// Kalman gain per update: altitude gain in Q15, climb rate gain in Q14 (1/s)
+static const int16_t vario_gain[VARIO_GAINS][2] = {
+    { 17857, 13259 }, { 15565, 20895 }, { 15524, 22007 }, { 15263, 19612 },
+    { 14549, 16378 }, { 13615, 13428 }, { 12644, 11026 }, { 11724,  9140 },
+    { 10888,  7669 }, { 10142,  6518 }, {  9483,  5610 }, {  8900,  4886 },
+    {  8386,  4304 }, {  7932,  3832 }, {  7530,  3447 }, {  7174,  3131 },
+    {  6859,  2869 }, {  6580,  2653 }, {  6333,  2473 }, {  6114,  2324 },
+    {  5920,  2200 }, {  5750,  2098 }, {  5600,  2013 }, {  5469,  1943 },
+    {  5355,  1886 }, {  5255,  1839 }, {  5170,  1802 }, {  5097,  1772 },
+    {  5034,  1748 }, {  4982,  1730 }, {  4938,  1715 }, {  4901,  1705 },
+    {  4871,  1697 }, {  4847,  1691 }, {  4827,  1687 }, {  4811,  1685 },
+    {  4799,  1683 }, {  4790,  1683 }, {  4783,  1682 }, {  4778,  1683 },
+    {  4774,  1683 }, {  4771,  1683 }, {  4770,  1684 }, {  4768,  1684 },
+    {  4768,  1685 }, {  4767,  1685 }, {  4767,  1685 }, {  4767,  1685 },
+};
+
+
+// *************************************************************************************************
+// @fn          vario_init
+// @brief       Reset the filter, the next sample is taken as the altitude
+// @param       f filter state
+// @return      none
+// *************************************************************************************************
+void vario_init(struct vario *f)
+{
+    f->h = 0;
+    f->v = 0;
+    f->k = 0;
+    f->valid = 0;
+}
+
+// *************************************************************************************************
+// @fn          vario_update
+// @brief       Predict one sample period ahead and correct with a measurement
+// @param       f filter state
+// @param       alt_q2 measured altitude in 0.25 m, see conv_pa_to_altitude_q2()
+// @return      none
+// *************************************************************************************************
+void vario_update(struct vario *f, int16_t alt_q2)
+{
+    int32_t z = (int32_t)alt_q2 << 6;
+    int32_t r, v;
+
+    if (!f->valid) {
+        f->h = z;
+        f->valid = 1;
+        return;
+    }
+
+    // h += v * dt
+    f->h += ((int32_t)f->v * VARIO_DT_Q16 + 0x8000) >> 16;
+
+    // Innovation, clamped to +-128 m so that the products stay in 32 bits
+    r = z - f->h;
+    if (r >  32767) r =  32767;
+    if (r < -32767) r = -32767;
+
+    f->h += ((int32_t)(int16_t)r * vario_gain[f->k][0] + 0x4000) >> 15;
+
+    v = f->v + (((int32_t)(int16_t)r * vario_gain[f->k][1] + 0x2000) >> 14);
+    if (v >  32767) v =  32767;
+    if (v < -32767) v = -32767;
+    f->v = (int16_t)v;
+
+    if (f->k < VARIO_GAINS - 1)
+        f->k++;
+}
+
+// *************************************************************************************************
+// @fn          vario_altitude
+// @brief       Filtered altitude
+// @param       f filter state
+// @return      altitude in m
+// *************************************************************************************************
+int16_t vario_altitude(const struct vario *f)
+{
+    return (int16_t)((f->h + 128) >> 8);
+}
+
+// *************************************************************************************************
+// @fn          vario_climb
+// @brief       Filtered climb rate
+// @param       f filter state
+// @return      climb rate in cm/s, negative when sinking
+// *************************************************************************************************
+int16_t vario_climb(const struct vario *f)
+{
+    // 100 / 256 = 25 / 64
+    return (int16_t)(((int32_t)f->v * 25 + 32) >> 6);
+}
@@ -0,0 +1,57 @@
+/**
+    drivers/vario.h: altitude and climb rate from barometric altitude
+
+    http://github.com/BenjaminSoelberg/openchronos-ng-elf
+
+    This file is part of openchronos-ng.
+
+    openchronos-ng is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    openchronos-ng is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+// *************************************************************************************************
+#ifndef VARIO_H_
+#define VARIO_H_
+
+// Include section
+#include "openchronos.h"
+
+// *************************************************************************************************
+// Defines section
+
+// Sample rate the filter is tuned for, the SCP1000 high speed mode
+#define VARIO_RATE_HZ           (9u)
+
+// Sample period in Q16
+#define VARIO_DT_Q16            ((int16_t)(65536L / VARIO_RATE_HZ))
+
+// Entries of the gain schedule, the last one is the steady state gain
+#define VARIO_GAINS             (48u)
+
+// *************************************************************************************************
+// Global Variable section
+struct vario {
+    int32_t h;              // altitude, 1/256 m
+    int16_t v;              // climb rate, 1/256 m/s
+    uint8_t k;              // updates since the reset, saturates at VARIO_GAINS - 1
+    uint8_t valid;          // h holds a measurement
+};
+
+// *************************************************************************************************
+// Prototypes section
+extern void vario_init(struct vario *f);
+extern void vario_update(struct vario *f, int16_t alt_q2);
+extern int16_t vario_altitude(const struct vario *f);
+extern int16_t vario_climb(const struct vario *f);
+
+#endif /*VARIO_H_*/
@@ -65,8 +65,10 @@
 #include "openchronos.h"
 #include "vti_as.h"
 #include "timer.h"
+#include "utils.h"
+#include "battery.h"
 
-#ifndef CONFIG_MOD_ACCELEROMETER
+#ifndef AS_ENABLED
 void as_disconnect(void)
 {
     AS_PWR_OUT &= ~AS_PWR_PIN; /* Power off */
@@ -95,6 +97,7 @@ uint8_t as_get_status(void);
 void write_MDTHR(uint8_t msec);
 void write_FFTMR(uint8_t multiplier);
 void write_MDTMR(uint8_t multiplier);
+static void as_wait_burst(void);
 
 
 /******************************************************************************/
@@ -123,6 +126,41 @@ void write_MDTMR(uint8_t multiplier);
 /* Global flag for proper acceleration sensor operation */
 uint8_t as_ok;
 
+/* X/Y/Z register addresses, shifted and with RW bit reset */
+static const uint8_t as_xyz_addr[3] = { 0x06 << 2, 0x07 << 2, 0x08 << 2 };
+
+/* INT_STATUS, reading it releases the INT pin after a motion event */
+static const uint8_t as_status_addr[1] = { ADDR_INT_STATUS << 2 };
+
+/* Register read in flight, driven by as_usci_isr() */
+static const uint8_t *as_burst_addr;
+static uint8_t as_burst_len;
+static uint8_t *as_burst_data;
+static uint8_t as_burst_pos;
+static uint8_t as_burst_addr_sent;
+static uint8_t as_burst_stream;
+static volatile uint8_t as_burst_busy;
+static volatile uint8_t as_burst_wake;
+
+/* Samples read from the data ready interrupt while streaming */
+static uint8_t as_ring[AS_RING_SIZE][3];
+static volatile uint8_t as_ring_head;
+static uint8_t as_ring_tail;
+static uint8_t as_stream_batch;
+static uint8_t as_stream_count;
+static uint8_t as_stream_pending;
+
+/* Motion events counted from the interrupt while in ACTIVITY_MODE */
+static uint8_t as_motion_counting;
+static volatile uint16_t as_motion_count;
+static uint8_t as_motion_status;
+
+/* What the modules sharing the sensor asked for, see as_claim() */
+static struct As_Param as_claim_param[AS_CLIENTS];
+static uint8_t as_claim_read[AS_CLIENTS];
+static uint8_t as_claimed;
+static uint8_t as_owner_client;
+
 
 /******************************************************************************/
 /* Extern section */
@@ -161,6 +199,9 @@ void as_init(void)
 
     /* Reset global sensor flag */
     as_ok = 1;
+    /* Nobody uses the sensor yet */
+    as_claimed = 0;
+    as_owner_client = AS_CLIENTS;
     /* Init configuration parameters to measurment mode */
     as_config.range = 8;
     as_config.sampling = SAMPLING_100_HZ;
@@ -265,6 +306,14 @@ void change_mode(uint8_t mode)
     /* Wait 2 ms before entering modality to settle down */
     timer0_delay(2, LPM3_bits);
 
+    /* Motion detection draws a fraction of the current of sampling */
+    if (mode == ACTIVITY_MODE) {
+        battery_load_stop(BATTERY_LOAD_ACCEL);
+        battery_load_start(BATTERY_LOAD_MOTION);
+    } else {
+        battery_load_stop(BATTERY_LOAD_MOTION);
+        battery_load_start(BATTERY_LOAD_ACCEL);
+    }
 }
 /******************************************************************************/
 /* @fn          as_start */
@@ -325,9 +374,21 @@ void as_start(uint8_t mode)
 /******************************************************************************/
 void as_stop(void)
 {
+    uint16_t int_state;
+
     /* Disable interrupt */
     AS_INT_IE &= ~AS_INT_PIN; /* Disable interrupt */
 
+    battery_load_stop(BATTERY_LOAD_ACCEL);
+    battery_load_stop(BATTERY_LOAD_MOTION);
+
+    /* Let a read in flight finish */
+    as_stream_stop();
+    as_motion_stop();
+    ENTER_CRITICAL_SECTION(int_state);
+    as_wait_burst();
+    EXIT_CRITICAL_SECTION(int_state);
+
 #ifdef AS_DISCONNECT
     /* Power-down sensor */
     AS_PWR_OUT &= ~AS_PWR_PIN; /* Power off */
@@ -347,12 +408,12 @@ void as_stop(void)
 }
 
 /******************************************************************************/
-/* @fn          as_read_register */
-/* @brief       Read a byte from the acceleration sensor */
+/* @fn          as_read_register_poll */
+/* @brief       Read a byte from the acceleration sensor, polling the USCI */
 /* @param       uint8_t bAddres Register address */
 /* @return      uint8_t Register content */
 /******************************************************************************/
-uint8_t as_read_register(uint8_t bAddress)
+static uint8_t as_read_register_poll(uint8_t bAddress)
 {
     uint8_t bResult;
     uint16_t timeout;
@@ -404,13 +465,13 @@ uint8_t as_read_register(uint8_t bAddress)
 }
 
 /******************************************************************************/
-/* @fn          as_write_register */
-/* @brief   Write a byte to the acceleration sensor */
+/* @fn          as_write_register_poll */
+/* @brief   Write a byte to the acceleration sensor, polling the USCI */
 /* @param       uint8_t bAddress    Register address */
 /*      uint8_t bData       Data to write */
 /* @return      uint8_t */
 /******************************************************************************/
-uint8_t as_write_register(uint8_t bAddress, uint8_t bData)
+static uint8_t as_write_register_poll(uint8_t bAddress, uint8_t bData)
 {
     uint8_t bResult;
     uint16_t timeout;
@@ -461,22 +522,433 @@ uint8_t as_write_register(uint8_t bAddress, uint8_t bData)
     return bResult;
 }
 
+/******************************************************************************/
+/* @fn          as_wait_burst */
+/* @brief       Sleep until no register read is in flight, call with interrupts off */
+/* @param       none */
+/* @return      none */
+/******************************************************************************/
+static void as_wait_burst(void)
+{
+    while (as_burst_busy) {
+        as_burst_wake = 1;
+        /* SMCLK clocks the SPI, so LPM0 is as deep as we can go */
+        _BIS_SR(LPM0_bits | GIE);
+        __disable_interrupt();
+    }
+    as_burst_wake = 0;
+}
+
+/******************************************************************************/
+/* @fn          as_burst_start */
+/* @brief       Start reading registers, as_usci_isr() does the rest */
+/* @param       uint8_t *addr   shifted register addresses */
+/*              uint8_t len     number of registers */
+/*              uint8_t *data   len bytes for the content */
+/*              uint8_t stream  1 if the sample goes to the ring buffer */
+/* @return      none */
+/******************************************************************************/
+static void as_burst_start(const uint8_t *addr, uint8_t len, uint8_t *data,
+                           uint8_t stream)
+{
+    as_burst_addr = addr;
+    as_burst_len = len;
+    as_burst_data = data;
+    as_burst_pos = 0;
+    as_burst_addr_sent = 0;
+    as_burst_stream = stream;
+    as_burst_busy = 1;
+
+    AS_SPI_REN &= ~AS_SDI_PIN; /* Pulldown on SDI pin not required */
+    AS_CSN_OUT &= ~AS_CSN_PIN; /* Select acceleration sensor */
+
+    (void)AS_RX_BUFFER; /* Read RX buffer just to clear interrupt flag */
+
+    AS_IE_REG |= AS_RX_IE;
+    AS_TX_BUFFER = as_burst_addr[0]; /* Write first address to TX buffer */
+}
+
+/******************************************************************************/
+/* @fn          as_read_register */
+/* @brief       Read a byte from the acceleration sensor */
+/* @param       uint8_t bAddres Register address */
+/* @return      uint8_t Register content */
+/******************************************************************************/
+uint8_t as_read_register(uint8_t bAddress)
+{
+    uint8_t bResult;
+    uint16_t int_state;
+
+    /* Keep the data ready interrupt from starting a read in between */
+    ENTER_CRITICAL_SECTION(int_state);
+    as_wait_burst();
+    bResult = as_read_register_poll(bAddress);
+    EXIT_CRITICAL_SECTION(int_state);
+
+    return bResult;
+}
+
+/******************************************************************************/
+/* @fn          as_write_register */
+/* @brief   Write a byte to the acceleration sensor */
+/* @param       uint8_t bAddress    Register address */
+/*      uint8_t bData       Data to write */
+/* @return      uint8_t */
+/******************************************************************************/
+uint8_t as_write_register(uint8_t bAddress, uint8_t bData)
+{
+    uint8_t bResult;
+    uint16_t int_state;
+
+    ENTER_CRITICAL_SECTION(int_state);
+    as_wait_burst();
+    bResult = as_write_register_poll(bAddress, bData);
+    EXIT_CRITICAL_SECTION(int_state);
+
+    return bResult;
+}
+
 /******************************************************************************/
 /* @fn          as_get_data */
 /* @brief       Service routine to read acceleration values. */
+/*              The three registers are read back to back by the USCI */
+/*              interrupt while the CPU sleeps in LPM0. */
 /* @param       none */
 /* @return      none */
 /******************************************************************************/
 void as_get_data(uint8_t *data)
 {
+    uint16_t int_state;
+
     /* Exit if sensor is not powered up */
     if ((AS_PWR_OUT & AS_PWR_PIN) != AS_PWR_PIN)
         return;
 
-    /* Store X/Y/Z acceleration data in buffer */
-    *(data + 0) = as_read_register(0x06);
-    *(data + 1) = as_read_register(0x07);
-    *(data + 2) = as_read_register(0x08);
+    /* Exit function if an error was detected previously */
+    if (!as_ok)
+        return;
+
+    ENTER_CRITICAL_SECTION(int_state);
+    as_wait_burst();
+    as_burst_start(as_xyz_addr, sizeof(as_xyz_addr), data, 0);
+    as_wait_burst();
+    EXIT_CRITICAL_SECTION(int_state);
+}
+
+/******************************************************************************/
+/* @fn          as_stream_start */
+/* @brief       Read every sample into the ring buffer from the data ready */
+/*              interrupt, and only raise SYS_MSG_AS_INT every batch samples */
+/* @param       uint8_t batch   samples per event, at most AS_RING_SIZE - 1 */
+/* @return      none */
+/******************************************************************************/
+void as_stream_start(uint8_t batch)
+{
+    uint16_t int_state;
+
+    ENTER_CRITICAL_SECTION(int_state);
+    as_ring_head = 0;
+    as_ring_tail = 0;
+    as_stream_count = 0;
+    as_stream_pending = 0;
+    as_stream_batch = batch;
+
+    /* A sample that is already waiting will not give another edge */
+    if (AS_INT_IN & AS_INT_PIN)
+        as_data_ready();
+    EXIT_CRITICAL_SECTION(int_state);
+}
+
+/******************************************************************************/
+/* @fn          as_stream_stop */
+/* @brief       Back to one SYS_MSG_AS_INT per data ready interrupt */
+/* @param       none */
+/* @return      none */
+/******************************************************************************/
+void as_stream_stop(void)
+{
+    as_stream_batch = 0;
+    as_stream_pending = 0;
+}
+
+/******************************************************************************/
+/* @fn          as_stream_read */
+/* @brief       Take the oldest sample from the ring buffer */
+/* @param       uint8_t *data   3 bytes for X/Y/Z */
+/* @return      uint8_t         1 if a sample was copied, 0 if empty */
+/******************************************************************************/
+uint8_t as_stream_read(uint8_t *data)
+{
+    if (as_ring_tail == as_ring_head)
+        return 0;
+
+    data[0] = as_ring[as_ring_tail][0];
+    data[1] = as_ring[as_ring_tail][1];
+    data[2] = as_ring[as_ring_tail][2];
+    as_ring_tail = (as_ring_tail + 1) & (AS_RING_SIZE - 1);
+
+    return 1;
+}
+
+/******************************************************************************/
+/* @fn          as_motion_start */
+/* @brief       Count motion interrupts in ACTIVITY_MODE without waking up. */
+/*              Each one is acknowledged by an INT_STATUS read from the */
+/*              interrupt, which arms the sensor for the next event. */
+/* @param       none */
+/* @return      none */
+/******************************************************************************/
+void as_motion_start(void)
+{
+    uint16_t int_state;
+
+    ENTER_CRITICAL_SECTION(int_state);
+    as_motion_count = 0;
+    as_motion_counting = 1;
+
+    /* An event that is already latched will not give another edge */
+    if (AS_INT_IN & AS_INT_PIN)
+        as_data_ready();
+    EXIT_CRITICAL_SECTION(int_state);
+}
+
+/******************************************************************************/
+/* @fn          as_motion_stop */
+/* @brief       Back to one SYS_MSG_AS_INT per motion interrupt */
+/* @param       none */
+/* @return      none */
+/******************************************************************************/
+void as_motion_stop(void)
+{
+    as_motion_counting = 0;
+}
+
+/******************************************************************************/
+/* @fn          as_motion_take */
+/* @brief       Motion events since the last call */
+/* @param       none */
+/* @return      uint16_t        number of events, saturated */
+/******************************************************************************/
+uint16_t as_motion_take(void)
+{
+    uint16_t int_state;
+    uint16_t count;
+
+    ENTER_CRITICAL_SECTION(int_state);
+    count = as_motion_count;
+    as_motion_count = 0;
+    EXIT_CRITICAL_SECTION(int_state);
+
+    return count;
+}
+
+/******************************************************************************/
+/* @fn          as_apply */
+/* @brief       Run the sensor the way a client asked for, from off or warm */
+/* @param       uint8_t client  the new owner */
+/* @return      none */
+/******************************************************************************/
+static void as_apply(uint8_t client)
+{
+    uint8_t read = as_claim_read[client];
+
+    if (as_owner_client == AS_CLIENTS) {
+        as_config = as_claim_param[client];
+        as_start(as_config.mode);
+    } else {
+        as_stream_stop();
+        as_motion_stop();
+        as_config = as_claim_param[client];
+        change_mode(as_config.mode);
+    }
+    as_owner_client = client;
+
+    if (read == AS_READ_MOTION)
+        as_motion_start();
+    else if (read != AS_READ_IRQ)
+        as_stream_start(read);
+}
+
+/******************************************************************************/
+/* @fn          as_arbitrate */
+/* @brief       Hand the sensor to the highest priority client with a claim */
+/* @param       uint8_t changed client whose request changed, AS_CLIENTS if none */
+/* @return      none */
+/******************************************************************************/
+static void as_arbitrate(uint8_t changed)
+{
+    uint8_t client;
+
+    for (client = 0; client < AS_CLIENTS; client++) {
+        if (as_claimed & (1 << client))
+            break;
+    }
+
+    if (client == AS_CLIENTS) {
+        if (as_owner_client != AS_CLIENTS) {
+            as_stop();
+            as_owner_client = AS_CLIENTS;
+        }
+        return;
+    }
+
+    if (client != as_owner_client || client == changed)
+        as_apply(client);
+}
+
+/******************************************************************************/
+/* @fn          as_claim */
+/* @brief       Ask for the sensor in a mode, or change the mode asked for. */
+/*              The highest priority client of enum AS_CLIENT with a claim */
+/*              owns the sensor. A lower one waits, with its request kept, */
+/*              and gets the sensor back as it asked when the others */
+/*              release it. */
+/* @param       uint8_t client  enum AS_CLIENT */
+/*              struct As_Param *param  range, sampling, thresholds and mode */
+/*              uint8_t read    AS_READ_IRQ, AS_READ_MOTION or a batch size */
+/*                              below AS_RING_SIZE to stream */
+/* @return      uint8_t         1 if the client owns the sensor now */
+/******************************************************************************/
+uint8_t as_claim(uint8_t client, const struct As_Param *param, uint8_t read)
+{
+    as_claim_param[client] = *param;
+    as_claim_read[client] = read;
+    as_claimed |= 1 << client;
+
+    as_arbitrate(client);
+
+    return as_owner_client == client;
+}
+
+/******************************************************************************/
+/* @fn          as_release */
+/* @brief       Drop a claim, the sensor goes to the next client or off */
+/* @param       uint8_t client  enum AS_CLIENT */
+/* @return      none */
+/******************************************************************************/
+void as_release(uint8_t client)
+{
+    if (!(as_claimed & (1 << client)))
+        return;
+
+    as_claimed &= ~(1 << client);
+    as_arbitrate(AS_CLIENTS);
+}
+
+/******************************************************************************/
+/* @fn          as_owner */
+/* @brief       Client the sensor runs for */
+/* @param       none */
+/* @return      uint8_t         enum AS_CLIENT, AS_CLIENTS if it is off */
+/******************************************************************************/
+uint8_t as_owner(void)
+{
+    return as_owner_client;
+}
+
+/******************************************************************************/
+/* @fn          as_irq_read */
+/* @brief       Start the read that services an interrupt of the sensor */
+/* @param       none */
+/* @return      none */
+/******************************************************************************/
+static void as_irq_read(void)
+{
+    if (as_stream_batch)
+        as_burst_start(as_xyz_addr, sizeof(as_xyz_addr),
+                       as_ring[as_ring_head], 1);
+    else
+        as_burst_start(as_status_addr, sizeof(as_status_addr),
+                       &as_motion_status, 0);
+}
+
+/******************************************************************************/
+/* @fn          as_data_ready */
+/* @brief       Data ready interrupt of the sensor, called from PORT2_ISR */
+/* @param       none */
+/* @return      none */
+/******************************************************************************/
+void as_data_ready(void)
+{
+    if (!as_stream_batch && !as_motion_counting) {
+        as_last_interrupt = 1;
+        return;
+    }
+
+    if (!as_stream_batch && as_motion_count != 0xffff)
+        as_motion_count++;
+
+    if (as_burst_busy)
+        as_stream_pending = 1;
+    else
+        as_irq_read();
+}
+
+/******************************************************************************/
+/* @fn          as_usci_isr */
+/* @brief       Shift the frames of a register read, one per register */
+/* @param       none */
+/* @return      none */
+/******************************************************************************/
+__attribute__((interrupt(AS_USCI_VECTOR)))
+void as_usci_isr(void)
+{
+    uint8_t bResult;
+    uint8_t next;
+    uint8_t wake;
+
+    switch (__even_in_range(AS_IV_REG, 4)) {
+    case 2:                             /* Vector 2: RXIFG */
+        bResult = AS_RX_BUFFER;
+
+        if (!as_burst_addr_sent) {
+            /* Address is out, clock in the register content */
+            as_burst_addr_sent = 1;
+            AS_TX_BUFFER = 0;
+            break;
+        }
+
+        as_burst_data[as_burst_pos++] = bResult;
+        AS_CSN_OUT |= AS_CSN_PIN; /* End of frame */
+
+        if (as_burst_pos < as_burst_len) {
+            __delay_cycles(AS_CSN_HIGH_CYCLES);
+            AS_CSN_OUT &= ~AS_CSN_PIN;
+            as_burst_addr_sent = 0;
+            AS_TX_BUFFER = as_burst_addr[as_burst_pos];
+            break;
+        }
+
+        AS_IE_REG &= ~AS_RX_IE;
+        AS_SPI_REN |= AS_SDI_PIN; /* Pulldown on SDI pin required again */
+        as_burst_busy = 0;
+        wake = as_burst_wake;
+
+        if (as_burst_stream) {
+            /* Keep the sample unless the ring is full */
+            next = (as_ring_head + 1) & (AS_RING_SIZE - 1);
+            if (next != as_ring_tail)
+                as_ring_head = next;
+
+            if (++as_stream_count >= as_stream_batch) {
+                as_stream_count = 0;
+                as_last_interrupt = 1;
+                wake = 1;
+            }
+        }
+
+        if (as_stream_pending) {
+            as_stream_pending = 0;
+            as_irq_read();
+        }
+
+        if (wake)
+            _BIC_SR_IRQ(LPM3_bits);
+        break;
+
+    default:
+        break;
+    }
 }
 
 uint8_t as_get_x(void)
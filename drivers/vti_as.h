@@ -57,12 +57,20 @@
 #ifndef VTI_AS_H_
 #define VTI_AS_H_
 
+/* Modules that keep the sensor connected and its interrupt serviced */
+#if defined(CONFIG_MOD_ACCELEROMETER) || defined(CONFIG_MOD_PEDOMETER) \
+    || defined(CONFIG_MOD_SLEEP)
+#define AS_ENABLED
+#endif
+
 /******************************************************************************/
 /* Include section */
 
 
 /******************************************************************************/
 /* Prototypes section */
+struct As_Param;
+
 extern void as_disconnect(void);
 extern void as_init(void);
 extern void as_start(uint8_t mode);
@@ -71,6 +79,17 @@ extern void as_stop(void);
 extern uint8_t as_read_register(uint8_t bAddress);
 extern uint8_t as_write_register(uint8_t bAddress, uint8_t bData);
 extern void as_get_data(uint8_t *data);
+extern void as_stream_start(uint8_t batch);
+extern void as_stream_stop(void);
+extern uint8_t as_stream_read(uint8_t *data);
+extern void as_motion_start(void);
+extern void as_motion_stop(void);
+extern uint16_t as_motion_take(void);
+extern uint8_t as_claim(uint8_t client, const struct As_Param *param,
+                        uint8_t read);
+extern void as_release(uint8_t client);
+extern uint8_t as_owner(void);
+extern void as_data_ready(void);
 extern uint8_t as_get_x(void);
 extern uint8_t as_get_y(void);
 extern uint8_t as_get_z(void);
@@ -112,6 +131,10 @@ extern void write_FFTHR(uint8_t mgrav);
 #define AS_SPI_CTL1         (UCA0CTL1)
 #define AS_SPI_BR0          (UCA0BR0)
 #define AS_SPI_BR1          (UCA0BR1)
+#define AS_IE_REG           (UCA0IE)
+#define AS_RX_IE            (UCRXIE)
+#define AS_IV_REG           (UCA0IV)
+#define AS_USCI_VECTOR      USCI_A0_VECTOR
 
 /* Port and pin resource for power-up of acceleration sensor, VDD=PJ.0 */
 #define AS_PWR_OUT          (PJOUT)
@@ -130,6 +153,12 @@ extern void write_FFTHR(uint8_t mgrav);
 /* SPI timeout to detect sensor failure */
 #define SPI_TIMEOUT     (1000u)
 
+/* CSN high time between two frames, 1us at 12MHz */
+#define AS_CSN_HIGH_CYCLES  (12u)
+
+/* X/Y/Z samples buffered while streaming, must be a power of two */
+#define AS_RING_SIZE        (32u)
+
 
 /* register address: */
 #define ADDR_CTRL       (0x02)
@@ -175,6 +204,19 @@ struct As_Param {
 };
 extern struct As_Param as_config;
 
+/* Modules sharing the sensor, highest priority first, see as_claim() */
+enum AS_CLIENT {
+    AS_CLIENT_ACCEL = 0,    /* accelerometer screen */
+    AS_CLIENT_SLEEP,        /* sleep tracker, through the night */
+    AS_CLIENT_PEDOMETER,    /* step counter, in the background */
+    AS_CLIENTS              /* as_owner() when the sensor is off */
+};
+
+/* How the owner takes the samples, the read argument of as_claim(). Any
+   other value streams into the ring in batches of that many samples. */
+#define AS_READ_IRQ         (0u)    /* SYS_MSG_AS_INT per interrupt */
+#define AS_READ_MOTION      (0xffu) /* count motion events, see as_motion_take() */
+
 
 enum AS_MOTION_STATUS {
     AS_NO_MOTION = 00,  /* motion not detected */
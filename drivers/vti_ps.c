@@ -44,47 +44,93 @@
 
 // driver
 #include "vti_ps.h"
-//#include "timer.h"
-
-//TODO: see what we should do with tis
-#define CONFIG_FIXEDPOINT_MATH
-
-#ifdef CONFIG_FIXEDPOINT_MATH
-#include "dsp.h"
-#endif
+#include "utils.h"
 
 
 // *************************************************************************************************
 // Prototypes section
 uint16_t ps_read_register(uint8_t address, uint8_t mode);
 uint8_t ps_write_register(uint8_t address, uint8_t data);
-uint8_t ps_twi_read(uint8_t ack);
-void twi_delay(void);
 
 
 // *************************************************************************************************
 // Defines section
 
+// 7 bit TWI address of the SCP1000
+#define PS_TWI_ADDRESS      (0x11u)
+
+// Transaction program for ps_twi_tick(), WRITE ops are followed by the byte to send
+#define PS_TWI_OP_END           (0u)
+#define PS_TWI_OP_START         (1u)
+#define PS_TWI_OP_RESTART       (2u)
+#define PS_TWI_OP_STOP          (3u)
+#define PS_TWI_OP_WRITE         (4u)
+#define PS_TWI_OP_WRITE_LAST    (5u)    // no ACK check
+#define PS_TWI_OP_READ          (6u)    // master ACK
+#define PS_TWI_OP_READ_LAST     (7u)    // master NACK
+
+#define PS_TWI_PROG_SIZE        (12u)
+
+// Standard atmosphere table, one entry per 1024 Pa from PS_ALT_PMIN
+#define PS_ALT_SHIFT            (10u)
+#define PS_ALT_STEP             (1 << PS_ALT_SHIFT)
+#define PS_ALT_ENTRIES          (85u)
+#define PS_ALT_PMIN             (35840ul)
+#define PS_ALT_PMAX             (PS_ALT_PMIN + (PS_ALT_ENTRIES - 1) * PS_ALT_STEP)
+
+// H0 = T0/dTdh (m)
+#define PS_ALT_H0               (44331)
+
+// Largest height above the reference point that gets temperature corrected (1/8m)
+#define PS_ALT_DH_MAX           (80000l)
+
 
 // *************************************************************************************************
 // Global Variable section
 
-#ifndef CONFIG_FIXEDPOINT_MATH
-// VTI pressure (hPa) to altitude (m) conversion tables
-const int16_t h0[17] = { -153, 0, 111, 540, 989, 1457, 1949, 2466, 3012, 3591, 4206, 4865, 5574, 6344, 7185, 8117, 9164 };
-const uint16_t p0[17] = { 1031, 1013, 1000, 950, 900, 850, 800, 750, 700, 650, 600, 550, 500, 450, 400, 350, 300 };
-float p[17];
-#else
-// Storage for pressure to altitude conversions
-static int16_t pLast; // Last measured pressure in 4Pa units
-static int16_t pRef; // Reference pressure at sea level in 4Pa units
-static int16_t hLast; // Last altitude estimate in normalized units b/H0/2^15
-#endif
+// Standard atmosphere altitude (1/16m) at PS_ALT_PMIN + i * 1024 Pa
+static const int32_t ps_alt_table[PS_ALT_ENTRIES] = {
+    127256, 124128, 121069, 118077, 115148, 112279, 109468, 106711,
+    104007, 101354, 98749, 96191, 93677, 91206, 88776, 86386,
+    84035, 81721, 79442, 77198, 74988, 72809, 70662, 68546,
+    66458, 64399, 62368, 60363, 58385, 56432, 54503, 52598,
+    50717, 48858, 47021, 45205, 43410, 41636, 39882, 38146,
+    36430, 34732, 33053, 31390, 29745, 28117, 26505, 24909,
+    23329, 21764, 20214, 18679, 17159, 15652, 14159, 12680,
+    11214, 9761, 8320, 6892, 5477, 4073, 2681, 1301,
+    -68, -1426, -2772, -4108, -5434, -6749, -8054, -9349,
+    -10634, -11909, -13175, -14431, -15679, -16917, -18146, -19366,
+    -20578, -21782, -22977, -24163, -25342
+};
+
+// Calibration from update_pressure_table()
+static int16_t ps_alt_e;        // Scale error of (H0 - h) against the standard atmosphere, Q20
+static int16_t ps_alt_href;     // Reference altitude (m)
 
 
 // Global flag for proper pressure sensor operation
 uint8_t ps_ok;
 
+// Set by PORT2_ISR on DRDY while the sensor samples, raises SYS_MSG_PS_INT
+volatile uint8_t ps_last_interrupt;
+
+// Mode the sensor was last started in, 0 while stopped
+uint8_t ps_mode;
+
+// Transaction in flight, driven by ps_twi_tick()
+static uint8_t ps_twi_prog[PS_TWI_PROG_SIZE];
+static uint8_t ps_twi_pc;
+static uint8_t ps_twi_stop;
+static uint16_t ps_twi_data;
+static uint8_t ps_twi_ok;
+static void (*ps_twi_callback)(uint16_t data, uint8_t ok);
+static volatile uint8_t ps_twi_busy;
+static volatile uint8_t ps_twi_wake;
+
+// Pressure read in flight, see ps_get_pa_async()
+static void (*ps_pa_callback)(uint32_t pa);
+static uint8_t ps_pa_msb;
+
 
 // *************************************************************************************************
 // Extern section
@@ -134,14 +180,22 @@ void ps_init(void)
 
 // *************************************************************************************************
 // @fn          ps_start
-// @brief       Init pressure sensor registers and start sampling
-// @param       none
-// @return      uint8_t     1=Sensor started, 0=Sensor did not start
+// @brief       Start sampling, every new result raises SYS_MSG_PS_INT
+// @param       uint8_t     mode    PS_MODE_*
+// @return      none
 // *************************************************************************************************
-void ps_start(void)
+void ps_start(uint8_t mode)
 {
-    // Start sampling data in ultra low power mode
-    ps_write_register(0x03, 0x0B);
+    ps_last_interrupt = 0;
+    PS_INT_IFG &= ~PS_INT_PIN;
+    PS_INT_IE |= PS_INT_PIN;
+
+    ps_write_register(0x03, mode);
+    ps_mode = mode;
+
+    // A result that is already waiting will not give another edge
+    if (PS_INT_IN & PS_INT_PIN)
+        ps_last_interrupt = 1;
 }
 
 
@@ -154,234 +208,325 @@ void ps_start(void)
 // *************************************************************************************************
 void ps_stop(void)
 {
+    PS_INT_IE &= ~PS_INT_PIN;
+
     // Put sensor to standby
     ps_write_register(0x03, 0x00);
+    ps_mode = 0;
 }
 
 
 
 // *************************************************************************************************
-// @fn          ps_twi_sda
-// @brief       Control SDA line
-// @param       uint8_t condition       PS_TWI_SEND_START, PS_TWI_SEND_RESTART, PS_TWI_SEND_STOP
-//                                      PS_TWI_CHECK_ACK
-// @return      uint8_t                 1=ACK, 0=NACK
+// @fn          ps_twi_begin
+// @brief       Start a transaction, ps_twi_tick() clocks it out in the background
+// @param       uint8_t len         Length of the program in ps_twi_prog, ending in a STOP
+//              void (*callback)    Called from the timer interrupt when done, may be NULL
+// @return      none
 // *************************************************************************************************
-uint8_t ps_twi_sda(uint8_t condition)
+static void ps_twi_begin(uint8_t len, void (*callback)(uint16_t data, uint8_t ok))
 {
-    uint8_t sda = 0;
-
-    if (condition == PS_TWI_SEND_START) {
-        PS_TWI_SDA_OUT;         // SDA is output
-        PS_TWI_SCL_HI;
-        twi_delay();
-        PS_TWI_SDA_LO;
-        twi_delay();
-        PS_TWI_SCL_LO;          // SCL 1-0 transition while SDA=0
-        twi_delay();
-    } else if (condition == PS_TWI_SEND_RESTART) {
-        PS_TWI_SDA_OUT;         // SDA is output
-        PS_TWI_SCL_LO;
-        PS_TWI_SDA_HI;
-        twi_delay();
-        PS_TWI_SCL_HI;
-        twi_delay();
-        PS_TWI_SDA_LO;
-        twi_delay();
-        PS_TWI_SCL_LO;
-        twi_delay();
-    } else if (condition == PS_TWI_SEND_STOP) {
-        PS_TWI_SDA_OUT;         // SDA is output
-        PS_TWI_SDA_LO;
-        twi_delay();
-        PS_TWI_SCL_LO;
-        twi_delay();
-        PS_TWI_SCL_HI;
-        twi_delay();
-        PS_TWI_SDA_HI;          // SDA 0-1 transition while SCL=1
-        twi_delay();
-    } else if (condition == PS_TWI_CHECK_ACK) {
-        PS_TWI_SDA_IN;          // SDA is input
-        PS_TWI_SCL_LO;
-        twi_delay();
-        PS_TWI_SCL_HI;
-        twi_delay();
-        sda = PS_TWI_IN & PS_SDA_PIN;
-        PS_TWI_SCL_LO;
-    }
-
-    // Return value will only be evaluated when checking device ACK
-    return (sda == 0);
+    ps_twi_prog[len] = PS_TWI_OP_END;
+    ps_twi_stop = len - 1;
+    ps_twi_pc = 0;
+    ps_twi_data = 0;
+    ps_twi_ok = 1;
+    ps_twi_callback = callback;
+    ps_twi_busy = 1;
+
+    // One byte or bus condition per tick of TA0CCR1
+    TA0CCR1 = TA0R + PS_TWI_TICKS;
+    TA0CCTL1 = CCIE;
 }
 
-
-
 // *************************************************************************************************
-// @fn          twi_delay
-// @brief       Delay between TWI signal edges.
+// @fn          ps_twi_wait
+// @brief       Sleep until no transaction is in flight, call with interrupts off
 // @param       none
 // @return      none
 // *************************************************************************************************
-void twi_delay(void)
+static void ps_twi_wait(void)
 {
-    asm("   nop");
+    while (ps_twi_busy) {
+        ps_twi_wake = 1;
+        // Timer0 runs from ACLK, so LPM3 is fine
+        _BIS_SR(LPM3_bits | GIE);
+        __disable_interrupt();
+    }
+    ps_twi_wake = 0;
 }
 
-
 // *************************************************************************************************
-// @fn          ps_twi_write
-// @brief       Clock out bits through SDA.
-// @param       uint8_t data        Byte to send
+// @fn          ps_twi_run
+// @brief       Clock the transaction just begun out at once, call with interrupts off. Cheaper
+//              than the timer for the blocking calls, which would only sleep between bytes.
+// @param       none
 // @return      none
 // *************************************************************************************************
-void ps_twi_write(uint8_t data)
+static void ps_twi_run(void)
 {
-    uint8_t i, mask;
-
-    // Set mask byte to 10000000b
-    mask = BIT0 << 7;
-
-    PS_TWI_SDA_OUT;     // SDA is output
-
-    for (i = 8; i > 0; i--) {
-        PS_TWI_SCL_LO;  // SCL=0
+    TA0CCTL1 = 0;
+    while (ps_twi_busy)
+        ps_twi_tick();
+}
 
-        if ((data & mask) == mask) {
-            PS_TWI_SDA_HI; // SDA=1
+// *************************************************************************************************
+// @fn          ps_twi_phase
+// @brief       Drive the bus through one phase of an op. SCL only rises in odd phases and SDA
+//              only changes while SCL is low, except in the START, RESTART and STOP conditions.
+// @param       uint8_t op          Op of the program at ps_twi_pc
+//              uint8_t phase       Phase of the op, from 0
+// @return      uint8_t             0 while the op goes on, else the program words it took
+// *************************************************************************************************
+static uint8_t ps_twi_phase(uint8_t op, uint8_t phase)
+{
+    uint8_t next = 0;
+
+    switch (op) {
+    case PS_TWI_OP_START:
+        // SDA falls while SCL is high, then SCL follows
+        if (phase == 0) {
+            PS_TWI_SDA_OUT;
+            PS_TWI_SDA_LO;
         } else {
-            PS_TWI_SDA_LO; // SDA=0
+            PS_TWI_SCL_LO;
+            next = 1;
         }
+        break;
+
+    case PS_TWI_OP_RESTART:
+        if (phase == 0) {
+            PS_TWI_SCL_LO;
+            PS_TWI_SDA_OUT;
+            PS_TWI_SDA_HI;
+        } else if (phase == 1) {
+            PS_TWI_SCL_HI;
+        } else if (phase == 2) {
+            PS_TWI_SDA_LO;
+        } else {
+            PS_TWI_SCL_LO;
+            next = 1;
+        }
+        break;
+
+    case PS_TWI_OP_STOP:
+        // SDA rises while SCL is high and the bus is idle again
+        if (phase == 0) {
+            PS_TWI_SCL_LO;
+            PS_TWI_SDA_OUT;
+            PS_TWI_SDA_LO;
+        } else if (phase == 1) {
+            PS_TWI_SCL_HI;
+        } else {
+            PS_TWI_SDA_HI;
+            next = 1;
+        }
+        break;
+
+    case PS_TWI_OP_WRITE:
+    case PS_TWI_OP_WRITE_LAST:
+        if (phase < 16) {
+            if (phase & 1) {
+                PS_TWI_SCL_HI;
+            } else {
+                PS_TWI_SCL_LO;
+                PS_TWI_SDA_OUT;
+                if (ps_twi_prog[ps_twi_pc + 1] & (0x80 >> (phase >> 1))) {
+                    PS_TWI_SDA_HI;
+                } else {
+                    PS_TWI_SDA_LO;
+                }
+            }
+        } else if (phase == 16) {
+            PS_TWI_SCL_LO;
+            PS_TWI_SDA_IN;
+        } else {
+            PS_TWI_SCL_HI;
+            // The sensor does not acknowledge the last byte of a write
+            if (op == PS_TWI_OP_WRITE && (PS_TWI_IN & PS_SDA_PIN))
+                ps_twi_ok = 0;
+            next = 2;
+        }
+        break;
+
+    case PS_TWI_OP_READ:
+    case PS_TWI_OP_READ_LAST:
+        if (phase < 16) {
+            if (phase & 1) {
+                PS_TWI_SCL_HI;
+                ps_twi_data <<= 1;
+                if (PS_TWI_IN & PS_SDA_PIN)
+                    ps_twi_data |= 1;
+            } else {
+                PS_TWI_SCL_LO;
+                PS_TWI_SDA_IN;
+            }
+        } else if (phase == 16) {
+            // ACK to continue, NACK after the last byte
+            PS_TWI_SCL_LO;
+            PS_TWI_SDA_OUT;
+            if (op == PS_TWI_OP_READ) {
+                PS_TWI_SDA_LO;
+            } else {
+                PS_TWI_SDA_HI;
+            }
+        } else {
+            PS_TWI_SCL_HI;
+            next = 1;
+        }
+        break;
 
-        mask = mask >> 1;
-        twi_delay();
-        PS_TWI_SCL_HI;  // SCL=1
-        twi_delay();
     }
 
-    PS_TWI_SCL_LO;      // SCL=0
-    PS_TWI_SDA_IN;      // SDA is input
+    return next;
 }
 
-
 // *************************************************************************************************
-// @fn          ps_twi_read
-// @brief       Read bits from SDA
-// @param       uint8_t ack     1=Send ACK after read, 0=Send NACK after read
-// @return      uint8_t         Bits read
+// @fn          ps_twi_tick
+// @brief       Clock out the next byte or bus condition of the current transaction, its phases
+//              back to back. Called from the TA0CCR1 interrupt.
+// @param       none
+// @return      uint8_t             1 if the transaction is done and the CPU should wake up
 // *************************************************************************************************
-uint8_t ps_twi_read(uint8_t ack)
+uint8_t ps_twi_tick(void)
 {
-    uint8_t i;
-    uint8_t data = 0;
-
-    PS_TWI_SDA_IN;      // SDA is input
-
-    for (i = 0; i < 8; i++) {
-        PS_TWI_SCL_LO;          // SCL=0
-        twi_delay();
-        PS_TWI_SCL_HI;          // SCL=0
-        twi_delay();
-
-        // Shift captured bits to left
-        data = data << 1;
-
-        // Capture new bit
-        if ((PS_TWI_IN & PS_SDA_PIN) == PS_SDA_PIN) data |= BIT0;
+    uint8_t op = ps_twi_prog[ps_twi_pc];
+    uint8_t phase = 0;
+    uint8_t next;
+    void (*callback)(uint16_t data, uint8_t ok);
+
+    if (op != PS_TWI_OP_END) {
+        do {
+            next = ps_twi_phase(op, phase++);
+            __delay_cycles(PS_TWI_DELAY);
+        } while (!next);
+
+        ps_twi_pc += next;
+
+        // Missing ACK, skip to the STOP condition
+        if (!ps_twi_ok && ps_twi_pc < ps_twi_stop)
+            ps_twi_pc = ps_twi_stop;
+
+        if (ps_twi_prog[ps_twi_pc] != PS_TWI_OP_END) {
+            TA0CCR1 = TA0R + PS_TWI_TICKS;
+            return 0;
+        }
     }
 
-    PS_TWI_SDA_OUT;         // SDA is output
-
-    // 1 aditional clock phase to generate master ACK
-    PS_TWI_SCL_LO;          // SCL=0
+    TA0CCTL1 &= ~CCIE;
+    ps_twi_busy = 0;
 
-    if (ack == 1)   PS_TWI_SDA_LO       // Send ack -> continue read
-        else            PS_TWI_SDA_HI       // Send nack -> stop read
-            twi_delay();
+    callback = ps_twi_callback;
+    if (callback)
+        callback(ps_twi_ok ? ps_twi_data : 0, ps_twi_ok);
 
-    PS_TWI_SCL_HI;          // SCL=0
-    twi_delay();
-    PS_TWI_SCL_LO;
+    return ps_twi_wake || callback;
+}
 
-    return (data);
+// *************************************************************************************************
+// @fn          ps_write_register_async
+// @brief       Write a byte to the pressure sensor in the background
+// @param       uint8_t address     Register address
+//              uint8_t data        Data to write
+//              void (*callback)    Called from the timer interrupt when done, may be NULL
+// @return      uint8_t             1=Started, 0=Bus busy
+// *************************************************************************************************
+uint8_t ps_write_register_async(uint8_t address, uint8_t data,
+                                void (*callback)(uint16_t data, uint8_t ok))
+{
+    if (ps_twi_busy)
+        return 0;
+
+    ps_twi_prog[0] = PS_TWI_OP_START;
+    ps_twi_prog[1] = PS_TWI_OP_WRITE;
+    ps_twi_prog[2] = (PS_TWI_ADDRESS << 1) | PS_TWI_WRITE;
+    ps_twi_prog[3] = PS_TWI_OP_WRITE;
+    ps_twi_prog[4] = address;
+    ps_twi_prog[5] = PS_TWI_OP_WRITE_LAST;
+    ps_twi_prog[6] = data;
+    ps_twi_prog[7] = PS_TWI_OP_STOP;
+    ps_twi_begin(8, callback);
+
+    return 1;
 }
 
+// *************************************************************************************************
+// @fn          ps_read_register_async
+// @brief       Read a register of the pressure sensor in the background
+// @param       uint8_t address     Register address
+//              uint8_t mode        PS_TWI_8BIT_ACCESS, PS_TWI_16BIT_ACCESS
+//              void (*callback)    Called from the timer interrupt with the register content
+// @return      uint8_t             1=Started, 0=Bus busy
+// *************************************************************************************************
+uint8_t ps_read_register_async(uint8_t address, uint8_t mode,
+                               void (*callback)(uint16_t data, uint8_t ok))
+{
+    uint8_t len = 0;
+
+    if (ps_twi_busy)
+        return 0;
+
+    ps_twi_prog[len++] = PS_TWI_OP_START;
+    ps_twi_prog[len++] = PS_TWI_OP_WRITE;
+    ps_twi_prog[len++] = (PS_TWI_ADDRESS << 1) | PS_TWI_WRITE;
+    ps_twi_prog[len++] = PS_TWI_OP_WRITE;
+    ps_twi_prog[len++] = address;
+    ps_twi_prog[len++] = PS_TWI_OP_RESTART;
+    ps_twi_prog[len++] = PS_TWI_OP_WRITE;
+    ps_twi_prog[len++] = (PS_TWI_ADDRESS << 1) | PS_TWI_READ;
+    if (mode == PS_TWI_16BIT_ACCESS)
+        ps_twi_prog[len++] = PS_TWI_OP_READ;
+    ps_twi_prog[len++] = PS_TWI_OP_READ_LAST;
+    ps_twi_prog[len++] = PS_TWI_OP_STOP;
+    ps_twi_begin(len, callback);
+
+    return 1;
+}
 
 
 // *************************************************************************************************
-// @fn          as_write_register
-// @brief       Write a byte to the pressure sensor
+// @fn          ps_write_register
+// @brief       Write a byte to the pressure sensor, waits for a transaction in flight
 // @param       uint8_t address         Register address
 //              uint8_t data            Data to write
-// @return      uint8_t
+// @return      uint8_t                 1=Success, 0=No ACK from the sensor
 // *************************************************************************************************
 uint8_t ps_write_register(uint8_t address, uint8_t data)
 {
-    volatile uint8_t success;
-
-    ps_twi_sda(PS_TWI_SEND_START);          // Generate start condition
-
-    ps_twi_write((0x11 << 1) | PS_TWI_WRITE);   // Send 7bit device address 0x11 + write bit '0'
-    success = ps_twi_sda(PS_TWI_CHECK_ACK); // Check ACK from device
-
-    if (!success) return (0);
-
-    ps_twi_write(address);                  // Send 8bit register address
-    success = ps_twi_sda(PS_TWI_CHECK_ACK); // Check ACK from device
+    uint16_t int_state;
+    uint8_t ok;
 
-    if (!success) return (0);
+    ENTER_CRITICAL_SECTION(int_state);
+    ps_twi_wait();
+    ps_write_register_async(address, data, NULL);
+    ps_twi_run();
+    ok = ps_twi_ok;
+    EXIT_CRITICAL_SECTION(int_state);
 
-    ps_twi_write(data);                     // Send 8bit data to register
-    success = ps_twi_sda(PS_TWI_CHECK_ACK); // Check ACK from device
-// Slave does not send this ACK
-// if (!success) return (0);
-
-    ps_twi_sda(PS_TWI_SEND_STOP);               // Generate stop condition
-
-    return (1);
+    return ok;
 }
 
 
 // *************************************************************************************************
 // @fn          ps_read_register
-// @brief       Read a byte from the pressure sensor
+// @brief       Read a register of the pressure sensor, waits for a transaction in flight
 // @param       uint8_t address     Register address
 //              uint8_t mode        PS_TWI_8BIT_ACCESS, PS_TWI_16BIT_ACCESS
-// @return      uint16_t            Register content
+// @return      uint16_t            Register content, 0 if the sensor did not ACK
 // *************************************************************************************************
 uint16_t ps_read_register(uint8_t address, uint8_t mode)
 {
-    uint8_t success;
-    uint16_t data = 0;
-
-    ps_twi_sda(PS_TWI_SEND_START);          // Generate start condition
-
-    ps_twi_write((0x11 << 1) | PS_TWI_WRITE);   // Send 7bit device address 0x11 + write bit '0'
-    success = ps_twi_sda(PS_TWI_CHECK_ACK); // Check ACK from device
-
-    if (!success) return (0);
-
-    ps_twi_write(address);                  // Send 8bit register address
-    success = ps_twi_sda(PS_TWI_CHECK_ACK); // Check ACK from device
-
-    if (!success) return (0);
-
-    ps_twi_sda(PS_TWI_SEND_RESTART);            // Generate restart condition
+    uint16_t int_state;
+    uint16_t data;
 
-    ps_twi_write((0x11 << 1) | PS_TWI_READ);    // Send 7bit device address 0x11 + read bit '1'
-    success = ps_twi_sda(PS_TWI_CHECK_ACK); // Check ACK from device
+    ENTER_CRITICAL_SECTION(int_state);
+    ps_twi_wait();
+    ps_read_register_async(address, mode, NULL);
+    ps_twi_run();
+    data = ps_twi_ok ? ps_twi_data : 0;
+    EXIT_CRITICAL_SECTION(int_state);
 
-    if (!success) return (0);
-
-    if (mode == PS_TWI_16BIT_ACCESS) {
-        data =  ps_twi_read(1) << 8;            // Read MSB 8bit data from register
-        data |= ps_twi_read(0);             // Read LSB 8bit data from register
-    } else {
-        data = ps_twi_read(0);              // Read 8bit data from register
-    }
-
-    ps_twi_sda(PS_TWI_SEND_STOP);               // Generate stop condition
-
-    return (data);
+    return data;
 }
 
 
@@ -410,6 +555,57 @@ uint32_t ps_get_pa(void)
 }
 
 
+// *************************************************************************************************
+// @fn          ps_pa_lsb_done
+// @brief       Second half of ps_get_pa_async(), DATARD16 is in
+// @param       uint16_t data       Register content
+//              uint8_t ok          0 if the sensor did not ACK
+// @return      none
+// *************************************************************************************************
+static void ps_pa_lsb_done(uint16_t data, uint8_t ok)
+{
+    uint32_t pa = 0;
+
+    if (ok)
+        pa = ((((uint32_t)ps_pa_msb & 0x07) << 16) | data) >> 2;
+
+    ps_pa_callback(pa);
+}
+
+// *************************************************************************************************
+// @fn          ps_pa_msb_done
+// @brief       First half of ps_get_pa_async(), DATARD8 is in
+// @param       uint16_t data       Register content
+//              uint8_t ok          0 if the sensor did not ACK
+// @return      none
+// *************************************************************************************************
+static void ps_pa_msb_done(uint16_t data, uint8_t ok)
+{
+    ps_pa_msb = data;
+
+    if (!ok)
+        ps_pa_callback(0);
+    else
+        ps_read_register_async(0x80, PS_TWI_16BIT_ACCESS, &ps_pa_lsb_done);
+}
+
+// *************************************************************************************************
+// @fn          ps_get_pa_async
+// @brief       Read out pressure in the background, see ps_get_pa()
+// @param       void (*callback)    Called from the timer interrupt with the pressure (Pa),
+//                                  0 if the sensor did not answer
+// @return      uint8_t             1=Started, 0=Bus busy
+// *************************************************************************************************
+uint8_t ps_get_pa_async(void (*callback)(uint32_t pa))
+{
+    if (ps_twi_busy)
+        return 0;
+
+    ps_pa_callback = callback;
+    return ps_read_register_async(0x7F, PS_TWI_8BIT_ACCESS, &ps_pa_msb_done);
+}
+
+
 // *************************************************************************************************
 // @fn          ps_get_temp
 // @brief       Read out temperature.
@@ -447,275 +643,138 @@ uint16_t ps_get_temp(void)
 
 // *************************************************************************************************
 // @fn          init_pressure_table
-// @brief       Init pressure table with constants
-// @param       uint32_t        p       Pressure (Pa)
-// @return      uint16_t                Altitude (m)
+// @brief       Reset the altitude conversion to the standard atmosphere (QNH 1013.25 hPa).
+// @param       none
+// @return      none
 // *************************************************************************************************
 void init_pressure_table(void)
 {
-#ifndef CONFIG_FIXEDPOINT_MATH
-    uint8_t i;
-
-    for (i = 0; i < 17; i++) p[i] = p0[i];
-
-#else
-    pLast = 101325 / 4; // Last measured pressure in 4Pa units
-    pRef = 101325 / 4; // Reference pressure at sea level in 4Pa units
-    hLast = 0;
-#endif
+    ps_alt_e = 0;
+    ps_alt_href = 0;
 }
 
-#ifdef CONFIG_FIXEDPOINT_MATH
+
 // *************************************************************************************************
-// @fn          conv_altitude_to_fraction
-// @brief       Relative pressure deviation from reference pressure for given altitude estimate.
-// @param       int16_t hh Altitude estimate (in normalised units).
-// @return      Calculated relative pressure deviation for this altitude
+// @fn          conv_pa_to_std_altitude
+// @brief       Standard atmosphere altitude for a pressure, from ps_alt_table.
+//              Three point Newton interpolation, t is the Q10 position past entry i:
+//                  h = h[i] + t*d1 + t*(t-1)/2*d2
+// @param       uint32_t        p       Pressure (Pa)
+// @return      int32_t                 Altitude (1/16m)
 // *************************************************************************************************
-int16_t conv_altitude_to_fraction(int16_t hh)
+static int32_t conv_pa_to_std_altitude(uint32_t p)
 {
-    /*
-    The fixed part of the function of altitude can be broken into tabulated ranges
-    and/or interpolated according to a Taylor series expansion
-         (1 - f) = (1 � h/H0)^b
-                 = 1 - h*b/H0 + h^2*b*(b�1)/2/H0^2 � h^3*b8(b�1)*(b-2)/6/H0^3 + �
-    At low altitudes h/H0 << 1, so this series tends to converge rapidly and is
-    well-suited for fixed point implementation. With one or two additional terms
-    the series converges accurately over the range of interest so there is no need
-    for table interpolation. For the proposed fixed point implementation we rewrite
-    this expression a bit into
-        hh = b*h/H0
-        (1 - f) = (1 � h/H0)^b
-                = 1 - hh*(1 � hh*(b�1)/2/b*(1 � hh*(b�2)/3/b*(...
-    We stick to integer multiply and shift operations. Signed int16_t values can contain
-    values +/�2^15 and unsigned uint16_t values 0..2^16. In C multiplication amounts to
-    expanding to int32_t, integer multiply and scaling back by a proper shift operation.
-
-    Given the above equations the natural unit of hh as the first order correction is
-    H0/b = 8434.48m. If we accept this as a maximum +/� range we can store int16_t hh in
-    units of (H0/b)/2^15 = 0,26m which keeps the resolution at less than a foot.
-     */
-    int16_t f, hf;
-    // f  = hh*(b � 4)/5/b, correction relevant above 3.5km:
-    // (Could be omitted, but it is relatively little work.)
-    f = mult_scale16(hh, 3132);
-    // f  = hh*(b � 3)/4/b*(1 - f), correction relevant above 1.3km:
-    hf = mult_scale16(hh, 7032);
-    f = hf - mult_scale15(hf, f);
-    // f = hh*(b � 2)/3/b*(1 - f), correction relevant above 300m:
-    hf = mult_scale16(hh, 13533);
-    f = hf - mult_scale15(hf, f);
-    // f = hh*(b � 1)/2/b*(1 - f), correction relevant above 30m:
-    hf = mult_scale16(hh, 26533);
-    f = hf - mult_scale15(hf, f);
-    // f = hh*(1 - f), the linear part:
-    f = hh - mult_scale15(hh, f);
-    return f;
-}
+    uint16_t i, t;
+    int16_t d1, d2;
+    int32_t h;
+
+    if (p < PS_ALT_PMIN) p = PS_ALT_PMIN;
+    if (p > PS_ALT_PMAX) p = PS_ALT_PMAX;
 
-#endif // CONFIG_FIXEDPOINT_MATH
+    p -= PS_ALT_PMIN;
+    i = (uint16_t)(p >> PS_ALT_SHIFT);
+    if (i > PS_ALT_ENTRIES - 3) i = PS_ALT_ENTRIES - 3;
+    t = (uint16_t)p - (i << PS_ALT_SHIFT);
+
+    d1 = (int16_t)(ps_alt_table[i + 1] - ps_alt_table[i]);
+    d2 = (int16_t)(ps_alt_table[i + 2] - ps_alt_table[i + 1]) - d1;
+
+    h  = (int32_t)t * d1;
+    h += (((int32_t)t * ((int16_t)t - PS_ALT_STEP)) >> (PS_ALT_SHIFT + 1)) * d2;
+
+    return ps_alt_table[i] + ((h + (PS_ALT_STEP / 2)) >> PS_ALT_SHIFT);
+}
 
 
 // *************************************************************************************************
 // @fn          update_pressure_table
-// @brief       Calculate pressure table for reference altitude.
-//              Implemented straight from VTI reference code.
-// @param       int16_t     href    Reference height
+// @brief       Recalibrate the conversion so that the current pressure reads as href.
+//              This is the same as setting QNH: the altitude above the standard atmosphere
+//              scales with (H0 - h), and ps_alt_e holds the scale error in Q20.
+// @param       int16_t     href    Reference height (m)
 //              uint32_t        p_meas  Pressure (Pa)
-//              uint16_t        t_meas  Temperature (10*�K)
+//              uint16_t        t_meas  Temperature (10*K), unused
 // @return      none
 // *************************************************************************************************
 void update_pressure_table(int16_t href, uint32_t p_meas, uint16_t t_meas)
 {
-#ifndef CONFIG_FIXEDPOINT_MATH
-    const float Invt00 = 0.003470415;
-    const float coefp  = 0.00006;
-    volatile float p_fact;
-    volatile float p_noll;
-    volatile float hnoll;
-    volatile float h_low = 0;
-    volatile float t0;
-    uint8_t i;
+    int32_t hstd = conv_pa_to_std_altitude(p_meas);
+    int32_t diff = hstd - ((int32_t)href << 4);
+    int32_t e;
 
-    // Typecast arguments
-    volatile float fl_href      = href;
-    volatile float fl_p_meas    = (float)p_meas / 100;  // Convert from Pa to hPa
-    volatile float fl_t_meas    = (float)t_meas / 10;       // Convert from 10�K to 1�K
+    // |e| < 2^15 covers QNH from about 860 to 1090 hPa
+    if (diff >  32767) diff =  32767;
+    if (diff < -32767) diff = -32767;
 
-    t0 = fl_t_meas + (0.0065 * fl_href);
+    // The long division is acceptable because it happens rarely
+    e = (diff << 16) / (PS_ALT_H0 - ((hstd + 8) >> 4));
+    if (e >  32767) e =  32767;
+    if (e < -32767) e = -32767;
 
-    hnoll  = fl_href / (t0 * Invt00);
-
-    for (i = 0; i <= 15; i++) {
-        if (h0[i] > hnoll) break;
-
-        h_low = h0[i];
-    }
-
-    p_noll = (float)(hnoll - h_low) * (1 - (hnoll - (float)h0[i]) * coefp) * ((float)p0[i] - (float)p0[i - 1]) / ((float)h0[i] - h_low) + (float)p0[i - 1];
-
-    // Calculate multiplicator
-    p_fact = fl_p_meas / p_noll;
-
-    // Apply correction factor to pressure table
-    for (i = 0; i <= 16; i++) {
-        p[i] = p0[i] * p_fact;
-    }
-
-#else
-    // Note: a user-provided sea-level reference pressure in mbar as used by pilots
-    // would be straightforward: href = 0; p_meas = (int32_t)mbar*100;
-    // The altitude reading will be iteratively updated.
-
-    // Convert to 4Pa units:
-    pLast = (int16_t)((p_meas + 2) >> 2);
-
-    // Convert reference altitude to normalized units:
-    /*if (sys.flag.use_metric_units) { // user_altitude in m
-        hLast = 4 * href - mult_scale16(href, 7536);
-    } else { // user_altitude in ft
-        hLast = href + mult_scale16(href, 12068);
-    }*/
-
-    int32_t f = (int32_t)0x8000 - conv_altitude_to_fraction(hLast);
-    // pRef = p_meas*2^15/f:
-    pRef = ((((int32_t)pLast << 16) + f) >> 1) / f;
-    // The long division is acceptable because it happens rarely.
-    // The term + f) is for proper rounding.
-    // The <<16 and >>1 operations correct for the 15bit scale of f.
-#endif
+    ps_alt_e = (int16_t)e;
+    ps_alt_href = href;
 }
 
-#ifndef CONFIG_FIXEDPOINT_MATH
+
 // *************************************************************************************************
-// @fn          conv_pa_to_meter
-// @brief       Convert pressure (Pa) to altitude (m) using a conversion table
-//              Implemented straight from VTI reference code.
+// @fn          conv_pa_to_altitude_q2
+// @brief       Calculates altitude from current pressure and the stored calibration.
+//
+//              The standard atmosphere altitude H0*(1 - (p/P0)^a) comes from ps_alt_table,
+//              with H0 = 44330.77m and a = 0.190263, and is moved to the calibrated QNH.
+//
+//              The table assumes the standard lapse rate, so the height above the reference
+//              point is stretched by T/Tstd. Tstd is the log mean of the standard temperature
+//              over the layer, Tmid - dT^2/12/Tmid. The temperature reading is strongly
+//              influenced by body heat, so callers that do not trust it pass t_meas = 0.
 // @param       uint32_t        p_meas  Pressure (Pa)
-//              uint16_t        t_meas  Temperature (10*�K)
-// @return      int16_t             Altitude (m)
+// @param       uint16_t        t_meas  Temperature (10*K), 0 to ignore
+// @return      int16_t                 Altitude (0.25m)
 // *************************************************************************************************
-int16_t conv_pa_to_meter(uint32_t p_meas, uint16_t t_meas)
+int16_t conv_pa_to_altitude_q2(uint32_t p_meas, uint16_t t_meas)
 {
-    const float coef2  = 0.0007;
-    const float Invt00 = 0.003470415;
-    volatile float hnoll;
-    volatile float t0;
-    volatile float p_low;
-    volatile float fl_h;
-    volatile int16_t h;
-    uint8_t i;
-
-    // Typecast arguments
-    volatile float fl_p_meas = (float)p_meas / 100; // Convert from Pa to hPa
-    volatile float fl_t_meas = (float)t_meas / 10;      // Convert from 10�K to 1�K
-
-    for (i = 0; i <= 16; i++) {
-        if (p[i] < fl_p_meas) break;
-
-        p_low = p[i];
+    int32_t h, dh, href, dt;
+    uint16_t tstd;
+
+    // Move to the calibrated QNH
+    h = conv_pa_to_std_altitude(p_meas);
+    h -= ((int32_t)(PS_ALT_H0 - ((h + 8) >> 4)) * ps_alt_e) >> 16;
+
+    if (t_meas) {
+        // Height above the reference point in 1/8m
+        href = (int32_t)ps_alt_href << 4;
+        dh = (h - href + 1) >> 1;
+        if (dh >  PS_ALT_DH_MAX) dh =  PS_ALT_DH_MAX;
+        if (dh < -PS_ALT_DH_MAX) dh = -PS_ALT_DH_MAX;
+
+        // Tmid in 1/160 K, 16 * (2881.5 - 0.065 * hmid)
+        tstd = 46104 - (int16_t)((((h + href) >> 1) * 4260 + 32768) >> 16);
+        // dT^2 / 12 / Tmid, with 1/Tmid to first order around 272 K
+        dt = dh >> 1;
+        tstd -= (uint16_t)((((((uint32_t)(dt * dt) >> 16) * (87040u - tstd)) >> 16) * 1674 + 65536) >> 17);
+
+        // h = href + dh * T / Tstd
+        dt = dh * ((int32_t)t_meas * 16 - tstd);
+        dt = (dt + (dt < 0 ? -(int32_t)(tstd / 2) : (int32_t)(tstd / 2))) / tstd;
+        h = href + ((dh + dt) << 1);
     }
 
-    if (i == 0) {
-        hnoll = (float)(fl_p_meas - p[0]) / (p[1] - p[0]) * ((float)(h0[1] - h0[0]));
-    } else if (i < 15) {
-        hnoll = (float)(fl_p_meas - p_low) * (1 - (fl_p_meas - p[i]) * coef2) / (p[i] - p_low) * ((float)(h0[i] - h0[i - 1])) + h0[i - 1];
-    } else if (i == 15) {
-        hnoll = (float)(fl_p_meas - p_low) / (p[i] - p_low) * ((float)(h0[i] - h0[i - 1])) + h0[i - 1];
-    } else { // i==16
-        hnoll = (float)(fl_p_meas - p[16]) / (p[16] - p[15]) * ((float)(h0[16] - h0[15])) + h0[16];
-    }
+    h = (h + 2) >> 2;
+    if (h >  32767) h =  32767;
+    if (h < -32768) h = -32768;
 
-    // Compensate temperature error
-    t0 = fl_t_meas / (1 - hnoll * Invt00 * 0.0065);
-    fl_h = Invt00 * t0 * hnoll;
-    h = (uint16_t)fl_h;
-
-    return (h);
+    return (int16_t)h;
 }
-#else
+
+
 // *************************************************************************************************
-// @fn          conv_pressure_to_altitude
-// @brief       Calculates altitude from current pressure, and
-//              stored reference pressure at sea level and previous altitude estimate.
-//              Temperature info is ignored.
+// @fn          conv_pa_to_altitude
+// @brief       Calculates altitude from current pressure, see conv_pa_to_altitude_q2().
 // @param       uint32_t        p_meas  Pressure (Pa)
-// @param       uint16_t        t_meas  Temperature (10*�K) Ignored !!!
-// @return      Estimated altitude in user-selected unit (m or ft)
-//              (internally filtered, slightly sluggish).
+// @param       uint16_t        t_meas  Temperature (10*K), 0 to ignore
+// @return      int16_t                 Altitude (m)
 // *************************************************************************************************
 int16_t conv_pa_to_altitude(uint32_t p_meas, uint16_t t_meas)
 {
-    /*
-    Assumption: fixed, linear T(h)
-    T = T0 � dTdh*h
-    with
-    T0 = 288.15K (15C)
-    dTdh = 6.5mK/m
-
-    Basic differential equation:
-        dh = -(R/G)*T(H)*dp/p
-    Solution:
-        H = H0*(1 � (p/pRef)^a)
-    with
-        H0 = T0/dTdh = 44330.77m
-        pRef = adjustable reference pressure at sea level (h=0).
-        a = dTdH*R/G = 0.190263
-        R = 287.052m^2/s^2/K
-        G = 9.80665 (at medium latitude)
-
-    We assume T0 and the temperature profile to be fixed; the temperature reading
-    of the watch is not very useful since it is strongly influenced by body heat,
-    clothing, shelter, etc.
-
-    Straight evaluation of h(p) requires an unattractive long division p/pRef
-    with pRef the adjustable reference pressure, and the Taylor expansion does
-    not converge very quickly.
-
-    Evaluation of p(h) requires a more attractive multiplication by the
-    user-adjustable reference pressure pRef:
-        f =(1 � h/H0)^b
-        p = pRef*f
-    with
-        b = 1/a = G/(dTdH*R) = 5.255896
-    In a very crude linear iteration the h value can be updated by
-        delta_h = �delta_p / dpdh
-    The slope dpdh varies by about a factor two over the range of interest,
-    but we can pick a fixed value on the safe side and accept that the updates
-    are a bit more damped at higher altitudes.
-
-    The sensor provides 19bit absolute pressure in units of 0.25Pa, but that is more
-    resolution than we can easily handle in the multiplications. We store measured
-    pressure p, reference pressure pRef and calculated pressure as uint16_t in units of 4Pa.
-
-    In the units chosen for p (4Pa) and for hLast (see function conv_altitude_to_fraction),
-    the slope dpdh is about -0.75 at sea level down to -0.375 at high altitudes. To avoid
-    overshoot and instabilities we assume a bigger value and accept a minor amount of
-    extra filtering delay at higher altitudes. The factor 1/0.75 is approximated by 1.
-    */
-    // Scale to 4Pa units:
-    int16_t p = (int16_t)((p_meas + 2) >> 2);
-    // Predictor to speed up response to pressure changes:
-//  hLast -= p - pLast; // Factor of about 1/0.75 would be better.
-    // Store current pressure for next predictor:
-    pLast = p;
-    // Calculate pressure ratio based on guessed altitude (serious DSP work):
-    int16_t f = conv_altitude_to_fraction(hLast);
-    // Calculate pressure expected for guessed height
-    uint16_t pCalculated = pRef - mult_scale15(pRef, f);
-    // This calculation is correct within about 7Pa.
-    // We still have to reverse the solution with a linearly improved guess:
-    hLast -= p - pCalculated;
-    // Iteration gain factor of about 1/0.75 would result in faster convergence,
-    // but even the big initial jump when the altimeter is switched on converges
-    // in some 5 or 6 steps to about 1m accuracy.
-
-    /*if (sys.flag.use_metric_units) {*/
-        // Altitude in meters (correct within about 0.7m):
-        return mult_scale16(hLast, 16869);
-/*  } else {
-        // Altitude in feet (correct within 1.5ft):
-        return mult_scale15(hLast, 27672);
-    }*/
+    return (conv_pa_to_altitude_q2(p_meas, t_meas) + 2) >> 2;
 }
-#endif // CONFIG_FIXEDPOINT_MATH
@@ -43,18 +43,21 @@
 // *************************************************************************************************
 // Prototypes section
 extern void ps_init(void);
-extern void ps_start(void);
+extern void ps_start(uint8_t mode);
 extern void ps_stop(void);
 extern uint32_t ps_get_pa(void);
 extern uint16_t ps_get_temp(void);
+extern uint8_t ps_get_pa_async(void (*callback)(uint32_t pa));
+extern uint8_t ps_read_register_async(uint8_t address, uint8_t mode,
+                                      void (*callback)(uint16_t data, uint8_t ok));
+extern uint8_t ps_write_register_async(uint8_t address, uint8_t data,
+                                       void (*callback)(uint16_t data, uint8_t ok));
+extern uint8_t ps_twi_tick(void);
 
 extern void init_pressure_table(void);
 extern void update_pressure_table(int16_t href, uint32_t p_meas, uint16_t t_meas);
-#ifndef CONFIG_FIXEDPOINT_MATH
-extern int16_t conv_pa_to_meter(uint32_t p_meas, uint16_t t_meas);
-#else
 extern int16_t conv_pa_to_altitude(uint32_t p_meas, uint16_t t_meas);
-#endif
+extern int16_t conv_pa_to_altitude_q2(uint32_t p_meas, uint16_t t_meas);
 
 // *************************************************************************************************
 // Defines section
@@ -81,10 +84,19 @@ extern int16_t conv_pa_to_altitude(uint32_t p_meas, uint16_t t_meas);
 #define PS_TWI_WRITE        (0u)
 #define PS_TWI_READ         (1u)
 
-#define PS_TWI_SEND_START   (0u)
-#define PS_TWI_SEND_RESTART (1u)
-#define PS_TWI_SEND_STOP    (2u)
-#define PS_TWI_CHECK_ACK    (3u)
+// PJ.2/PJ.3 have no USCI function, so the bus is bit-banged. The async calls clock one
+// byte or bus condition per TA0CCR1 interrupt, 1 tick = 61us apart, the blocking calls
+// the whole transaction at once.
+#define PS_TWI_TICKS        (1u)
+
+// MCLK cycles between bus phases, 1us at 12 MHz keeps SCL under the 400 kHz of the sensor
+#define PS_TWI_DELAY        (12u)
+
+// Measurement modes written to OPERATION by ps_start()
+#define PS_MODE_HIGH_SPEED      (0x09u)     // 9 Hz, 15 bit
+#define PS_MODE_HIGH_RES        (0x0Au)     // 1.8 Hz, 17 bit
+#define PS_MODE_ULTRA_LOW_POWER (0x0Bu)     // 1 Hz
+#define PS_MODE_TRIGGERED       (0x0Cu)     // one measurement, then standby
 
 #define PS_TWI_8BIT_ACCESS  (0u)
 #define PS_TWI_16BIT_ACCESS (1u)
@@ -103,6 +115,9 @@ extern int16_t conv_pa_to_altitude(uint32_t p_meas, uint16_t t_meas);
 
 // *************************************************************************************************
 // Extern section
+extern uint8_t ps_ok;
+extern volatile uint8_t ps_last_interrupt;
+extern uint8_t ps_mode;
 
 
 #endif /*VTI_PS_H_*/
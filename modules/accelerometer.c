@@ -30,12 +30,11 @@
 #include "drivers/display.h"
 #include "drivers/vti_as.h"
 #include "drivers/buzzer.h"
+#include "drivers/dsp.h"
 
 // *************************************************************************************************
 // Defines section
 
-#define BIT(x) (1uL << (x))
-
 #define ACCEL_MODE_OFF      (0u)
 #define ACCEL_MODE_ON       (1u)
 #define ACCEL_MODE_BACKGROUND   (2u)
@@ -48,13 +47,48 @@
 // This parameter is ignored if in background mode!
 #define ACCEL_MEASUREMENT_TIMEOUT       (60u)
 
+// Weight of a new sample in the displayed value, 0.8 in Q15
+#define ACCEL_FILTER_NEW                (26214)
+
+// Samples per SYS_MSG_AS_INT in measurement mode
+#define ACCEL_STREAM_BATCH              (AS_RING_SIZE / 2)
+
 // Conversion values from data to mgrav taken from CMA3000-D0x datasheet (rev 0.4, table 4)
-const uint16_t mgrav_per_bit[7] = { 18, 36, 71, 143, 286, 571, 1142 };
+// The per bit values are summed up by the compiler for every value of the
+// low nibble and of the upper three bits, so a conversion is two lookups
+#define MGRAV_SUM(v, b0, b1, b2, b3) \
+    ((((v) & 1) ? (b0) : 0) + (((v) & 2) ? (b1) : 0) + \
+     (((v) & 4) ? (b2) : 0) + (((v) & 8) ? (b3) : 0))
+#define MGRAV_8(b0, b1, b2, b3) \
+    MGRAV_SUM(0, b0, b1, b2, b3), MGRAV_SUM(1, b0, b1, b2, b3), \
+    MGRAV_SUM(2, b0, b1, b2, b3), MGRAV_SUM(3, b0, b1, b2, b3), \
+    MGRAV_SUM(4, b0, b1, b2, b3), MGRAV_SUM(5, b0, b1, b2, b3), \
+    MGRAV_SUM(6, b0, b1, b2, b3), MGRAV_SUM(7, b0, b1, b2, b3)
+#define MGRAV_16(b0, b1, b2, b3) \
+    MGRAV_8(b0, b1, b2, b3), \
+    MGRAV_SUM(8, b0, b1, b2, b3) + MGRAV_SUM(0, b0, b1, b2, b3), \
+    MGRAV_SUM(8, b0, b1, b2, b3) + MGRAV_SUM(1, b0, b1, b2, b3), \
+    MGRAV_SUM(8, b0, b1, b2, b3) + MGRAV_SUM(2, b0, b1, b2, b3), \
+    MGRAV_SUM(8, b0, b1, b2, b3) + MGRAV_SUM(3, b0, b1, b2, b3), \
+    MGRAV_SUM(8, b0, b1, b2, b3) + MGRAV_SUM(4, b0, b1, b2, b3), \
+    MGRAV_SUM(8, b0, b1, b2, b3) + MGRAV_SUM(5, b0, b1, b2, b3), \
+    MGRAV_SUM(8, b0, b1, b2, b3) + MGRAV_SUM(6, b0, b1, b2, b3), \
+    MGRAV_SUM(8, b0, b1, b2, b3) + MGRAV_SUM(7, b0, b1, b2, b3)
+
+// [0] is the 2g range, [1] the 8g range
+static const uint16_t mgrav_lo[2][16] = {
+    { MGRAV_16(18, 36, 71, 143) },
+    { MGRAV_16(71, 143, 286, 571) }
+};
+static const uint16_t mgrav_hi[2][8] = {
+    { MGRAV_8(286, 571, 1142, 0) },
+    { MGRAV_8(1142, 2286, 4571, 0) }
+};
 
 
 // *** Tunes for accelerometer synestesia
 
-static note smb[] = {0x2588, 0x000F};
+static const note smb[] = {0x2588, 0x000F};
 
 // *************************************************************************************************
 // Global Variable section
@@ -66,18 +100,23 @@ struct accel
     // Sensor raw data
     uint8_t         xyz[3];
 
+    // Sensor data converted to mgrav, without sign
+    uint16_t        mgrav[3];
 
 
-    // Acceleration data in 10 * mgrav
+    // Filtered acceleration data in mgrav
     uint16_t        data;
 
-    // Sensor old data for FIR filter
-    uint16_t        data_prev;
+    // Low pass on the displayed axis
+    struct iir1     filter;
 
     // Timeout: should be decreased with the 1 minute RTC event
     uint16_t            timeout;
     // Display X/Y/Z values
     uint8_t             view_style;
+
+    // Sensor set up asked for, see as_claim()
+    struct As_Param     as;
 };
 extern struct accel sAccel;
 
@@ -128,8 +167,7 @@ uint8_t acceleration_value_is_positive(uint8_t value)
 // *************************************************************************************************
 uint16_t convert_acceleration_value_to_mgrav(uint8_t value)
 {
-    uint16_t result;
-    uint8_t i;
+    uint8_t range = (as_config.range == 8);
 
     if (!acceleration_value_is_positive(value))
     {
@@ -138,14 +176,30 @@ uint16_t convert_acceleration_value_to_mgrav(uint8_t value)
         value += 1;
     }
 
-    result = 0;
-    for (i=0; i<7; i++)
-    {
+    return mgrav_lo[range][value & 0x0F] + mgrav_hi[range][(value >> 4) & 0x07];
+}
 
-        result += ((value & (BIT(i)))>>i) * mgrav_per_bit[i];
-    }
+// *************************************************************************************************
+// @fn          convert_acceleration_xyz_to_mgrav
+// @brief       Converts a X/Y/Z sample to mgrav units
+// @param       u8 *xyz     g data from sensor
+//              u16 *mgrav  Acceleration (mgrav) of each axis
+// @return      none
+// *************************************************************************************************
+void convert_acceleration_xyz_to_mgrav(const uint8_t *xyz, uint16_t *mgrav)
+{
+    const uint16_t *lo = mgrav_lo[as_config.range == 8];
+    const uint16_t *hi = mgrav_hi[as_config.range == 8];
+    uint8_t value;
+    uint8_t i;
 
-    return (result);
+    for (i = 0; i < 3; i++)
+    {
+        value = xyz[i];
+        if (!acceleration_value_is_positive(value))
+            value = ~value + 1;
+        mgrav[i] = lo[value & 0x0F] + hi[(value >> 4) & 0x07];
+    }
 }
 
 void update_menu()
@@ -204,9 +258,12 @@ static void up_btn()
     // Depending on the state what do we do?
     switch (submenu_state) {
         case VIEW_SET_MODE:
-            as_config.mode++;
-            as_config.mode %= 3;
-            change_mode(as_config.mode);
+            sAccel.as.mode++;
+            sAccel.as.mode %= 3;
+            // Measurement mode samples continuously, buffer in the driver
+            as_claim(AS_CLIENT_ACCEL, &sAccel.as,
+                     sAccel.as.mode == MEASUREMENT_MODE ?
+                     ACCEL_STREAM_BATCH : AS_READ_IRQ);
             update_menu();
 
             break;
@@ -282,15 +339,12 @@ void display_data(uint8_t display_id)
             break;
     }
 
-    // Filter acceleration
-    #ifdef FIXEDPOINT
-    accel_data = (uint16_t)(((sAccel.data_prev * 2) + (sAccel.data * 8)) / 10);
-    #else
-    accel_data = (uint16_t)((sAccel.data_prev * 0.2) + (sAccel.data * 0.8));
-    #endif
+    // Filter acceleration, 0.8 * new + 0.2 * old
+    sAccel.data = iir1_filter(&sAccel.filter,
+                              convert_acceleration_value_to_mgrav(raw_data));
 
-    // Store average acceleration
-    sAccel.data = sAccel.data_prev;
+    // mgrav / 10 for the x.xx format, 6554 / 65536 = 0.1
+    accel_data = mult_scale16(sAccel.data, 6554);
 
     // Display acceleration in x.xx format in the second screen this is real time!
     display_chars(display_id,LCD_SEG_L1_2_0, _sprintf("%03s", accel_data), SEG_ON);
@@ -315,19 +369,29 @@ static void as_event(enum sys_message msg)
         if(sAccel.timeout<1)
         {
             //disable accelerometer to save power
-            as_stop();
+            as_release(AS_CLIENT_ACCEL);
             //update the mode to remember
             sAccel.mode = ACCEL_MODE_OFF;
         }
 
     }
-    if ( (msg & SYS_MSG_AS_INT) == SYS_MSG_AS_INT)
+    if ( (msg & SYS_MSG_AS_INT) == SYS_MSG_AS_INT
+         && as_config.mode == MEASUREMENT_MODE)
+    {
+        // A batch of samples is waiting in the driver's ring buffer
+        while (as_stream_read(sAccel.xyz))
+            convert_acceleration_xyz_to_mgrav(sAccel.xyz, sAccel.mgrav);
+
+        display_data(1);
+        if (submenu_state == VIEW_AXIS) lcd_screen_activate(1);
+    }
+    else if ( (msg & SYS_MSG_AS_INT) == SYS_MSG_AS_INT)
     {
         //Check the vti register for status information
         as_status.all_flags=as_get_status();
         //TODO For debugging only
         _printf(0, LCD_SEG_L1_1_0, "%1u", as_status.all_flags);
-        buzzer_play(smb);
+        buzzer_play(smb, BUZZER_PRIO_FEEDBACK);
         //if we were in free fall or motion detection mode check for the event
         if(as_status.int_status.falldet || as_status.int_status.motiondet){
 
@@ -336,6 +400,7 @@ static void as_event(enum sys_message msg)
 
             //read the data
             as_get_data(sAccel.xyz);
+            convert_acceleration_xyz_to_mgrav(sAccel.xyz, sAccel.mgrav);
             //display_data(0);
             /* update menu screen */
             lcd_screen_activate(0);
@@ -389,16 +454,17 @@ static void acc_activated()
         {
             // Clear previous acceleration value
             sAccel.data = 0;
+            iir1_init(&sAccel.filter, ACCEL_FILTER_NEW, 0);
             // 2 g range
-            as_config.range=2;
+            sAccel.as.range=2;
             // 100 Hz sampling rate
-            as_config.sampling=SAMPLING_10_HZ;
+            sAccel.as.sampling=SAMPLING_10_HZ;
             // keep mode
-            as_config.mode=ACTIVITY_MODE;
+            sAccel.as.mode=ACTIVITY_MODE;
             //time window is 10 msec for free fall and 100 msec for activity
             //2g multiple 71 mg: 0F=4 * 71 mg= 1.065 g
-            as_config.MDTHR=2;
-            as_config.MDFFTMR=1;
+            sAccel.as.MDTHR=2;
+            sAccel.as.MDFFTMR=1;
 
             // Set timeout counter
             sAccel.timeout = ACCEL_MEASUREMENT_TIMEOUT;
@@ -412,8 +478,8 @@ static void acc_activated()
             // Select Axis X
             sAccel.view_style=DISPLAY_ACCEL_Z;
 
-            // Start sensor in motion detection mode
-            as_start(ACTIVITY_MODE);
+            // Start sensor in motion detection mode, other modules wait
+            as_claim(AS_CLIENT_ACCEL, &sAccel.as, AS_READ_IRQ);
             // After this call interrupts will be generated
         }
 
@@ -465,8 +531,8 @@ static void acc_deactivated()
     /* otherwise shutdown all the stuff
     ** deregister from the message bus */
     sys_messagebus_unregister_all(&as_event);
-    /* Stop acceleration sensor */
-    as_stop();
+    /* Stop acceleration sensor, or hand it back to another module */
+    as_release(AS_CLIENT_ACCEL);
 
     /* Clear mode */
     sAccel.mode = ACCEL_MODE_OFF;
@@ -480,7 +546,7 @@ void mod_accelerometer_init()
     //if this is called only one time after reboot there are some important things to initialise
     //Initialise sAccel struct?
     sAccel.data=0;
-    sAccel.data_prev=0;
+    iir1_init(&sAccel.filter, ACCEL_FILTER_NEW, 0);
     // Set timeout counter
     sAccel.timeout = ACCEL_MEASUREMENT_TIMEOUT;
     /* Clear mode */
@@ -42,8 +42,10 @@ static union {
 } alarm_state;
 
 static uint8_t tmp_hh, tmp_mm;
-static note chime_notes[2] = {0x1931, 0x000F};
-static note alarm_notes[4] = {0x3234, 0x1900, 0x3234, 0x000F};
+static const note chime_notes[2] = {0x1931, 0x000F};
+
+/* two beeps a second for the 30 seconds, a step louder every 4 seconds */
+static const struct buzzer_pattern alarm_pattern = {0x3234, 300, 60, 8};
 
 static void print_mm (void)
 {
@@ -93,6 +95,8 @@ static uint8_t alarm_sec_elapsed = 0;
 static void alarm_event(enum sys_message msg)
 {
     if (msg & SYS_MSG_BUTTON || alarm_sec_elapsed >= 30) {
+        if (msg & SYS_MSG_BUTTON)
+            buzzer_stop();
         alarm_sec_elapsed = 0;
         ports_buttons_clear();
         sys_messagebus_unregister(&alarm_event, SYS_MSG_BUTTON | SYS_MSG_RTC_SECOND);
@@ -101,16 +105,16 @@ static void alarm_event(enum sys_message msg)
 
     if (msg & SYS_MSG_RTC_ALARM) {
         sys_messagebus_register(&alarm_event, SYS_MSG_BUTTON | SYS_MSG_RTC_SECOND);
+        buzzer_play_pattern(&alarm_pattern, BUZZER_PRIO_ALARM);
     }
 
     alarm_sec_elapsed++;
-    buzzer_play(alarm_notes);
 }
 
 static void hour_event(enum sys_message msg)
 {
     if (msg & SYS_MSG_RTC_HOUR) {
-        buzzer_play(chime_notes);
+        buzzer_play(chime_notes, BUZZER_PRIO_CHIME);
     }
 }
 
@@ -0,0 +1,312 @@
+/**
+    altimeter.c: altimeter and variometer
+
+    http://github.com/BenjaminSoelberg/openchronos-ng-elf
+
+    This file is part of openchronos-ng.
+
+    openchronos-ng is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    openchronos-ng is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#include "messagebus.h"
+#include "menu.h"
+
+/* drivers */
+#include "drivers/display.h"
+#include "drivers/buzzer.h"
+#include "drivers/vti_ps.h"
+#include "drivers/vario.h"
+
+/* Climb rates in cm/s where the lift beeps and the sink tone start */
+#define ALTIMETER_LIFT      (10)
+#define ALTIMETER_SINK      (-200)
+
+/* Samples between two screen updates, about 3 Hz */
+#define ALTIMETER_REFRESH   (3u)
+
+static struct vario altimeter;
+static uint32_t altimeter_pa;
+static uint16_t altimeter_temp;
+static uint8_t altimeter_samples;
+static int16_t altimeter_ref;
+
+static uint8_t altimeter_running;
+static uint8_t altimeter_active;
+static uint8_t altimeter_editing;
+static uint8_t altimeter_sound = 1;
+
+/* tone, rest, stop */
+static note altimeter_notes[3];
+
+static void display_altitude(int16_t alt)
+{
+    if (alt < 0)
+        _printf(0, LCD_SEG_L1_3_0, "%3s", alt);
+    else
+        _printf(0, LCD_SEG_L1_3_0, "%4u", alt);
+}
+
+static void display_climb(int16_t climb)
+{
+    if (climb > 999)
+        climb = 999;
+    if (climb < -999)
+        climb = -999;
+
+    /* m/s with two decimals, the point sits between L2_2 and L2_1 */
+    _printf(0, LCD_SEG_L2_3_0, "%03s", climb);
+
+    display_symbol(0, LCD_SYMB_ARROW_UP,
+                   climb >= ALTIMETER_LIFT ? SEG_ON : SEG_OFF);
+    display_symbol(0, LCD_SYMB_ARROW_DOWN,
+                   climb <= -ALTIMETER_LIFT ? SEG_ON : SEG_OFF);
+}
+
+static void display_state(void)
+{
+    display_symbol(0, LCD_ICON_BEEPER1, altimeter_sound ? SEG_ON : SEG_OFF);
+
+    if (!ps_ok) {
+        display_chars(0, LCD_SEG_L1_3_0, " ERR", SEG_SET);
+        return;
+    }
+
+    if (!altimeter_running) {
+        display_chars(0, LCD_SEG_L1_3_0, " OFF", SEG_SET);
+        display_clear(0, 2);
+        display_symbol(0, LCD_UNIT_L1_M, SEG_OFF);
+        return;
+    }
+
+    display_symbol(0, LCD_UNIT_L1_M, SEG_ON);
+    display_symbol(0, LCD_SEG_L2_DP, SEG_ON);
+
+    if (!altimeter.valid) {
+        display_chars(0, LCD_SEG_L1_3_0, "----", SEG_SET);
+        return;
+    }
+
+    if (!altimeter_editing)
+        display_altitude(vario_altitude(&altimeter));
+    display_climb(vario_climb(&altimeter));
+}
+
+/*
+  Lift beeps rise a semitone every 0.2 m/s from A6 and come faster, sink
+  is a long tone falling from G#4 every 0.5 m/s. A new one only starts
+  when the buzzer is idle, which sets the cadence.
+*/
+static void altimeter_beep(int16_t climb)
+{
+    uint16_t idx, ms, rest;
+    uint8_t octave, pitch;
+
+    if (is_buzzer_playing())
+        return;
+
+    if (climb >= ALTIMETER_LIFT) {
+        idx = (climb - ALTIMETER_LIFT) / 20;
+        if (idx > 23)
+            idx = 23;
+        octave = 2 + idx / 12;
+        pitch = 1 + idx % 12;
+        ms = 300 - idx * 10;
+        rest = ms;
+    } else if (climb <= ALTIMETER_SINK) {
+        idx = (ALTIMETER_SINK - climb) / 50;
+        if (idx > 11)
+            idx = 11;
+        octave = 0;
+        pitch = 12 - idx;
+        ms = 600;
+        rest = 100;
+    } else {
+        return;
+    }
+
+    altimeter_notes[0] = (ms << 6) | (octave << 4) | pitch;
+    altimeter_notes[1] = rest << 6;
+    altimeter_notes[2] = 0x000F;
+    buzzer_play(altimeter_notes, BUZZER_PRIO_FEEDBACK);
+}
+
+static void altimeter_event(enum sys_message msg)
+{
+    /* once a second is plenty for the temperature */
+    if (altimeter_samples == 0) {
+        altimeter_temp = ps_get_temp();
+        altimeter_samples = VARIO_RATE_HZ;
+    }
+    altimeter_samples--;
+
+    /* reading the result also clears DRDY for the next one */
+    altimeter_pa = ps_get_pa();
+    vario_update(&altimeter,
+                 conv_pa_to_altitude_q2(altimeter_pa, altimeter_temp));
+
+    if (altimeter_sound)
+        altimeter_beep(vario_climb(&altimeter));
+
+    if (altimeter_active && altimeter_samples % ALTIMETER_REFRESH == 0)
+        display_state();
+}
+
+static void altimeter_start(void)
+{
+    if (!ps_ok)
+        return;
+
+    vario_init(&altimeter);
+    altimeter_samples = 0;
+
+    sys_messagebus_register(&altimeter_event, SYS_MSG_PS_INT);
+    ps_start(PS_MODE_HIGH_SPEED);
+
+    display_symbol(0, LCD_ICON_RECORD, SEG_ON);
+    altimeter_running = 1;
+}
+
+static void altimeter_stop(void)
+{
+    sys_messagebus_unregister_all(&altimeter_event);
+    ps_stop();
+
+    display_symbol(0, LCD_ICON_RECORD, SEG_OFF);
+    display_symbol(0, LCD_SYMB_ARROW_UP, SEG_OFF);
+    display_symbol(0, LCD_SYMB_ARROW_DOWN, SEG_OFF);
+    display_symbol(0, LCD_SEG_L2_DP, SEG_OFF);
+    altimeter_running = 0;
+}
+
+/********************* edit mode callbacks ********************************/
+
+static void edit_ref_complete(void)
+{
+    /* the current pressure now reads as the entered altitude */
+    update_pressure_table(altimeter_ref, altimeter_pa, altimeter_temp);
+    vario_init(&altimeter);
+    altimeter_editing = 0;
+}
+
+static void edit_ref_cancel(void)
+{
+    altimeter_editing = 0;
+}
+
+static void edit_ref_set(int16_t step)
+{
+    altimeter_ref += step;
+    if (altimeter_ref > 8000)
+        altimeter_ref = 8000;
+    if (altimeter_ref < -999)
+        altimeter_ref = -999;
+
+    display_altitude(altimeter_ref);
+}
+
+static void edit_hundreds_sel(void)
+{
+    display_chars(0, LCD_SEG_L1_3_2, NULL, BLINK_ON);
+}
+static void edit_hundreds_dsel(void)
+{
+    display_chars(0, LCD_SEG_L1_3_2, NULL, BLINK_OFF);
+}
+static void edit_hundreds_set(int8_t step)
+{
+    edit_ref_set(step * 100);
+}
+
+static void edit_meters_sel(void)
+{
+    display_chars(0, LCD_SEG_L1_1_0, NULL, BLINK_ON);
+}
+static void edit_meters_dsel(void)
+{
+    display_chars(0, LCD_SEG_L1_1_0, NULL, BLINK_OFF);
+}
+static void edit_meters_set(int8_t step)
+{
+    edit_ref_set(step);
+}
+
+static struct menu_editmode_item edit_items[] = {
+    {&edit_hundreds_sel, &edit_hundreds_dsel, &edit_hundreds_set},
+    {&edit_meters_sel, &edit_meters_dsel, &edit_meters_set},
+    { NULL },
+};
+
+/************************** menu callbacks ********************************/
+
+static void altimeter_up_pressed(void)
+{
+    if (altimeter_running)
+        altimeter_stop();
+    else
+        altimeter_start();
+
+    display_state();
+}
+
+static void altimeter_down_pressed(void)
+{
+    altimeter_sound ^= 1;
+    display_state();
+}
+
+static void altimeter_edit(void)
+{
+    /* the reference needs a pressure reading to go with it */
+    if (!altimeter_running || !altimeter.valid)
+        return;
+
+    altimeter_ref = vario_altitude(&altimeter);
+    altimeter_editing = 1;
+    display_altitude(altimeter_ref);
+    menu_editmode_start(&edit_ref_complete, &edit_ref_cancel, edit_items);
+}
+
+static void altimeter_activate(void)
+{
+    altimeter_active = 1;
+    display_state();
+}
+
+static void altimeter_deactivate(void)
+{
+    altimeter_active = 0;
+
+    /* sampling and the vario tone go on in the background */
+    display_symbol(0, LCD_UNIT_L1_M, SEG_OFF);
+    display_symbol(0, LCD_ICON_BEEPER1, SEG_OFF);
+    display_symbol(0, LCD_SYMB_ARROW_UP, SEG_OFF);
+    display_symbol(0, LCD_SYMB_ARROW_DOWN, SEG_OFF);
+    display_clear(0, 1);
+    display_clear(0, 2);
+}
+
+void mod_altimeter_init(void)
+{
+    init_pressure_table();
+
+    menu_add_entry("ALTI",
+                   &altimeter_up_pressed,
+                   &altimeter_down_pressed,
+                   NULL,
+                   &altimeter_edit,
+                   NULL,
+                   NULL,
+                   &altimeter_activate,
+                   &altimeter_deactivate);
+}
@@ -0,0 +1,180 @@
+/**
+    barometer.c: pressure history and 3 hour tendency
+
+    http://github.com/BenjaminSoelberg/openchronos-ng-elf
+
+    This file is part of openchronos-ng.
+
+    openchronos-ng is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    openchronos-ng is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#include "messagebus.h"
+#include "menu.h"
+
+/* drivers */
+#include "drivers/display.h"
+#include "drivers/rtca.h"
+#include "drivers/vti_ps.h"
+#include "drivers/barolog.h"
+
+/* Minutes between two readings, must match the BAROLOG_SLOTS span */
+#define BAROMETER_PERIOD    (15u)
+
+static struct barolog barometer;
+static uint8_t barometer_waiting;
+static uint8_t barometer_active;
+static uint8_t barometer_view;
+
+static void display_state(void)
+{
+    enum barolog_trend trend = barolog_trend(&barometer);
+    int16_t change;
+
+    display_symbol(0, LCD_SYMB_ARROW_UP,
+                   trend == BAROLOG_RISING ? SEG_ON : SEG_OFF);
+    display_symbol(0, LCD_SYMB_ARROW_DOWN,
+                   trend == BAROLOG_FALLING ? SEG_ON : SEG_OFF);
+
+    if (!ps_ok) {
+        display_chars(0, LCD_SEG_L1_3_0, " ERR", SEG_SET);
+        return;
+    }
+
+    if (barometer.count == 0) {
+        display_chars(0, LCD_SEG_L1_3_0, "----", SEG_SET);
+        display_clear(0, 2);
+        return;
+    }
+
+    /* hPa */
+    _printf(0, LCD_SEG_L1_3_0, "%4u", (barolog_pa(&barometer, 0) + 50) / 100);
+
+    if (barometer_view) {
+        /* 3 hour change in hPa with two decimals */
+        change = barolog_change(&barometer);
+        if (change > 999)
+            change = 999;
+        if (change < -999)
+            change = -999;
+        display_symbol(0, LCD_SEG_L2_DP, SEG_ON);
+        _printf(0, LCD_SEG_L2_3_0, "%03s", change);
+        return;
+    }
+
+    display_symbol(0, LCD_SEG_L2_DP, SEG_OFF);
+
+    switch (trend) {
+    case BAROLOG_RISING:
+        display_chars(0, LCD_SEG_L2_3_0, "RISE", SEG_SET);
+        break;
+    case BAROLOG_FALLING:
+        display_chars(0, LCD_SEG_L2_3_0, "FALL", SEG_SET);
+        break;
+    case BAROLOG_STEADY:
+        display_chars(0, LCD_SEG_L2_3_0, "STDY", SEG_SET);
+        break;
+    default:
+        display_chars(0, LCD_SEG_L2_3_0, "----", SEG_SET);
+        break;
+    }
+}
+
+static void barometer_sample(uint32_t pa)
+{
+    barolog_add(&barometer, pa);
+
+    if (barometer_active)
+        display_state();
+}
+
+static void barometer_event(enum sys_message msg)
+{
+    /* DRDY of our own measurement, the altimeter gets these as well */
+    if ((msg & SYS_MSG_PS_INT) && barometer_waiting) {
+        barometer_waiting = 0;
+        barometer_sample(ps_get_pa());
+
+        /* unless the altimeter has taken the sensor over since */
+        if (ps_mode == PS_MODE_TRIGGERED)
+            ps_stop();
+    }
+
+    if (!(msg & SYS_MSG_RTC_MINUTE))
+        return;
+
+    /* a result that never came, the slot repeats the last reading */
+    if (barometer_waiting) {
+        barometer_waiting = 0;
+        if (ps_mode == PS_MODE_TRIGGERED)
+            ps_stop();
+        if (barometer.count)
+            barometer_sample(barolog_pa(&barometer, 0));
+    }
+
+    if (!ps_ok || rtca_time.min % BAROMETER_PERIOD != 0)
+        return;
+
+    /* the altimeter keeps the sensor running, take its latest result */
+    if (ps_mode != 0) {
+        barometer_sample(ps_get_pa());
+        return;
+    }
+
+    /* one measurement, DRDY comes back as SYS_MSG_PS_INT */
+    barometer_waiting = 1;
+    ps_start(PS_MODE_TRIGGERED);
+}
+
+/************************** menu callbacks ********************************/
+
+static void barometer_down_pressed(void)
+{
+    barometer_view ^= 1;
+    display_state();
+}
+
+static void barometer_activate(void)
+{
+    barometer_active = 1;
+    display_state();
+}
+
+static void barometer_deactivate(void)
+{
+    barometer_active = 0;
+
+    /* logging goes on in the background */
+    display_symbol(0, LCD_SYMB_ARROW_UP, SEG_OFF);
+    display_symbol(0, LCD_SYMB_ARROW_DOWN, SEG_OFF);
+    display_symbol(0, LCD_SEG_L2_DP, SEG_OFF);
+    display_clear(0, 1);
+    display_clear(0, 2);
+}
+
+void mod_barometer_init(void)
+{
+    barolog_init(&barometer);
+    sys_messagebus_register(&barometer_event,
+                            SYS_MSG_RTC_MINUTE | SYS_MSG_PS_INT);
+
+    menu_add_entry("BARO",
+                   NULL,
+                   &barometer_down_pressed,
+                   NULL,
+                   NULL,
+                   NULL,
+                   NULL,
+                   &barometer_activate,
+                   &barometer_deactivate);
+}
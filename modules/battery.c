@@ -31,13 +31,21 @@
 
 static void display_battery(void)
 {
-    /* display battery percentage on line one */
+#ifdef CONFIG_BATTERY_MONITOR
+    /* display state of charge on line one */
+    _printf(0, LCD_SEG_L1_2_0, "%3u", battery_info.soc);
+#else
+    /* without the monitor there is only the voltage to go by */
     display_chars(0, LCD_SEG_L1_2_0, _itopct(BATTERY_EMPTY_THRESHOLD,
            BATTERY_FULL_THRESHOLD, battery_info.voltage), SEG_SET);
+#endif
 
 #ifdef CONFIG_MOD_BATTERY_SHOW_VOLTAGE
     /* display battery voltage in line two (xx.x format) */
     _printf(0, LCD_SEG_L2_3_0, "%4u", battery_info.voltage);
+#elif defined(CONFIG_BATTERY_MONITOR)
+    /* display days left in line two */
+    _printf(0, LCD_SEG_L2_4_0, "%4uD", battery_info.days);
 #endif
 }
 
@@ -69,9 +77,7 @@ static void battery_deactivate(void)
 
     /* cleanup screen */
     display_clear(0, 1);
-#ifdef CONFIG_MOD_BATTERY_SHOW_VOLTAGE
     display_clear(0, 2);
-#endif
 
     /* clear static symbols */
 #ifdef CONFIG_MOD_BATTERY_SHOW_VOLTAGE
@@ -46,7 +46,7 @@ static void update() {
     _printf(0, LCD_SEG_L1_1_0, "%02u", key);
 
     n[0] = 0x3200 + (oct << 4) + key;
-    buzzer_play(n);
+    buzzer_play(n, BUZZER_PRIO_FEEDBACK);
 
 }
 
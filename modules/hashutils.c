@@ -114,176 +114,348 @@ static void sha1_transform(SHA1_INFO *sha1_info)
     sha1_info->digest[4] = T32(sha1_info->digest[4] + E);
 }
 
+/* SHA-256, written for a 16bit CPU without barrel shifter: the message
+   schedule is kept in a 16 word window instead of 64 words and each
+   Sigma function is done as nested rotations, which needs 22 (resp. 25)
+   single bit shifts instead of 37 (resp. 42) */
+
+#define ROTR(x,n)    T32(((x) >> (n)) | ((x) << (32 - (n))))
+
+#define CH(x,y,z)    ((x & y) ^ (~x & z))
+#define MAJ(x,y,z)   ((x & y) | (z & (x | y)))
+#define BSIG0(x)     ROTR(ROTR(ROTR(x, 9) ^ x, 11) ^ x, 2)
+#define BSIG1(x)     ROTR(ROTR(ROTR(x, 14) ^ x, 5) ^ x, 6)
+#define SSIG0(x)     (ROTR(ROTR(x, 11) ^ x, 7) ^ (x >> 3))
+#define SSIG1(x)     (ROTR(ROTR(x, 2) ^ x, 17) ^ (x >> 10))
+
+static const uint32_t sha256_k[64] = {
+    0x428a2f98L, 0x71374491L, 0xb5c0fbcfL, 0xe9b5dba5L,
+    0x3956c25bL, 0x59f111f1L, 0x923f82a4L, 0xab1c5ed5L,
+    0xd807aa98L, 0x12835b01L, 0x243185beL, 0x550c7dc3L,
+    0x72be5d74L, 0x80deb1feL, 0x9bdc06a7L, 0xc19bf174L,
+    0xe49b69c1L, 0xefbe4786L, 0x0fc19dc6L, 0x240ca1ccL,
+    0x2de92c6fL, 0x4a7484aaL, 0x5cb0a9dcL, 0x76f988daL,
+    0x983e5152L, 0xa831c66dL, 0xb00327c8L, 0xbf597fc7L,
+    0xc6e00bf3L, 0xd5a79147L, 0x06ca6351L, 0x14292967L,
+    0x27b70a85L, 0x2e1b2138L, 0x4d2c6dfcL, 0x53380d13L,
+    0x650a7354L, 0x766a0abbL, 0x81c2c92eL, 0x92722c85L,
+    0xa2bfe8a1L, 0xa81a664bL, 0xc24b8b70L, 0xc76c51a3L,
+    0xd192e819L, 0xd6990624L, 0xf40e3585L, 0x106aa070L,
+    0x19a4c116L, 0x1e376c08L, 0x2748774cL, 0x34b0bcb5L,
+    0x391c0cb3L, 0x4ed8aa4aL, 0x5b9cca4fL, 0x682e6ff3L,
+    0x748f82eeL, 0x78a5636fL, 0x84c87814L, 0x8cc70208L,
+    0x90befffaL, 0xa4506cebL, 0xbef9a3f7L, 0xc67178f2L
+};
+
+static void sha256_transform(SHA256_INFO *sha256_info)
+{
+    uint8_t i;
+    uint8_t *dp;
+    uint32_t T1, T2, A, B, C, D, E, F, G, H, W[16];
+
+    dp = sha256_info->data;
+
+    for (i = 0; i < 16; ++i) {
+            W[i] = ((uint32_t) dp[0] << 24) | ((uint32_t) dp[1] << 16) |
+                   ((uint16_t) dp[2] <<  8) | dp[3];
+            dp += 4;
+        }
+
+    A = sha256_info->digest[0];
+    B = sha256_info->digest[1];
+    C = sha256_info->digest[2];
+    D = sha256_info->digest[3];
+    E = sha256_info->digest[4];
+    F = sha256_info->digest[5];
+    G = sha256_info->digest[6];
+    H = sha256_info->digest[7];
+
+    for (i = 0; i < 64; ++i) {
+            if (i >= 16) {
+                    T1 = W[(i + 14) & 15];
+                    T2 = W[(i + 1) & 15];
+                    W[i & 15] = T32(W[i & 15] + SSIG1(T1) + W[(i + 9) & 15]
+                                    + SSIG0(T2));
+                }
+            T1 = T32(H + BSIG1(E) + CH(E, F, G) + sha256_k[i] + W[i & 15]);
+            T2 = T32(BSIG0(A) + MAJ(A, B, C));
+            H = G; G = F; F = E; E = T32(D + T1);
+            D = C; C = B; B = A; A = T32(T1 + T2);
+        }
+
+    sha256_info->digest[0] = T32(sha256_info->digest[0] + A);
+    sha256_info->digest[1] = T32(sha256_info->digest[1] + B);
+    sha256_info->digest[2] = T32(sha256_info->digest[2] + C);
+    sha256_info->digest[3] = T32(sha256_info->digest[3] + D);
+    sha256_info->digest[4] = T32(sha256_info->digest[4] + E);
+    sha256_info->digest[5] = T32(sha256_info->digest[5] + F);
+    sha256_info->digest[6] = T32(sha256_info->digest[6] + G);
+    sha256_info->digest[7] = T32(sha256_info->digest[7] + H);
+}
+
+/* Both hashes share padding, length encoding and HMAC construction, they
+   only differ in the compression function and the size of the state */
+
+struct sha_algo {
+    void (*transform)(SHA1_INFO *);
+    const uint32_t *iv;
+    uint8_t words;
+};
+
+static const uint32_t sha1_iv[5] = {
+    0x67452301L, 0xefcdab89L, 0x98badcfeL, 0x10325476L, 0xc3d2e1f0L
+};
+
+static const uint32_t sha256_iv[8] = {
+    0x6a09e667L, 0xbb67ae85L, 0x3c6ef372L, 0xa54ff53aL,
+    0x510e527fL, 0x9b05688cL, 0x1f83d9abL, 0x5be0cd19L
+};
+
+static const struct sha_algo sha1_algo = { sha1_transform, sha1_iv, 5 };
+static const struct sha_algo sha256_algo = { sha256_transform, sha256_iv, 8 };
+
 /* initialize the SHA digest */
 
-void sha1_init(SHA1_INFO *sha1_info)
+static void sha_init(const struct sha_algo *algo, SHA1_INFO *sha_info)
 {
-    sha1_info->digest[0] = 0x67452301L;
-    sha1_info->digest[1] = 0xefcdab89L;
-    sha1_info->digest[2] = 0x98badcfeL;
-    sha1_info->digest[3] = 0x10325476L;
-    sha1_info->digest[4] = 0xc3d2e1f0L;
-    sha1_info->count_lo = 0L;
-    sha1_info->count_hi = 0L;
-    sha1_info->local = 0;
+    memcpy(sha_info->digest, algo->iv, algo->words * sizeof(uint32_t));
+    sha_info->count_lo = 0L;
+    sha_info->count_hi = 0L;
+    sha_info->local = 0;
 }
 
 /* update the SHA digest */
 
-void sha1_update(SHA1_INFO *sha1_info, const uint8_t *buffer, int count)
+static void sha_update(const struct sha_algo *algo, SHA1_INFO *sha_info,
+                       const uint8_t *buffer, int count)
 {
     int i;
     uint32_t clo;
 
-    clo = T32(sha1_info->count_lo + ((uint32_t) count << 3));
-    if (clo < sha1_info->count_lo) {
-            ++sha1_info->count_hi;
+    clo = T32(sha_info->count_lo + ((uint32_t) count << 3));
+    if (clo < sha_info->count_lo) {
+            ++sha_info->count_hi;
         }
-    sha1_info->count_lo = clo;
-    sha1_info->count_hi += (uint32_t) count >> 29;
-    if (sha1_info->local) {
-            i = SHA1_BLOCKSIZE - sha1_info->local;
+    sha_info->count_lo = clo;
+    sha_info->count_hi += (uint32_t) count >> 29;
+    if (sha_info->local) {
+            i = SHA1_BLOCKSIZE - sha_info->local;
             if (i > count) {
                     i = count;
                 }
-            memcpy(((uint8_t *) sha1_info->data) + sha1_info->local, buffer, i);
+            memcpy(((uint8_t *) sha_info->data) + sha_info->local, buffer, i);
             count -= i;
             buffer += i;
-            sha1_info->local += i;
-            if (sha1_info->local == SHA1_BLOCKSIZE) {
-                    sha1_transform(sha1_info);
+            sha_info->local += i;
+            if (sha_info->local == SHA1_BLOCKSIZE) {
+                    algo->transform(sha_info);
                 } else {
                     return;
                 }
         }
     while (count >= SHA1_BLOCKSIZE) {
-            memcpy(sha1_info->data, buffer, SHA1_BLOCKSIZE);
+            memcpy(sha_info->data, buffer, SHA1_BLOCKSIZE);
             buffer += SHA1_BLOCKSIZE;
             count -= SHA1_BLOCKSIZE;
-            sha1_transform(sha1_info);
+            algo->transform(sha_info);
         }
-    memcpy(sha1_info->data, buffer, count);
-    sha1_info->local = count;
-}
-
-
-static void sha1_transform_and_copy(unsigned char digest[20], SHA1_INFO *sha1_info)
-{
-    sha1_transform(sha1_info);
-    digest[ 0] = (unsigned char) ((sha1_info->digest[0] >> 24) & 0xff);
-    digest[ 1] = (unsigned char) ((sha1_info->digest[0] >> 16) & 0xff);
-    digest[ 2] = (unsigned char) ((sha1_info->digest[0] >>  8) & 0xff);
-    digest[ 3] = (unsigned char) ((sha1_info->digest[0]      ) & 0xff);
-    digest[ 4] = (unsigned char) ((sha1_info->digest[1] >> 24) & 0xff);
-    digest[ 5] = (unsigned char) ((sha1_info->digest[1] >> 16) & 0xff);
-    digest[ 6] = (unsigned char) ((sha1_info->digest[1] >>  8) & 0xff);
-    digest[ 7] = (unsigned char) ((sha1_info->digest[1]      ) & 0xff);
-    digest[ 8] = (unsigned char) ((sha1_info->digest[2] >> 24) & 0xff);
-    digest[ 9] = (unsigned char) ((sha1_info->digest[2] >> 16) & 0xff);
-    digest[10] = (unsigned char) ((sha1_info->digest[2] >>  8) & 0xff);
-    digest[11] = (unsigned char) ((sha1_info->digest[2]      ) & 0xff);
-    digest[12] = (unsigned char) ((sha1_info->digest[3] >> 24) & 0xff);
-    digest[13] = (unsigned char) ((sha1_info->digest[3] >> 16) & 0xff);
-    digest[14] = (unsigned char) ((sha1_info->digest[3] >>  8) & 0xff);
-    digest[15] = (unsigned char) ((sha1_info->digest[3]      ) & 0xff);
-    digest[16] = (unsigned char) ((sha1_info->digest[4] >> 24) & 0xff);
-    digest[17] = (unsigned char) ((sha1_info->digest[4] >> 16) & 0xff);
-    digest[18] = (unsigned char) ((sha1_info->digest[4] >>  8) & 0xff);
-    digest[19] = (unsigned char) ((sha1_info->digest[4]      ) & 0xff);
+    memcpy(sha_info->data, buffer, count);
+    sha_info->local = count;
 }
 
 /* finish computing the SHA digest */
-void sha1_final(SHA1_INFO *sha1_info, uint8_t digest[20])
+static void sha_final(const struct sha_algo *algo, SHA1_INFO *sha_info,
+                      uint8_t *digest)
 {
     int count;
+    uint8_t i;
     uint32_t lo_bit_count, hi_bit_count;
 
-    lo_bit_count = sha1_info->count_lo;
-    hi_bit_count = sha1_info->count_hi;
+    lo_bit_count = sha_info->count_lo;
+    hi_bit_count = sha_info->count_hi;
     count = (int) ((lo_bit_count >> 3) & 0x3f);
-    ((uint8_t *) sha1_info->data)[count++] = 0x80;
+    ((uint8_t *) sha_info->data)[count++] = 0x80;
     if (count > SHA1_BLOCKSIZE - 8) {
-            memset(((uint8_t *) sha1_info->data) + count, 0, SHA1_BLOCKSIZE - count);
-            sha1_transform(sha1_info);
-            memset((uint8_t *) sha1_info->data, 0, SHA1_BLOCKSIZE - 8);
+            memset(((uint8_t *) sha_info->data) + count, 0, SHA1_BLOCKSIZE - count);
+            algo->transform(sha_info);
+            memset((uint8_t *) sha_info->data, 0, SHA1_BLOCKSIZE - 8);
         } else {
-            memset(((uint8_t *) sha1_info->data) + count, 0,
+            memset(((uint8_t *) sha_info->data) + count, 0,
                    SHA1_BLOCKSIZE - 8 - count);
         }
-    sha1_info->data[56] = (uint8_t)((hi_bit_count >> 24) & 0xff);
-    sha1_info->data[57] = (uint8_t)((hi_bit_count >> 16) & 0xff);
-    sha1_info->data[58] = (uint8_t)((hi_bit_count >>  8) & 0xff);
-    sha1_info->data[59] = (uint8_t)((hi_bit_count >>  0) & 0xff);
-    sha1_info->data[60] = (uint8_t)((lo_bit_count >> 24) & 0xff);
-    sha1_info->data[61] = (uint8_t)((lo_bit_count >> 16) & 0xff);
-    sha1_info->data[62] = (uint8_t)((lo_bit_count >>  8) & 0xff);
-    sha1_info->data[63] = (uint8_t)((lo_bit_count >>  0) & 0xff);
-    sha1_transform_and_copy(digest, sha1_info);
+    sha_info->data[56] = (uint8_t)((hi_bit_count >> 24) & 0xff);
+    sha_info->data[57] = (uint8_t)((hi_bit_count >> 16) & 0xff);
+    sha_info->data[58] = (uint8_t)((hi_bit_count >>  8) & 0xff);
+    sha_info->data[59] = (uint8_t)((hi_bit_count >>  0) & 0xff);
+    sha_info->data[60] = (uint8_t)((lo_bit_count >> 24) & 0xff);
+    sha_info->data[61] = (uint8_t)((lo_bit_count >> 16) & 0xff);
+    sha_info->data[62] = (uint8_t)((lo_bit_count >>  8) & 0xff);
+    sha_info->data[63] = (uint8_t)((lo_bit_count >>  0) & 0xff);
+    algo->transform(sha_info);
+
+    for (i = 0; i < algo->words; i++) {
+            *digest++ = (uint8_t) ((sha_info->digest[i] >> 24) & 0xff);
+            *digest++ = (uint8_t) ((sha_info->digest[i] >> 16) & 0xff);
+            *digest++ = (uint8_t) ((sha_info->digest[i] >>  8) & 0xff);
+            *digest++ = (uint8_t) ((sha_info->digest[i]      ) & 0xff);
+        }
+}
+
+void sha1_init(SHA1_INFO *sha1_info)
+{
+    sha_init(&sha1_algo, sha1_info);
+}
+
+void sha1_update(SHA1_INFO *sha1_info, const uint8_t *buffer, int count)
+{
+    sha_update(&sha1_algo, sha1_info, buffer, count);
+}
+
+void sha1_final(SHA1_INFO *sha1_info, uint8_t digest[20])
+{
+    sha_final(&sha1_algo, sha1_info, digest);
+}
+
+void sha256_init(SHA256_INFO *sha256_info)
+{
+    sha_init(&sha256_algo, sha256_info);
+}
+
+void sha256_update(SHA256_INFO *sha256_info, const uint8_t *buffer, int count)
+{
+    sha_update(&sha256_algo, sha256_info, buffer, count);
+}
+
+void sha256_final(SHA256_INFO *sha256_info, uint8_t digest[32])
+{
+    sha_final(&sha256_algo, sha256_info, digest);
 }
 
-/*---------------------HMAC_SHA1-------------------------*/ 
+/*---------------------HMAC_SHA1/HMAC_SHA256--------------------*/ 
 
 uint8_t tmp_key[64];
-uint8_t sha[SHA1_DIGEST_LENGTH];
-uint8_t hashed_key[SHA1_DIGEST_LENGTH];
+uint8_t sha[SHA256_DIGEST_LENGTH];
+uint8_t hashed_key[SHA256_DIGEST_LENGTH];
 
-void hmac_sha1(const uint8_t *key, int keyLength,
-               const uint8_t *data, int dataLength,
-               uint8_t *result, int resultLength) {
+/* Absorb the padded key into a fresh context and keep only the chaining
+   value; resuming from it later skips one compression per digest */
+static void hmac_pad(const struct sha_algo *algo, uint32_t *state,
+                     const uint8_t *key, int keyLength, uint8_t pad) {
   SHA1_INFO ctx;
   int i;
+
+  memset(&ctx, 0, sizeof(ctx));
+
+  // The key is padded to the full length of 64 bytes, and then each byte is
+  // XOR'ed with 0x36 for the inner digest or 0x5C for the outer one.
+  for (i = 0; i < keyLength; ++i) {
+    tmp_key[i] = key[i] ^ pad;
+  }
+  if (keyLength < 64) {
+    memset(tmp_key + keyLength, pad, 64 - keyLength);
+  }
+
+  sha_init(algo, &ctx);
+  sha_update(algo, &ctx, tmp_key, 64);
+  memcpy(state, ctx.digest, algo->words * sizeof(uint32_t));
+}
+
+static void hmac_resume(const struct sha_algo *algo, SHA1_INFO *ctx,
+                        const uint32_t *state) {
+  memcpy(ctx->digest, state, algo->words * sizeof(uint32_t));
+  ctx->count_lo = SHA1_BLOCKSIZE * 8;
+  ctx->count_hi = 0L;
+  ctx->local = 0;
+}
+
+static void hmac_init(const struct sha_algo *algo, HMAC_STATE *state,
+                      const uint8_t *key, int keyLength) {
   // Zero out all internal data structures
   memset(hashed_key, 0, sizeof(hashed_key));
-  memset(sha, 0, sizeof(sha));
   memset(tmp_key, 0, sizeof(tmp_key));
 
-  memset(&ctx, 0, sizeof(ctx));
-
 #if defined(__COMPILED_OUT__)
   if (keyLength > 64) {
     // The key can be no bigger than 64 bytes. If it is, we'll hash it down to
-    // 20 bytes.
-    sha1_init(&ctx);
-    sha1_update(&ctx, key, keyLength);
-    sha1_final(&ctx, hashed_key);
+    // the digest length.
+    SHA1_INFO ctx;
+    sha_init(algo, &ctx);
+    sha_update(algo, &ctx, key, keyLength);
+    sha_final(algo, &ctx, hashed_key);
     key = hashed_key;
-    keyLength = SHA1_DIGEST_LENGTH;
+    keyLength = algo->words * sizeof(uint32_t);
   }
 #endif
 
-  // The key for the inner digest is derived from our key, by padding the key
-  // the full length of 64 bytes, and then XOR'ing each byte with 0x36.
-  for (i = 0; i < keyLength; ++i) {
-    tmp_key[i] = key[i] ^ 0x36;
-  }
-  if (keyLength < 64) {
-    memset(tmp_key + keyLength, 0x36, 64 - keyLength);
-  }
+  hmac_pad(algo, state->inner, key, keyLength, 0x36);
+  hmac_pad(algo, state->outer, key, keyLength, 0x5C);
+}
 
-  // Compute inner digest
-  sha1_init(&ctx);
-  sha1_update(&ctx, tmp_key, 64);
-  sha1_update(&ctx, data, dataLength);
-  sha1_final(&ctx, sha);
+static void hmac_final(const struct sha_algo *algo, const HMAC_STATE *state,
+                       const uint8_t *data, int dataLength,
+                       uint8_t *result, int resultLength) {
+  SHA1_INFO ctx;
+  int digestLength = algo->words * sizeof(uint32_t);
 
-  // The key for the outer digest is derived from our key, by padding the key
-  // the full length of 64 bytes, and then XOR'ing each byte with 0x5C.
-  for (i = 0; i < keyLength; ++i) {
-    tmp_key[i] = key[i] ^ 0x5C;
-  }
-  memset(tmp_key + keyLength, 0x5C, 64 - keyLength);
+  memset(sha, 0, sizeof(sha));
+  memset(&ctx, 0, sizeof(ctx));
+
+  // Compute inner digest
+  hmac_resume(algo, &ctx, state->inner);
+  sha_update(algo, &ctx, data, dataLength);
+  sha_final(algo, &ctx, sha);
 
   // Compute outer digest
-  sha1_init(&ctx);
-  sha1_update(&ctx, tmp_key, 64);
-  sha1_update(&ctx, sha, SHA1_DIGEST_LENGTH);
-  sha1_final(&ctx, sha);
+  hmac_resume(algo, &ctx, state->outer);
+  sha_update(algo, &ctx, sha, digestLength);
+  sha_final(algo, &ctx, sha);
 
   // Copy result to output buffer and truncate or pad as necessary
   memset(result, 0, resultLength);
-  if (resultLength > SHA1_DIGEST_LENGTH) {
-    resultLength = SHA1_DIGEST_LENGTH;
+  if (resultLength > digestLength) {
+    resultLength = digestLength;
   }
   memcpy(result, sha, resultLength);
+}
+
+static void hmac(const struct sha_algo *algo,
+                 const uint8_t *key, int keyLength,
+                 const uint8_t *data, int dataLength,
+                 uint8_t *result, int resultLength) {
+  HMAC_STATE state;
+
+  hmac_init(algo, &state, key, keyLength);
+  hmac_final(algo, &state, data, dataLength, result, resultLength);
+}
+
+void hmac_sha1(const uint8_t *key, int keyLength,
+               const uint8_t *data, int dataLength,
+               uint8_t *result, int resultLength) {
+  hmac(&sha1_algo, key, keyLength, data, dataLength, result, resultLength);
+}
+
+void hmac_sha256(const uint8_t *key, int keyLength,
+                 const uint8_t *data, int dataLength,
+                 uint8_t *result, int resultLength) {
+  hmac(&sha256_algo, key, keyLength, data, dataLength, result, resultLength);
+}
+
+void hmac_sha1_init(HMAC_STATE *state, const uint8_t *key, int keyLength) {
+  hmac_init(&sha1_algo, state, key, keyLength);
+}
+
+void hmac_sha1_final(const HMAC_STATE *state,
+                     const uint8_t *data, int dataLength,
+                     uint8_t *result, int resultLength) {
+  hmac_final(&sha1_algo, state, data, dataLength, result, resultLength);
+}
+
+void hmac_sha256_init(HMAC_STATE *state, const uint8_t *key, int keyLength) {
+  hmac_init(&sha256_algo, state, key, keyLength);
+}
 
+void hmac_sha256_final(const HMAC_STATE *state,
+                       const uint8_t *data, int dataLength,
+                       uint8_t *result, int resultLength) {
+  hmac_final(&sha256_algo, state, data, dataLength, result, resultLength);
 }
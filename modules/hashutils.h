@@ -1,4 +1,4 @@
-// SHA1/HMAC header file
+// SHA1/SHA256/HMAC header file
 //
 // Copyright 2010 Google Inc.
 // Author: Markus Gutschke
@@ -21,6 +21,9 @@
 #define SHA1_BLOCKSIZE     64
 #define SHA1_DIGEST_LENGTH 20
 
+#define SHA256_BLOCKSIZE     64
+#define SHA256_DIGEST_LENGTH 32
+
 typedef struct {
     uint32_t digest[8];
     uint32_t count_lo, count_hi;
@@ -28,12 +31,42 @@ typedef struct {
     int      local;
 } SHA1_INFO;
 
+// SHA-256 uses the same state, with all eight digest words in use
+typedef SHA1_INFO SHA256_INFO;
+
+// Chaining values after the inner and outer padded key blocks, so a key
+// can be kept ready for HMAC without storing the key itself
+typedef struct {
+    uint32_t inner[8];
+    uint32_t outer[8];
+} HMAC_STATE;
+
 void sha1_init(SHA1_INFO *sha1_info) __attribute__((visibility("hidden")));
 void sha1_update(SHA1_INFO *sha1_info, const uint8_t *buffer, int count)
 __attribute__((visibility("hidden")));
 void sha1_final(SHA1_INFO *sha1_info, uint8_t digest[20])
 __attribute__((visibility("hidden")));
 
+void sha256_init(SHA256_INFO *sha256_info) __attribute__((visibility("hidden")));
+void sha256_update(SHA256_INFO *sha256_info, const uint8_t *buffer, int count)
+__attribute__((visibility("hidden")));
+void sha256_final(SHA256_INFO *sha256_info, uint8_t digest[32])
+__attribute__((visibility("hidden")));
+
 void hmac_sha1(const uint8_t *key, int keyLength,
                const uint8_t *data, int dataLength,
                uint8_t *result, int resultLength) __attribute__((visibility("hidden")));;
+void hmac_sha256(const uint8_t *key, int keyLength,
+                 const uint8_t *data, int dataLength,
+                 uint8_t *result, int resultLength) __attribute__((visibility("hidden")));
+
+void hmac_sha1_init(HMAC_STATE *state, const uint8_t *key, int keyLength)
+__attribute__((visibility("hidden")));
+void hmac_sha1_final(const HMAC_STATE *state,
+                     const uint8_t *data, int dataLength,
+                     uint8_t *result, int resultLength) __attribute__((visibility("hidden")));
+void hmac_sha256_init(HMAC_STATE *state, const uint8_t *key, int keyLength)
+__attribute__((visibility("hidden")));
+void hmac_sha256_final(const HMAC_STATE *state,
+                       const uint8_t *data, int dataLength,
+                       uint8_t *result, int resultLength) __attribute__((visibility("hidden")));
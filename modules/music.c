@@ -28,13 +28,12 @@
 #include "drivers/display.h"
 #include "drivers/buzzer.h"
 
-/* tunes generated using contrib/rtttl2bin.py */
-/* super mario bros tune */
-static note smb[] = {0x25a8, 0x25a8, 0x12d0, 0x4b28, 0x25a4, 0x4b28, 0x4b2b, 0x4b10, 0x4b1b, 0x4b10, 0x4b24, 0x2590, 0x4b1b, 0x2590, 0x4b18, 0x2590, 0x4b11, 0x4b13, 0x2592, 0x4b11, 0x191b, 0x25a8, 0x25ab, 0x4b21, 0x25a9, 0x4b2b, 0x4b28, 0x25a4, 0x25a6, 0x4b13, 0x2590, 0x4b24, 0x2590, 0x4b1b, 0x2590, 0x4b18, 0x2590, 0x4b11, 0x4b13, 0x2592, 0x4b11, 0x191b, 0x25a8, 0x25ab, 0x4b21, 0x25a9, 0x4b2b, 0x4b28, 0x25a4, 0x25a6, 0x4b13, 0x4b10, 0x25ab, 0x25aa, 0x25a9, 0x25a7, 0x2590, 0x25a8, 0x2590, 0x259c, 0x2591, 0x25a4, 0x2590, 0x2591, 0x25a4, 0x25a6, 0x4b10, 0x25ab, 0x25aa, 0x25a9, 0x25a7, 0x2590, 0x25a8, 0x2590, 0x25b4, 0x2590, 0x25b4, 0x25b4, 0x9610, 0x25ab, 0x25aa, 0x25a9, 0x25a7, 0x2590, 0x25a8, 0x2590, 0x259c, 0x2591, 0x25a4, 0x2590, 0x2591, 0x25a4, 0x25a6, 0x4b10, 0x25a7, 0x4b10, 0x25a6, 0x4b10, 0x25a4, 0x000F};
+/* tunes compiled from modules/tunes at build time */
+#include "modules/tunes.h"
 
 static void num_press()
 {
-    buzzer_play(smb);
+    buzzer_play_melody(&tune_smb, BUZZER_PRIO_MUSIC);
 }
 
 
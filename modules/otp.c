@@ -40,6 +40,10 @@
 /* hmac routines*/
 #include "hashutils.h"
 
+#if defined(CONFIG_MOD_OTP_INFOMEM)
+#include "drivers/infomem.h"
+#endif
+
 /* 7-segment character bit assignments */
 /* Replicated from drivers/display.c (shouldn't this be in display.h ?) */
 #define SEG_A     (BIT4)
@@ -50,47 +54,49 @@
 #define SEG_F     (BIT0)
 #define SEG_G     (BIT1)
 
-static int days[12] ={0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334};
-
 #if defined(CONFIG_MOD_OTP_SOUND_CUE)
 int8_t otp_sound_cue = 0;
 int8_t otp_first_code = 1;
 #endif
 
-uint32_t simple_mktime(int year, int month, int day, int hour, int minute, int second)
-{
-    //only works for year 2000 - 2032
-    uint32_t    result;
-
-    year += month / 12;
-    month %= 12;
-    result = (year - 1970) * 365 + days[month];
-    if (month <= 1) year--;
-
-    result += (year - 1968) / 4;
-    result += day - 1;
-    result  = ((result * 24 + hour) * 60 + minute) * 60 + second;
-
-#if defined(CONFIG_RTC_DST)
-        if (rtc_dst_state == RTC_DST_STATE_DST) {
-            result = result - 3600;
-        }    
-#endif
-
-    return result;
-}
-
+/* Factory keys, used unless infomem holds a keystore */
 const  keystore_t otp_keys[]          = CONFIG_MOD_OTP_KEYS;
 #define NUM_ELEMS(x) (sizeof(x)/sizeof(x[0]))
 #define NUM_KEYS NUM_ELEMS(otp_keys)
 
+#if defined(CONFIG_MOD_OTP_INFOMEM)
+#define OTP_MAX_KEYS (NUM_KEYS > 16 ? NUM_KEYS : 16)
+#else
+#define OTP_MAX_KEYS NUM_KEYS
+#endif
+
+/* Keys as used at runtime. The secret itself is not kept, only the HMAC
+   state after the padded key blocks, which also saves two of the four
+   hash compressions per code */
+struct otp_key {
+    char identifier;
+    uint8_t algorithm;
+    uint8_t digits;
+    uint16_t period;
+    uint32_t t0;
+    HMAC_STATE hmac;
+};
+
+static struct otp_key otp_table[OTP_MAX_KEYS];
 
 static uint8_t current_key_index = 0;
-static uint8_t max_key_index = NUM_KEYS;
+static uint8_t max_key_index = 0;
+
+/* Code of the upcoming window for each key, computed during the idle
+   seconds of the current window so the rollover is a pure display update */
+static struct {
+    uint32_t time;
+    uint32_t value;
+} otp_next[OTP_MAX_KEYS];
 
 static uint32_t  last_time    = 0;
 static uint8_t   otp_data[]   = {0,0,0,0,0,0,0,0};
-static uint8_t   otp_result[SHA1_DIGEST_LENGTH];
+static uint8_t   otp_result[SHA256_DIGEST_LENGTH];
 static uint8_t   indicator[]  = {
     SEG_A+SEG_F+SEG_E+SEG_D+SEG_C+SEG_B, SEG_B,
     SEG_A+SEG_F+SEG_E+SEG_D+SEG_C,       SEG_C,
@@ -100,21 +106,203 @@ static uint8_t   indicator[]  = {
     SEG_A,                               SEG_A
 };
 
-static void otp_get_current_params(char *potp_identifier, 
-        const uint8_t **potp_key, uint8_t *potp_key_len)
+static const uint32_t otp_modulus[] = {
+    1000000, 100000000
+};
+
+static void otp_set_key(struct otp_key *k, char identifier,
+        const uint8_t *key, uint8_t key_len, uint8_t algorithm,
+        uint8_t digits, uint16_t period, uint32_t t0)
 {
-    const keystore_t *current_key = &otp_keys[current_key_index];
-    /*only a single char is supported right now*/
-    *potp_identifier = current_key->otp_identifier[0];
-    *potp_key = (const uint8_t *)current_key->otp_key;
-    *potp_key_len = current_key->otp_key_len;
+    k->identifier = identifier;
+    k->algorithm = algorithm;
+    k->digits = digits == 8 ? 8 : 6;
+    k->period = period ? period : 30;
+    k->t0 = t0;
+
+    if (algorithm == OTP_ALG_SHA256)
+        hmac_sha256_init(&k->hmac, key, key_len);
+    else
+        hmac_sha1_init(&k->hmac, key, key_len);
+}
+
+#if defined(CONFIG_MOD_OTP_INFOMEM)
+/* A keystore in infomem is a sequence of records: a word with the
+   identifier in the low byte and the key length in the high one, the
+   settings if OTP_RECORD_SETTINGS is set in the length, and the key
+   bytes padded to a full word. Keys of the RFC 6238 defaults take no
+   settings, 16 keys of 10 bytes fit into the 125 words of infomem. */
+struct otp_settings {
+    uint8_t algorithm;
+    uint8_t digits;
+    uint16_t period;
+    uint16_t t0[2];
+};
+
+#define OTP_RECORD_SETTINGS 0x80
+#define OTP_SETTINGS_WORDS ((uint8_t)(sizeof(struct otp_settings) / 2))
+#define OTP_KEY_WORDS    32
+
+static uint8_t otp_load_infomem(void)
+{
+    struct otp_settings set;
+    uint16_t key[OTP_KEY_WORDS];
+    uint16_t head = 0;
+    int16_t amount = infomem_app_amount(OTP_INFOMEM_ID);
+    uint8_t offset = 0;
+    uint8_t key_len;
+    uint8_t words;
+    uint8_t n = 0;
+
+    while (n < OTP_MAX_KEYS && offset < amount) {
+        infomem_app_read(OTP_INFOMEM_ID, &head, 1, offset++);
+        key_len = head >> 8;
+
+        memset(&set, 0, sizeof(set));
+        if (key_len & OTP_RECORD_SETTINGS) {
+            key_len &= ~OTP_RECORD_SETTINGS;
+            if (offset + OTP_SETTINGS_WORDS > amount)
+                break;
+            infomem_app_read(OTP_INFOMEM_ID, (uint16_t *)&set,
+                    OTP_SETTINGS_WORDS, offset);
+            offset += OTP_SETTINGS_WORDS;
+        }
+
+        words = (key_len + 1) / 2;
+        if (words > OTP_KEY_WORDS || offset + words > amount)
+            break;
+        infomem_app_read(OTP_INFOMEM_ID, key, words, offset);
+        offset += words;
+
+        otp_set_key(&otp_table[n++], head & 0xff, (const uint8_t *)key,
+                key_len, set.algorithm, set.digits, set.period,
+                ((uint32_t)set.t0[1] << 16) | set.t0[0]);
+    }
+    return n;
 }
 
+/* Settings other than SHA-1, 6 digits every 30 s from the epoch */
+static uint8_t otp_has_settings(const keystore_t *key)
+{
+    return key->otp_algorithm == OTP_ALG_SHA256 || key->otp_digits == 8
+        || (key->otp_period && key->otp_period != 30) || key->otp_t0;
+}
+#endif
+
+static void otp_load_keys(void)
+{
+    uint8_t i;
+
+    current_key_index = 0;
+    memset(otp_next, 0, sizeof(otp_next));
+
+#if defined(CONFIG_MOD_OTP_INFOMEM)
+    max_key_index = otp_load_infomem();
+    if (max_key_index > 0)
+        return;
+#endif
+
+    for (i = 0; i < NUM_KEYS; i++) {
+        const keystore_t *key = &otp_keys[i];
+        /*only a single char is supported right now*/
+        otp_set_key(&otp_table[i], key->otp_identifier[0],
+                (const uint8_t *)key->otp_key, key->otp_key_len,
+                key->otp_algorithm, key->otp_digits, key->otp_period,
+                key->otp_t0);
+    }
+    max_key_index = NUM_KEYS;
+}
 
-static uint32_t calculate_otp(uint32_t time, const uint8_t *otp_key, 
-        uint8_t otp_key_len)
+#if defined(CONFIG_MOD_OTP_INFOMEM)
+int16_t otp_keystore_write(const keystore_t *keys, uint8_t count)
+{
+    uint16_t buf[1 + OTP_SETTINGS_WORDS + OTP_KEY_WORDS];
+    struct otp_settings *set = (struct otp_settings *)&buf[1];
+    uint16_t total = 0;
+    uint8_t offset = 0;
+    uint8_t words;
+    int16_t ret, amount;
+    uint8_t i;
+
+    if (count == 0) {
+        ret = infomem_app_clear(OTP_INFOMEM_ID);
+        if (ret < 0)
+            return ret;
+        /* back to the built-in keys */
+        otp_load_keys();
+        return max_key_index;
+    }
+
+    /* refuse before the old keystore is touched, a write that fails
+       half way would leave only some of the keys behind */
+    for (i = 0; i < count; i++) {
+        if (keys[i].otp_key_len > 2 * OTP_KEY_WORDS)
+            return -5;
+        total += 1 + (keys[i].otp_key_len + 1) / 2;
+        if (otp_has_settings(&keys[i]))
+            total += OTP_SETTINGS_WORDS;
+    }
+
+    ret = infomem_space();
+    if (ret < 0)
+        return ret;
+    amount = infomem_app_amount(OTP_INFOMEM_ID);
+    /* a new application also needs its header word */
+    if (total > ret + (amount > 0 ? amount : -1))
+        return -4;
+
+    for (i = 0; i < count; i++) {
+        const keystore_t *key = &keys[i];
+
+        words = 1;
+        buf[0] = (uint8_t)key->otp_identifier[0]
+            | ((uint16_t)key->otp_key_len << 8);
+        if (otp_has_settings(key)) {
+            buf[0] |= (uint16_t)OTP_RECORD_SETTINGS << 8;
+            set->algorithm = key->otp_algorithm;
+            set->digits = key->otp_digits;
+            set->period = key->otp_period;
+            set->t0[0] = key->otp_t0 & 0xffff;
+            set->t0[1] = key->otp_t0 >> 16;
+            words += OTP_SETTINGS_WORDS;
+        }
+
+        if (key->otp_key_len & 1)
+            buf[words + key->otp_key_len / 2] = 0;
+        memcpy(&buf[words], key->otp_key, key->otp_key_len);
+        words += (key->otp_key_len + 1) / 2;
+
+        /* the first record replaces the old keystore, the others append */
+        if (i == 0)
+            ret = infomem_app_replace(OTP_INFOMEM_ID, buf, words);
+        else
+            ret = infomem_app_modify(OTP_INFOMEM_ID, buf, words, offset);
+        if (ret < 0)
+            return ret;
+        offset += words;
+    }
+
+    otp_load_keys();
+    return max_key_index;
+}
+#endif
+
+/* Seconds since the unix epoch in UTC */
+static uint32_t otp_now(void)
+{
+    uint32_t now = rtca_epoch();
+#if defined(CONFIG_RTC_DST)
+    if (rtc_dst_state == RTC_DST_STATE_DST) {
+        now -= 3600;
+    }
+#endif
+    return now - CONFIG_MOD_OTP_OFFSET * 3600;
+}
+
+static uint32_t calculate_otp(uint32_t time, const struct otp_key *key)
 {
     uint32_t val = 0;
+    uint8_t len;
     int i;
 
     memset(otp_data, 0, sizeof(otp_data));
@@ -126,60 +314,106 @@ static uint32_t calculate_otp(uint32_t time, const uint8_t *otp_key,
     otp_data[7] = (time      ) & 0xff;
     
 
-    hmac_sha1(otp_key, otp_key_len, otp_data, sizeof(otp_data),
-        otp_result, sizeof(otp_result));
+    if (key->algorithm == OTP_ALG_SHA256) {
+        len = SHA256_DIGEST_LENGTH;
+        hmac_sha256_final(&key->hmac,
+            otp_data, sizeof(otp_data), otp_result, len);
+    } else {
+        len = SHA1_DIGEST_LENGTH;
+        hmac_sha1_final(&key->hmac,
+            otp_data, sizeof(otp_data), otp_result, len);
+    }
 
-    int off = otp_result[SHA1_DIGEST_LENGTH - 1] & 0x0f;
+    int off = otp_result[len - 1] & 0x0f;
 
     char *cc = (char *)&val;
     for (i =0; i < 4; i++) {
         cc[3-i] = otp_result[off+i];
     }
     val &= 0x7fffffff;
-    val %= 1000000;
+    val %= otp_modulus[key->digits > 6];
 
     return val;
 }
 
+/* Fill at most one stale entry of otp_next per call, current key first */
+static void otp_precompute(uint32_t now)
+{
+    uint8_t i = current_key_index;
+
+    do {
+        const struct otp_key *key = &otp_table[i];
+        uint32_t time = (now - key->t0) / key->period + 1;
+
+        if (otp_next[i].time != time) {
+            otp_next[i].value = calculate_otp(time, key);
+            otp_next[i].time = time;
+            return;
+        }
+        if (++i == max_key_index)
+            i = 0;
+    } while (i != current_key_index);
+}
+
 static void clock_event(enum sys_message msg)
 {
-    // Check how long the current code is valid
-    uint8_t segment = (rtca_time.sec / 5) % 6;
+    const struct otp_key *key = &otp_table[current_key_index];
+    uint8_t digits = key->digits;
+    uint16_t period = key->period;
 
-    char otp_identifier;
-    const uint8_t *otp_key;
-    uint8_t otp_key_len;
+    // Calculate timestamp
+    uint32_t now = otp_now();
+    uint32_t time = (now - key->t0) / period;
+
+    // Check how long the current code is valid
+    uint16_t elapsed = now - key->t0 - time * period;
+    uint8_t segment = (uint32_t)elapsed * 6 / period;
 
-    otp_get_current_params(&otp_identifier, &otp_key, &otp_key_len);
     // Draw indicator in lower-left corner
     display_bits(0, LCD_SEG_L2_4, indicator[2*segment  ], SEG_SET);
     display_bits(0, LCD_SEG_L2_4, indicator[2*segment+1], BLINK_SET);
-    display_char(0 ,LCD_SEG_L1_3, otp_identifier, SEG_SET); 
-
-    // Calculate timestamp
-    uint32_t time = simple_mktime(rtca_time.year, rtca_time.mon - 1, rtca_time.day,
-                                  rtca_time.hour, rtca_time.min    , rtca_time.sec);
-    time = (time - CONFIG_MOD_OTP_OFFSET * 3600) / 30;
+    // Codes longer than 6 digits take over the identifier position
+    if (digits <= 6)
+        display_char(0 ,LCD_SEG_L1_3, key->identifier, SEG_SET);
 
     // Check if new code must be calculated
     if(time != last_time) {
 
         last_time = time;
-        uint32_t otp_value = calculate_otp(time,otp_key, otp_key_len);
-
-        // Draw first half on the top line
-        uint16_t v = (otp_value / 1000) % 1000;
-        _printf(0, LCD_SEG_L1_2_0, "%03u", v);
-
-        // Draw second half on the bottom line
-        v = (otp_value % 1000);
-        _printf(0, LCD_SEG_L2_2_0,"%03u", v);
+        uint32_t otp_value;
+
+        // Use the code precomputed during the previous window if we have it
+        if (otp_next[current_key_index].time == time)
+            otp_value = otp_next[current_key_index].value;
+        else
+            otp_value = calculate_otp(time, key);
+
+        if (digits > 6) {
+            // Leading digits on the top line, last four on the bottom line
+            _printf(0, LCD_SEG_L1_3_0, "%04u", (uint16_t)(otp_value / 10000));
+            _printf(0, LCD_SEG_L2_3_0, "%04u", (uint16_t)(otp_value % 10000));
+        } else {
+            // Draw first half on the top line
+            uint16_t v = (otp_value / 1000) % 1000;
+            _printf(0, LCD_SEG_L1_2_0, "%03u", v);
+
+            // Draw second half on the bottom line
+            v = (otp_value % 1000);
+            _printf(0, LCD_SEG_L2_2_0,"%03u", v);
+
+            display_char(0, LCD_SEG_L2_3, ' ', SEG_SET);
+#if defined(CONFIG_MOD_OTP_SOUND_CUE)
+            display_bits(0, LCD_SEG_L2_3, SEG_G, otp_sound_cue ? SEG_ON : SEG_OFF);
+#endif
+        }
 #if defined(CONFIG_MOD_OTP_SOUND_CUE)
-        extern note welcome[4];
         if (!otp_first_code && otp_sound_cue)
-            buzzer_play(welcome);
+            buzzer_play(welcome, BUZZER_PRIO_FEEDBACK);
         otp_first_code = 0;
 #endif
+    } else {
+        // Idle second, get the next window's code ready
+        otp_precompute(now);
     }
 }
 
@@ -231,6 +465,20 @@ static void otp_gen_prev()
     otp_request_update(false);
 }
 
+#if defined(CONFIG_MOD_OTP_INFOMEM)
+/* Keep the built-in keys in infomem, so a firmware built without them
+   still has them. Beeps when they are stored. */
+static void otp_store_keys()
+{
+    if (otp_keystore_write(otp_keys, NUM_KEYS) > 0) {
+        buzzer_play(welcome, BUZZER_PRIO_FEEDBACK);
+        otp_request_update(false);
+    } else {
+        display_chars(0, LCD_SEG_L1_3_0, "FAIL", SEG_SET);
+    }
+}
+#endif
+
 #if defined(CONFIG_MOD_OTP_SOUND_CUE)
 static void otp_toggle_beep()
 {
@@ -241,6 +489,8 @@ static void otp_toggle_beep()
 
 void mod_otp_init()
 {
+    otp_load_keys();
+
     menu_add_entry("OTP",
                    &otp_gen_next,      /* up         */
                    &otp_gen_prev,      /* down       */
@@ -250,7 +500,11 @@ void mod_otp_init()
                    NULL,               /* num        */
 #endif
                    NULL,               /* long star  */
+#if defined(CONFIG_MOD_OTP_INFOMEM)
+                   &otp_store_keys,    /* long num   */
+#else
                    NULL,               /* long num   */
+#endif
                    NULL,               /* up-down    */
                    &otp_activated,     /* activate   */
                    &otp_deactivated);  /* deactivate */
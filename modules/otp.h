@@ -18,10 +18,29 @@
 #ifndef  __OTP_H__
 #define  __OTP_H__
 #include <stdint.h>
+
+#define OTP_ALG_SHA1   0
+#define OTP_ALG_SHA256 1
+
+/* Trailing fields left out of an initializer are zero, which selects the
+   RFC 6238 defaults: HMAC-SHA1, 6 digits, 30 second steps from the epoch */
 typedef struct keystore
 {
     const  char *otp_identifier;
     const  char *otp_key;
     const uint8_t otp_key_len;
+    const uint8_t otp_algorithm;  /* OTP_ALG_SHA1 or OTP_ALG_SHA256 */
+    const uint8_t otp_digits;     /* 6 or 8, 0 means 6 */
+    const uint16_t otp_period;    /* seconds per step, 0 means 30 */
+    const uint32_t otp_t0;        /* unix time of the first step */
 }keystore_t;
+
+/* infomem application identifier of the keystore */
+#define OTP_INFOMEM_ID 0x4f
+
+/* Replace the keystore in infomem (with CONFIG_MOD_OTP_INFOMEM) by count keys and reload them,
+   no keys brings back the built-in ones. Returns the number of keys loaded, -5 if a key is
+   longer than 64 bytes, -4 if the keys do not fit (the old ones are kept in both cases)
+   or one of the infomem_* error codes */
+int16_t otp_keystore_write(const keystore_t *keys, uint8_t count);
 #endif
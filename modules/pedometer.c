@@ -0,0 +1,172 @@
+/**
+    pedometer.c: daily step counter
+
+    http://github.com/BenjaminSoelberg/openchronos-ng-elf
+
+    This file is part of openchronos-ng.
+
+    openchronos-ng is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    openchronos-ng is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#include "messagebus.h"
+#include "menu.h"
+
+/* drivers */
+#include "drivers/display.h"
+#include "drivers/vti_as.h"
+#include "drivers/stepcount.h"
+
+/* Sensor output data rate while counting, must match as_config.sampling */
+#define PEDOMETER_RATE      (100u)
+
+extern uint8_t as_ok;
+
+static struct stepcount pedometer;
+static struct As_Param pedometer_as;
+static uint8_t pedometer_running;
+static uint8_t pedometer_active;
+
+static void display_steps(void)
+{
+    uint32_t steps = pedometer.steps;
+    uint16_t hi, lo;
+
+    if (steps > 99999)
+        steps = 99999;
+
+    /* _printf() takes 16 bit values, split the total in two */
+    hi = steps / 1000;
+    lo = steps % 1000;
+
+    if (hi) {
+        _printf(0, LCD_SEG_L2_4_3, "%2u", hi);
+        _printf(0, LCD_SEG_L2_2_0, "%03u", lo);
+    } else {
+        display_chars(0, LCD_SEG_L2_4_3, "  ", SEG_SET);
+        _printf(0, LCD_SEG_L2_2_0, "%3u", lo);
+    }
+}
+
+static void display_state(void)
+{
+    display_chars(0, LCD_SEG_L1_3_0, pedometer_running ? "STEP" : " OFF",
+                  SEG_SET);
+}
+
+static void pedometer_event(enum sys_message msg)
+{
+    uint8_t xyz[3];
+    uint8_t counted = 0;
+
+    /* the ring is another module's while it has the sensor */
+    if ((msg & SYS_MSG_AS_INT) && as_owner() == AS_CLIENT_PEDOMETER) {
+        while (as_stream_read(xyz))
+            counted += stepcount_feed(&pedometer, xyz);
+    }
+
+    /* the total is a daily one */
+    if (msg & SYS_MSG_RTC_DAY) {
+        pedometer.steps = 0;
+        counted = 1;
+    }
+
+    if (counted && pedometer_active)
+        display_steps();
+}
+
+static void pedometer_start(void)
+{
+    if (!as_ok)
+        return;
+
+    stepcount_init(&pedometer, PEDOMETER_RATE);
+
+    /* counting waits while a higher priority module has the sensor */
+    pedometer_as.range = 2;
+    pedometer_as.sampling = SAMPLING_100_HZ;
+    pedometer_as.mode = MEASUREMENT_MODE;
+    as_claim(AS_CLIENT_PEDOMETER, &pedometer_as, AS_RING_SIZE / 2);
+
+    sys_messagebus_register(&pedometer_event,
+                            SYS_MSG_AS_INT | SYS_MSG_RTC_DAY);
+
+    display_symbol(0, LCD_ICON_RECORD, SEG_ON);
+    pedometer_running = 1;
+}
+
+static void pedometer_stop(void)
+{
+    sys_messagebus_unregister_all(&pedometer_event);
+
+    as_release(AS_CLIENT_PEDOMETER);
+
+    display_symbol(0, LCD_ICON_RECORD, SEG_OFF);
+    pedometer_running = 0;
+}
+
+static void pedometer_up_pressed(void)
+{
+    uint32_t steps = pedometer.steps;
+
+    if (pedometer_running) {
+        pedometer_stop();
+    } else {
+        pedometer_start();
+        /* keep the count of the day across a pause */
+        pedometer.steps = steps;
+    }
+
+    display_state();
+}
+
+static void pedometer_num_long_pressed(void)
+{
+    pedometer.steps = 0;
+    display_steps();
+}
+
+static void pedometer_activate(void)
+{
+    pedometer_active = 1;
+
+    if (!as_ok) {
+        display_chars(0, LCD_SEG_L1_3_0, " ERR", SEG_SET);
+        return;
+    }
+
+    display_state();
+    display_steps();
+}
+
+static void pedometer_deactivate(void)
+{
+    pedometer_active = 0;
+
+    /* counting goes on in the background, only the screen is cleaned */
+    display_clear(0, 1);
+    display_clear(0, 2);
+}
+
+void mod_pedometer_init(void)
+{
+    menu_add_entry("STEP",
+                   &pedometer_up_pressed,
+                   NULL,
+                   NULL,
+                   NULL,
+                   &pedometer_num_long_pressed,
+                   NULL,
+                   &pedometer_activate,
+                   &pedometer_deactivate);
+}
@@ -0,0 +1,217 @@
+/**
+    sleep.c: sleep tracker on accelerometer motion interrupts
+
+    http://github.com/BenjaminSoelberg/openchronos-ng-elf
+
+    This file is part of openchronos-ng.
+
+    openchronos-ng is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    openchronos-ng is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#include "messagebus.h"
+#include "menu.h"
+
+/* drivers */
+#include "drivers/display.h"
+#include "drivers/rtca.h"
+#include "drivers/vti_as.h"
+#include "drivers/sleeplog.h"
+
+#ifdef CONFIG_INFOMEM
+#include "drivers/infomem.h"
+#endif
+
+/* Motion detection at 10 Hz, threshold and time as in the accelerometer
+   module's activity mode */
+#define SLEEP_MDTHR         2
+#define SLEEP_MDFFTMR       1
+
+/* The last night in infomem: a header followed by the log table */
+#define SLEEP_INFOMEM_ID    0x53
+#define SLEEP_SAVE_MINUTES  60
+
+struct sleep_header {
+    uint8_t day;
+    uint8_t mon;
+    uint8_t hour;
+    uint8_t min;
+    uint16_t minutes;
+    uint16_t wakeups;
+};
+
+#define SLEEP_HEADER_WORDS  ((uint8_t)(sizeof(struct sleep_header) / 2))
+#define SLEEP_HIST_WORDS    ((uint8_t)(SLEEPLOG_MINUTES / 8))
+
+extern uint8_t as_ok;
+
+static struct sleeplog sleep_log;
+static struct sleep_header sleep_night;
+static struct As_Param sleep_as;
+static uint8_t sleep_running;
+static uint8_t sleep_active;
+static uint8_t sleep_view;
+
+#ifdef CONFIG_INFOMEM
+static void sleep_save(void)
+{
+    sleep_night.minutes = sleep_log.minutes;
+    sleep_night.wakeups = sleep_log.wakeups;
+
+    if (infomem_app_replace(SLEEP_INFOMEM_ID, (uint16_t *)&sleep_night,
+                            SLEEP_HEADER_WORDS) < 0)
+        return;
+
+    infomem_app_modify(SLEEP_INFOMEM_ID, (uint16_t *)sleep_log.hist,
+                       SLEEP_HIST_WORDS, SLEEP_HEADER_WORDS);
+}
+
+static void sleep_load(void)
+{
+    if (infomem_app_amount(SLEEP_INFOMEM_ID)
+        < SLEEP_HEADER_WORDS + SLEEP_HIST_WORDS)
+        return;
+
+    infomem_app_read(SLEEP_INFOMEM_ID, (uint16_t *)&sleep_night,
+                     SLEEP_HEADER_WORDS, 0);
+    infomem_app_read(SLEEP_INFOMEM_ID, (uint16_t *)sleep_log.hist,
+                     SLEEP_HIST_WORDS, SLEEP_HEADER_WORDS);
+    sleep_log.minutes = sleep_night.minutes;
+    sleep_log.wakeups = sleep_night.wakeups;
+}
+#else
+#define sleep_save()
+#define sleep_load()
+#endif
+
+static void display_sleep(void)
+{
+    display_chars(0, LCD_SEG_L1_3_0, sleep_running ? "SLEP" : " OFF",
+                  SEG_SET);
+
+    if (sleep_view) {
+        display_symbol(0, LCD_SEG_L2_COL0, SEG_OFF);
+        display_chars(0, LCD_SEG_L2_4_2, "UP ", SEG_SET);
+        _printf(0, LCD_SEG_L2_1_0, "%2u", sleep_log.wakeups);
+    } else {
+        /* night length as h:mm */
+        display_char(0, LCD_SEG_L2_4, ' ', SEG_SET);
+        _printf(0, LCD_SEG_L2_3_2, "%2u", sleep_log.minutes / 60);
+        _printf(0, LCD_SEG_L2_1_0, "%02u", sleep_log.minutes % 60);
+        display_symbol(0, LCD_SEG_L2_COL0, SEG_ON);
+    }
+}
+
+static void sleep_event(enum sys_message msg)
+{
+    /* a still minute while the accelerometer screen has the sensor */
+    sleeplog_minute(&sleep_log,
+                    as_owner() == AS_CLIENT_SLEEP ? as_motion_take() : 0);
+
+    if (sleep_log.minutes % SLEEP_SAVE_MINUTES == 0)
+        sleep_save();
+
+    if (sleep_active)
+        display_sleep();
+}
+
+static void sleep_start(void)
+{
+    if (!as_ok)
+        return;
+
+    sleeplog_init(&sleep_log);
+    sleep_night.day = rtca_time.day;
+    sleep_night.mon = rtca_time.mon;
+    sleep_night.hour = rtca_time.hour;
+    sleep_night.min = rtca_time.min;
+
+    sleep_as.range = 2;
+    sleep_as.sampling = SAMPLING_10_HZ;
+    sleep_as.mode = ACTIVITY_MODE;
+    sleep_as.MDTHR = SLEEP_MDTHR;
+    sleep_as.MDFFTMR = SLEEP_MDFFTMR;
+
+    /* From here on the CPU only wakes up once a minute, the pedometer
+       pauses until tracking stops */
+    as_claim(AS_CLIENT_SLEEP, &sleep_as, AS_READ_MOTION);
+
+    sys_messagebus_register(&sleep_event, SYS_MSG_RTC_MINUTE);
+
+    display_symbol(0, LCD_ICON_RECORD, SEG_ON);
+    sleep_running = 1;
+}
+
+static void sleep_stop(void)
+{
+    sys_messagebus_unregister_all(&sleep_event);
+
+    as_release(AS_CLIENT_SLEEP);
+    sleep_save();
+
+    display_symbol(0, LCD_ICON_RECORD, SEG_OFF);
+    sleep_running = 0;
+}
+
+static void sleep_up_pressed(void)
+{
+    if (sleep_running)
+        sleep_stop();
+    else
+        sleep_start();
+
+    display_sleep();
+}
+
+static void sleep_down_pressed(void)
+{
+    sleep_view ^= 1;
+    display_sleep();
+}
+
+static void sleep_activate(void)
+{
+    sleep_active = 1;
+
+    if (!as_ok) {
+        display_chars(0, LCD_SEG_L1_3_0, " ERR", SEG_SET);
+        return;
+    }
+
+    display_sleep();
+}
+
+static void sleep_deactivate(void)
+{
+    sleep_active = 0;
+
+    /* tracking goes on in the background, only the screen is cleaned */
+    display_symbol(0, LCD_SEG_L2_COL0, SEG_OFF);
+    display_clear(0, 1);
+    display_clear(0, 2);
+}
+
+void mod_sleep_init(void)
+{
+    sleep_load();
+
+    menu_add_entry("SLEP",
+                   &sleep_up_pressed,
+                   &sleep_down_pressed,
+                   NULL,
+                   NULL,
+                   NULL,
+                   NULL,
+                   &sleep_activate,
+                   &sleep_deactivate);
+}
@@ -49,13 +49,15 @@
 
 /* drivers */
 #include "drivers/display.h"
+#include "drivers/ports.h"
+#include "drivers/rtca.h"
+#include "drivers/utils.h"
 #include <drivers/timer.h>
 
 /* Defines */
 
 #define SWATCH_MODE_OFF         (0u)
 #define SWATCH_MODE_ON          (1u)
-#define SWATCH_MODE_BACKGROUND  (2u)
 #define MAX_LAPS                 10
 
 /*
@@ -75,33 +77,63 @@ struct swatch_conf {
     uint8_t state;
     uint8_t laps;
     uint8_t lap_act;
+    uint8_t visible;
+    uint8_t refreshing;
 };
-//Add two extra for current time and display time
 
-#define SW_DISPLAYNG MAX_LAPS + 1
 #define SW_COUNTING  MAX_LAPS
 
-struct swatch_time sSwatch_time[MAX_LAPS + 2];
+/*
+ * Nothing counts while the stopwatch runs. It keeps the rtca_ticks() it
+ * was started at plus the time of earlier runs, and the elapsed time is
+ * only worked out when it is shown.
+ */
+static uint32_t sSwatch_start;
+static uint32_t sSwatch_offset;
+static uint32_t sSwatch_laps[MAX_LAPS];
 struct swatch_conf sSwatch_conf;
-static uint8_t icon_stopwatch_on_cents;
-static uint8_t icon_stopwatch_off_cents;
 
 static struct menu *menu_entry; // Kind of a hack in order to change the button allocation at runtime
 
 /*
  * Helper Functions
  */
+static uint32_t elapsed_stopwatch(uint32_t now) {
+    if (sSwatch_conf.state == SWATCH_MODE_OFF)
+        return sSwatch_offset;
+    return sSwatch_offset + (now - sSwatch_start);
+}
+
+/* a 32bit read is two instructions, keep the port ISR out */
+static uint32_t pressed_ticks(void) {
+    uint16_t int_state;
+    uint32_t ticks;
+
+    ENTER_CRITICAL_SECTION(int_state);
+    ticks = ports_pressed_ticks;
+    EXIT_CRITICAL_SECTION(int_state);
+
+    return ticks;
+}
+
+static void split_stopwatch(uint32_t ticks, struct swatch_time *time) {
+    uint32_t seconds = ticks >> RTCA_TICKS_SHIFT;
+
+    time->cents = ((ticks & (RTCA_TICKS_HZ - 1)) * 100) >> RTCA_TICKS_SHIFT;
+    time->seconds = seconds % 60;
+    time->minutes = (seconds / 60) % 60;
+    time->hours = (seconds / 3600) % 20;
+}
+
 static void clear_stopwatch(void) {
-    sSwatch_time[SW_COUNTING].cents = 0;
-    sSwatch_time[SW_COUNTING].hours = 0;
-    sSwatch_time[SW_COUNTING].minutes = 0;
-    sSwatch_time[SW_COUNTING].seconds = 0;
+    sSwatch_offset = 0;
     sSwatch_conf.laps = 0;
     sSwatch_conf.lap_act = SW_COUNTING;
 }
 
 static void increment_lap_stopwatch(void) {
-    sSwatch_time[sSwatch_conf.laps] = sSwatch_time[SW_COUNTING];
+    /* the lap ends at the button edge, not when the press got here */
+    sSwatch_laps[sSwatch_conf.laps] = elapsed_stopwatch(pressed_ticks());
     if (sSwatch_conf.laps < (MAX_LAPS - 1)) {
             sSwatch_conf.laps++;
         }
@@ -109,62 +141,53 @@ static void increment_lap_stopwatch(void) {
 
 /* Function to write the screen */
 static void drawStopWatchScreen(void) {
-    if (sSwatch_conf.state != SWATCH_MODE_BACKGROUND) {
-        sSwatch_time[SW_DISPLAYNG] = sSwatch_time[sSwatch_conf.lap_act];
-        if (SW_COUNTING == sSwatch_conf.lap_act) {
-            if (sSwatch_conf.state == SWATCH_MODE_OFF) {
-                display_chars(0, LCD_SEG_L1_3_0, "STOP", SEG_SET);
-            } else {
-                display_chars(0, LCD_SEG_L1_3_2, "LP", SEG_SET);
-                _printf(0, LCD_SEG_L1_1_0, "%2u", sSwatch_conf.laps);
-            }
+    struct swatch_time time;
 
+    if (SW_COUNTING == sSwatch_conf.lap_act) {
+        split_stopwatch(elapsed_stopwatch(rtca_ticks()), &time);
+        if (sSwatch_conf.state == SWATCH_MODE_OFF) {
+            display_chars(0, LCD_SEG_L1_3_0, "STOP", SEG_SET);
         } else {
             display_chars(0, LCD_SEG_L1_3_2, "LP", SEG_SET);
-            _printf(0, LCD_SEG_L1_1_0, "%2u", sSwatch_conf.lap_act +1);
-        }
-        if (sSwatch_time[SW_DISPLAYNG].minutes < 20
-                && sSwatch_time[SW_DISPLAYNG].hours == 0) {
-            _printf(0, LCD_SEG_L2_5_4, "%02u", sSwatch_time[SW_DISPLAYNG].minutes);
-            _printf(0, LCD_SEG_L2_3_2, "%02u", sSwatch_time[SW_DISPLAYNG].seconds);
-            _printf(0, LCD_SEG_L2_1_0, "%02u", sSwatch_time[SW_DISPLAYNG].cents);
-        } else {
-            _printf(0, LCD_SEG_L2_5_4, "%02u", sSwatch_time[SW_DISPLAYNG].hours);
-            _printf(0, LCD_SEG_L2_3_2, "%02u", sSwatch_time[SW_DISPLAYNG].minutes);
-            _printf(0, LCD_SEG_L2_1_0, "%02u", sSwatch_time[SW_DISPLAYNG].seconds);
+            _printf(0, LCD_SEG_L1_1_0, "%2u", sSwatch_conf.laps);
         }
+
+    } else {
+        split_stopwatch(sSwatch_laps[sSwatch_conf.lap_act], &time);
+        display_chars(0, LCD_SEG_L1_3_2, "LP", SEG_SET);
+        _printf(0, LCD_SEG_L1_1_0, "%2u", sSwatch_conf.lap_act +1);
     }
-    if (sSwatch_conf.state != SWATCH_MODE_OFF) {
-        if (sSwatch_time[SW_COUNTING].cents == icon_stopwatch_on_cents) {
-            display_symbol(0, LCD_ICON_STOPWATCH, SEG_ON);
-        } else if (sSwatch_time[SW_COUNTING].cents == icon_stopwatch_off_cents) {
-            display_symbol(0, LCD_ICON_STOPWATCH, SEG_OFF);
-        }
+    if (time.minutes < 20 && time.hours == 0) {
+        _printf(0, LCD_SEG_L2_5_4, "%02u", time.minutes);
+        _printf(0, LCD_SEG_L2_3_2, "%02u", time.seconds);
+        _printf(0, LCD_SEG_L2_1_0, "%02u", time.cents);
     } else {
-        display_symbol(0, LCD_ICON_STOPWATCH, SEG_OFF);
+        _printf(0, LCD_SEG_L2_5_4, "%02u", time.hours);
+        _printf(0, LCD_SEG_L2_3_2, "%02u", time.minutes);
+        _printf(0, LCD_SEG_L2_1_0, "%02u", time.seconds);
     }
 }
 
-/* Function called every 5ms to increment the counters */
+/* Function called every 50ms while the running stopwatch is on screen */
 static void stopwatch_event(enum sys_message msg) {
-    if (sSwatch_conf.state != SWATCH_MODE_OFF) {
-        sSwatch_time[SW_COUNTING].cents += 5;
-        if (sSwatch_time[SW_COUNTING].cents >= 100) {
-            sSwatch_time[SW_COUNTING].cents = 0;
-            sSwatch_time[SW_COUNTING].seconds++;
-            if (sSwatch_time[SW_COUNTING].seconds >= 60) {
-                sSwatch_time[SW_COUNTING].seconds = 0;
-                sSwatch_time[SW_COUNTING].minutes++;
-                if (sSwatch_time[SW_COUNTING].minutes >= 60) {
-                    sSwatch_time[SW_COUNTING].minutes = 0;
-                    sSwatch_time[SW_COUNTING].hours++;
-                    if (sSwatch_time[SW_COUNTING].hours >= 20) {
-                        sSwatch_time[SW_COUNTING].hours = 0;
-                    }
-                }
-            }
-        }
-        drawStopWatchScreen();
+    drawStopWatchScreen();
+}
+
+/* Redraw at 20Hz only while running and visible, else nothing wakes up */
+static void update_refresh(void) {
+    uint8_t refresh = sSwatch_conf.visible
+        && sSwatch_conf.state == SWATCH_MODE_ON;
+
+    if (refresh == sSwatch_conf.refreshing)
+        return;
+    sSwatch_conf.refreshing = refresh;
+
+    if (refresh) {
+        sys_messagebus_register(&stopwatch_event, SYS_MSG_TIMER_20HZ);
+        start_timer0_20hz();
+    } else {
+        stop_timer0_20hz();
+        sys_messagebus_unregister_all(&stopwatch_event);
     }
 }
 
@@ -172,24 +195,21 @@ static void stopwatch_event(enum sys_message msg) {
 static void stopwatch_activated() {
     display_symbol(0, LCD_SEG_L2_COL0, SEG_ON);
     display_symbol(0, LCD_SEG_L2_COL1, SEG_ON);
-    if (sSwatch_conf.state == SWATCH_MODE_BACKGROUND) {
-        sSwatch_conf.state = SWATCH_MODE_ON;
-    }
+    sSwatch_conf.visible = 1;
+    update_refresh();
     drawStopWatchScreen();
 }
 
 /* Deactivation of the module */
 static void stopwatch_deactivated() {
+    sSwatch_conf.visible = 0;
+    update_refresh();
+
     /* clean up screen */
     display_clear(0, 1);
     display_clear(0, 2);
-    if (sSwatch_conf.state == SWATCH_MODE_ON) {
-        sSwatch_conf.state = SWATCH_MODE_BACKGROUND;
-    } else {
-        display_symbol(0, LCD_ICON_STOPWATCH, SEG_OFF);
-        display_symbol(0, LCD_SEG_L2_COL0, SEG_OFF);
-        display_symbol(0, LCD_SEG_L2_COL1, SEG_OFF);
-    }
+    display_symbol(0, LCD_SEG_L2_COL0, SEG_OFF);
+    display_symbol(0, LCD_SEG_L2_COL1, SEG_OFF);
 }
 
 static void down_press() {
@@ -230,19 +250,19 @@ static void num_long_pressed() {
 
 static void num_press() {
     if (sSwatch_conf.state == SWATCH_MODE_OFF) {
+        sSwatch_start = pressed_ticks();
         sSwatch_conf.state = SWATCH_MODE_ON;
         sSwatch_conf.lap_act = SW_COUNTING;
         menu_entry->lnum_btn_fn = NULL;
-        icon_stopwatch_on_cents = sSwatch_time[SW_COUNTING].cents;
-        icon_stopwatch_off_cents = (icon_stopwatch_on_cents + 50) % 100;
-        sys_messagebus_register(&stopwatch_event, SYS_MSG_TIMER_20HZ);
-        start_timer0_20hz();
+        /* the LCD blinks the icon, also in the background */
+        display_symbol(0, LCD_ICON_STOPWATCH, SEG_SET | BLINK_ON);
     } else {
+        sSwatch_offset = elapsed_stopwatch(pressed_ticks());
         sSwatch_conf.state = SWATCH_MODE_OFF;
         menu_entry->lnum_btn_fn = &num_long_pressed;
-        stop_timer0_20hz();
-        sys_messagebus_unregister_all(&stopwatch_event);
+        display_symbol(0, LCD_ICON_STOPWATCH, SEG_OFF | BLINK_OFF);
     }
+    update_refresh();
     drawStopWatchScreen();
 }
 
@@ -86,6 +86,14 @@
 #include "drivers/wdt.h"
 #include "drivers/lpm.h"
 
+#ifdef CONFIG_INFOMEM
+#include "drivers/infomem.h"
+#endif
+
+#ifdef CONFIG_RTC_CAL
+#include "drivers/rtc_cal.h"
+#endif
+
 void handle_events(void)
 {
     enum sys_message msg = SYS_MSG_NONE;
@@ -108,6 +116,12 @@ void handle_events(void)
         as_last_interrupt = 0;
     }
 
+    /* drivers/vti_ps */
+    if (ps_last_interrupt) {
+        msg |= SYS_MSG_PS_INT;
+        ps_last_interrupt = 0;
+    }
+
     /* menu system */
     if (msg & SYS_MSG_RTC_SECOND) {
         menu_timeout_poll();
@@ -115,9 +129,15 @@ void handle_events(void)
 
 #ifdef CONFIG_BATTERY_MONITOR
     /* drivers/battery */
-    if (msg & SYS_MSG_RTC_MINUTE) {
+    if ((msg & SYS_MSG_RTC_MINUTE) && battery_minute()) {
         msg |= SYS_MSG_BATT;
-        battery_measurement();
+    }
+#endif
+
+#ifdef CONFIG_RTC_CAL
+    /* drivers/rtc_cal */
+    if (msg & SYS_MSG_RTC_MINUTE) {
+        rtc_cal_minute();
     }
 #endif
 
@@ -150,8 +170,8 @@ void init_application(void)
     // Allow reconfiguration during runtime:
     PMAPCTL = PMAPRECFG;
 
-    // P2.7 = TA1CCR0A output (buzzer output)
-    P2MAP7 = PM_TA1CCR0A;
+    // P2.7 = TA1CCR1A output (buzzer PWM output)
+    P2MAP7 = PM_TA1CCR1A;
     P2OUT &= ~BIT7;
     P2DIR |= BIT7;
 
@@ -178,7 +198,7 @@ void init_application(void)
     radio_reset();
     radio_powerdown();
 
-#ifdef CONFIG_MOD_ACCELEROMETER
+#ifdef AS_ENABLED
     // ---------------------------------------------------------------------
     // Init acceleration sensor
     as_init();
@@ -194,6 +214,9 @@ void init_application(void)
     // Configure Timer0 for use by the clock and delay functions
     timer0_init();
 
+    /* drivers/battery, before the buzzer reports its first load */
+    battery_init();
+
     /* Init buzzer */
     buzzer_init();
 
@@ -201,12 +224,14 @@ void init_application(void)
     // Init pressure sensor
     ps_init();
 
-    /* drivers/battery */
-    battery_init();
-
     /* drivers/temperature */
     temperature_init();
 
+#ifdef CONFIG_RTC_CAL
+    /* drivers/rtc_cal, needs the temperature */
+    rtc_cal_init();
+#endif
+
 #ifdef CONFIG_INFOMEM
     if (infomem_ready() == -2) {
         infomem_init(INFOMEM_C, INFOMEM_C + 2 * INFOMEM_SEGMENT_SIZE);
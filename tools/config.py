@@ -63,7 +63,7 @@ DATA["CONFIG_RTC_DST"] = {
     "name": "DST",
     "default": False,
     'depends': [ 'CONFIG_RTC_IRQ' ],
-    "help": "Automatically adjusts real-time clock for daylight savings time",
+    "help": "Automatically adjusts real-time clock for daylight savings time, from a table of the switches in 2012 to 2047",
 }
 
 DATA["CONFIG_RTC_DST_ZONE"] = {
@@ -74,6 +74,40 @@ DATA["CONFIG_RTC_DST_ZONE"] = {
     "help": "DST Zone: 1=DST_US, 2=DST_MEX, 3=DST_BRZ, 4=DST_EU, 5=DST_AUS, 6=DST_NZ"
 }
 
+DATA["CONFIG_RTC_CAL"] = {
+    "name": "Temperature compensation",
+    "default": False,
+    'depends': [ 'CONFIG_RTC_IRQ' ],
+    "help": "Trims the RTC crystal for its temperature every hour through RTCCAL, from a temperature reading every 10 minutes",
+}
+
+DATA["CONFIG_RTC_CAL_TURNOVER"] = {
+    "name": "Crystal turnover temperature",
+    "type": "text",
+    "default": "25",
+    "ifndef": True,
+    'depends': [ 'CONFIG_RTC_CAL' ],
+    "help": "Temperature in degrees C where the crystal runs fastest, see its datasheet",
+}
+
+DATA["CONFIG_RTC_CAL_CURVE"] = {
+    "name": "Crystal parabolic coefficient",
+    "type": "text",
+    "default": "34",
+    "ifndef": True,
+    'depends': [ 'CONFIG_RTC_CAL' ],
+    "help": "How much the crystal slows down away from the turnover temperature, in ppb per degree C squared",
+}
+
+DATA["CONFIG_RTC_CAL_OFFSET"] = {
+    "name": "Crystal offset",
+    "type": "text",
+    "default": "0",
+    "ifndef": True,
+    'depends': [ 'CONFIG_RTC_CAL' ],
+    "help": "Frequency error of this crystal at the turnover temperature in ppb, positive when the clock runs fast. 1000 ppb is about 0.6 seconds a week",
+}
+
 # TIMER0 DRIVER ##############################################################
 
 DATA["TEXT_TIMER"] = {
@@ -129,7 +163,7 @@ DATA["CONFIG_BATTERY_MONITOR"] = {
     "name": "Background Battery Monitor",
     "default": False,
     'depends': [ 'CONFIG_RTC_IRQ' ],
-    "help": "Monitors the battery voltage every minute and displays a warning on low battery. Also used by the battery to auto-refresh display, if enabled.",
+    "help": "Monitors the battery voltage and displays a warning on low battery. Measures every minute at first and after buzzer or radio use, and up to about every two hours while the voltage holds. Also used by the battery to auto-refresh display, if enabled.",
 }
 
 DATA["CONFIG_BATTERY_DISABLE_FILTER"] = {
@@ -159,6 +193,19 @@ DATA["CONFIG_TEMPERATURE_METRIC"] = {
     "help": "Show in degrees C if enabled, F otherwise.",
 }
 
+# INFOMEM DRIVER #############################################################
+
+DATA["TEXT_INFOMEM"] = {
+    "name": "Information memory driver",
+    "type": "info"
+}
+
+DATA["CONFIG_INFOMEM"] = {
+    "name": "Persistent storage in infomem",
+    "default": False,
+    "help": "Lets modules keep data in the information memory flash across resets and firmware updates.",
+}
+
 # AUTOMATICALLY GENERATED MODULE LIST ########################################
 
 DATA["TEXT_MODULES"] = {
@@ -3,6 +3,7 @@
 # vim: ts=4 noexpandtab
 
 import base64
+import re
 import time
 
 
@@ -22,11 +23,17 @@ def b32encode_each(string, decode):
         return base64.b32encode(s), None
 
 
+OTP_ALGORITHMS = ['SHA1', 'SHA256']
+
+# keystore_t fields after the key, with the defaults for a bare ID:KEY
+OTP_PARAMS = [('otp_algorithm', '0'), ('otp_digits', '6'),
+              ('otp_period', '30'), ('otp_t0', '0')]
+
+
 def b32encode(strings, decode):
     strings.strip()
     start_block = '{ '
     end_block = ' }'
-    removechars = start_block + end_block + ' '
     if decode:
         encoded_auth_secrets = strings.split(',')
         decoded_auth_list = []
@@ -42,25 +49,43 @@ def b32encode(strings, decode):
                 identifier.strip()
                 secret = colon_split_secret[1]
 
+            # optional ALGORITHM:DIGITS:PERIOD:T0, trailing ones can be left out
+            params = [p.strip() for p in colon_split_secret[2:]]
+            if params:
+                params[0] = str(OTP_ALGORITHMS.index(params[0].upper()))
+            params += [d for _, d in OTP_PARAMS[len(params):]]
+
+            # designated, so keystore_t can grow without warnings
             decoded_secret, decoded_secret_len = b32encode_each(secret, True)
-            decoded_auth_list.append(start_block + '"' + identifier + '"')
-            decoded_auth_list.append(decoded_secret)
-            decoded_auth_list.append(str(decoded_secret_len) + end_block)
+            fields = ['.otp_identifier = "' + identifier + '"',
+                      '.otp_key = ' + decoded_secret,
+                      '.otp_key_len = ' + str(decoded_secret_len)]
+            fields += ['.%s = %s' % (n, v) for (n, _), v in zip(OTP_PARAMS, params)]
+            decoded_auth_list.append(start_block + ", ".join(fields) + end_block)
 
-        return start_block + ",".join(decoded_auth_list) + end_block
+        return start_block + ", ".join(decoded_auth_list) + end_block
 
     else:
-        for c in removechars:
-            strings = strings.replace(c, '')
-        strings.strip()
         encoded_auth_list = []
-        decoded_auth_secrets = strings.split(',')
-        for identifier, decoded_secret, secret_len in zip(*[iter(decoded_auth_secrets)] * 3):
-            identifier = identifier.replace('"', '')
-            encoded_secret, _ = b32encode_each(decoded_secret, False)
+        for block in re.findall(r'\{([^{}]*)\}', strings):
+            fields = [f.strip() for f in block.split(',')]
+            if '=' in block:
+                named = dict([f.lstrip('.').split('=', 1) for f in fields])
+                named = dict([(k.strip(), v.strip()) for k, v in named.items()])
+                fields = [named['otp_identifier'], named['otp_key'],
+                          named['otp_key_len']]
+                fields += [named.get(n, d) for n, d in OTP_PARAMS]
+            identifier = fields[0].replace('"', '')
+            encoded_secret, _ = b32encode_each(fields[1], False)
+            params = fields[3:]
+            # leave out the trailing defaults
+            while params and params[-1] == OTP_PARAMS[len(params) - 1][1]:
+                params.pop()
+            if params:
+                params[0] = OTP_ALGORITHMS[int(params[0])]
             if not identifier[0].isdigit():
                 encoded_secret = identifier + ':' + encoded_secret
-            encoded_auth_list.append(encoded_secret)
+            encoded_auth_list.append(":".join([encoded_secret] + params))
         return ",".join(encoded_auth_list)
 
 
@@ -0,0 +1,96 @@
+#!/usr/bin/env python
+# encoding: utf-8
+# vim: set ts=4 :
+#
+# This file is part of openchronos-ng.
+#
+# openchronos-ng is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# openchronos-ng is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+# Writes drivers/rtc_dst_table.h, the DST transition days of every zone
+# in drivers/rtc_dst.h for the years FIRST_YEAR to LAST_YEAR. The firmware
+# compiles in the table of CONFIG_RTC_DST_ZONE only.
+
+import datetime
+import sys
+
+FIRST_YEAR = 2012
+LAST_YEAR = 2047
+
+# zone: ((month, nth sunday) DST starts, (month, nth sunday) DST ends),
+# nth -1 is the last sunday of the month
+ZONES = (
+    ('DST_US', 'US/Canada', (3, 2), (11, 1)),
+    ('DST_MEX', 'Mexico', (4, 1), (10, -1)),
+    ('DST_BRZ', 'Brazil', (10, 3), (2, 3)),
+    ('DST_EU', 'EU/UK', (3, -1), (10, -1)),
+    ('DST_AUS', 'Australia', (10, 1), (4, 1)),
+    ('DST_NZ', 'New Zealand', (9, -1), (4, 1)),
+)
+
+BASE = datetime.date(FIRST_YEAR, 1, 1)
+
+
+def sunday(year, month, nth):
+    """ The date of the nth (or with -1 the last) sunday of a month """
+    if nth < 0:
+        first = datetime.date(year + month // 12, month % 12 + 1, 1)
+        day = first - datetime.timedelta(days=1)
+        return day - datetime.timedelta(days=(day.weekday() + 1) % 7)
+    day = datetime.date(year, month, 7 * nth)
+    return day - datetime.timedelta(days=(day.weekday() + 1) % 7)
+
+
+def transitions(start, end):
+    """ Days since BASE of all transitions, in order """
+    days = list()
+    for year in range(FIRST_YEAR, LAST_YEAR + 1):
+        for month, nth in sorted((start, end)):
+            days.append((sunday(year, month, nth) - BASE).days)
+    return days
+
+
+def main(path):
+    epoch = (BASE - datetime.date(1970, 1, 1)).days * 86400
+    out = list()
+    out.append("/* This file is autogenerated by tools/make_rtc_dst.py, do not edit! */")
+    out.append("")
+    out.append("#ifndef __RTC_DST_TABLE_H__")
+    out.append("#define __RTC_DST_TABLE_H__")
+    out.append("")
+    out.append("/* transitions happen at 02:00 local time on the days since this */")
+    out.append("#define RTC_DST_TABLE_EPOCH %dul /* %s */" % (epoch, BASE.isoformat()))
+    out.append("#define RTC_DST_TABLE_YEARS %d" % (LAST_YEAR - FIRST_YEAR + 1))
+
+    for name, title, start, end in ZONES:
+        days = transitions(start, end)
+        out.append("")
+        out.append("#if (CONFIG_RTC_DST_ZONE == %s)" % name)
+        out.append("/* %s, %d to %d */" % (title, FIRST_YEAR, LAST_YEAR))
+        out.append("#define RTC_DST_TABLE_STARTS_DST %d" % (start[0] < end[0]))
+        out.append("static const uint16_t rtc_dst_table[%d] = {" % len(days))
+        for i in range(0, len(days), 8):
+            out.append("    " + ", ".join("%5d" % d for d in days[i:i + 8]) + ",")
+        out.append("};")
+        out.append("#endif")
+
+    out.append("")
+    out.append("#endif /* __RTC_DST_TABLE_H__ */")
+
+    f = open(path, 'w')
+    f.write("\n".join(out) + "\n")
+    f.close()
+
+
+if __name__ == '__main__':
+    main(len(sys.argv) > 1 and sys.argv[1] or 'drivers/rtc_dst_table.h')